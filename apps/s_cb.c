@@ -1391,6 +1391,34 @@ void print_ssl_summary(SSL *s)
 #endif
 }
 
+/* Prints the timing of the last handshake, if it was timed */
+void print_handshake_timing(BIO *bio, SSL *s)
+{
+    OSSL_HANDSHAKE_STATE state;
+    const char *desc;
+    uint64_t nsec, count;
+    size_t i, bytes;
+    int phase, sent;
+
+    if (!SSL_get_handshake_phase(s, SSL_HS_PHASE_TOTAL, &nsec, &count)
+            || count == 0)
+        return;
+    BIO_printf(bio, "---\nHandshake phases (usec):\n");
+    for (phase = 0; phase < SSL_HS_PHASE_NUM; phase++) {
+        if (SSL_get_handshake_phase(s, phase, &nsec, &count) && count > 0)
+            BIO_printf(bio, "    %-10s %12.1f  x%u\n",
+                       SSL_handshake_phase_name(phase), nsec / 1000.0,
+                       (unsigned int)count);
+    }
+    BIO_printf(bio, "Handshake flights (usec from start):\n");
+    for (i = 0; SSL_get_handshake_flight(s, i, &sent, &bytes, &nsec); i++)
+        BIO_printf(bio, "    %12.1f  %s %zu bytes\n", nsec / 1000.0,
+                   sent ? "sent" : "received", bytes);
+    BIO_printf(bio, "Handshake transitions (usec from start):\n");
+    for (i = 0; SSL_get_handshake_transition(s, i, &state, &desc, &nsec); i++)
+        BIO_printf(bio, "    %12.1f  %s\n", nsec / 1000.0, desc);
+}
+
 int config_ctx(SSL_CONF_CTX *cctx, STACK_OF(OPENSSL_STRING) *str,
                SSL_CTX *ctx)
 {
@@ -585,6 +585,7 @@ typedef enum OPTION_choice {
     OPT_KEY, OPT_RECONNECT, OPT_BUILD_CHAIN, OPT_CAFILE, OPT_NOCAFILE,
     OPT_CHAINCAFILE, OPT_VERIFYCAFILE, OPT_NEXTPROTONEG, OPT_ALPN,
     OPT_SERVERINFO, OPT_STARTTLS, OPT_SERVERNAME, OPT_NOSERVERNAME, OPT_ASYNC,
+    OPT_HS_TIMING, OPT_KTLS,
     OPT_USE_SRTP, OPT_KEYMATEXPORT, OPT_KEYMATEXPORTLEN, OPT_PROTOHOST,
     OPT_MAXFRAGLEN, OPT_MAX_SEND_FRAG, OPT_SPLIT_SEND_FRAG, OPT_MAX_PIPELINES,
     OPT_READ_BUF, OPT_KEYLOG_FILE, OPT_EARLY_DATA, OPT_REQCAFILE,
@@ -712,6 +713,8 @@ const OPTIONS s_client_options[] = {
     {"alpn", OPT_ALPN, 's',
      "Enable ALPN extension, considering named protocols supported (comma-separated list)"},
     {"async", OPT_ASYNC, '-', "Support asynchronous operation"},
+    {"hs_timing", OPT_HS_TIMING, '-', "Print the timing of each handshake"},
+    {"ktls", OPT_KTLS, '-', "Hand the record layer to the kernel if possible"},
     {"ssl_config", OPT_SSL_CONFIG, 's', "Use specified configuration file"},
     {"max_send_frag", OPT_MAX_SEND_FRAG, 'p', "Maximum Size of send frames "},
     {"split_send_frag", OPT_SPLIT_SEND_FRAG, 'p',
@@ -961,7 +964,7 @@ int s_client_main(int argc, char **argv)
     int ct_validation = 0;
 #endif
     int min_version = 0, max_version = 0, prot_opt = 0, no_prot_opt = 0;
-    int async = 0;
+    int async = 0, hs_timing = 0, ktls = 0;
     unsigned int max_send_fragment = 0;
     unsigned int split_send_fragment = 0, max_pipelines = 0;
     enum { use_inet, use_unix, use_unknown } connect_type = use_unknown;
@@ -1484,6 +1487,12 @@ int s_client_main(int argc, char **argv)
         case OPT_ASYNC:
             async = 1;
             break;
+        case OPT_HS_TIMING:
+            hs_timing = 1;
+            break;
+        case OPT_KTLS:
+            ktls = 1;
+            break;
         case OPT_MAXFRAGLEN:
             len = atoi(opt_arg());
             switch (len) {
@@ -1761,6 +1770,14 @@ int s_client_main(int argc, char **argv)
         SSL_CTX_set_mode(ctx, SSL_MODE_ASYNC);
     }
 
+    if (ktls)
+        SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_KTLS);
+
+    if (hs_timing && !SSL_CTX_set_handshake_timing(ctx, 1)) {
+        ERR_print_errors(bio_err);
+        goto end;
+    }
+
     if (max_send_fragment > 0
         && !SSL_CTX_set_max_send_fragment(ctx, max_send_fragment)) {
         BIO_printf(bio_err, "%s: Max send fragment size %u is out of permitted range\n",
@@ -2783,6 +2800,8 @@ int s_client_main(int argc, char **argv)
                 print_stuff(bio_c_out, con, full_log);
                 if (full_log > 0)
                     full_log--;
+                if (hs_timing)
+                    print_handshake_timing(bio_c_out, con);
 
                 if (starttls_proto) {
                     BIO_write(bio_err, mbuf, mbuf_len);
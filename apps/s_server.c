@@ -102,6 +102,9 @@ static char *keymatexportlabel = NULL;
 static int keymatexportlen = 20;
 
 static int async = 0;
+static int s_hs_timing = 0;
+static int s_ktls = 0;
+static int s_sendfile = 0;
 
 static const char *session_id_prefix = NULL;
 
@@ -740,7 +743,8 @@ typedef enum OPTION_choice {
     OPT_CRLF, OPT_QUIET, OPT_BRIEF, OPT_NO_DHE,
     OPT_NO_RESUME_EPHEMERAL, OPT_PSK_IDENTITY, OPT_PSK_HINT, OPT_PSK,
     OPT_PSK_SESS, OPT_SRPVFILE, OPT_SRPUSERSEED, OPT_REV, OPT_WWW,
-    OPT_UPPER_WWW, OPT_HTTP, OPT_ASYNC, OPT_SSL_CONFIG,
+    OPT_UPPER_WWW, OPT_HTTP, OPT_ASYNC, OPT_HS_TIMING, OPT_KTLS, OPT_SENDFILE,
+    OPT_SSL_CONFIG,
     OPT_MAX_SEND_FRAG, OPT_SPLIT_SEND_FRAG, OPT_MAX_PIPELINES, OPT_READ_BUF,
     OPT_SSL3, OPT_TLS1_3, OPT_TLS1_2, OPT_TLS1_1, OPT_TLS1, OPT_DTLS, OPT_DTLS1,
     OPT_DTLS1_2, OPT_SCTP, OPT_TIMEOUT, OPT_MTU, OPT_LISTEN, OPT_STATELESS,
@@ -880,6 +884,10 @@ const OPTIONS s_server_options[] = {
     {"rev", OPT_REV, '-',
      "act as a simple test server which just sends back with the received text reversed"},
     {"async", OPT_ASYNC, '-', "Operate in asynchronous mode"},
+    {"hs_timing", OPT_HS_TIMING, '-', "Print the timing of each handshake"},
+    {"ktls", OPT_KTLS, '-', "Hand the record layer to the kernel if possible"},
+    {"sendfile", OPT_SENDFILE, '-',
+     "Send files with SSL_sendfile() for -WWW and -HTTP"},
     {"ssl_config", OPT_SSL_CONFIG, 's',
      "Configure SSL_CTX using the configuration 'val'"},
     {"max_send_frag", OPT_MAX_SEND_FRAG, 'p', "Maximum Size of send frames "},
@@ -1062,6 +1070,9 @@ int s_server_main(int argc, char *argv[])
     s_quiet = 0;
     s_brief = 0;
     async = 0;
+    s_hs_timing = 0;
+    s_ktls = 0;
+    s_sendfile = 0;
 
     cctx = SSL_CONF_CTX_new();
     vpm = X509_VERIFY_PARAM_new();
@@ -1558,6 +1569,15 @@ int s_server_main(int argc, char *argv[])
         case OPT_ASYNC:
             async = 1;
             break;
+        case OPT_HS_TIMING:
+            s_hs_timing = 1;
+            break;
+        case OPT_KTLS:
+            s_ktls = 1;
+            break;
+        case OPT_SENDFILE:
+            s_sendfile = 1;
+            break;
         case OPT_MAX_SEND_FRAG:
             max_send_fragment = atoi(opt_arg());
             break;
@@ -1839,6 +1859,14 @@ int s_server_main(int argc, char *argv[])
         SSL_CTX_set_mode(ctx, SSL_MODE_ASYNC);
     }
 
+    if (s_ktls)
+        SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_KTLS);
+
+    if (s_hs_timing && !SSL_CTX_set_handshake_timing(ctx, 1)) {
+        ERR_print_errors(bio_err);
+        goto end;
+    }
+
     if (max_send_fragment > 0
         && !SSL_CTX_set_max_send_fragment(ctx, max_send_fragment)) {
         BIO_printf(bio_err, "%s: Max send fragment size %u is out of permitted range\n",
@@ -2899,6 +2927,8 @@ static void print_connection_info(SSL *con)
 #endif
     if (SSL_session_reused(con))
         BIO_printf(bio_s_out, "Reused session-id\n");
+    if (s_hs_timing)
+        print_handshake_timing(bio_s_out, con);
     BIO_printf(bio_s_out, "Secure Renegotiation IS%s supported\n",
                SSL_get_secure_renegotiation_support(con) ? "" : " NOT");
     if ((SSL_get_options(con) & SSL_OP_NO_RENEGOTIATION))
@@ -2942,6 +2972,36 @@ static DH *load_dh_param(const char *dhfile)
 }
 #endif
 
+/* Sends the headers buffered in |io|, then |file| with SSL_sendfile() */
+static void www_sendfile(SSL *con, BIO *io, BIO *file)
+{
+    FILE *fp = NULL;
+    off_t offset = 0;
+    ossl_ssize_t n;
+
+    for (;;) {
+        if (BIO_flush(io) > 0)
+            break;
+        if (!BIO_should_retry(io))
+            return;
+    }
+    BIO_get_fp(file, &fp);
+    for (;;) {
+        n = SSL_sendfile(con, fileno(fp), offset, SIZE_MAX, 0);
+        if (n == 0)
+            return;
+        if (n < 0) {
+            if (SSL_get_error(con, (int)n) != SSL_ERROR_WANT_WRITE) {
+                ERR_print_errors(bio_err);
+                return;
+            }
+            BIO_printf(bio_s_out, "rwrite W BLOCK\n");
+            continue;
+        }
+        offset += (off_t)n;
+    }
+}
+
 static int www_body(int s, int stype, int prot, unsigned char *context)
 {
     char *buf = NULL;
@@ -3275,6 +3335,12 @@ static int www_body(int s, int stype, int prot, unsigned char *context)
                     BIO_puts(io,
                              "HTTP/1.0 200 ok\r\nContent-type: text/plain\r\n\r\n");
             }
+            if (s_sendfile) {
+                www_sendfile(con, io, file);
+                BIO_free(file);
+                break;
+            }
+
             /* send the file */
             for (;;) {
                 i = BIO_read(file, buf, bufsize);
@@ -112,6 +112,13 @@ extern int* get_oqssl_sig_nids();
 extern int oqs_size(const EVP_PKEY *pkey);
 #endif
 #include <openssl/modes.h>
+#if !defined(OPENSSL_NO_OQSKEM) || !defined(OPENSSL_NO_OQSSIG)
+# include <time.h>
+# if defined(OPENSSL_THREADS) && !defined(OPENSSL_SYS_WINDOWS)
+#  include <pthread.h>
+#  define PQ_THREADS
+# endif
+#endif
 
 #ifndef HAVE_FORK
 # if defined(OPENSSL_SYS_VMS) || defined(OPENSSL_SYS_WINDOWS) || defined(OPENSSL_SYS_VXWORKS)
@@ -319,7 +326,8 @@ typedef enum OPTION_choice {
     OPT_ERR = -1, OPT_EOF = 0, OPT_HELP,
     OPT_ELAPSED, OPT_EVP, OPT_DECRYPT, OPT_ENGINE, OPT_MULTI,
     OPT_MR, OPT_MB, OPT_MISALIGN, OPT_ASYNCJOBS, OPT_R_ENUM,
-    OPT_PRIMES, OPT_SECONDS, OPT_BYTES, OPT_AEAD
+    OPT_PRIMES, OPT_SECONDS, OPT_BYTES, OPT_AEAD,
+    OPT_VERIFY_BATCH, OPT_THREADS, OPT_JSON, OPT_SIG_MSGLEN
 } OPTION_CHOICE;
 
 const OPTIONS speed_options[] = {
@@ -354,6 +362,18 @@ const OPTIONS speed_options[] = {
      "Run [non-PKI] benchmarks on custom-sized buffer"},
     {"misalign", OPT_MISALIGN, 'p',
      "Use specified offset to mis-align buffers"},
+#ifndef OPENSSL_NO_OQSSIG
+    {"verify_batch", OPT_VERIFY_BATCH, 'p',
+     "Also verify OQS signatures in batches of the specified size"},
+    {"sig_msglen", OPT_SIG_MSGLEN, 'p',
+     "Length of the message signed by OQS signatures (default 20)"},
+#endif
+#if !defined(OPENSSL_NO_OQSKEM) || !defined(OPENSSL_NO_OQSSIG)
+    {"threads", OPT_THREADS, 's',
+     "Comma-separated thread counts for the OQS KEM and signature benchmarks"},
+    {"json", OPT_JSON, '>',
+     "Also write the OQS KEM and signature results as JSON to this file"},
+#endif
     {NULL}
 };
 
@@ -611,16 +631,39 @@ static OPT_PAIR eddsa_choices[] = {
 static double eddsa_results[EdDSA_NUM][2];    /* 2 ops: sign then verify */
 #endif /* OPENSSL_NO_EC */
 
+#if !defined(OPENSSL_NO_OQSKEM) || !defined(OPENSSL_NO_OQSSIG)
+# define PQ_MAX_RUNS     16     /* entries in the -threads list */
+# define PQ_MAX_THREADS  1024
+
+typedef struct pq_result_st {
+    double ops;                 /* operations per second, all threads */
+    double p50;                 /* latency percentiles in microseconds */
+    double p99;
+} PQ_RESULT;
+
+static int pq_threads[PQ_MAX_RUNS] = { 1 };
+static int pq_runs = 1;
+static const char *json_file = NULL;
+#endif
+
 #ifndef OPENSSL_NO_OQSKEM
-# define OQSKEM_NUM      OQS_OPENSSL_KEM_algs_length 
+/* Every PQ KEM and its hybrid, without the oqs_kem_default aliases */
+# define OQSKEM_NUM      (NID_p521_hqc256_3_cca2 - NID_oqs_kem_default - 1)
+static int oqskem_nids[OQSKEM_NUM];
 static OPT_PAIR oqskem_choices[OQSKEM_NUM];
-static double oqskem_results[OQSKEM_NUM][3];
+static PQ_RESULT oqskem_results[OQSKEM_NUM][PQ_MAX_RUNS][3];
+static const char *const oqskem_op_names[3] = { "keygen", "encaps", "decaps" };
 # endif
 
 #ifndef OPENSSL_NO_OQSSIG
 # define OQSSIG_NUM      OQS_OPENSSL_SIG_algs_length 
 static OPT_PAIR oqssig_choices[OQSSIG_NUM];
-static double oqssig_results[OQSSIG_NUM][3]; // generate,sign,verify
+static PQ_RESULT oqssig_results[OQSSIG_NUM][PQ_MAX_RUNS][3];
+static const char *const oqssig_op_names[3] = {
+    "sign", "verify", "batch_verify"
+};
+static int verify_batch = 0;
+static int sig_msglen = 20;
 # endif
 
 #ifndef SIGALRM
@@ -654,11 +697,6 @@ typedef struct loopargs_st {
     unsigned char *secret_a;
     unsigned char *secret_b;
     size_t outlen[EC_NUM];
-#endif
-#ifndef OPENSSL_NO_OQSSIG
-    EC_KEY *oqssig[OQSSIG_NUM];
-    EVP_MD_CTX *oqssig_ctx[OQSSIG_NUM];
-    size_t oqs_outlen[OQSSIG_NUM];
 #endif
     EVP_CIPHER_CTX *ctx;
     HMAC_CTX *hctx;
@@ -1269,56 +1307,620 @@ static int EdDSA_verify_loop(void *args)
 }
 #endif                          /* OPENSSL_NO_EC */
 
-#ifndef OPENSSL_NO_OQSSIG
-static long oqssig_c[OQSSIG_NUM][2];
-static int OQS_sign_loop(void *args)
+#if !defined(OPENSSL_NO_OQSKEM) || !defined(OPENSSL_NO_OQSSIG)
+/*
+ * The OQS KEM and signature benchmarks run each operation for a fixed
+ * wall-clock time on one or more threads that share the same keys, so that
+ * contention on shared key material shows up in the results.  Every
+ * operation includes its context set-up, as in a TLS handshake.  Latencies
+ * go into a histogram with 16 linear buckets per power of two nanoseconds,
+ * which gives the p50 and p99 to within about 6%.
+ */
+# define PQ_LAT_SUB_BITS 4
+# define PQ_LAT_BUCKETS  (64 << PQ_LAT_SUB_BITS)
+
+typedef struct pq_bench_st {
+    int (*op)(void *shared, void *state);
+    void *(*state_new)(void *shared);
+    void (*state_free)(void *state);
+    void *shared;
+    int ops_per_call;
+    uint64_t ns;                /* how long each thread runs */
+} PQ_BENCH;
+
+typedef struct pq_thread_st {
+    const PQ_BENCH *bench;
+    void *state;
+    long count;
+    uint64_t elapsed;
+    int error;
+    uint64_t latency[PQ_LAT_BUCKETS];
+} PQ_THREAD;
+
+static uint64_t pq_now(void)
 {
-    loopargs_t *tempargs = *(loopargs_t **) args;
-    unsigned char *buf = tempargs->buf;
-    EVP_MD_CTX **oqsctx = tempargs->oqssig_ctx;
-    unsigned char *oqssig = tempargs->buf2;
-    size_t sigsize_store = tempargs->sigsize;
-    int ret, count;
+# if defined(_WIN32)
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+# else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+# endif
+}
 
-    for (count = 0; COND(oqssig_c[testnum][0]); count++) {
-        /* OQS algs destroy this so we must retain it for repeated runs */
-        sigsize_store = tempargs->sigsize;
+static unsigned int pq_latency_bucket(uint64_t ns)
+{
+    unsigned int msb = 0;
+    uint64_t v;
+
+    if (ns < (2 << PQ_LAT_SUB_BITS))
+        return (unsigned int)ns;
+    for (v = ns; v > 1; v >>= 1)
+        msb++;
+    return ((msb - PQ_LAT_SUB_BITS + 1) << PQ_LAT_SUB_BITS)
+           + (unsigned int)((ns >> (msb - PQ_LAT_SUB_BITS))
+                            & ((1 << PQ_LAT_SUB_BITS) - 1));
+}
 
-        ret = EVP_DigestSign(oqsctx[testnum], oqssig, &sigsize_store, buf, 20);
-        if (ret == 0) {
-            BIO_printf(bio_err, "OQS sign failure\n");
-            ERR_print_errors(bio_err);
-            count = -1;
+/* Returns the midpoint of a latency bucket in microseconds */
+static double pq_latency_value(unsigned int bucket)
+{
+    int shift = (int)(bucket >> PQ_LAT_SUB_BITS) - 1;
+    double lower;
+
+    if (shift <= 0)
+        return bucket / 1000.0;
+    lower = (double)((bucket & ((1 << PQ_LAT_SUB_BITS) - 1))
+                     + (1 << PQ_LAT_SUB_BITS));
+    return (lower + 0.5) * (double)((uint64_t)1 << shift) / 1000.0;
+}
+
+static double pq_latency_percentile(const uint64_t *latency, double q)
+{
+    uint64_t total = 0, target, seen = 0;
+    unsigned int i;
+
+    for (i = 0; i < PQ_LAT_BUCKETS; i++)
+        total += latency[i];
+    target = (uint64_t)ceil(q * (double)total);
+    if (target == 0)
+        target = 1;
+    for (i = 0; i < PQ_LAT_BUCKETS; i++) {
+        seen += latency[i];
+        if (seen >= target)
+            return pq_latency_value(i);
+    }
+    return 0;
+}
+
+static void pq_run(PQ_THREAD *t)
+{
+    const PQ_BENCH *b = t->bench;
+    uint64_t start = pq_now(), now = start, before;
+
+    while (now - start < b->ns) {
+        before = now;
+        if (!b->op(b->shared, t->state)) {
+            t->error = 1;
             break;
         }
+        now = pq_now();
+        t->latency[pq_latency_bucket(now - before)]++;
+        t->count += b->ops_per_call;
     }
-    // return final &tempargs->sigsize so verify finds a good value
-    tempargs->sigsize = sigsize_store; 
-    return count;
+    t->elapsed = now - start;
 }
 
-static int OQS_verify_loop(void *args)
+# ifdef PQ_THREADS
+static void *pq_thread_main(void *arg)
 {
-    loopargs_t *tempargs = *(loopargs_t **) args;
-    unsigned char *buf = tempargs->buf;
-    EVP_MD_CTX **oqsctx = tempargs->oqssig_ctx;
-    unsigned char *oqssig = tempargs->buf2;
-    size_t oqssigsize = tempargs->sigsize;
-    int ret, count;
+    pq_run(arg);
+    return NULL;
+}
+# endif
 
-    for (count = 0; COND(oqssig_c[testnum][1]); count++) {
-        ret = EVP_DigestVerify(oqsctx[testnum], oqssig, oqssigsize, buf, 20);
-        if (ret != 1) {
-            BIO_printf(bio_err, "OQS verify failure\n");
-            ERR_print_errors(bio_err);
-            count = -1;
-            break;
+/*
+ * Runs |b| on |nthreads| threads, the calling one included, and fills in
+ * |res|.  Returns 1 on success or 0 if an operation failed.
+ */
+static int pq_bench_run(const PQ_BENCH *b, int nthreads, PQ_RESULT *res)
+{
+    PQ_THREAD *t = app_malloc(sizeof(*t) * nthreads, "benchmark threads");
+# ifdef PQ_THREADS
+    pthread_t *tid = app_malloc(sizeof(*tid) * nthreads, "thread ids");
+    int started = 1;
+# endif
+    int i, j, ok = 1;
+
+    memset(t, 0, sizeof(*t) * nthreads);
+    for (i = 0; i < nthreads; i++) {
+        t[i].bench = b;
+        if ((t[i].state = b->state_new(b->shared)) == NULL)
+            ok = 0;
+    }
+    if (ok) {
+# ifdef PQ_THREADS
+        for (; started < nthreads; started++) {
+            if (pthread_create(&tid[started], NULL, pq_thread_main,
+                               &t[started]) != 0) {
+                BIO_printf(bio_err, "Unable to start benchmark thread\n");
+                ok = 0;
+                break;
+            }
         }
+# endif
+        pq_run(&t[0]);
+# ifdef PQ_THREADS
+        for (i = 1; i < started; i++)
+            pthread_join(tid[i], NULL);
+# endif
     }
-    return count;
+
+    memset(res, 0, sizeof(*res));
+    for (i = 0; i < nthreads; i++) {
+        if (t[i].error)
+            ok = 0;
+        if (t[i].elapsed > 0)
+            res->ops += (double)t[i].count * 1e9 / (double)t[i].elapsed;
+        if (i > 0)
+            for (j = 0; j < PQ_LAT_BUCKETS; j++)
+                t[0].latency[j] += t[i].latency[j];
+        if (t[i].state != NULL)
+            b->state_free(t[i].state);
+    }
+    res->p50 = pq_latency_percentile(t[0].latency, 0.50);
+    res->p99 = pq_latency_percentile(t[0].latency, 0.99);
+
+    OPENSSL_free(t);
+# ifdef PQ_THREADS
+    OPENSSL_free(tid);
+# endif
+    return ok;
+}
+
+static int pq_bench(const PQ_BENCH *b, const char *name, const char *op,
+                    int nthreads, int tm, PQ_RESULT *res)
+{
+    BIO_printf(bio_err,
+               mr ? "+DTP:%s:%s:%d:%d\n"
+               : "Doing %s %s's for %ds on %d thread(s): ",
+               name, op, tm, nthreads);
+    (void)BIO_flush(bio_err);
+    if (!pq_bench_run(b, nthreads, res)) {
+        BIO_printf(bio_err, "OQS %s failure\n", op);
+        ERR_print_errors(bio_err);
+        return 0;
+    }
+    if (mr)
+        BIO_printf(bio_err, "+R12:%s:%s:%d:%.1f:%.2f:%.2f\n",
+                   name, op, nthreads, res->ops, res->p50, res->p99);
+    else
+        BIO_printf(bio_err, "%.1f %s's/s, p50 %.2fus, p99 %.2fus\n",
+                   res->ops, op, res->p50, res->p99);
+    return 1;
+}
+
+/*
+ * Returns the NID of the classical half of a hybrid OQS scheme, which the
+ * scheme is named after, or 0
+ */
+static int pq_classical_nid(int nid)
+{
+    static const struct {
+        const char *prefix;
+        int nid;
+    } halves[] = {
+        {"p256_", NID_X9_62_prime256v1},
+        {"p384_", NID_secp384r1},
+        {"p521_", NID_secp521r1},
+        {"rsa3072_", NID_rsaEncryption},
+    };
+    const char *sn = OBJ_nid2sn(nid);
+    size_t i;
+
+    for (i = 0; sn != NULL && i < OSSL_NELEM(halves); i++) {
+        if (strncmp(sn, halves[i].prefix, strlen(halves[i].prefix)) == 0)
+            return halves[i].nid;
+    }
+    return 0;
+}
+
+/* Classical half of a hybrid key exchange */
+static EVP_PKEY *pq_ec_keygen(int nid)
+{
+    EVP_PKEY *pkey = NULL;
+# ifndef OPENSSL_NO_EC
+    EVP_PKEY_CTX *kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+
+    if (kctx == NULL
+            || EVP_PKEY_keygen_init(kctx) <= 0
+            || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx, nid) <= 0
+            || EVP_PKEY_keygen(kctx, &pkey) <= 0) {
+        EVP_PKEY_free(pkey);
+        pkey = NULL;
+    }
+    EVP_PKEY_CTX_free(kctx);
+# endif
+    return pkey;
+}
+
+static int pq_ecdh(EVP_PKEY *priv, EVP_PKEY *peer)
+{
+    EVP_PKEY_CTX *dctx = EVP_PKEY_CTX_new(priv, NULL);
+    unsigned char secret[MAX_ECDH_SIZE];
+    size_t secretlen = sizeof(secret);
+    int ok = dctx != NULL
+             && EVP_PKEY_derive_init(dctx) > 0
+             && EVP_PKEY_derive_set_peer(dctx, peer) > 0
+             && EVP_PKEY_derive(dctx, secret, &secretlen) > 0;
+
+    EVP_PKEY_CTX_free(dctx);
+    return ok;
+}
+#endif
+
+#ifndef OPENSSL_NO_OQSKEM
+typedef struct pq_kem_st {
+    OQS_KEM *kem;
+    int classical_nid;          /* curve of a hybrid, 0 otherwise */
+    EVP_PKEY *client_key;       /* classical halves of a hybrid exchange */
+    EVP_PKEY *server_key;
+    unsigned char *public_key;
+    unsigned char *secret_key;
+    unsigned char *ciphertext;
+} PQ_KEM;
+
+typedef struct pq_kem_state_st {
+    unsigned char *public_key;
+    unsigned char *secret_key;
+    unsigned char *ciphertext;
+    unsigned char *shared_secret;
+} PQ_KEM_STATE;
+
+static void *pq_kem_state_new(void *shared)
+{
+    const OQS_KEM *kem = ((PQ_KEM *)shared)->kem;
+    PQ_KEM_STATE *s = app_malloc(sizeof(*s), "KEM state");
+
+    s->public_key = app_malloc(kem->length_public_key, "KEM public key");
+    s->secret_key = app_malloc(kem->length_secret_key, "KEM secret key");
+    s->ciphertext = app_malloc(kem->length_ciphertext, "KEM ciphertext");
+    s->shared_secret = app_malloc(kem->length_shared_secret,
+                                  "KEM shared secret");
+    return s;
+}
+
+static void pq_kem_state_free(void *state)
+{
+    PQ_KEM_STATE *s = state;
+
+    OPENSSL_free(s->public_key);
+    OPENSSL_free(s->secret_key);
+    OPENSSL_free(s->ciphertext);
+    OPENSSL_free(s->shared_secret);
+    OPENSSL_free(s);
+}
+
+/* A client key share: the classical key pair and the KEM key pair */
+static int pq_kem_keygen(void *shared, void *state)
+{
+    PQ_KEM *k = shared;
+    PQ_KEM_STATE *s = state;
+
+    if (k->classical_nid != 0) {
+        EVP_PKEY *pkey = pq_ec_keygen(k->classical_nid);
+
+        if (pkey == NULL)
+            return 0;
+        EVP_PKEY_free(pkey);
+    }
+    return OQS_KEM_keypair(k->kem, s->public_key, s->secret_key)
+           == OQS_SUCCESS;
+}
+
+/* A server key share: ephemeral ECDH with the client and encapsulation */
+static int pq_kem_encaps(void *shared, void *state)
+{
+    PQ_KEM *k = shared;
+    PQ_KEM_STATE *s = state;
+
+    if (k->classical_nid != 0) {
+        EVP_PKEY *pkey = pq_ec_keygen(k->classical_nid);
+        int ok = pkey != NULL && pq_ecdh(pkey, k->client_key);
+
+        EVP_PKEY_free(pkey);
+        if (!ok)
+            return 0;
+    }
+    return OQS_KEM_encaps(k->kem, s->ciphertext, s->shared_secret,
+                          k->public_key) == OQS_SUCCESS;
+}
+
+/* The client side of the server key share */
+static int pq_kem_decaps(void *shared, void *state)
+{
+    PQ_KEM *k = shared;
+    PQ_KEM_STATE *s = state;
+
+    if (k->classical_nid != 0 && !pq_ecdh(k->client_key, k->server_key))
+        return 0;
+    return OQS_KEM_decaps(k->kem, s->shared_secret, k->ciphertext,
+                          k->secret_key) == OQS_SUCCESS;
+}
+
+static void pq_kem_cleanup(PQ_KEM *k)
+{
+    EVP_PKEY_free(k->client_key);
+    EVP_PKEY_free(k->server_key);
+    OPENSSL_free(k->public_key);
+    OPENSSL_free(k->secret_key);
+    OPENSSL_free(k->ciphertext);
+    OQS_KEM_free(k->kem);
+}
+
+/* Sets up the keys and ciphertext that all threads share */
+static int pq_kem_setup(PQ_KEM *k, int nid)
+{
+    unsigned char *shared_secret;
+    int ok;
+
+    memset(k, 0, sizeof(*k));
+    if ((k->kem = OQS_KEM_new(get_oqs_alg_name(nid))) == NULL)
+        return 0;
+    k->classical_nid = pq_classical_nid(nid);
+    if (k->classical_nid != 0
+            && ((k->client_key = pq_ec_keygen(k->classical_nid)) == NULL
+                || (k->server_key = pq_ec_keygen(k->classical_nid)) == NULL))
+        return 0;
+
+    k->public_key = app_malloc(k->kem->length_public_key, "KEM public key");
+    k->secret_key = app_malloc(k->kem->length_secret_key, "KEM secret key");
+    k->ciphertext = app_malloc(k->kem->length_ciphertext, "KEM ciphertext");
+    shared_secret = app_malloc(k->kem->length_shared_secret,
+                               "KEM shared secret");
+    ok = OQS_KEM_keypair(k->kem, k->public_key, k->secret_key) == OQS_SUCCESS
+         && OQS_KEM_encaps(k->kem, k->ciphertext, shared_secret,
+                           k->public_key) == OQS_SUCCESS;
+    OPENSSL_free(shared_secret);
+    return ok;
+}
+#endif
+
+#ifndef OPENSSL_NO_OQSSIG
+typedef struct pq_sig_st {
+    EVP_PKEY *pkey;
+    unsigned char *msg;
+    size_t msglen;
+    unsigned char *sig;         /* a signature of |msg| */
+    size_t siglen;
+} PQ_SIG;
+
+typedef struct pq_sig_state_st {
+    EVP_MD_CTX *ctx;
+    unsigned char *sig;
+    size_t sigsize;
+    EVP_PKEY_VERIFY_ITEM *items;
+} PQ_SIG_STATE;
+
+static void *pq_sig_state_new(void *shared)
+{
+    PQ_SIG *g = shared;
+    PQ_SIG_STATE *s = app_malloc(sizeof(*s), "signature state");
+    int i;
+
+    s->sigsize = EVP_PKEY_size(g->pkey);
+    s->sig = app_malloc(s->sigsize, "signature");
+    s->items = NULL;
+    if (verify_batch > 0) {
+        s->items = app_malloc(sizeof(*s->items) * verify_batch,
+                              "verify batch");
+        for (i = 0; i < verify_batch; i++) {
+            s->items[i].pkey = g->pkey;
+            s->items[i].tbs = g->msg;
+            s->items[i].tbslen = g->msglen;
+            s->items[i].sig = g->sig;
+            s->items[i].siglen = g->siglen;
+        }
+    }
+    if ((s->ctx = EVP_MD_CTX_new()) == NULL) {
+        OPENSSL_free(s->sig);
+        OPENSSL_free(s->items);
+        OPENSSL_free(s);
+        return NULL;
+    }
+    return s;
+}
+
+static void pq_sig_state_free(void *state)
+{
+    PQ_SIG_STATE *s = state;
+
+    EVP_MD_CTX_free(s->ctx);
+    OPENSSL_free(s->sig);
+    OPENSSL_free(s->items);
+    OPENSSL_free(s);
+}
+
+static int pq_sig_sign(void *shared, void *state)
+{
+    PQ_SIG *g = shared;
+    PQ_SIG_STATE *s = state;
+    size_t siglen = s->sigsize;
+
+    EVP_MD_CTX_reset(s->ctx);
+    return EVP_DigestSignInit(s->ctx, NULL, NULL, NULL, g->pkey) == 1
+           && EVP_DigestSign(s->ctx, s->sig, &siglen, g->msg,
+                             g->msglen) == 1;
+}
+
+static int pq_sig_verify(void *shared, void *state)
+{
+    PQ_SIG *g = shared;
+    PQ_SIG_STATE *s = state;
+
+    EVP_MD_CTX_reset(s->ctx);
+    return EVP_DigestVerifyInit(s->ctx, NULL, NULL, NULL, g->pkey) == 1
+           && EVP_DigestVerify(s->ctx, g->sig, g->siglen, g->msg,
+                               g->msglen) == 1;
+}
+
+/* Verifies the same signature in batches of |verify_batch| */
+static int pq_sig_verify_batch(void *shared, void *state)
+{
+    PQ_SIG_STATE *s = state;
+
+    return EVP_DigestVerifyBatch(s->items, verify_batch) == 1;
+}
+
+static void pq_sig_cleanup(PQ_SIG *g)
+{
+    EVP_PKEY_free(g->pkey);
+    OPENSSL_free(g->msg);
+    OPENSSL_free(g->sig);
+}
+
+/* Generates the key that all threads share and a signature to verify */
+static int pq_sig_setup(PQ_SIG *g, int nid)
+{
+    EVP_PKEY_CTX *kctx;
+    EVP_MD_CTX *ctx = NULL;
+    int ok = 0;
+
+    memset(g, 0, sizeof(*g));
+    if ((kctx = EVP_PKEY_CTX_new_id(nid, NULL)) == NULL
+            || EVP_PKEY_keygen_init(kctx) <= 0
+            || EVP_PKEY_keygen(kctx, &g->pkey) <= 0)
+        goto end;
+
+    g->msglen = sig_msglen;
+    g->msg = app_malloc(g->msglen + 1, "message to sign");
+    memset(g->msg, 'S', g->msglen);
+    g->siglen = EVP_PKEY_size(g->pkey);
+    g->sig = app_malloc(g->siglen, "signature");
+    ok = (ctx = EVP_MD_CTX_new()) != NULL
+         && EVP_DigestSignInit(ctx, NULL, NULL, NULL, g->pkey) == 1
+         && EVP_DigestSign(ctx, g->sig, &g->siglen, g->msg, g->msglen) == 1;
+ end:
+    EVP_PKEY_CTX_free(kctx);
+    EVP_MD_CTX_free(ctx);
+    return ok;
 }
 #endif
 
+#if !defined(OPENSSL_NO_OQSKEM) || !defined(OPENSSL_NO_OQSSIG)
+static void pq_print_table(const char *kind, const int *nids, const int *doit,
+                           int num, PQ_RESULT (*results)[PQ_MAX_RUNS][3],
+                           const char *const *ops, int nops)
+{
+    int r, k, i, first;
+    char title[40];
+
+    for (r = 0; r < pq_runs; r++) {
+        first = 1;
+        for (k = 0; k < num; k++) {
+            if (!doit[k])
+                continue;
+            if (first) {
+                BIO_snprintf(title, sizeof(title), "%s, %d thread(s)", kind,
+                             pq_threads[r]);
+                printf("%-30s", title);
+                for (i = 0; i < nops; i++)
+                    printf(" %12s/s", ops[i]);
+                for (i = 0; i < nops; i++)
+                    printf(" %12s p50/p99 us", ops[i]);
+                printf("\n");
+                first = 0;
+            }
+            printf("%29s:", OBJ_nid2sn(nids[k]));
+            for (i = 0; i < nops; i++)
+                printf(" %14.1f", results[k][r][i].ops);
+            for (i = 0; i < nops; i++)
+                printf(" %12.2f/%-10.2f", results[k][r][i].p50,
+                       results[k][r][i].p99);
+            printf("\n");
+        }
+    }
+}
+
+static void pq_print_mr(const char *tag, const int *nids, const int *doit,
+                        int num, PQ_RESULT (*results)[PQ_MAX_RUNS][3])
+{
+    int r, k, i;
+
+    for (k = 0; k < num; k++) {
+        if (!doit[k])
+            continue;
+        for (r = 0; r < pq_runs; r++) {
+            printf("%s:%d:%s:%d:%d", tag, k, OBJ_nid2sn(nids[k]), r,
+                   pq_threads[r]);
+            for (i = 0; i < 3; i++)
+                printf(":%f:%f:%f", results[k][r][i].ops,
+                       results[k][r][i].p50, results[k][r][i].p99);
+            printf("\n");
+        }
+    }
+}
+
+static void pq_print_json_algs(BIO *out, const char *key, const int *nids,
+                               const int *doit, int num,
+                               PQ_RESULT (*results)[PQ_MAX_RUNS][3],
+                               const char *const *ops, int nops)
+{
+    int r, k, i, first = 1;
+
+    BIO_printf(out, "  \"%s\": [", key);
+    for (k = 0; k < num; k++) {
+        if (!doit[k])
+            continue;
+        BIO_printf(out, "%s\n    {\"name\": \"%s\", \"hybrid\": %s, \"runs\": [",
+                   first ? "" : ",", OBJ_nid2sn(nids[k]),
+                   pq_classical_nid(nids[k]) != 0 ? "true" : "false");
+        for (r = 0; r < pq_runs; r++) {
+            BIO_printf(out, "%s\n      {\"threads\": %d", r > 0 ? "," : "",
+                       pq_threads[r]);
+            for (i = 0; i < nops; i++)
+                BIO_printf(out, ", \"%s\": {\"ops_per_sec\": %.1f, "
+                           "\"p50_us\": %.2f, \"p99_us\": %.2f}", ops[i],
+                           results[k][r][i].ops, results[k][r][i].p50,
+                           results[k][r][i].p99);
+            BIO_printf(out, "}");
+        }
+        BIO_printf(out, "\n    ]}");
+        first = 0;
+    }
+    BIO_printf(out, "\n  ]");
+}
+
+/* Parses a comma-separated list of thread counts into |pq_threads| */
+static int pq_parse_threads(const char *arg)
+{
+    const char *p = arg;
+    char *end;
+    long n;
+
+    pq_runs = 0;
+    do {
+        n = strtol(p, &end, 10);
+        if (end == p || n < 1 || n > PQ_MAX_THREADS || pq_runs == PQ_MAX_RUNS
+                || (*end != ',' && *end != '\0'))
+            return 0;
+# ifndef PQ_THREADS
+        if (n > 1)
+            return 0;
+# endif
+        pq_threads[pq_runs++] = (int)n;
+        p = end + 1;
+    } while (*end == ',');
+    return 1;
+}
+#endif
 
 static int run_benchmark(int async_jobs,
                          int (*loop_function) (void *), loopargs_t * loopargs)
@@ -1637,24 +2239,17 @@ int speed_main(int argc, char **argv)
 #endif                          /* ndef OPENSSL_NO_EC */
 
 #ifndef OPENSSL_NO_OQSKEM
-    const char *oqskem_method_names[OQSKEM_NUM];
-    OQS_KEM *oqskem_kem[OQSKEM_NUM];
-    unsigned char *oqskem_secret_key;
-    unsigned char *oqskem_public_key;
-    unsigned char *oqskem_ciphertext;
-    unsigned char *oqskem_shared_secret_e;
-    unsigned char *oqskem_shared_secret_d;
-    long oqskem_c[OQSKEM_NUM][3];
     int oqskem_doit[OQSKEM_NUM] = { 0 };
+    int oqskemcnt = 0, nid;
 
     /* populate oqskem_choices */
-    int oqskemcnt = 0;
-    int* oqssl_kem_nids_list = get_oqssl_kem_nids(); 
-    for (oqskemcnt = 0; oqskemcnt < OQSKEM_NUM; ++oqskemcnt) {
-        oqskem_choices[oqskemcnt].name = OBJ_nid2sn(oqssl_kem_nids_list[oqskemcnt]);
+    for (nid = NID_oqs_kem_default; IS_OQS_OPENSSL_KEM_NID(nid); nid++) {
+        if (nid == NID_oqs_kem_default || nid == NID_p256_oqs_kem_default)
+            continue;
+        oqskem_nids[oqskemcnt] = nid;
+        oqskem_choices[oqskemcnt].name = OBJ_nid2sn(nid);
         oqskem_choices[oqskemcnt].retval = oqskemcnt;
-        oqskem_kem[oqskemcnt] = NULL;
-        oqskem_method_names[oqskemcnt] = oqskem_choices[oqskemcnt].name; 
+        oqskemcnt++;
     }
 #endif /* ndef OPENSSL_NO_OQSKEM */
 
@@ -1771,6 +2366,36 @@ int speed_main(int argc, char **argv)
         case OPT_AEAD:
             aead = 1;
             break;
+        case OPT_VERIFY_BATCH:
+#ifndef OPENSSL_NO_OQSSIG
+            if (!opt_int(opt_arg(), &verify_batch))
+                goto end;
+#endif
+            break;
+        case OPT_SIG_MSGLEN:
+#ifndef OPENSSL_NO_OQSSIG
+            if (!opt_int(opt_arg(), &sig_msglen))
+                goto end;
+            if (sig_msglen < 0) {
+                BIO_printf(bio_err, "%s: negative message length\n", prog);
+                goto opterr;
+            }
+#endif
+            break;
+        case OPT_THREADS:
+#if !defined(OPENSSL_NO_OQSKEM) || !defined(OPENSSL_NO_OQSSIG)
+            if (!pq_parse_threads(opt_arg())) {
+                BIO_printf(bio_err, "%s: bad thread count list %s\n",
+                           prog, opt_arg());
+                goto opterr;
+            }
+#endif
+            break;
+        case OPT_JSON:
+#if !defined(OPENSSL_NO_OQSKEM) || !defined(OPENSSL_NO_OQSSIG)
+            json_file = opt_arg();
+#endif
+            break;
         }
     }
     argc = opt_num_rest();
@@ -1858,11 +2483,11 @@ int speed_main(int argc, char **argv)
 #ifndef OPENSSL_NO_OQSKEM
         if (strcmp(*argv, "oqskem") == 0) {
             for (loop = 0; loop < OSSL_NELEM(oqskem_doit); loop++)
-                oqskem_doit[loop] = OQS_KEM_alg_is_enabled(get_oqs_alg_name(oqssl_kem_nids_list[loop]));
+                oqskem_doit[loop] = OQS_KEM_alg_is_enabled(get_oqs_alg_name(oqskem_nids[loop]));
             continue;
         }
         if (found(*argv, oqskem_choices, &i)) {
-            oqskem_doit[i] = 2*OQS_KEM_alg_is_enabled(get_oqs_alg_name(oqssl_kem_nids_list[i]));
+            oqskem_doit[i] = 2*OQS_KEM_alg_is_enabled(get_oqs_alg_name(oqskem_nids[i]));
             continue;
         }
 #endif
@@ -1987,7 +2612,7 @@ int speed_main(int argc, char **argv)
 #endif
 #ifndef OPENSSL_NO_OQSKEM
     	for (i = 0; i < OQSKEM_NUM; i++) 
-            oqskem_doit[i] = OQS_KEM_alg_is_enabled(get_oqs_alg_name(oqssl_kem_nids_list[i]));
+            oqskem_doit[i] = OQS_KEM_alg_is_enabled(get_oqs_alg_name(oqskem_nids[i]));
 #endif
 #ifndef OPENSSL_NO_OQSSIG
     	for (i = 0; i < OQSSIG_NUM; i++) 
@@ -2296,24 +2921,6 @@ int speed_main(int argc, char **argv)
     eddsa_c[R_EC_Ed448][0] = count / 7200;
 #  endif /* OPENSSL_NO_EC */
 
-#ifndef OPENSSL_NO_OQSKEM
-    for (i = 0; i <= OQSKEM_NUM; i++) {
-        oqskem_c[i][0] = count/1000;
-        oqskem_c[i][1] = count/1000;
-    }
-    oqskem_secret_key = NULL;
-    oqskem_public_key = NULL;
-    oqskem_ciphertext = NULL;
-    oqskem_shared_secret_d = NULL;
-    oqskem_shared_secret_e = NULL;
-#endif
-#ifndef OPENSSL_NO_OQSSIG
-    for (i = 0; i <= OQSSIG_NUM; i++) {
-        oqssig_c[i][0] = count/1000;
-        oqssig_c[i][1] = count/1000;
-    }
-#endif
-
 # else
 /* not worth fixing */
 #  error "You cannot disable DES on systems without SIGALRM."
@@ -3373,187 +3980,77 @@ int speed_main(int argc, char **argv)
 
 #ifndef OPENSSL_NO_OQSKEM
     OQS_randombytes_custom_algorithm((void (*)(uint8_t *, size_t)) &RAND_bytes);
-    int j;
-    for (j = 0; j < OQSKEM_NUM; j++) {
-        if (!oqskem_doit[j])
+    for (testnum = 0; testnum < OQSKEM_NUM; testnum++) {
+        static int (*const kem_ops[3])(void *, void *) = {
+            pq_kem_keygen, pq_kem_encaps, pq_kem_decaps
+        };
+        PQ_KEM kem;
+        PQ_BENCH bench;
+        int r;
+
+        if (!oqskem_doit[testnum])
             continue;
-
-        oqskem_kem[j] = OQS_KEM_new(get_oqs_alg_name(oqssl_kem_nids_list[j]));
-        if (oqskem_kem[j] == NULL) {
-            BIO_printf(bio_err,"OQSKEM failure - OQS_KEM_new(%s).\n", get_oqs_alg_name(oqssl_kem_nids_list[j]));
+        if (!pq_kem_setup(&kem, oqskem_nids[testnum])) {
+            BIO_printf(bio_err, "OQSKEM failure.\n");
             ERR_print_errors(bio_err);
-            rsa_count=1;
-        } else {
-            oqskem_public_key = malloc(oqskem_kem[j]->length_public_key);
-            oqskem_secret_key = malloc(oqskem_kem[j]->length_secret_key);
-            oqskem_ciphertext = malloc(oqskem_kem[j]->length_ciphertext);
-            oqskem_shared_secret_d = malloc(oqskem_kem[j]->length_shared_secret);
-            oqskem_shared_secret_e = malloc(oqskem_kem[j]->length_shared_secret);
-
-            /* time OQSKEM keypair operation */
-            char lbl[1000];
-            sprintf(lbl, "%s (OQS KEM %s)", oqskem_method_names[j], oqskem_kem[j]->method_name);
-            // XXX TBR TBD oqskem_method_names[j] = strdup(oqskem_kem[j]->method_name);
-            pkey_print_message(lbl, "keypair", oqskem_c[j][0], 0, seconds.oqskem);
-            Time_F(START);
-            for (count = 0, run = 1; COND(oqskem_c[j][0]); count++) {
-                OQS_KEM_keypair(oqskem_kem[j], oqskem_public_key, oqskem_secret_key);
-            }
-            d = Time_F(STOP);
-            sprintf(lbl, "%%ld %s keypair in %%.2fs\n", oqskem_method_names[j]);
-            BIO_printf(bio_err, mr ? "+R9:%ld:%.2f\n" : lbl, count, d);
-            oqskem_results[j][0] = d / (double)count;
-            rsa_count = count;
-
-            /* time OQSKEM encaps operation */
-            sprintf(lbl, "%s", oqskem_method_names[j]);
-            pkey_print_message(lbl, "encaps", oqskem_c[j][1], 0, seconds.oqskem);
-            Time_F(START);
-            for (count = 0, run = 1; COND(oqskem_c[j][1]); count++) {
-                OQS_KEM_encaps(oqskem_kem[j], oqskem_ciphertext, oqskem_shared_secret_e, oqskem_public_key);
-            }
-            d = Time_F(STOP);
-            sprintf(lbl, "%%ld %s encaps in %%.2fs\n", oqskem_method_names[j]);
-            BIO_printf(bio_err, mr ? "+R10:%ld:%.2f\n" : lbl, count, d);
-            oqskem_results[j][1] = d / (double)count;
-            rsa_count = count;
-
-            /* time OQSKEM decaps operation */
-            sprintf(lbl, "%s", oqskem_method_names[j]);
-            pkey_print_message(lbl, "decaps", oqskem_c[j][2], 0, seconds.oqskem);
-            Time_F(START);
-            for (count = 0, run = 1; COND(oqskem_c[j][2]); count++) {
-                OQS_KEM_decaps(oqskem_kem[j], oqskem_shared_secret_d, oqskem_ciphertext, oqskem_secret_key);
+            oqskem_doit[testnum] = 0;
+        }
+        bench.state_new = pq_kem_state_new;
+        bench.state_free = pq_kem_state_free;
+        bench.shared = &kem;
+        bench.ops_per_call = 1;
+        bench.ns = (uint64_t)seconds.oqskem * 1000000000;
+        for (r = 0; r < pq_runs && oqskem_doit[testnum]; r++) {
+            for (k = 0; k < 3; k++) {
+                bench.op = kem_ops[k];
+                if (!pq_bench(&bench, oqskem_choices[testnum].name,
+                              oqskem_op_names[k], pq_threads[r],
+                              seconds.oqskem,
+                              &oqskem_results[testnum][r][k])) {
+                    oqskem_doit[testnum] = 0;
+                    break;
+                }
             }
-            d = Time_F(STOP);
-            sprintf(lbl, "%%ld %s decaps in %%.2fs\n", oqskem_method_names[j]);
-            BIO_printf(bio_err, mr ? "+R11:%ld:%.2f\n" : lbl, count, d);
-            oqskem_results[j][2] = d / (double)count;
-            rsa_count = count;
-            OQS_MEM_insecure_free(oqskem_public_key);
-            OQS_MEM_insecure_free(oqskem_ciphertext);
-            OQS_MEM_secure_free(oqskem_secret_key, oqskem_kem[j]->length_secret_key);
-            OQS_MEM_secure_free(oqskem_shared_secret_d, oqskem_kem[j]->length_shared_secret);
-            OQS_MEM_secure_free(oqskem_shared_secret_e, oqskem_kem[j]->length_shared_secret);
-        }
-        OQS_KEM_free(oqskem_kem[j]);
-
-        if (rsa_count <= 1) {
-            /* if longer than 10s, don't do any more */
-            for (j++; j < OQSKEM_NUM; j++)
-                oqskem_doit[j] = 0;
         }
+        pq_kem_cleanup(&kem);
     }
 #endif /* ndef OPENSSL_NO_OQSKEM */
 
 #ifndef OPENSSL_NO_OQSSIG
     for (testnum = 0; testnum < OQSSIG_NUM; testnum++) {
-        int st = 1;
-        EVP_PKEY *oqssig_pkey = NULL;
-        EVP_PKEY_CTX *oqssig_pctx = NULL;
+        static int (*const sig_ops[3])(void *, void *) = {
+            pq_sig_sign, pq_sig_verify, pq_sig_verify_batch
+        };
+        PQ_SIG sig;
+        PQ_BENCH bench;
+        int r;
 
         if (!oqssig_doit[testnum])
             continue;           /* Ignore algorithm */
-        for (i = 0; i < loopargs_len; i++) {
-            loopargs[i].oqssig_ctx[testnum] = EVP_MD_CTX_new();
-            if (loopargs[i].oqssig_ctx[testnum] == NULL) {
-                st = 0;
-                break;
-            }
-
-            if ((oqssig_pctx = EVP_PKEY_CTX_new_id(oqssl_sig_nids_list[testnum], NULL))
-                    == NULL
-                || !EVP_PKEY_keygen_init(oqssig_pctx)
-                || !EVP_PKEY_keygen(oqssig_pctx, &oqssig_pkey)) {
-                st = 0;
-                EVP_PKEY_CTX_free(oqssig_pctx);
-                break;
-            }
-            EVP_PKEY_CTX_free(oqssig_pctx);
-
-            if (!EVP_DigestSignInit(loopargs[i].oqssig_ctx[testnum], NULL, NULL,
-                                    NULL, oqssig_pkey)) {
-                st = 0;
-                EVP_PKEY_free(oqssig_pkey);
-                break;
-            }
-            EVP_PKEY_free(oqssig_pkey);
-        }
-        if (st == 0) {
+        if (!pq_sig_setup(&sig, oqssl_sig_nids_list[testnum])) {
             BIO_printf(bio_err, "OQSSIG failure.\n");
             ERR_print_errors(bio_err);
-            rsa_count = 1;
-        } else {
-            for (i = 0; i < loopargs_len; i++) {
-                /* Perform signature test */
-                loopargs[i].sigsize = oqs_size(oqssig_pkey);
-                st = EVP_DigestSign(loopargs[i].oqssig_ctx[testnum],
-                                    loopargs[i].buf2, &loopargs[i].sigsize,
-                                    loopargs[i].buf, 20);
-                // reset size for repeated sign runs as OQS sign may have destroyed value
-                loopargs[i].sigsize = oqs_size(oqssig_pkey);
-                if (st == 0)
-                    break;
-            }
-            if (st == 0) {
-                BIO_printf(bio_err,
-                           "OQS sign failure.  No OQS sign will be done.\n");
-                ERR_print_errors(bio_err);
-                rsa_count = 1;
-            } else {
-                pkey_print_message("sign", OBJ_nid2sn(oqssl_sig_nids_list[testnum]),
-                                   oqssig_c[testnum][0],
-                                   0, seconds.oqssig);
-                loopargs[i].sigsize = oqs_size(oqssig_pkey);
-                Time_F(START);
-                count = run_benchmark(async_jobs, OQS_sign_loop, loopargs);
-                d = Time_F(STOP);
-
-                BIO_printf(bio_err,
-                           mr ? "+R8:%ld:%s:%.2f\n" :
-                           "%ld %s signs in %.2fs \n",
-                           count,
-                           OBJ_nid2sn(oqssl_sig_nids_list[testnum]) , d);
-                oqssig_results[testnum][0] = (double)count / d;
-                rsa_count = count;
-            }
-
-            /* Perform verification test */
-            for (i = 0; i < loopargs_len; i++) {
-                st = EVP_DigestVerify(loopargs[i].oqssig_ctx[testnum],
-                                      loopargs[i].buf2, loopargs[i].sigsize,
-                                      loopargs[i].buf, 20);
-                if (st != 1)
-                    break;
-            }
-            if (st != 1) {
-                BIO_printf(bio_err,
-                           "OQS verify failure.  No OQS verify will be done.\n");
-                ERR_print_errors(bio_err);
-                oqssig_doit[testnum] = 0;
-            } else {
-                pkey_print_message("verify", OBJ_nid2sn(oqssl_sig_nids_list[testnum]),
-                                   oqssig_c[testnum][1],
-                                   0, seconds.oqssig);
-                Time_F(START);
-                count = run_benchmark(async_jobs, OQS_verify_loop, loopargs);
-                d = Time_F(STOP);
-                BIO_printf(bio_err,
-                           mr ? "+R9:%ld:%s:%.2f\n"
-                           : "%ld %s verify in %.2fs\n",
-                           count, 
-                           OBJ_nid2sn(oqssl_sig_nids_list[testnum]), d);
-                oqssig_results[testnum][1] = (double)count / d;
-            }
-
-            if (rsa_count <= 1) {
-                /* if longer than 10s, don't do any more */
-                for (testnum++; testnum < OQSSIG_NUM; testnum++)
+            oqssig_doit[testnum] = 0;
+        }
+        bench.state_new = pq_sig_state_new;
+        bench.state_free = pq_sig_state_free;
+        bench.shared = &sig;
+        bench.ns = (uint64_t)seconds.oqssig * 1000000000;
+        for (r = 0; r < pq_runs && oqssig_doit[testnum]; r++) {
+            for (k = 0; k < (verify_batch > 0 ? 3 : 2); k++) {
+                bench.op = sig_ops[k];
+                bench.ops_per_call = k == 2 ? verify_batch : 1;
+                if (!pq_bench(&bench, oqssig_choices[testnum].name,
+                              oqssig_op_names[k], pq_threads[r],
+                              seconds.oqssig,
+                              &oqssig_results[testnum][r][k])) {
                     oqssig_doit[testnum] = 0;
+                    break;
+                }
             }
         }
+        pq_sig_cleanup(&sig);
     }
-
 #endif /* ndef OPENSSL_NO_OQSSIG */
 
 
@@ -3716,45 +4213,48 @@ int speed_main(int argc, char **argv)
 #endif
 
 #ifndef OPENSSL_NO_OQSKEM
-    testnum = 1;
-    for (k = 0; k < OQSKEM_NUM; k++) {
-        if (!oqskem_doit[k])
-            continue;
-        if (testnum && !mr) {
-            printf("%30skeygen/s      encap/s      decap/s\n", " ");
-            testnum = 0;
-        }
-        if (mr)
-            printf("+F5:%u:%s:%f:%f:%f\n",
-                   k, oqskem_method_names[k], 
-                   oqskem_results[k][0], oqskem_results[k][1], oqskem_results[k][2]);
-
-        else
-            printf("%29s %8.1f     %8.1f     %8.1f\n",
-                   oqskem_method_names[k],
-                   1.0 / oqskem_results[k][0], 1.0 / oqskem_results[k][1], 1.0 / oqskem_results[k][2]);
-    }
+    if (mr)
+        pq_print_mr("+F7", oqskem_nids, oqskem_doit, OQSKEM_NUM,
+                    oqskem_results);
+    else
+        pq_print_table("OQS KEM", oqskem_nids, oqskem_doit, OQSKEM_NUM,
+                       oqskem_results, oqskem_op_names, 3);
 #endif
 
 #ifndef OPENSSL_NO_OQSSIG
-    testnum = 1;
-    for (k = 0; k < OQSSIG_NUM; k++) {
-        if (!oqssig_doit[k])
-            continue;
-        if (testnum && !mr) {
-            printf("%30s      sign    verify   sign/s  verify/s\n", " ");
-            testnum = 0;
-        }
+    if (mr)
+        pq_print_mr("+F8", oqssl_sig_nids_list, oqssig_doit, OQSSIG_NUM,
+                    oqssig_results);
+    else
+        pq_print_table("OQS signature", oqssl_sig_nids_list, oqssig_doit,
+                       OQSSIG_NUM, oqssig_results, oqssig_op_names,
+                       verify_batch > 0 ? 3 : 2);
+#endif
 
-        if (mr)
-            printf("+F6:%u:%s:%f:%f\n",
-                   k, OBJ_nid2sn(oqssl_sig_nids_list[k]),
-                   oqssig_results[k][0], oqssig_results[k][1]);
-        else
-            printf("%29s: %8.4fs %8.4fs %8.1f %8.1f\n",
-                   OBJ_nid2sn(oqssl_sig_nids_list[k]),
-                   1.0 / oqssig_results[k][0], 1.0 / oqssig_results[k][1],
-                   oqssig_results[k][0], oqssig_results[k][1]);
+#if !defined(OPENSSL_NO_OQSKEM) || !defined(OPENSSL_NO_OQSSIG)
+    if (json_file != NULL) {
+        BIO *json = bio_open_default(json_file, 'w', FORMAT_TEXT);
+
+        if (json == NULL)
+            goto end;
+        BIO_printf(json, "{\n  \"version\": \"%s\"",
+                   OpenSSL_version(OPENSSL_VERSION));
+# ifndef OPENSSL_NO_OQSKEM
+        BIO_printf(json, ",\n  \"kem_seconds\": %d,\n", seconds.oqskem);
+        pq_print_json_algs(json, "kem", oqskem_nids, oqskem_doit, OQSKEM_NUM,
+                           oqskem_results, oqskem_op_names, 3);
+# endif
+# ifndef OPENSSL_NO_OQSSIG
+        BIO_printf(json, ",\n  \"sig_seconds\": %d,\n  \"sig_msglen\": %d,\n",
+                   seconds.oqssig, sig_msglen);
+        if (verify_batch > 0)
+            BIO_printf(json, "  \"verify_batch\": %d,\n", verify_batch);
+        pq_print_json_algs(json, "sig", oqssl_sig_nids_list, oqssig_doit,
+                           OQSSIG_NUM, oqssig_results, oqssig_op_names,
+                           verify_batch > 0 ? 3 : 2);
+# endif
+        BIO_printf(json, "\n}\n");
+        BIO_free_all(json);
     }
 #endif
 
@@ -3784,15 +4284,10 @@ int speed_main(int argc, char **argv)
         OPENSSL_free(loopargs[i].secret_a);
         OPENSSL_free(loopargs[i].secret_b);
 #endif
-#ifndef OPENSSL_NO_OQSKEM
-        OPENSSL_free(oqssl_kem_nids_list);
-#endif
+    }
 #ifndef OPENSSL_NO_OQSSIG
-        for (k = 0; k < OQSSIG_NUM; k++)
-            EVP_MD_CTX_free(loopargs[i].oqssig_ctx[k]);
-        OPENSSL_free(oqssl_sig_nids_list);
+    OPENSSL_free(oqssl_sig_nids_list);
 #endif
-    }
     if (async_jobs > 0) {
         for (i = 0; i < loopargs_len; i++)
             ASYNC_WAIT_CTX_free(loopargs[i].wait_ctx);
@@ -3892,6 +4387,33 @@ static char *sstrsep(char **string, const char *delim)
     return token;
 }
 
+#if !defined(OPENSSL_NO_OQSKEM) || !defined(OPENSSL_NO_OQSSIG)
+/* Adds up the throughput of forked children and keeps the worst latency */
+static void pq_parse_mr(char *p, int num,
+                        PQ_RESULT (*results)[PQ_MAX_RUNS][3])
+{
+    static char sep[] = ":";
+    PQ_RESULT *res;
+    double d;
+    int k, r, i;
+
+    k = atoi(sstrsep(&p, sep));
+    sstrsep(&p, sep);
+    r = atoi(sstrsep(&p, sep));
+    sstrsep(&p, sep);
+    if (k < 0 || k >= num || r < 0 || r >= PQ_MAX_RUNS)
+        return;
+    for (i = 0; i < 3; i++) {
+        res = &results[k][r][i];
+        res->ops += atof(sstrsep(&p, sep));
+        if ((d = atof(sstrsep(&p, sep))) > res->p50)
+            res->p50 = d;
+        if ((d = atof(sstrsep(&p, sep))) > res->p99)
+            res->p99 = d;
+    }
+}
+#endif
+
 static int do_multi(int multi, int size_num)
 {
     int n;
@@ -3920,6 +4442,9 @@ static int do_multi(int multi, int size_num)
             close(fd[1]);
             mr = 1;
             usertime = 0;
+#if !defined(OPENSSL_NO_OQSKEM) || !defined(OPENSSL_NO_OQSSIG)
+            json_file = NULL;   /* the parent writes the merged results */
+#endif
             free(fds);
             return 0;
         }
@@ -4024,6 +4549,16 @@ static int do_multi(int multi, int size_num)
             }
 # endif
 
+# ifndef OPENSSL_NO_OQSKEM
+            else if (strncmp(buf, "+F7:", 4) == 0) {
+                pq_parse_mr(buf + 4, OQSKEM_NUM, oqskem_results);
+            }
+# endif
+# ifndef OPENSSL_NO_OQSSIG
+            else if (strncmp(buf, "+F8:", 4) == 0) {
+                pq_parse_mr(buf + 4, OQSSIG_NUM, oqssig_results);
+            }
+# endif
             else if (strncmp(buf, "+H:", 3) == 0) {
                 ;
             } else
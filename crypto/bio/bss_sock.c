@@ -11,6 +11,8 @@
 #include <errno.h>
 #include "bio_local.h"
 #include "internal/cryptlib.h"
+#include "internal/thread_once.h"
+#include "internal/ktls.h"
 
 #ifndef OPENSSL_NO_SOCK
 
@@ -26,6 +28,17 @@
 #  define sock_puts  SockPuts
 # endif
 
+# ifndef OPENSSL_NO_KTLS
+static CRYPTO_ONCE ktls_rekey_once = CRYPTO_ONCE_STATIC_INIT;
+static int ktls_rekey = 0;
+
+DEFINE_RUN_ONCE_STATIC(ktls_rekey_probe)
+{
+    ktls_rekey = ktls_probe_rekey();
+    return 1;
+}
+# endif
+
 static int sock_write(BIO *h, const char *buf, int num);
 static int sock_read(BIO *h, char *buf, int size);
 static int sock_puts(BIO *h, const char *str);
@@ -96,7 +109,12 @@ static int sock_read(BIO *b, char *out, int outl)
 
     if (out != NULL) {
         clear_socket_error();
-        ret = readsocket(b->num, out, outl);
+# ifndef OPENSSL_NO_KTLS
+        if ((b->flags & BIO_FLAGS_KTLS_RX) != 0)
+            ret = ktls_read_record(b->num, out, outl);
+        else
+# endif
+            ret = readsocket(b->num, out, outl);
         BIO_clear_retry_flags(b);
         if (ret <= 0) {
             if (BIO_sock_should_retry(ret))
@@ -113,7 +131,16 @@ static int sock_write(BIO *b, const char *in, int inl)
     int ret;
 
     clear_socket_error();
-    ret = writesocket(b->num, in, inl);
+# ifndef OPENSSL_NO_KTLS
+    if ((b->flags & BIO_FLAGS_KTLS_TX_CTRL_MSG) != 0) {
+        ret = ktls_send_ctrl_message(b->num, (unsigned char)(size_t)b->ptr,
+                                     in, inl);
+        /* What is left of a partly sent record keeps its type */
+        if (ret == inl)
+            b->flags &= ~BIO_FLAGS_KTLS_TX_CTRL_MSG;
+    } else
+# endif
+        ret = writesocket(b->num, in, inl);
     BIO_clear_retry_flags(b);
     if (ret <= 0) {
         if (BIO_sock_should_retry(ret))
@@ -133,6 +160,8 @@ static long sock_ctrl(BIO *b, int cmd, long num, void *ptr)
         b->num = *((int *)ptr);
         b->shutdown = (int)num;
         b->init = 1;
+        b->flags &= ~(BIO_FLAGS_KTLS_TX | BIO_FLAGS_KTLS_RX
+                      | BIO_FLAGS_KTLS_TX_CTRL_MSG);
         break;
     case BIO_C_GET_FD:
         if (b->init) {
@@ -156,6 +185,30 @@ static long sock_ctrl(BIO *b, int cmd, long num, void *ptr)
     case BIO_CTRL_EOF:
         ret = (b->flags & BIO_FLAGS_IN_EOF) != 0 ? 1 : 0;
         break;
+# ifndef OPENSSL_NO_KTLS
+    case BIO_CTRL_SET_KTLS:
+        if (!b->init || !ktls_enable(b->num)
+                || !ktls_start(b->num, ptr, (int)num))
+            return 0;
+        b->flags |= num != 0 ? BIO_FLAGS_KTLS_TX : BIO_FLAGS_KTLS_RX;
+        break;
+    case BIO_CTRL_GET_KTLS_SEND:
+        ret = (b->flags & BIO_FLAGS_KTLS_TX) != 0 ? 1 : 0;
+        break;
+    case BIO_CTRL_GET_KTLS_RECV:
+        ret = (b->flags & BIO_FLAGS_KTLS_RX) != 0 ? 1 : 0;
+        break;
+    case BIO_CTRL_GET_KTLS_REKEY:
+        ret = RUN_ONCE(&ktls_rekey_once, ktls_rekey_probe) && ktls_rekey;
+        break;
+    case BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG:
+        b->ptr = (void *)(size_t)num;
+        b->flags |= BIO_FLAGS_KTLS_TX_CTRL_MSG;
+        break;
+    case BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG:
+        b->flags &= ~BIO_FLAGS_KTLS_TX_CTRL_MSG;
+        break;
+# endif
     default:
         ret = 0;
         break;
@@ -18,6 +18,7 @@
 #include "comp_local.h"
 
 COMP_METHOD *COMP_zlib(void);
+COMP_METHOD *COMP_zlib_oneshot(void);
 
 static COMP_METHOD zlib_method_nozlib = {
     NID_undef,
@@ -42,6 +43,12 @@ static int zlib_stateful_compress_block(COMP_CTX *ctx, unsigned char *out,
 static int zlib_stateful_expand_block(COMP_CTX *ctx, unsigned char *out,
                                       unsigned int olen, unsigned char *in,
                                       unsigned int ilen);
+static int zlib_oneshot_compress_block(COMP_CTX *ctx, unsigned char *out,
+                                       unsigned int olen, unsigned char *in,
+                                       unsigned int ilen);
+static int zlib_oneshot_expand_block(COMP_CTX *ctx, unsigned char *out,
+                                     unsigned int olen, unsigned char *in,
+                                     unsigned int ilen);
 
 /* memory allocations functions for zlib initialisation */
 static void *zlib_zalloc(void *opaque, unsigned int no, unsigned int size)
@@ -67,6 +74,19 @@ static COMP_METHOD zlib_stateful_method = {
     zlib_stateful_expand_block
 };
 
+/*
+ * Each block is a complete zlib stream (RFC 1950), independent of any other
+ * block compressed or expanded with the same COMP_CTX.
+ */
+static COMP_METHOD zlib_oneshot_method = {
+    NID_zlib_compression,
+    LN_zlib_compression,
+    NULL,
+    NULL,
+    zlib_oneshot_compress_block,
+    zlib_oneshot_expand_block
+};
+
 /*
  * When OpenSSL is built on Windows, we do not want to require that
  * the ZLIB.DLL be available in order for the OpenSSL DLLs to
@@ -204,6 +224,57 @@ static int zlib_stateful_expand_block(COMP_CTX *ctx, unsigned char *out,
     return olen - state->istream.avail_out;
 }
 
+static int zlib_oneshot_compress_block(COMP_CTX *ctx, unsigned char *out,
+                                       unsigned int olen, unsigned char *in,
+                                       unsigned int ilen)
+{
+    z_stream stream;
+    int err;
+
+    memset(&stream, 0, sizeof(stream));
+    stream.zalloc = zlib_zalloc;
+    stream.zfree = zlib_zfree;
+    if (deflateInit_(&stream, Z_DEFAULT_COMPRESSION,
+                     ZLIB_VERSION, sizeof(z_stream)) != Z_OK)
+        return -1;
+
+    stream.next_in = in;
+    stream.avail_in = ilen;
+    stream.next_out = out;
+    stream.avail_out = olen;
+    err = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    /* Anything short of the end of the stream means |out| was too small */
+    if (err != Z_STREAM_END)
+        return -1;
+    return olen - stream.avail_out;
+}
+
+static int zlib_oneshot_expand_block(COMP_CTX *ctx, unsigned char *out,
+                                     unsigned int olen, unsigned char *in,
+                                     unsigned int ilen)
+{
+    z_stream stream;
+    int err;
+
+    memset(&stream, 0, sizeof(stream));
+    stream.zalloc = zlib_zalloc;
+    stream.zfree = zlib_zfree;
+    if (inflateInit_(&stream, ZLIB_VERSION, sizeof(z_stream)) != Z_OK)
+        return -1;
+
+    stream.next_in = in;
+    stream.avail_in = ilen;
+    stream.next_out = out;
+    stream.avail_out = olen;
+    err = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    /* The input must hold exactly one stream that fits into |out| */
+    if (err != Z_STREAM_END || stream.avail_in != 0)
+        return -1;
+    return olen - stream.avail_out;
+}
+
 #endif
 
 COMP_METHOD *COMP_zlib(void)
@@ -259,6 +330,19 @@ COMP_METHOD *COMP_zlib(void)
     return meth;
 }
 
+COMP_METHOD *COMP_zlib_oneshot(void)
+{
+    COMP_METHOD *meth = &zlib_method_nozlib;
+
+#ifdef ZLIB
+    /* Loads the shared library if necessary */
+    if (COMP_zlib() == &zlib_stateful_method)
+        meth = &zlib_oneshot_method;
+#endif
+
+    return meth;
+}
+
 void comp_zlib_cleanup_int(void)
 {
 #ifdef ZLIB_SHARED
@@ -26,7 +26,10 @@
 
 #include <stdio.h>
 #include "internal/cryptlib.h"
+#include "internal/thread_once.h"
+#include "internal/tsan_assist.h"
 #include <openssl/x509.h>
+#include <openssl/async.h>
 #include "crypto/asn1.h"
 #include "crypto/evp.h"
 
@@ -51,26 +54,45 @@ typedef struct
 {
   /* OpenSSL NID */
   int nid;
-  /* OQS signature context */
-  OQS_SIG *s;
+  /* OQS signature context, borrowed from the algorithm registry */
+  const OQS_SIG *s;
   /* OQS public key */
   uint8_t *pubkey;
+  /*
+   * Allocation holding |pubkey|, owned by the key. NULL while |pubkey| points
+   * into |pubkey_enc|, the encoding held by the X509_PUBKEY it was decoded
+   * from.
+   */
+  unsigned char *pubkey_alloc;
+  const unsigned char *pubkey_enc;
   /* OQS private key */
   uint8_t *privkey;
   /* Classical key pair for hybrid schemes; either a private or public key depending on context */
   EVP_PKEY *classical_pkey;
   /* Security bits for the scheme */
   int security_bits;
-  /* digest engine for CMS: */
-  EVP_MD_CTX * digest;
 } OQS_KEY;
 
+/*
+ * Per-operation state, kept in the EVP_PKEY_CTX rather than in the shared
+ * OQS_KEY so that one key can be used by concurrent operations
+ */
+typedef struct
+{
+  /* SHA-512 pre-hash for the streaming DigestSign/DigestVerify API (CMS) */
+  EVP_MD_CTX *digest;
+  /* Whether |digest| has been initialised for the current operation */
+  int digest_started;
+} OQS_PKEY_CTX;
+
 /*
  * OQS key type
  */
 typedef enum {
     KEY_TYPE_PUBLIC,
     KEY_TYPE_PRIVATE,
+    /* A public key that references its encoding rather than a copy */
+    KEY_TYPE_PUBLIC_BORROWED,
 } oqs_key_type_t;
 
 int oqssl_sig_nids_list[] = {
@@ -169,278 +191,241 @@ int* get_oqssl_kem_nids() {
    return kem_nid_list;
 }
 
+/*
+ * Per-NID description of the OQS algorithms. The OQS signature NIDs are
+ * allocated in generate.yml order (see obj_mac.num) and are directly followed
+ * by the KEM NIDs (see objects.txt), so the table is indexed by
+ * nid - OQS_ALG_INFO_FIRST_NID.
+ */
+typedef struct {
+    int nid;
+    const char *alg_name;       /* liboqs algorithm name */
+    int oqs_nid;                /* PQ component of a hybrid, 0 otherwise */
+    int classical_nid;          /* Classical component of a hybrid, 0 otherwise */
+    int security_bits;
+} OQS_ALG_INFO;
+
+#define OQS_ALG_INFO_FIRST_NID NID_oqs_sig_default
+#define OQS_ALG_INFO_LAST_NID  NID_p521_hqc256_3_cca2
+
+static const OQS_ALG_INFO oqs_alg_info[OQS_ALG_INFO_LAST_NID
+                                       - OQS_ALG_INFO_FIRST_NID + 1] = {
+///// OQS_TEMPLATE_FRAGMENT_SIG_ALG_INFO_START
+    {NID_oqs_sig_default, OQS_SIG_alg_default, 0, 0, 128},
+    {NID_p256_oqs_sig_default, OQS_SIG_alg_default,
+     NID_oqs_sig_default, NID_X9_62_prime256v1, 128},
+    {NID_rsa3072_oqs_sig_default, OQS_SIG_alg_default,
+     NID_oqs_sig_default, NID_rsaEncryption, 128},
+    {NID_dilithium2, OQS_SIG_alg_dilithium_2, 0, 0, 128},
+    {NID_p256_dilithium2, OQS_SIG_alg_dilithium_2,
+     NID_dilithium2, NID_X9_62_prime256v1, 128},
+    {NID_rsa3072_dilithium2, OQS_SIG_alg_dilithium_2,
+     NID_dilithium2, NID_rsaEncryption, 128},
+    {NID_dilithium3, OQS_SIG_alg_dilithium_3, 0, 0, 128},
+    {NID_p256_dilithium3, OQS_SIG_alg_dilithium_3,
+     NID_dilithium3, NID_X9_62_prime256v1, 128},
+    {NID_rsa3072_dilithium3, OQS_SIG_alg_dilithium_3,
+     NID_dilithium3, NID_rsaEncryption, 128},
+    {NID_dilithium4, OQS_SIG_alg_dilithium_4, 0, 0, 192},
+    {NID_p384_dilithium4, OQS_SIG_alg_dilithium_4,
+     NID_dilithium4, NID_secp384r1, 192},
+    {NID_falcon512, OQS_SIG_alg_falcon_512, 0, 0, 128},
+    {NID_p256_falcon512, OQS_SIG_alg_falcon_512,
+     NID_falcon512, NID_X9_62_prime256v1, 128},
+    {NID_rsa3072_falcon512, OQS_SIG_alg_falcon_512,
+     NID_falcon512, NID_rsaEncryption, 128},
+    {NID_falcon1024, OQS_SIG_alg_falcon_1024, 0, 0, 256},
+    {NID_p521_falcon1024, OQS_SIG_alg_falcon_1024,
+     NID_falcon1024, NID_secp521r1, 256},
+    {NID_picnicl1full, OQS_SIG_alg_picnic_L1_full, 0, 0, 128},
+    {NID_p256_picnicl1full, OQS_SIG_alg_picnic_L1_full,
+     NID_picnicl1full, NID_X9_62_prime256v1, 128},
+    {NID_rsa3072_picnicl1full, OQS_SIG_alg_picnic_L1_full,
+     NID_picnicl1full, NID_rsaEncryption, 128},
+    {NID_picnic3l1, OQS_SIG_alg_picnic3_L1, 0, 0, 128},
+    {NID_p256_picnic3l1, OQS_SIG_alg_picnic3_L1,
+     NID_picnic3l1, NID_X9_62_prime256v1, 128},
+    {NID_rsa3072_picnic3l1, OQS_SIG_alg_picnic3_L1,
+     NID_picnic3l1, NID_rsaEncryption, 128},
+    {NID_rainbowIaclassic, OQS_SIG_alg_rainbow_Ia_classic, 0, 0, 128},
+    {NID_p256_rainbowIaclassic, OQS_SIG_alg_rainbow_Ia_classic,
+     NID_rainbowIaclassic, NID_X9_62_prime256v1, 128},
+    {NID_rsa3072_rainbowIaclassic, OQS_SIG_alg_rainbow_Ia_classic,
+     NID_rainbowIaclassic, NID_rsaEncryption, 128},
+    {NID_rainbowVcclassic, OQS_SIG_alg_rainbow_Vc_classic, 0, 0, 256},
+    {NID_p521_rainbowVcclassic, OQS_SIG_alg_rainbow_Vc_classic,
+     NID_rainbowVcclassic, NID_secp521r1, 256},
+    {NID_sphincsharaka128frobust, OQS_SIG_alg_sphincs_haraka_128f_robust, 0, 0, 128},
+    {NID_p256_sphincsharaka128frobust, OQS_SIG_alg_sphincs_haraka_128f_robust,
+     NID_sphincsharaka128frobust, NID_X9_62_prime256v1, 128},
+    {NID_rsa3072_sphincsharaka128frobust, OQS_SIG_alg_sphincs_haraka_128f_robust,
+     NID_sphincsharaka128frobust, NID_rsaEncryption, 128},
+///// OQS_TEMPLATE_FRAGMENT_SIG_ALG_INFO_END
+    {NID_oqs_kem_default, OQS_KEM_alg_default, 0, 0, 128},
+    {NID_p256_oqs_kem_default, OQS_KEM_alg_default,
+     NID_oqs_kem_default, NID_X9_62_prime256v1, 128},
+///// OQS_TEMPLATE_FRAGMENT_KEM_ALG_INFO_START
+    {NID_frodo640aes, OQS_KEM_alg_frodokem_640_aes, 0, 0, 128},
+    {NID_p256_frodo640aes, OQS_KEM_alg_frodokem_640_aes,
+     NID_frodo640aes, NID_X9_62_prime256v1, 128},
+    {NID_frodo640shake, OQS_KEM_alg_frodokem_640_shake, 0, 0, 128},
+    {NID_p256_frodo640shake, OQS_KEM_alg_frodokem_640_shake,
+     NID_frodo640shake, NID_X9_62_prime256v1, 128},
+    {NID_frodo976aes, OQS_KEM_alg_frodokem_976_aes, 0, 0, 192},
+    {NID_p384_frodo976aes, OQS_KEM_alg_frodokem_976_aes,
+     NID_frodo976aes, NID_secp384r1, 192},
+    {NID_frodo976shake, OQS_KEM_alg_frodokem_976_shake, 0, 0, 192},
+    {NID_p384_frodo976shake, OQS_KEM_alg_frodokem_976_shake,
+     NID_frodo976shake, NID_secp384r1, 192},
+    {NID_frodo1344aes, OQS_KEM_alg_frodokem_1344_aes, 0, 0, 256},
+    {NID_p521_frodo1344aes, OQS_KEM_alg_frodokem_1344_aes,
+     NID_frodo1344aes, NID_secp521r1, 256},
+    {NID_frodo1344shake, OQS_KEM_alg_frodokem_1344_shake, 0, 0, 256},
+    {NID_p521_frodo1344shake, OQS_KEM_alg_frodokem_1344_shake,
+     NID_frodo1344shake, NID_secp521r1, 256},
+    {NID_bike1l1cpa, OQS_KEM_alg_bike1_l1_cpa, 0, 0, 128},
+    {NID_p256_bike1l1cpa, OQS_KEM_alg_bike1_l1_cpa,
+     NID_bike1l1cpa, NID_X9_62_prime256v1, 128},
+    {NID_bike1l3cpa, OQS_KEM_alg_bike1_l3_cpa, 0, 0, 192},
+    {NID_p384_bike1l3cpa, OQS_KEM_alg_bike1_l3_cpa,
+     NID_bike1l3cpa, NID_secp384r1, 192},
+    {NID_bike1l1fo, OQS_KEM_alg_bike1_l1_fo, 0, 0, 128},
+    {NID_p256_bike1l1fo, OQS_KEM_alg_bike1_l1_fo,
+     NID_bike1l1fo, NID_X9_62_prime256v1, 128},
+    {NID_bike1l3fo, OQS_KEM_alg_bike1_l3_fo, 0, 0, 192},
+    {NID_p384_bike1l3fo, OQS_KEM_alg_bike1_l3_fo,
+     NID_bike1l3fo, NID_secp384r1, 192},
+    {NID_kyber512, OQS_KEM_alg_kyber_512, 0, 0, 128},
+    {NID_p256_kyber512, OQS_KEM_alg_kyber_512,
+     NID_kyber512, NID_X9_62_prime256v1, 128},
+    {NID_kyber768, OQS_KEM_alg_kyber_768, 0, 0, 192},
+    {NID_p384_kyber768, OQS_KEM_alg_kyber_768,
+     NID_kyber768, NID_secp384r1, 192},
+    {NID_kyber1024, OQS_KEM_alg_kyber_1024, 0, 0, 256},
+    {NID_p521_kyber1024, OQS_KEM_alg_kyber_1024,
+     NID_kyber1024, NID_secp521r1, 256},
+    {NID_ntru_hps2048509, OQS_KEM_alg_ntru_hps2048509, 0, 0, 128},
+    {NID_p256_ntru_hps2048509, OQS_KEM_alg_ntru_hps2048509,
+     NID_ntru_hps2048509, NID_X9_62_prime256v1, 128},
+    {NID_ntru_hps2048677, OQS_KEM_alg_ntru_hps2048677, 0, 0, 192},
+    {NID_p384_ntru_hps2048677, OQS_KEM_alg_ntru_hps2048677,
+     NID_ntru_hps2048677, NID_secp384r1, 192},
+    {NID_ntru_hps4096821, OQS_KEM_alg_ntru_hps4096821, 0, 0, 256},
+    {NID_p521_ntru_hps4096821, OQS_KEM_alg_ntru_hps4096821,
+     NID_ntru_hps4096821, NID_secp521r1, 256},
+    {NID_ntru_hrss701, OQS_KEM_alg_ntru_hrss701, 0, 0, 192},
+    {NID_p384_ntru_hrss701, OQS_KEM_alg_ntru_hrss701,
+     NID_ntru_hrss701, NID_secp384r1, 192},
+    {NID_lightsaber, OQS_KEM_alg_saber_lightsaber, 0, 0, 128},
+    {NID_p256_lightsaber, OQS_KEM_alg_saber_lightsaber,
+     NID_lightsaber, NID_X9_62_prime256v1, 128},
+    {NID_saber, OQS_KEM_alg_saber_saber, 0, 0, 192},
+    {NID_p384_saber, OQS_KEM_alg_saber_saber,
+     NID_saber, NID_secp384r1, 192},
+    {NID_firesaber, OQS_KEM_alg_saber_firesaber, 0, 0, 256},
+    {NID_p521_firesaber, OQS_KEM_alg_saber_firesaber,
+     NID_firesaber, NID_secp521r1, 256},
+    {NID_sidhp434, OQS_KEM_alg_sidh_p434, 0, 0, 128},
+    {NID_p256_sidhp434, OQS_KEM_alg_sidh_p434,
+     NID_sidhp434, NID_X9_62_prime256v1, 128},
+    {NID_sidhp503, OQS_KEM_alg_sidh_p503, 0, 0, 128},
+    {NID_p256_sidhp503, OQS_KEM_alg_sidh_p503,
+     NID_sidhp503, NID_X9_62_prime256v1, 128},
+    {NID_sidhp610, OQS_KEM_alg_sidh_p610, 0, 0, 192},
+    {NID_p384_sidhp610, OQS_KEM_alg_sidh_p610,
+     NID_sidhp610, NID_secp384r1, 192},
+    {NID_sidhp751, OQS_KEM_alg_sidh_p751, 0, 0, 256},
+    {NID_p521_sidhp751, OQS_KEM_alg_sidh_p751,
+     NID_sidhp751, NID_secp521r1, 256},
+    {NID_sikep434, OQS_KEM_alg_sike_p434, 0, 0, 128},
+    {NID_p256_sikep434, OQS_KEM_alg_sike_p434,
+     NID_sikep434, NID_X9_62_prime256v1, 128},
+    {NID_sikep503, OQS_KEM_alg_sike_p503, 0, 0, 128},
+    {NID_p256_sikep503, OQS_KEM_alg_sike_p503,
+     NID_sikep503, NID_X9_62_prime256v1, 128},
+    {NID_sikep610, OQS_KEM_alg_sike_p610, 0, 0, 192},
+    {NID_p384_sikep610, OQS_KEM_alg_sike_p610,
+     NID_sikep610, NID_secp384r1, 192},
+    {NID_sikep751, OQS_KEM_alg_sike_p751, 0, 0, 256},
+    {NID_p521_sikep751, OQS_KEM_alg_sike_p751,
+     NID_sikep751, NID_secp521r1, 256},
+    {NID_kyber90s512, OQS_KEM_alg_kyber_512_90s, 0, 0, 128},
+    {NID_p256_kyber90s512, OQS_KEM_alg_kyber_512_90s,
+     NID_kyber90s512, NID_X9_62_prime256v1, 128},
+    {NID_kyber90s768, OQS_KEM_alg_kyber_768_90s, 0, 0, 192},
+    {NID_p384_kyber90s768, OQS_KEM_alg_kyber_768_90s,
+     NID_kyber90s768, NID_secp384r1, 192},
+    {NID_kyber90s1024, OQS_KEM_alg_kyber_1024_90s, 0, 0, 256},
+    {NID_p521_kyber90s1024, OQS_KEM_alg_kyber_1024_90s,
+     NID_kyber90s1024, NID_secp521r1, 256},
+    {NID_hqc128_1_cca2, OQS_KEM_alg_hqc_128_1_cca2, 0, 0, 128},
+    {NID_p256_hqc128_1_cca2, OQS_KEM_alg_hqc_128_1_cca2,
+     NID_hqc128_1_cca2, NID_X9_62_prime256v1, 128},
+    {NID_hqc192_1_cca2, OQS_KEM_alg_hqc_192_1_cca2, 0, 0, 192},
+    {NID_p384_hqc192_1_cca2, OQS_KEM_alg_hqc_192_1_cca2,
+     NID_hqc192_1_cca2, NID_secp384r1, 192},
+    {NID_hqc192_2_cca2, OQS_KEM_alg_hqc_192_2_cca2, 0, 0, 192},
+    {NID_p384_hqc192_2_cca2, OQS_KEM_alg_hqc_192_2_cca2,
+     NID_hqc192_2_cca2, NID_secp384r1, 192},
+    {NID_hqc256_1_cca2, OQS_KEM_alg_hqc_256_1_cca2, 0, 0, 256},
+    {NID_p521_hqc256_1_cca2, OQS_KEM_alg_hqc_256_1_cca2,
+     NID_hqc256_1_cca2, NID_secp521r1, 256},
+    {NID_hqc256_2_cca2, OQS_KEM_alg_hqc_256_2_cca2, 0, 0, 256},
+    {NID_p521_hqc256_2_cca2, OQS_KEM_alg_hqc_256_2_cca2,
+     NID_hqc256_2_cca2, NID_secp521r1, 256},
+    {NID_hqc256_3_cca2, OQS_KEM_alg_hqc_256_3_cca2, 0, 0, 256},
+    {NID_p521_hqc256_3_cca2, OQS_KEM_alg_hqc_256_3_cca2,
+     NID_hqc256_3_cca2, NID_secp521r1, 256},
+///// OQS_TEMPLATE_FRAGMENT_KEM_ALG_INFO_END
+};
+
+static const OQS_ALG_INFO *oqs_alg_info_lookup(int nid)
+{
+    const OQS_ALG_INFO *info;
+
+    if (nid < OQS_ALG_INFO_FIRST_NID || nid > OQS_ALG_INFO_LAST_NID)
+        return NULL;
+    info = &oqs_alg_info[nid - OQS_ALG_INFO_FIRST_NID];
+    return info->nid == nid ? info : NULL;
+}
+
 /*
  * Maps OpenSSL NIDs to OQS IDs
  */
 char* get_oqs_alg_name(int openssl_nid)
 {
-  switch (openssl_nid)
-  {
-///// OQS_TEMPLATE_FRAGMENT_ASSIGN_SIG_ALG_START
-    case NID_oqs_sig_default:
-    case NID_p256_oqs_sig_default:
-    case NID_rsa3072_oqs_sig_default:
-      return OQS_SIG_alg_default;
-    case NID_dilithium2:
-    case NID_p256_dilithium2:
-    case NID_rsa3072_dilithium2:
-      return OQS_SIG_alg_dilithium_2;
-    case NID_dilithium3:
-    case NID_p256_dilithium3:
-    case NID_rsa3072_dilithium3:
-      return OQS_SIG_alg_dilithium_3;
-    case NID_dilithium4:
-    case NID_p384_dilithium4:
-      return OQS_SIG_alg_dilithium_4;
-    case NID_falcon512:
-    case NID_p256_falcon512:
-    case NID_rsa3072_falcon512:
-      return OQS_SIG_alg_falcon_512;
-    case NID_falcon1024:
-    case NID_p521_falcon1024:
-      return OQS_SIG_alg_falcon_1024;
-    case NID_picnicl1full:
-    case NID_p256_picnicl1full:
-    case NID_rsa3072_picnicl1full:
-      return OQS_SIG_alg_picnic_L1_full;
-    case NID_picnic3l1:
-    case NID_p256_picnic3l1:
-    case NID_rsa3072_picnic3l1:
-      return OQS_SIG_alg_picnic3_L1;
-    case NID_rainbowIaclassic:
-    case NID_p256_rainbowIaclassic:
-    case NID_rsa3072_rainbowIaclassic:
-      return OQS_SIG_alg_rainbow_Ia_classic;
-    case NID_rainbowVcclassic:
-    case NID_p521_rainbowVcclassic:
-      return OQS_SIG_alg_rainbow_Vc_classic;
-    case NID_sphincsharaka128frobust:
-    case NID_p256_sphincsharaka128frobust:
-    case NID_rsa3072_sphincsharaka128frobust:
-      return OQS_SIG_alg_sphincs_haraka_128f_robust;
-    case NID_oqs_kem_default:
-      return OQS_KEM_alg_default;
-    case NID_frodo640aes:
-    case NID_p256_frodo640aes:
-      return OQS_KEM_alg_frodokem_640_aes;
-    case NID_frodo640shake:
-    case NID_p256_frodo640shake:
-      return OQS_KEM_alg_frodokem_640_shake;
-    case NID_frodo976aes:
-    case NID_p384_frodo976aes:
-      return OQS_KEM_alg_frodokem_976_aes;
-    case NID_frodo976shake:
-    case NID_p384_frodo976shake:
-      return OQS_KEM_alg_frodokem_976_shake;
-    case NID_frodo1344aes:
-    case NID_p521_frodo1344aes:
-      return OQS_KEM_alg_frodokem_1344_aes;
-    case NID_frodo1344shake:
-    case NID_p521_frodo1344shake:
-      return OQS_KEM_alg_frodokem_1344_shake;
-    case NID_bike1l1cpa:
-    case NID_p256_bike1l1cpa:
-      return OQS_KEM_alg_bike1_l1_cpa;
-    case NID_bike1l3cpa:
-    case NID_p384_bike1l3cpa:
-      return OQS_KEM_alg_bike1_l3_cpa;
-    case NID_bike1l1fo:
-    case NID_p256_bike1l1fo:
-      return OQS_KEM_alg_bike1_l1_fo;
-    case NID_bike1l3fo:
-    case NID_p384_bike1l3fo:
-      return OQS_KEM_alg_bike1_l3_fo;
-    case NID_kyber512:
-    case NID_p256_kyber512:
-      return OQS_KEM_alg_kyber_512;
-    case NID_kyber768:
-    case NID_p384_kyber768:
-      return OQS_KEM_alg_kyber_768;
-    case NID_kyber1024:
-    case NID_p521_kyber1024:
-      return OQS_KEM_alg_kyber_1024;
-    case NID_ntru_hps2048509:
-    case NID_p256_ntru_hps2048509:
-      return OQS_KEM_alg_ntru_hps2048509;
-    case NID_ntru_hps2048677:
-    case NID_p384_ntru_hps2048677:
-      return OQS_KEM_alg_ntru_hps2048677;
-    case NID_ntru_hps4096821:
-    case NID_p521_ntru_hps4096821:
-      return OQS_KEM_alg_ntru_hps4096821;
-    case NID_ntru_hrss701:
-    case NID_p384_ntru_hrss701:
-      return OQS_KEM_alg_ntru_hrss701;
-    case NID_lightsaber:
-    case NID_p256_lightsaber:
-      return OQS_KEM_alg_saber_lightsaber;
-    case NID_saber:
-    case NID_p384_saber:
-      return OQS_KEM_alg_saber_saber;
-    case NID_firesaber:
-    case NID_p521_firesaber:
-      return OQS_KEM_alg_saber_firesaber;
-    case NID_sidhp434:
-    case NID_p256_sidhp434:
-      return OQS_KEM_alg_sidh_p434;
-    case NID_sidhp503:
-    case NID_p256_sidhp503:
-      return OQS_KEM_alg_sidh_p503;
-    case NID_sidhp610:
-    case NID_p384_sidhp610:
-      return OQS_KEM_alg_sidh_p610;
-    case NID_sidhp751:
-    case NID_p521_sidhp751:
-      return OQS_KEM_alg_sidh_p751;
-    case NID_sikep434:
-    case NID_p256_sikep434:
-      return OQS_KEM_alg_sike_p434;
-    case NID_sikep503:
-    case NID_p256_sikep503:
-      return OQS_KEM_alg_sike_p503;
-    case NID_sikep610:
-    case NID_p384_sikep610:
-      return OQS_KEM_alg_sike_p610;
-    case NID_sikep751:
-    case NID_p521_sikep751:
-      return OQS_KEM_alg_sike_p751;
-    case NID_kyber90s512:
-    case NID_p256_kyber90s512:
-      return OQS_KEM_alg_kyber_512_90s;
-    case NID_kyber90s768:
-    case NID_p384_kyber90s768:
-      return OQS_KEM_alg_kyber_768_90s;
-    case NID_kyber90s1024:
-    case NID_p521_kyber90s1024:
-      return OQS_KEM_alg_kyber_1024_90s;
-    case NID_hqc128_1_cca2:
-    case NID_p256_hqc128_1_cca2:
-      return OQS_KEM_alg_hqc_128_1_cca2;
-    case NID_hqc192_1_cca2:
-    case NID_p384_hqc192_1_cca2:
-      return OQS_KEM_alg_hqc_192_1_cca2;
-    case NID_hqc192_2_cca2:
-    case NID_p384_hqc192_2_cca2:
-      return OQS_KEM_alg_hqc_192_2_cca2;
-    case NID_hqc256_1_cca2:
-    case NID_p521_hqc256_1_cca2:
-      return OQS_KEM_alg_hqc_256_1_cca2;
-    case NID_hqc256_2_cca2:
-    case NID_p521_hqc256_2_cca2:
-      return OQS_KEM_alg_hqc_256_2_cca2;
-    case NID_hqc256_3_cca2:
-    case NID_p521_hqc256_3_cca2:
-      return OQS_KEM_alg_hqc_256_3_cca2;
-///// OQS_TEMPLATE_FRAGMENT_ASSIGN_SIG_ALG_END
-    default:
-      return NULL;
-  }
+  const OQS_ALG_INFO *info = oqs_alg_info_lookup(openssl_nid);
+
+  return info == NULL ? NULL : (char *)info->alg_name;
 }
 
 static int is_oqs_hybrid_alg(int openssl_nid)
 {
-  switch (openssl_nid)
-  {
-///// OQS_TEMPLATE_FRAGMENT_LIST_HYBRID_NIDS_START
-    case NID_p256_oqs_sig_default:
-    case NID_rsa3072_oqs_sig_default:
-    case NID_p256_dilithium2:
-    case NID_rsa3072_dilithium2:
-    case NID_p256_dilithium3:
-    case NID_rsa3072_dilithium3:
-    case NID_p384_dilithium4:
-    case NID_p256_falcon512:
-    case NID_rsa3072_falcon512:
-    case NID_p521_falcon1024:
-    case NID_p256_picnicl1full:
-    case NID_rsa3072_picnicl1full:
-    case NID_p256_picnic3l1:
-    case NID_rsa3072_picnic3l1:
-    case NID_p256_rainbowIaclassic:
-    case NID_rsa3072_rainbowIaclassic:
-    case NID_p521_rainbowVcclassic:
-    case NID_p256_sphincsharaka128frobust:
-    case NID_rsa3072_sphincsharaka128frobust:
-///// OQS_TEMPLATE_FRAGMENT_LIST_HYBRID_NIDS_END
-      return 1;
-    default:
-      return 0;
-  }
-}
+  const OQS_ALG_INFO *info = oqs_alg_info_lookup(openssl_nid);
 
+  return info != NULL && info->classical_nid != 0;
+}
 
 static int get_classical_nid(int hybrid_id)
 {
-  switch (hybrid_id)
-  {
-///// OQS_TEMPLATE_FRAGMENT_ASSIGN_CLASSICAL_NIDS_START
-    case NID_rsa3072_oqs_sig_default:
-    case NID_rsa3072_dilithium2:
-    case NID_rsa3072_dilithium3:
-    case NID_rsa3072_falcon512:
-    case NID_rsa3072_picnicl1full:
-    case NID_rsa3072_picnic3l1:
-    case NID_rsa3072_rainbowIaclassic:
-    case NID_rsa3072_sphincsharaka128frobust:
-      return NID_rsaEncryption;
-    case NID_p256_oqs_sig_default:
-    case NID_p256_dilithium2:
-    case NID_p256_dilithium3:
-    case NID_p256_falcon512:
-    case NID_p256_picnicl1full:
-    case NID_p256_picnic3l1:
-    case NID_p256_rainbowIaclassic:
-    case NID_p256_sphincsharaka128frobust:
-      return NID_X9_62_prime256v1;
-    case NID_p384_dilithium4:
-      return NID_secp384r1;
-    case NID_p521_falcon1024:
-    case NID_p521_rainbowVcclassic:
-      return NID_secp521r1;///// OQS_TEMPLATE_FRAGMENT_ASSIGN_CLASSICAL_NIDS_END
-    default:
-      return 0;
-  }
+  const OQS_ALG_INFO *info = oqs_alg_info_lookup(hybrid_id);
+
+  return info == NULL ? 0 : info->classical_nid;
+}
+
+/*
+ * Returns the NID of the classical half of a hybrid scheme, or 0
+ */
+int get_oqs_classical_nid(int openssl_nid)
+{
+  return get_classical_nid(openssl_nid);
 }
 
 static int get_oqs_nid(int hybrid_id)
 {
-  switch (hybrid_id)
-  {
-///// OQS_TEMPLATE_FRAGMENT_ASSIGN_OQS_NID_START
-    case NID_p256_oqs_sig_default:
-    case NID_rsa3072_oqs_sig_default:
-      return NID_oqs_sig_default;
-    case NID_p256_dilithium2:
-    case NID_rsa3072_dilithium2:
-      return NID_dilithium2;
-    case NID_p256_dilithium3:
-    case NID_rsa3072_dilithium3:
-      return NID_dilithium3;
-    case NID_p384_dilithium4:
-      return NID_dilithium4;
-    case NID_p256_falcon512:
-    case NID_rsa3072_falcon512:
-      return NID_falcon512;
-    case NID_p521_falcon1024:
-      return NID_falcon1024;
-    case NID_p256_picnicl1full:
-    case NID_rsa3072_picnicl1full:
-      return NID_picnicl1full;
-    case NID_p256_picnic3l1:
-    case NID_rsa3072_picnic3l1:
-      return NID_picnic3l1;
-    case NID_p256_rainbowIaclassic:
-    case NID_rsa3072_rainbowIaclassic:
-      return NID_rainbowIaclassic;
-    case NID_p521_rainbowVcclassic:
-      return NID_rainbowVcclassic;
-    case NID_p256_sphincsharaka128frobust:
-    case NID_rsa3072_sphincsharaka128frobust:
-      return NID_sphincsharaka128frobust;
-///// OQS_TEMPLATE_FRAGMENT_ASSIGN_OQS_NID_END
-    default:
-      return 0;
-  }
+  const OQS_ALG_INFO *info = oqs_alg_info_lookup(hybrid_id);
+
+  return info == NULL ? 0 : info->oqs_nid;
 }
 
 static int get_classical_key_len(oqs_key_type_t keytype, int classical_id) {
@@ -476,6 +461,153 @@ static int get_classical_sig_len(int classical_id)
     }
 }
 
+/*
+ * Registry of OQS signature descriptors.
+ *
+ * OQS_SIG_new() allocates a fresh descriptor on each call, but the
+ * descriptors are immutable and only ever read by the key code. We therefore
+ * instantiate every algorithm once, the first time any of them is needed,
+ * and hand out shared read-only pointers, stored at the index of the NID in
+ * oqs_alg_info[]. A hybrid NID shares the descriptor of its PQ component.
+ */
+static CRYPTO_ONCE oqs_registry_once = CRYPTO_ONCE_STATIC_INIT;
+static OQS_SIG *oqs_sig_registry[OSSL_NELEM(oqs_alg_info)];
+
+DEFINE_RUN_ONCE_STATIC(do_oqs_registry_init)
+{
+    const OQS_ALG_INFO *info;
+    size_t i;
+
+    for (i = 0; i < OSSL_NELEM(oqs_alg_info); i++) {
+        info = &oqs_alg_info[i];
+        /* NULL for schemes not enabled in liboqs: lookups will fail */
+        if (IS_OQS_OPENSSL_SIG_NID(info->nid) && info->oqs_nid == 0)
+            oqs_sig_registry[i] = OQS_SIG_new(info->alg_name);
+    }
+    for (i = 0; i < OSSL_NELEM(oqs_alg_info); i++) {
+        info = &oqs_alg_info[i];
+        if (IS_OQS_OPENSSL_SIG_NID(info->nid) && info->oqs_nid != 0)
+            oqs_sig_registry[i] =
+                oqs_sig_registry[info->oqs_nid - OQS_ALG_INFO_FIRST_NID];
+    }
+    return 1;
+}
+
+/*
+ * Returns the shared OQS signature descriptor for a PQ or hybrid signature
+ * NID, or NULL if the NID is unknown or the scheme isn't enabled in liboqs.
+ * The returned object is owned by the library and must not be freed.
+ */
+const OQS_SIG *get_oqs_sig(int openssl_nid)
+{
+    const OQS_ALG_INFO *info = oqs_alg_info_lookup(openssl_nid);
+
+    if (info == NULL || !IS_OQS_OPENSSL_SIG_NID(openssl_nid)
+            || !RUN_ONCE(&oqs_registry_once, do_oqs_registry_init))
+        return NULL;
+    return oqs_sig_registry[info - oqs_alg_info];
+}
+
+/*
+ * When on, OQS public keys decoded from an X509_PUBKEY (certificates,
+ * SubjectPublicKeyInfo) reference the decoded encoding instead of a copy of
+ * it. This halves the memory of keys such as Rainbow's, which are up to a
+ * couple of MB, and saves a copy on every parse. Off by default.
+ */
+static int oqs_key_zero_copy = 0;
+
+void EVP_set_oqs_key_zero_copy(int on)
+{
+    tsan_store(&oqs_key_zero_copy, on != 0);
+}
+
+int EVP_get_oqs_key_zero_copy(void)
+{
+    return tsan_load(&oqs_key_zero_copy);
+}
+
+/*
+ * OQS operations are pure computations that can take milliseconds. Called
+ * from within an ASYNC job (SSL_MODE_ASYNC) they are handed to the offload
+ * method if one is set, usually by an engine, which is expected to run
+ * fn(arg) elsewhere and pause the job until it completes, so that the thread
+ * can serve other connections meanwhile.
+ */
+static CRYPTO_ONCE oqs_offload_once = CRYPTO_ONCE_STATIC_INIT;
+static CRYPTO_RWLOCK *oqs_offload_lock = NULL;
+static EVP_OQS_OFFLOAD_FN oqs_offload = NULL;
+
+DEFINE_RUN_ONCE_STATIC(do_oqs_offload_init)
+{
+    oqs_offload_lock = CRYPTO_THREAD_lock_new();
+    return oqs_offload_lock != NULL;
+}
+
+/*
+ * Installs |offload|. Only one offload method can be set at a time: returns
+ * 0 if another one already is.
+ */
+int EVP_set_oqs_offload(EVP_OQS_OFFLOAD_FN offload)
+{
+    int ret;
+
+    if (!RUN_ONCE(&oqs_offload_once, do_oqs_offload_init)
+            || !CRYPTO_THREAD_write_lock(oqs_offload_lock))
+        return 0;
+    ret = oqs_offload == NULL || oqs_offload == offload;
+    if (ret)
+        oqs_offload = offload;
+    CRYPTO_THREAD_unlock(oqs_offload_lock);
+    return ret;
+}
+
+/* Removes |offload|, if it is the offload method set */
+void EVP_clear_oqs_offload(EVP_OQS_OFFLOAD_FN offload)
+{
+    if (!RUN_ONCE(&oqs_offload_once, do_oqs_offload_init)
+            || !CRYPTO_THREAD_write_lock(oqs_offload_lock))
+        return;
+    if (oqs_offload == offload)
+        oqs_offload = NULL;
+    CRYPTO_THREAD_unlock(oqs_offload_lock);
+}
+
+/*
+ * Runs the OQS operation fn(arg), offloaded if possible, and returns its
+ * result. fn must not touch the OpenSSL error queue. An offload method
+ * returns -1 if it could not take the operation, in which case it is run
+ * inline.
+ */
+int EVP_run_oqs_op(EVP_OQS_OP_FN fn, void *arg)
+{
+    EVP_OQS_OFFLOAD_FN offload = NULL;
+    int ret;
+
+    if (ASYNC_get_current_job() != NULL
+            && RUN_ONCE(&oqs_offload_once, do_oqs_offload_init)
+            && CRYPTO_THREAD_read_lock(oqs_offload_lock)) {
+        offload = oqs_offload;
+        CRYPTO_THREAD_unlock(oqs_offload_lock);
+    }
+    if (offload != NULL && (ret = offload(fn, arg)) >= 0)
+        return ret;
+    return fn(arg);
+}
+
+void oqs_registry_cleanup_int(void)
+{
+    size_t i;
+
+    for (i = 0; i < OSSL_NELEM(oqs_alg_info); i++) {
+        /* Hybrids share the descriptor of their PQ component */
+        if (oqs_alg_info[i].oqs_nid == 0)
+            OQS_SIG_free(oqs_sig_registry[i]);
+    }
+    memset(oqs_sig_registry, 0, sizeof(oqs_sig_registry));
+    CRYPTO_THREAD_lock_free(oqs_offload_lock);
+    oqs_offload_lock = NULL;
+}
+
 /*
  * Returns options when running OQS KEM, e.g., in openssl speed
  */
@@ -551,54 +683,9 @@ const char *OQSSIG_options(void)
  */
 static int get_oqs_security_bits(int openssl_nid)
 {
-  switch (openssl_nid)
-  {
-///// OQS_TEMPLATE_FRAGMENT_GET_SIG_SECURITY_BITS_START
-    case NID_oqs_sig_default:
-    case NID_p256_oqs_sig_default:
-    case NID_rsa3072_oqs_sig_default:
-      return 128;
-    case NID_dilithium2:
-    case NID_p256_dilithium2:
-    case NID_rsa3072_dilithium2:
-      return 128;
-    case NID_dilithium3:
-    case NID_p256_dilithium3:
-    case NID_rsa3072_dilithium3:
-      return 128;
-    case NID_dilithium4:
-    case NID_p384_dilithium4:
-      return 192;
-    case NID_falcon512:
-    case NID_p256_falcon512:
-    case NID_rsa3072_falcon512:
-      return 128;
-    case NID_falcon1024:
-    case NID_p521_falcon1024:
-      return 256;
-    case NID_picnicl1full:
-    case NID_p256_picnicl1full:
-    case NID_rsa3072_picnicl1full:
-      return 128;
-    case NID_picnic3l1:
-    case NID_p256_picnic3l1:
-    case NID_rsa3072_picnic3l1:
-      return 128;
-    case NID_rainbowIaclassic:
-    case NID_p256_rainbowIaclassic:
-    case NID_rsa3072_rainbowIaclassic:
-      return 128;
-    case NID_rainbowVcclassic:
-    case NID_p521_rainbowVcclassic:
-      return 256;
-    case NID_sphincsharaka128frobust:
-    case NID_p256_sphincsharaka128frobust:
-    case NID_rsa3072_sphincsharaka128frobust:
-      return 128;
-///// OQS_TEMPLATE_FRAGMENT_GET_SIG_SECURITY_BITS_END
-    default:
-      return 0;
-  }
+  const OQS_ALG_INFO *info = oqs_alg_info_lookup(openssl_nid);
+
+  return info == NULL ? 0 : info->security_bits;
 }
 
 static int is_EC_nid(int nid) {
@@ -664,14 +751,11 @@ static void oqs_pkey_ctx_free(OQS_KEY* key) {
   }
   if (key->s) {
     privkey_len = key->s->length_secret_key;
-    OQS_SIG_free(key->s);
   }
   if (key->privkey) {
     OPENSSL_secure_clear_free(key->privkey, privkey_len);
   }
-  if (key->pubkey) {
-    OPENSSL_free(key->pubkey);
-  }
+  OPENSSL_free(key->pubkey_alloc);
   if (key->classical_pkey) {
     EVP_PKEY_free(key->classical_pkey);
   }
@@ -695,16 +779,20 @@ static int oqs_key_init(OQS_KEY **p_oqs_key, int nid, oqs_key_type_t keytype) {
     oqs_key->nid = nid;
     if (!OQS_SIG_alg_is_enabled(oqs_alg_name))
       fprintf(stderr, "Warning: OQS algorithm '%s' not enabled.\n", oqs_alg_name);
-    oqs_key->s = OQS_SIG_new(oqs_alg_name);
+    oqs_key->s = get_oqs_sig(nid);
     if (oqs_key->s == NULL) {
       /* TODO: Perhaps even check if the alg is available earlier in the stack. */
       ECerr(EC_F_OQS_KEY_INIT, EC_R_NO_SUCH_OQS_ALGORITHM);
       goto err;
     }
-    oqs_key->pubkey = OPENSSL_malloc(oqs_key->s->length_public_key);
-    if (oqs_key->pubkey == NULL) {
-      ECerr(0, ERR_R_MALLOC_FAILURE);
-      goto err;
+    /* A borrowed public key is set by the caller */
+    if (keytype != KEY_TYPE_PUBLIC_BORROWED) {
+      oqs_key->pubkey = oqs_key->pubkey_alloc =
+          OPENSSL_malloc(oqs_key->s->length_public_key);
+      if (oqs_key->pubkey == NULL) {
+        ECerr(0, ERR_R_MALLOC_FAILURE);
+        goto err;
+      }
     }
     /* Optionally allocate the private key */
     if (keytype == KEY_TYPE_PRIVATE) {
@@ -807,7 +895,9 @@ static int oqs_pub_decode(EVP_PKEY *pkey, X509_PUBKEY *pubkey)
       }
     }
 
-    if (!oqs_key_init(&oqs_key, id, 0)) {
+    if (!oqs_key_init(&oqs_key, id, EVP_get_oqs_key_zero_copy()
+                                        ? KEY_TYPE_PUBLIC_BORROWED
+                                        : KEY_TYPE_PUBLIC)) {
       ECerr(EC_F_OQS_PUB_DECODE, EC_R_KEY_INIT_FAILED);
       return 0;
     }
@@ -826,7 +916,16 @@ static int oqs_pub_decode(EVP_PKEY *pkey, X509_PUBKEY *pubkey)
     if (is_hybrid) {
       int classical_id = get_classical_nid(id);
       int actual_classical_pubkey_len;
+      if (pklen < SIZE_OF_UINT32) {
+        ECerr(EC_F_OQS_PUB_DECODE, EC_R_WRONG_LENGTH);
+        goto err;
+      }
       DECODE_UINT32(actual_classical_pubkey_len, p);
+      if (actual_classical_pubkey_len < 0
+              || actual_classical_pubkey_len > pklen - SIZE_OF_UINT32) {
+        ECerr(EC_F_OQS_PUB_DECODE, EC_R_WRONG_LENGTH);
+        goto err;
+      }
       if (is_EC_nid(classical_id)) {
 	if (!decode_EC_key(KEY_TYPE_PUBLIC, classical_id, p + SIZE_OF_UINT32, actual_classical_pubkey_len, oqs_key)) {
 	  ECerr(EC_F_OQS_PUB_DECODE, ERR_R_FATAL);
@@ -843,8 +942,22 @@ static int oqs_pub_decode(EVP_PKEY *pkey, X509_PUBKEY *pubkey)
 
       index += (SIZE_OF_UINT32 + actual_classical_pubkey_len);
     }
-    /* decode PQC public key */
-    memcpy(oqs_key->pubkey, p + index, oqs_key->s->length_public_key);
+    if ((size_t)(pklen - index) < oqs_key->s->length_public_key) {
+      ECerr(EC_F_OQS_PUB_DECODE, EC_R_WRONG_LENGTH);
+      goto err;
+    }
+
+    /*
+     * decode PQC public key. In zero-copy mode, reference it where it is: the
+     * X509_PUBKEY hands the encoding over to us before freeing or replacing
+     * it, see oqs_ameth_pkey_ctrl()
+     */
+    if (oqs_key->pubkey_alloc == NULL) {
+      oqs_key->pubkey = (uint8_t *)p + index;
+      oqs_key->pubkey_enc = p;
+    } else {
+      memcpy(oqs_key->pubkey, p + index, oqs_key->s->length_public_key);
+    }
 
     EVP_PKEY_assign(pkey, id, oqs_key);
     return 1;
@@ -878,8 +991,8 @@ static int oqs_pub_cmp(const EVP_PKEY *a, const EVP_PKEY *b)
 static int oqs_priv_decode(EVP_PKEY *pkey, const PKCS8_PRIV_KEY_INFO *p8)
 {
     const unsigned char *p;
-    int plen, max_privkey_len;
-    ASN1_OCTET_STRING *oct = NULL;
+    int plen, max_privkey_len, ret, tag, xclass;
+    long len;
     const X509_ALGOR *palg;
     OQS_KEY *oqs_key = NULL;
     int id = pkey->ameth->pkey_id;
@@ -889,14 +1002,18 @@ static int oqs_priv_decode(EVP_PKEY *pkey, const PKCS8_PRIV_KEY_INFO *p8)
     if (!PKCS8_pkey_get0(NULL, &p, &plen, &palg, p8))
         return 0;
 
-    oct = d2i_ASN1_OCTET_STRING(NULL, &p, plen);
-    if (oct == NULL) {
-        p = NULL;
-        plen = 0;
-    } else {
-        p = ASN1_STRING_get0_data(oct);
-        plen = ASN1_STRING_length(oct);
+    /*
+     * The key is an OCTET STRING. Read it in place: decoding it into an
+     * ASN1_OCTET_STRING would make another copy of the secret key, which
+     * would not be cleared when freed.
+     */
+    ret = ASN1_get_object(&p, &len, &tag, &xclass, plen);
+    if ((ret & 0x80) != 0 || (ret & V_ASN1_CONSTRUCTED) != 0
+            || tag != V_ASN1_OCTET_STRING || xclass != V_ASN1_UNIVERSAL) {
+        ECerr(EC_F_OQS_PRIV_DECODE, EC_R_DECODE_ERROR);
+        return 0;
     }
+    plen = (int)len;
 
     /* oct contains first the private key, then the public key */
     if (palg != NULL) {
@@ -929,7 +1046,16 @@ static int oqs_priv_decode(EVP_PKEY *pkey, const PKCS8_PRIV_KEY_INFO *p8)
     if (is_hybrid) {
       int classical_id = get_classical_nid(id);
       int actual_classical_privkey_len;
+      if (plen < SIZE_OF_UINT32) {
+        ECerr(EC_F_OQS_PRIV_DECODE, EC_R_KEY_LENGTH_WRONG);
+        goto err;
+      }
       DECODE_UINT32(actual_classical_privkey_len, p);
+      if (actual_classical_privkey_len < 0
+              || actual_classical_privkey_len > plen - SIZE_OF_UINT32) {
+        ECerr(EC_F_OQS_PRIV_DECODE, EC_R_KEY_LENGTH_WRONG);
+        goto err;
+      }
       if (is_EC_nid(classical_id)) {
 	if (!decode_EC_key(KEY_TYPE_PRIVATE, classical_id, p + SIZE_OF_UINT32, actual_classical_privkey_len, oqs_key)) {
 	  ECerr(EC_F_OQS_PRIV_DECODE, ERR_R_FATAL);
@@ -945,6 +1071,12 @@ static int oqs_priv_decode(EVP_PKEY *pkey, const PKCS8_PRIV_KEY_INFO *p8)
       }
       index += (SIZE_OF_UINT32 + actual_classical_privkey_len);
     }
+    if ((size_t)(plen - index)
+            < oqs_key->s->length_secret_key + oqs_key->s->length_public_key) {
+      ECerr(EC_F_OQS_PRIV_DECODE, EC_R_KEY_LENGTH_WRONG);
+      goto err;
+    }
+
     /* decode private key */
     memcpy(oqs_key->privkey, p + index, oqs_key->s->length_secret_key);
     index += oqs_key->s->length_secret_key;
@@ -953,8 +1085,6 @@ static int oqs_priv_decode(EVP_PKEY *pkey, const PKCS8_PRIV_KEY_INFO *p8)
     memcpy(oqs_key->pubkey, p + index, oqs_key->s->length_public_key);
 
     EVP_PKEY_assign(pkey, pkey->ameth->pkey_id, oqs_key);
-
-    ASN1_OCTET_STRING_free(oct);
     return 1;
 
  err:
@@ -1234,6 +1364,24 @@ static int oqs_sig_info_set_##ALG(X509_SIG_INFO *siginf, const X509_ALGOR *alg,
 
 int oqs_ameth_pkey_ctrl(EVP_PKEY *pkey, int op, long arg1, void *arg2) {
    switch (op) {
+   case ASN1_PKEY_CTRL_X509_PUBKEY_RELEASE: {
+      OQS_KEY *oqs_key = (OQS_KEY*) pkey->pkey.ptr;
+      ASN1_BIT_STRING *enc = arg2;
+
+      /*
+       * The X509_PUBKEY we reference is going away: take its encoding over.
+       * |pubkey| keeps pointing at the same bytes, so concurrent users of the
+       * key are unaffected.
+       */
+      if (oqs_key != NULL && oqs_key->pubkey_enc != NULL
+              && oqs_key->pubkey_enc == enc->data) {
+        oqs_key->pubkey_alloc = enc->data;
+        oqs_key->pubkey_enc = NULL;
+        enc->data = NULL;
+        enc->length = 0;
+      }
+      return 1;
+   }
    case ASN1_PKEY_CTRL_DEFAULT_MD_NID:
 	*(int *)arg2 = NID_sha512;
 	return 1;
@@ -1360,6 +1508,32 @@ static int pkey_oqs_keygen(EVP_PKEY_CTX *ctx, EVP_PKEY *pkey)
     return rv;
 }
 
+/* The post-quantum half of a signature, see EVP_run_oqs_op() */
+typedef struct {
+    const OQS_KEY *oqs_key;
+    unsigned char *sig;
+    const unsigned char *csig;
+    size_t siglen;
+    const unsigned char *tbs;
+    size_t tbslen;
+} OQS_SIG_JOB;
+
+static int oqs_sig_sign_job(void *arg)
+{
+    OQS_SIG_JOB *job = arg;
+
+    return OQS_SIG_sign(job->oqs_key->s, job->sig, &job->siglen, job->tbs,
+                        job->tbslen, job->oqs_key->privkey) == OQS_SUCCESS;
+}
+
+static int oqs_sig_verify_job(void *arg)
+{
+    OQS_SIG_JOB *job = arg;
+
+    return OQS_SIG_verify(job->oqs_key->s, job->tbs, job->tbslen, job->csig,
+                          job->siglen, job->oqs_key->pubkey) == OQS_SUCCESS;
+}
+
 static int pkey_oqs_digestsign(EVP_MD_CTX *ctx, unsigned char *sig,
                                size_t *siglen, const unsigned char *tbs,
                                size_t tbslen)
@@ -1373,6 +1547,7 @@ static int pkey_oqs_digestsign(EVP_MD_CTX *ctx, unsigned char *sig,
     size_t classical_sig_len = 0, oqs_sig_len = 0;
     size_t actual_classical_sig_len = 0;
     size_t index = 0;
+    OQS_SIG_JOB sig_job;
     int rv = 0;
 
     if (!oqs_key || !oqs_key->s || !oqs_key->privkey || (is_hybrid && !oqs_key->classical_pkey)) {
@@ -1451,10 +1626,16 @@ static int pkey_oqs_digestsign(EVP_MD_CTX *ctx, unsigned char *sig,
       index += classical_sig_len;
     }
 
-    if (OQS_SIG_sign(oqs_key->s, sig + index, &oqs_sig_len, tbs, tbslen, oqs_key->privkey) != OQS_SUCCESS) {
+    sig_job.oqs_key = oqs_key;
+    sig_job.sig = sig + index;
+    sig_job.siglen = 0;
+    sig_job.tbs = tbs;
+    sig_job.tbslen = tbslen;
+    if (!EVP_run_oqs_op(oqs_sig_sign_job, &sig_job)) {
       ECerr(EC_F_PKEY_OQS_DIGESTSIGN, EC_R_SIGNING_FAILED);
-      return 0;
+      goto end;
     }
+    oqs_sig_len = sig_job.siglen;
     *siglen = classical_sig_len + oqs_sig_len;
 
     rv = 1; /* success */
@@ -1466,15 +1647,16 @@ static int pkey_oqs_digestsign(EVP_MD_CTX *ctx, unsigned char *sig,
     return rv;
 }
 
-static int pkey_oqs_digestverify(EVP_MD_CTX *ctx, const unsigned char *sig,
-                                 size_t siglen, const unsigned char *tbs,
-                                 size_t tbslen)
+static int oqs_verify(const OQS_KEY *oqs_key, const unsigned char *sig,
+                      size_t siglen, const unsigned char *tbs, size_t tbslen)
 {
-    const OQS_KEY *oqs_key = (OQS_KEY*) EVP_MD_CTX_pkey_ctx(ctx)->pkey->pkey.ptr;
-    int is_hybrid = is_oqs_hybrid_alg(oqs_key->nid);
+    int is_hybrid = oqs_key != NULL && is_oqs_hybrid_alg(oqs_key->nid);
     int classical_id = 0;
     size_t classical_sig_len = 0;
     size_t index = 0;
+    OQS_SIG_JOB sig_job;
+    EVP_PKEY_CTX *ctx_verify = NULL;
+    int rv = 0;
 
     if (!oqs_key || !oqs_key->s  || !oqs_key->pubkey || (is_hybrid && !oqs_key->classical_pkey) ||
 	sig == NULL || tbs == NULL) {
@@ -1487,26 +1669,34 @@ static int pkey_oqs_digestverify(EVP_MD_CTX *ctx, const unsigned char *sig,
     }
 
     if (is_hybrid) {
-      EVP_PKEY_CTX *ctx_verify = NULL;
       const EVP_MD *classical_md;
       size_t actual_classical_sig_len = 0;
       int digest_len;
       unsigned char digest[SHA512_DIGEST_LENGTH]; /* init with max length */
 
+      if (siglen < SIZE_OF_UINT32) {
+	ECerr(EC_F_PKEY_OQS_DIGESTVERIFY, EC_R_VERIFICATION_FAILED);
+	return 0;
+      }
+      DECODE_UINT32(actual_classical_sig_len, sig);
+      if (actual_classical_sig_len > siglen - SIZE_OF_UINT32) {
+	ECerr(EC_F_PKEY_OQS_DIGESTVERIFY, EC_R_VERIFICATION_FAILED);
+	return 0;
+      }
+      classical_sig_len = SIZE_OF_UINT32 + actual_classical_sig_len;
+      index += classical_sig_len;
+
       if ((ctx_verify = EVP_PKEY_CTX_new(oqs_key->classical_pkey, NULL)) == NULL ||
 	  EVP_PKEY_verify_init(ctx_verify) <= 0) {
 	ECerr(EC_F_PKEY_OQS_DIGESTVERIFY, ERR_R_FATAL);
-	EVP_PKEY_CTX_free(ctx_verify);
-	return 0;
+	goto end;
       }
       if (classical_id == EVP_PKEY_RSA) {
 	if (EVP_PKEY_CTX_set_rsa_padding(ctx_verify, RSA_PKCS1_PADDING) <= 0) {
 	  ECerr(EC_F_PKEY_OQS_DIGESTVERIFY, ERR_R_FATAL);
-	  EVP_PKEY_CTX_free(ctx_verify);
-	  return 0;
+	  goto end;
 	}
       }
-      DECODE_UINT32(actual_classical_sig_len, sig);
       /* classical schemes can't sign arbitrarily large data; we hash it first */
       switch (oqs_key->s->claimed_nist_level) {
       case 1:
@@ -1530,23 +1720,57 @@ static int pkey_oqs_digestverify(EVP_MD_CTX *ctx, const unsigned char *sig,
       }
       if (EVP_PKEY_CTX_set_signature_md(ctx_verify, classical_md) <= 0) {
 	ECerr(EC_F_PKEY_OQS_DIGESTVERIFY, ERR_R_FATAL);
-	return 0;
+	goto end;
       }
       if (EVP_PKEY_verify(ctx_verify, sig + SIZE_OF_UINT32, actual_classical_sig_len, digest, digest_len) <= 0) {
 	ECerr(EC_F_PKEY_OQS_DIGESTVERIFY, EC_R_VERIFICATION_FAILED);
-	return 0;
+	goto end;
       }
-      classical_sig_len = SIZE_OF_UINT32 + actual_classical_sig_len;
-      index += classical_sig_len;
-      EVP_PKEY_CTX_free(ctx_verify);
     }
 
-    if (OQS_SIG_verify(oqs_key->s, tbs, tbslen, sig + index, siglen - classical_sig_len, oqs_key->pubkey) != OQS_SUCCESS) {
+    sig_job.oqs_key = oqs_key;
+    sig_job.csig = sig + index;
+    sig_job.siglen = siglen - classical_sig_len;
+    sig_job.tbs = tbs;
+    sig_job.tbslen = tbslen;
+    if (!EVP_run_oqs_op(oqs_sig_verify_job, &sig_job)) {
       ECerr(EC_F_PKEY_OQS_DIGESTVERIFY, EC_R_VERIFICATION_FAILED);
-      return 0;
+      goto end;
     }
 
-    return 1;
+    rv = 1;
+
+ end:
+    EVP_PKEY_CTX_free(ctx_verify);
+    return rv;
+}
+
+static int pkey_oqs_digestverify(EVP_MD_CTX *ctx, const unsigned char *sig,
+                                 size_t siglen, const unsigned char *tbs,
+                                 size_t tbslen)
+{
+    return oqs_verify(EVP_MD_CTX_pkey_ctx(ctx)->pkey->pkey.ptr, sig, siglen,
+                      tbs, tbslen);
+}
+
+/*
+ * Verifies a batch of OQS signatures against their keys directly, without
+ * setting up an EVP_MD_CTX and EVP_PKEY_CTX for each of them
+ */
+static int pkey_oqs_digestverify_batch(EVP_PKEY_VERIFY_ITEM *items, size_t num)
+{
+    size_t i;
+    int ret = 1;
+
+    for (i = 0; i < num; i++) {
+        EVP_PKEY_VERIFY_ITEM *item = &items[i];
+
+        item->result = oqs_verify(item->pkey->pkey.ptr, item->sig,
+                                  item->siglen, item->tbs, item->tbslen);
+        if (item->result != 1)
+            ret = 0;
+    }
+    return ret;
 }
 
 static int pkey_oqs_ctrl(EVP_PKEY_CTX *ctx, int type, int p1, void *p2)
@@ -1573,6 +1797,47 @@ static int pkey_oqs_ctrl(EVP_PKEY_CTX *ctx, int type, int p1, void *p2)
     return -2;
 }
 
+static int pkey_oqs_init(EVP_PKEY_CTX *ctx)
+{
+    OQS_PKEY_CTX *dctx = OPENSSL_zalloc(sizeof(*dctx));
+
+    if (dctx == NULL) {
+        ECerr(EC_F_PKEY_OQS_INIT, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    ctx->data = dctx;
+    return 1;
+}
+
+static void pkey_oqs_cleanup(EVP_PKEY_CTX *ctx)
+{
+    OQS_PKEY_CTX *dctx = ctx->data;
+
+    if (dctx == NULL)
+        return;
+    EVP_MD_CTX_free(dctx->digest);
+    OPENSSL_free(dctx);
+    ctx->data = NULL;
+}
+
+static int pkey_oqs_copy(EVP_PKEY_CTX *dst, EVP_PKEY_CTX *src)
+{
+    OQS_PKEY_CTX *sctx = src->data, *dctx;
+
+    if (!pkey_oqs_init(dst))
+        return 0;
+    dctx = dst->data;
+    if (sctx->digest_started) {
+        if ((dctx->digest = EVP_MD_CTX_new()) == NULL
+                || !EVP_MD_CTX_copy_ex(dctx->digest, sctx->digest)) {
+            pkey_oqs_cleanup(dst);
+            return 0;
+        }
+        dctx->digest_started = 1;
+    }
+    return 1;
+}
+
 static int pkey_oqs_sign_init(EVP_PKEY_CTX *ctx) {
    return 1;
 }
@@ -1584,69 +1849,65 @@ static int pkey_oqs_sign(EVP_PKEY_CTX *ctx, unsigned char *sig,
    return 1;
 }
 
-static int oqs_int_update(EVP_MD_CTX *ctx, const void *data, size_t count)
+/*
+ * Starts the pre-hash of a streaming operation. The EVP_MD_CTX is allocated
+ * once per EVP_PKEY_CTX and reused by every operation done with it.
+ */
+static int oqs_digest_start(OQS_PKEY_CTX *dctx)
 {
-    OQS_KEY *oqs_key = (OQS_KEY*) EVP_MD_CTX_pkey_ctx(ctx)->pkey->pkey.ptr;
+    if (dctx->digest_started)
+        return 1;
+    if (dctx->digest == NULL && (dctx->digest = EVP_MD_CTX_new()) == NULL)
+        return 0;
+    if (EVP_DigestInit_ex(dctx->digest, EVP_sha512(), NULL) <= 0)
+        return 0;
+    dctx->digest_started = 1;
+    return 1;
+}
 
-    if (oqs_key->digest == NULL) {
-        if ((oqs_key->digest = EVP_MD_CTX_create()) == NULL) {
-           return 0;
-        }
+/* Finishes the pre-hash into |tbs|, which holds SHA512_DIGEST_LENGTH bytes */
+static int oqs_digest_final(OQS_PKEY_CTX *dctx, unsigned char *tbs,
+                            unsigned int *tbslen)
+{
+    if (!oqs_digest_start(dctx)
+            || EVP_DigestFinal_ex(dctx->digest, tbs, tbslen) <= 0)
+        return 0;
+    dctx->digest_started = 0;
+    return 1;
+}
 
-        if (EVP_DigestInit_ex(oqs_key->digest, EVP_sha512(), NULL) <= 0) {
-           return 0;
-        }
-    }
+static int oqs_int_update(EVP_MD_CTX *ctx, const void *data, size_t count)
+{
+    OQS_PKEY_CTX *dctx = EVP_MD_CTX_pkey_ctx(ctx)->data;
 
-    if(EVP_DigestUpdate(oqs_key->digest, data, count)<=0) {
-	return 0;
-    }
-    return 1;
+    return oqs_digest_start(dctx)
+           && EVP_DigestUpdate(dctx->digest, data, count) > 0;
 }
 
 static int pkey_oqs_signctx_init (EVP_PKEY_CTX *ctx, EVP_MD_CTX *mctx) {
+    OQS_PKEY_CTX *dctx = ctx->data;
 
-    EVP_MD_CTX_set_flags(mctx, EVP_MD_CTX_FLAG_NO_INIT);
+    dctx->digest_started = 0;
+    /* finalise in place: no need to duplicate the context to sign */
+    EVP_MD_CTX_set_flags(mctx, EVP_MD_CTX_FLAG_NO_INIT | EVP_MD_CTX_FLAG_FINALISE);
     EVP_MD_CTX_set_update_fn(mctx, oqs_int_update);
 
     return 1;
 }
 
 static int pkey_oqs_signctx(EVP_PKEY_CTX *ctx, unsigned char *sig, size_t *siglen, EVP_MD_CTX *mctx) {
-    OQS_KEY *oqs_key = (OQS_KEY*) EVP_MD_CTX_pkey_ctx(mctx)->pkey->pkey.ptr;
-    unsigned char* tbs = NULL;
+    /* as per https://tools.ietf.org/id/draft-ietf-lamps-cms-shakes-08.html */
+    unsigned char tbs[SHA512_DIGEST_LENGTH];
     unsigned int tbslen = 0;
 
-
-    if (sig != NULL) {
-       tbslen = 512/8; // as per https://tools.ietf.org/id/draft-ietf-lamps-cms-shakes-08.html
-       // Finalize SHAKE:
-       if (oqs_key->digest == NULL) {
-         return 0;
-       }
-
-       if((tbs = (unsigned char *)OPENSSL_malloc(tbslen)) == NULL) {
-         return 0;
-       }
-
-       if(EVP_DigestFinal(oqs_key->digest, tbs, &tbslen) <= 0) {
-         return 0;
-       }
-
-    }
-    int ret = pkey_oqs_digestsign(mctx, sig, siglen, tbs, tbslen);
-    if (sig != NULL) { // cleanup only if it's not the empty setup call
-       OPENSSL_free(tbs);
-       EVP_MD_CTX_destroy(oqs_key->digest);
-       oqs_key->digest = NULL;
-    }
-    if (ret <= 0) {
+    if (sig == NULL) {
+       /* we only return the sig len */
+       return pkey_oqs_digestsign(mctx, NULL, siglen, NULL, 0);
     }
-    else {
-       EVP_MD_CTX_set_flags(mctx, EVP_MD_CTX_FLAG_FINALISE); // don't go around again...
+    if (!oqs_digest_final(ctx->data, tbs, &tbslen)) {
+       return 0;
     }
-
-   return ret;
+    return pkey_oqs_digestsign(mctx, sig, siglen, tbs, tbslen);
 }
 
 static int pkey_oqs_digestcustom(EVP_PKEY_CTX *ctx, EVP_MD_CTX *mctx) {
@@ -1663,22 +1924,30 @@ static int pkey_oqs_verify(EVP_PKEY_CTX *ctx,
    return 1;
 }
 static int pkey_oqs_verifyctx_init(EVP_PKEY_CTX *ctx, EVP_MD_CTX *mctx) {
+   OQS_PKEY_CTX *dctx = ctx->data;
 
-   EVP_MD_CTX_set_flags(mctx, EVP_MD_CTX_FLAG_NO_INIT);
+   dctx->digest_started = 0;
+   EVP_MD_CTX_set_flags(mctx, EVP_MD_CTX_FLAG_NO_INIT | EVP_MD_CTX_FLAG_FINALISE);
    EVP_MD_CTX_set_update_fn(mctx, oqs_int_update);
-   EVP_MD_CTX_set_flags(mctx, EVP_MD_CTX_FLAG_FINALISE); // don't go around again...
    return 1;
 }
 
 static int pkey_oqs_verifyctx(EVP_PKEY_CTX *ctx, const unsigned char *sig, int siglen,
                       EVP_MD_CTX *mctx) {
-   return 1;
+   unsigned char tbs[SHA512_DIGEST_LENGTH];
+   unsigned int tbslen = 0;
+
+   if (siglen < 0 || !oqs_digest_final(ctx->data, tbs, &tbslen)) {
+      return 0;
+   }
+   return pkey_oqs_digestverify(mctx, sig, siglen, tbs, tbslen);
 }
 
 #define DEFINE_OQS_EVP_PKEY_METHOD(ALG, NID_ALG)    \
 const EVP_PKEY_METHOD ALG##_pkey_meth = {           \
     NID_ALG, EVP_PKEY_FLAG_SIGCTX_CUSTOM,           \
-    0, 0, 0, 0, 0, 0,                               \
+    pkey_oqs_init, pkey_oqs_copy, pkey_oqs_cleanup, \
+    0, 0, 0,                                        \
     pkey_oqs_keygen,                                \
     pkey_oqs_sign_init, pkey_oqs_sign,              \
     pkey_oqs_verify_init, pkey_oqs_verify,          \
@@ -1691,7 +1960,8 @@ const EVP_PKEY_METHOD ALG##_pkey_meth = {           \
     pkey_oqs_digestsign,                            \
     pkey_oqs_digestverify,                          \
     0, 0, 0,                                        \
-    pkey_oqs_digestcustom                           \
+    pkey_oqs_digestcustom,                          \
+    pkey_oqs_digestverify_batch                     \
 };
 
 #define DEFINE_OQS_EVP_METHODS(ALG, NID_ALG, SHORT_NAME, LONG_NAME)   \
@@ -94,6 +94,8 @@ static ERR_STRING_DATA ERR_str_functs[] = {
     {ERR_PACK(0, SYS_F_STAT, 0), "stat"},
     {ERR_PACK(0, SYS_F_FCNTL, 0), "fcntl"},
     {ERR_PACK(0, SYS_F_FSTAT, 0), "fstat"},
+    {ERR_PACK(0, SYS_F_PREAD, 0), "pread"},
+    {ERR_PACK(0, SYS_F_SENDFILE, 0), "sendfile"},
     {0, NULL},
 };
 
@@ -12,6 +12,7 @@
 #include <openssl/evp.h>
 #include <openssl/objects.h>
 #include <openssl/x509.h>
+#include <openssl/engine.h>
 #include "crypto/evp.h"
 #include "evp_local.h"
 
@@ -216,3 +217,77 @@ int EVP_DigestVerify(EVP_MD_CTX *ctx, const unsigned char *sigret,
         return -1;
     return EVP_DigestVerifyFinal(ctx, sigret, siglen);
 }
+
+/*
+ * Returns the built-in method of |pkey| if it can verify signatures in
+ * batches, or NULL. Keys whose method may come from an ENGINE are not
+ * batched.
+ */
+static const EVP_PKEY_METHOD *verify_batch_meth(const EVP_PKEY *pkey)
+{
+    const EVP_PKEY_METHOD *pmeth;
+
+#ifndef OPENSSL_NO_ENGINE
+    ENGINE *e;
+
+    if (pkey->engine != NULL || pkey->pmeth_engine != NULL)
+        return NULL;
+    if ((e = ENGINE_get_pkey_meth_engine(pkey->type)) != NULL) {
+        ENGINE_finish(e);
+        return NULL;
+    }
+#endif
+    pmeth = EVP_PKEY_meth_find(pkey->type);
+    return pmeth != NULL && pmeth->digestverify_batch != NULL ? pmeth : NULL;
+}
+
+int evp_pkey_can_verify_batch(const EVP_PKEY *pkey)
+{
+    return verify_batch_meth(pkey) != NULL;
+}
+
+/*
+ * Verifies |num| signatures as EVP_DigestVerify() would after
+ * EVP_DigestVerifyInit() with the default digest of each key, and sets the
+ * result of each item. Runs of consecutive items that a key method can
+ * verify in one go are handed over to it, the others are verified one at a
+ * time. Returns 1 if all signatures are valid, 0 otherwise.
+ */
+int EVP_DigestVerifyBatch(EVP_PKEY_VERIFY_ITEM *items, size_t num)
+{
+    EVP_MD_CTX *ctx = NULL;
+    const EVP_PKEY_METHOD *pmeth, *next;
+    size_t i, j;
+    int ret = 1;
+
+    for (i = 0; i < num; i = j) {
+        j = i + 1;
+        if ((pmeth = verify_batch_meth(items[i].pkey)) != NULL) {
+            while (j < num
+                   && (next = verify_batch_meth(items[j].pkey)) != NULL
+                   && next->digestverify_batch == pmeth->digestverify_batch)
+                j++;
+            if (!pmeth->digestverify_batch(items + i, j - i))
+                ret = 0;
+            continue;
+        }
+
+        if (ctx == NULL && (ctx = EVP_MD_CTX_new()) == NULL) {
+            EVPerr(EVP_F_EVP_DIGESTVERIFYBATCH, ERR_R_MALLOC_FAILURE);
+            for (; i < num; i++)
+                items[i].result = -1;
+            return 0;
+        }
+        EVP_MD_CTX_reset(ctx);
+        if (EVP_DigestVerifyInit(ctx, NULL, NULL, NULL, items[i].pkey) <= 0)
+            items[i].result = -1;
+        else
+            items[i].result = EVP_DigestVerify(ctx, items[i].sig,
+                                               items[i].siglen, items[i].tbs,
+                                               items[i].tbslen);
+        if (items[i].result != 1)
+            ret = 0;
+    }
+    EVP_MD_CTX_free(ctx);
+    return ret;
+}
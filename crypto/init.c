@@ -578,6 +578,8 @@ void OPENSSL_cleanup(void)
                     "bio_cleanup()\n");
     fprintf(stderr, "OPENSSL_INIT: OPENSSL_cleanup: "
                     "evp_cleanup_int()\n");
+    fprintf(stderr, "OPENSSL_INIT: OPENSSL_cleanup: "
+                    "oqs_registry_cleanup_int()\n");
     fprintf(stderr, "OPENSSL_INIT: OPENSSL_cleanup: "
                     "obj_cleanup_int()\n");
     fprintf(stderr, "OPENSSL_INIT: OPENSSL_cleanup: "
@@ -604,6 +606,7 @@ void OPENSSL_cleanup(void)
     crypto_cleanup_all_ex_data_int();
     bio_cleanup();
     evp_cleanup_int();
+    oqs_registry_cleanup_int();
     obj_cleanup_int();
     err_cleanup();
 
@@ -17,6 +17,7 @@
  */
 #include "e_os.h"
 #include <openssl/crypto.h>
+#include "crypto/cryptlib.h"
 
 #include <string.h>
 
@@ -49,6 +50,8 @@
 
 #ifdef OPENSSL_SECURE_MEMORY
 static size_t secure_mem_used;
+static size_t secure_mem_high_water;
+static uint64_t secure_mem_contended;
 
 static int secure_mem_initialized;
 
@@ -57,15 +60,63 @@ static CRYPTO_RWLOCK *sec_malloc_lock = NULL;
 /*
  * These are the functions that must be implemented by a secure heap (sh).
  */
-static int sh_init(size_t size, int minsize);
+static int sh_init(size_t size, int minsize, size_t large_size, int flags);
 static void *sh_malloc(size_t size);
 static void sh_free(void *ptr);
 static void sh_done(void);
 static size_t sh_actual_size(char *ptr);
 static int sh_allocated(const char *ptr);
+static void sh_free_space(size_t *free_bytes, size_t *largest_free);
+
+/*
+ * The optional per-thread caches. Chunks in a cache still count as used.
+ * sh_cache_size() returns 0 for chunks that are never cached.
+ */
+static void *sh_cache_get(size_t size);
+static int sh_cache_put(void *ptr, size_t size);
+static size_t sh_cache_size(const char *ptr);
+static void sh_cache_drain(void);
+/* Must be called with sec_malloc_lock held */
+static void sh_cache_stats(size_t *cached, uint64_t *hits);
+
+/* Takes sec_malloc_lock, counting the times another thread was holding it */
+static void sec_malloc_lock_acquire(void)
+{
+    if (!ossl_thread_try_write_lock(sec_malloc_lock)) {
+        CRYPTO_THREAD_write_lock(sec_malloc_lock);
+        secure_mem_contended++;
+    }
+}
+
+/* Returns |ptr|, which is in the secure heap, to a thread cache or the heap */
+static void sec_free(void *ptr)
+{
+    size_t actual_size;
+
+    /* Cacheable chunks can be sized without taking the lock */
+    if ((actual_size = sh_cache_size(ptr)) != 0) {
+        CLEAR(ptr, actual_size);
+        if (sh_cache_put(ptr, actual_size))
+            return;
+    }
+    sec_malloc_lock_acquire();
+    if (actual_size == 0) {
+        actual_size = sh_actual_size(ptr);
+        CLEAR(ptr, actual_size);
+    }
+    secure_mem_used -= actual_size;
+    sh_free(ptr);
+    CRYPTO_THREAD_unlock(sec_malloc_lock);
+}
 #endif
 
 int CRYPTO_secure_malloc_init(size_t size, int minsize)
+{
+    return CRYPTO_secure_malloc_init_ex(size, minsize, 0, 0);
+}
+
+int CRYPTO_secure_malloc_init_ex(size_t size, int minsize, size_t large_size,
+                                 int flags)
 {
 #ifdef OPENSSL_SECURE_MEMORY
     int ret = 0;
@@ -74,7 +125,7 @@ int CRYPTO_secure_malloc_init(size_t size, int minsize)
         sec_malloc_lock = CRYPTO_THREAD_lock_new();
         if (sec_malloc_lock == NULL)
             return 0;
-        if ((ret = sh_init(size, minsize)) != 0) {
+        if ((ret = sh_init(size, minsize, large_size, flags)) != 0) {
             secure_mem_initialized = 1;
         } else {
             CRYPTO_THREAD_lock_free(sec_malloc_lock);
@@ -91,9 +142,12 @@ int CRYPTO_secure_malloc_init(size_t size, int minsize)
 int CRYPTO_secure_malloc_done(void)
 {
 #ifdef OPENSSL_SECURE_MEMORY
+    sh_cache_drain();
     if (secure_mem_used == 0) {
         sh_done();
         secure_mem_initialized = 0;
+        secure_mem_high_water = 0;
+        secure_mem_contended = 0;
         CRYPTO_THREAD_lock_free(sec_malloc_lock);
         sec_malloc_lock = NULL;
         return 1;
@@ -120,10 +174,14 @@ void *CRYPTO_secure_malloc(size_t num, const char *file, int line)
     if (!secure_mem_initialized) {
         return CRYPTO_malloc(num, file, line);
     }
-    CRYPTO_THREAD_write_lock(sec_malloc_lock);
+    if ((ret = sh_cache_get(num)) != NULL)
+        return ret;
+    sec_malloc_lock_acquire();
     ret = sh_malloc(num);
     actual_size = ret ? sh_actual_size(ret) : 0;
     secure_mem_used += actual_size;
+    if (secure_mem_used > secure_mem_high_water)
+        secure_mem_high_water = secure_mem_used;
     CRYPTO_THREAD_unlock(sec_malloc_lock);
     return ret;
 #else
@@ -144,20 +202,13 @@ void *CRYPTO_secure_zalloc(size_t num, const char *file, int line)
 void CRYPTO_secure_free(void *ptr, const char *file, int line)
 {
 #ifdef OPENSSL_SECURE_MEMORY
-    size_t actual_size;
-
     if (ptr == NULL)
         return;
     if (!CRYPTO_secure_allocated(ptr)) {
         CRYPTO_free(ptr, file, line);
         return;
     }
-    CRYPTO_THREAD_write_lock(sec_malloc_lock);
-    actual_size = sh_actual_size(ptr);
-    CLEAR(ptr, actual_size);
-    secure_mem_used -= actual_size;
-    sh_free(ptr);
-    CRYPTO_THREAD_unlock(sec_malloc_lock);
+    sec_free(ptr);
 #else
     CRYPTO_free(ptr, file, line);
 #endif /* OPENSSL_SECURE_MEMORY */
@@ -167,8 +218,6 @@ void CRYPTO_secure_clear_free(void *ptr, size_t num,
                               const char *file, int line)
 {
 #ifdef OPENSSL_SECURE_MEMORY
-    size_t actual_size;
-
     if (ptr == NULL)
         return;
     if (!CRYPTO_secure_allocated(ptr)) {
@@ -176,12 +225,7 @@ void CRYPTO_secure_clear_free(void *ptr, size_t num,
         CRYPTO_free(ptr, file, line);
         return;
     }
-    CRYPTO_THREAD_write_lock(sec_malloc_lock);
-    actual_size = sh_actual_size(ptr);
-    CLEAR(ptr, actual_size);
-    secure_mem_used -= actual_size;
-    sh_free(ptr);
-    CRYPTO_THREAD_unlock(sec_malloc_lock);
+    sec_free(ptr);
 #else
     if (ptr == NULL)
         return;
@@ -193,14 +237,10 @@ void CRYPTO_secure_clear_free(void *ptr, size_t num,
 int CRYPTO_secure_allocated(const void *ptr)
 {
 #ifdef OPENSSL_SECURE_MEMORY
-    int ret;
-
     if (!secure_mem_initialized)
         return 0;
-    CRYPTO_THREAD_write_lock(sec_malloc_lock);
-    ret = sh_allocated(ptr);
-    CRYPTO_THREAD_unlock(sec_malloc_lock);
-    return ret;
+    /* The heap's bounds don't change until CRYPTO_secure_malloc_done() */
+    return sh_allocated(ptr);
 #else
     return 0;
 #endif /* OPENSSL_SECURE_MEMORY */
@@ -209,7 +249,15 @@ int CRYPTO_secure_allocated(const void *ptr)
 size_t CRYPTO_secure_used(void)
 {
 #ifdef OPENSSL_SECURE_MEMORY
-    return secure_mem_used;
+    size_t used, cached = 0;
+
+    if (!secure_mem_initialized)
+        return 0;
+    CRYPTO_THREAD_write_lock(sec_malloc_lock);
+    sh_cache_stats(&cached, NULL);
+    used = secure_mem_used - cached;
+    CRYPTO_THREAD_unlock(sec_malloc_lock);
+    return used;
 #else
     return 0;
 #endif /* OPENSSL_SECURE_MEMORY */
@@ -228,6 +276,38 @@ size_t CRYPTO_secure_actual_size(void *ptr)
     return 0;
 #endif
 }
+
+int CRYPTO_secure_malloc_stats(size_t *used, size_t *high_water,
+                               size_t *free_bytes, size_t *largest_free,
+                               uint64_t *cache_hits, uint64_t *contended)
+{
+#ifdef OPENSSL_SECURE_MEMORY
+    size_t cached = 0, fr = 0, largest = 0;
+    uint64_t hits = 0;
+
+    if (!secure_mem_initialized)
+        return 0;
+    CRYPTO_THREAD_write_lock(sec_malloc_lock);
+    sh_cache_stats(&cached, &hits);
+    if (used != NULL)
+        *used = secure_mem_used - cached;
+    if (high_water != NULL)
+        *high_water = secure_mem_high_water;
+    if (contended != NULL)
+        *contended = secure_mem_contended;
+    sh_free_space(&fr, &largest);
+    CRYPTO_THREAD_unlock(sec_malloc_lock);
+    if (free_bytes != NULL)
+        *free_bytes = fr;
+    if (largest_free != NULL)
+        *largest_free = largest;
+    if (cache_hits != NULL)
+        *cache_hits = hits;
+    return 1;
+#else
+    return 0;
+#endif /* OPENSSL_SECURE_MEMORY */
+}
 /* END OF PAGE ...
 
    ... START OF PAGE */
@@ -251,8 +331,28 @@ size_t CRYPTO_secure_actual_size(void *ptr)
  *
  * This code assumes eight-bit bytes.  The numbers 3 and 7 are all over the
  * place.
+ *
+ * Post-quantum secret keys can be tens of kilobytes (and some a megabyte),
+ * and buddy allocation rounds those up to the next power of two. The heap
+ * can therefore have a second, separately mapped and locked, region for
+ * large objects. It is managed first-fit in SH_LARGE_ALIGN units with its
+ * extent list kept outside the mapping, and freed neighbours are merged.
+ *
+ * Small secrets such as KEM shared secrets are allocated and freed on every
+ * handshake, so each thread can also keep a few freed (and cleansed) buddy
+ * chunks per size class. Those are handed back without taking the global
+ * lock; a table with the size class of each allocated chunk lets a free
+ * find its class without the lock too.
  */
 
+/* Allocations larger than this go to the large object region, if any */
+# define SH_LARGE_MIN       (16 * 1024)
+# define SH_LARGE_ALIGN     64
+/* Largest chunk, and number of chunks per size class, in a thread cache */
+# define SH_CACHE_MAX       4096
+# define SH_CACHE_DEPTH     8
+# define SH_CACHE_CLASSES   16
+
 #define ONE ((size_t)1)
 
 # define TESTBIT(t, b)  (t[(b) >> 3] &  (ONE << ((b) & 7)))
@@ -263,6 +363,8 @@ size_t CRYPTO_secure_actual_size(void *ptr)
     ((char*)(p) >= sh.arena && (char*)(p) < &sh.arena[sh.arena_size])
 #define WITHIN_FREELIST(p) \
     ((char*)(p) >= (char*)sh.freelist && (char*)(p) < (char*)&sh.freelist[sh.freelist_size])
+#define WITHIN_LARGE(p) \
+    ((char*)(p) >= sh.large && (char*)(p) < &sh.large[sh.large_size])
 
 
 typedef struct sh_list_st
@@ -271,6 +373,26 @@ typedef struct sh_list_st
     struct sh_list_st **p_next;
 } SH_LIST;
 
+/* A used or free piece of the large object region, in address order */
+typedef struct sh_extent_st
+{
+    char *ptr;
+    size_t size;
+    int used;
+    struct sh_extent_st *prev;
+    struct sh_extent_st *next;
+} SH_EXTENT;
+
+/* Freed chunks kept by one thread, linked through their first bytes */
+typedef struct sh_cache_st
+{
+    CRYPTO_RWLOCK *lock;
+    char *chunks[SH_CACHE_CLASSES];
+    size_t count[SH_CACHE_CLASSES];
+    uint64_t hits;
+    struct sh_cache_st *next;
+} SH_CACHE;
+
 typedef struct sh_st
 {
     char* map_result;
@@ -283,6 +405,18 @@ typedef struct sh_st
     unsigned char *bittable;
     unsigned char *bitmalloc;
     size_t bittable_size; /* size in bits */
+    char *large_map_result;
+    size_t large_map_size;
+    char *large;
+    size_t large_size;
+    SH_EXTENT *extents;
+    /* Thread caches, all of which are on the |caches| list */
+    int cache_enabled;
+    CRYPTO_THREAD_LOCAL cache_key;
+    SH_CACHE *caches;
+    uint64_t stopped_cache_hits;
+    /* Freelist index + 1 of the chunk starting at each minsize unit */
+    unsigned char *chunk_list;
 } SH;
 
 static SH sh;
@@ -373,14 +507,95 @@ static void sh_remove_from_list(char *ptr)
 }
 
 
-static int sh_init(size_t size, int minsize)
+static size_t sh_pagesize(void)
+{
+#if defined(_SC_PAGE_SIZE) || defined (_SC_PAGESIZE)
+# if defined(_SC_PAGE_SIZE)
+    long tmppgsize = sysconf(_SC_PAGE_SIZE);
+# else
+    long tmppgsize = sysconf(_SC_PAGESIZE);
+# endif
+    if (tmppgsize >= 1)
+        return (size_t)tmppgsize;
+#endif
+    return PAGE_SIZE;
+}
+
+/*
+ * Maps |size| bytes with a guard page on either side, locked into memory and
+ * excluded from core dumps. Returns 0 on failure, 1 on success and 2 if the
+ * memory could be mapped but not fully protected.
+ */
+static int sh_map(size_t size, char **map_result, size_t *map_size,
+                  char **arena)
 {
     int ret;
-    size_t i;
-    size_t pgsize;
+    size_t pgsize = sh_pagesize();
     size_t aligned;
 
+    /* Allocate space for heap, and two extra pages as guards */
+    *map_size = pgsize + size + pgsize;
+    if (1) {
+#ifdef MAP_ANON
+        *map_result = mmap(NULL, *map_size,
+                           PROT_READ|PROT_WRITE, MAP_ANON|MAP_PRIVATE, -1, 0);
+    } else {
+#endif
+        int fd;
+
+        *map_result = MAP_FAILED;
+        if ((fd = open("/dev/zero", O_RDWR)) >= 0) {
+            *map_result = mmap(NULL, *map_size,
+                               PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+            close(fd);
+        }
+    }
+    if (*map_result == MAP_FAILED)
+        return 0;
+    *arena = (char *)(*map_result + pgsize);
+
+    /* Now try to add guard pages and lock into memory. */
+    ret = 1;
+
+    /* Starting guard is already aligned from mmap. */
+    if (mprotect(*map_result, pgsize, PROT_NONE) < 0)
+        ret = 2;
+
+    /* Ending guard page - need to round up to page boundary */
+    aligned = (pgsize + size + (pgsize - 1)) & ~(pgsize - 1);
+    if (mprotect(*map_result + aligned, pgsize, PROT_NONE) < 0)
+        ret = 2;
+
+#if defined(OPENSSL_SYS_LINUX) && defined(MLOCK_ONFAULT) && defined(SYS_mlock2)
+    if (syscall(SYS_mlock2, *arena, size, MLOCK_ONFAULT) < 0) {
+        if (errno == ENOSYS) {
+            if (mlock(*arena, size) < 0)
+                ret = 2;
+        } else {
+            ret = 2;
+        }
+    }
+#else
+    if (mlock(*arena, size) < 0)
+        ret = 2;
+#endif
+#ifdef MADV_DONTDUMP
+    if (madvise(*arena, size, MADV_DONTDUMP) < 0)
+        ret = 2;
+#endif
+
+    return ret;
+}
+
+static void sh_cache_thread_stop(void *arg);
+
+static int sh_init(size_t size, int minsize, size_t large_size, int flags)
+{
+    int ret, lret;
+    size_t i;
+
     memset(&sh, 0, sizeof(sh));
+    sh.map_result = sh.large_map_result = MAP_FAILED;
 
     /* make sure size and minsize are powers of 2 */
     OPENSSL_assert(size > 0);
@@ -422,73 +637,35 @@ static int sh_init(size_t size, int minsize)
     if (sh.bitmalloc == NULL)
         goto err;
 
-    /* Allocate space for heap, and two extra pages as guards */
-#if defined(_SC_PAGE_SIZE) || defined (_SC_PAGESIZE)
-    {
-# if defined(_SC_PAGE_SIZE)
-        long tmppgsize = sysconf(_SC_PAGE_SIZE);
-# else
-        long tmppgsize = sysconf(_SC_PAGESIZE);
-# endif
-        if (tmppgsize < 1)
-            pgsize = PAGE_SIZE;
-        else
-            pgsize = (size_t)tmppgsize;
-    }
-#else
-    pgsize = PAGE_SIZE;
-#endif
-    sh.map_size = pgsize + sh.arena_size + pgsize;
-    if (1) {
-#ifdef MAP_ANON
-        sh.map_result = mmap(NULL, sh.map_size,
-                             PROT_READ|PROT_WRITE, MAP_ANON|MAP_PRIVATE, -1, 0);
-    } else {
-#endif
-        int fd;
-
-        sh.map_result = MAP_FAILED;
-        if ((fd = open("/dev/zero", O_RDWR)) >= 0) {
-            sh.map_result = mmap(NULL, sh.map_size,
-                                 PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
-            close(fd);
-        }
-    }
-    if (sh.map_result == MAP_FAILED)
+    if ((ret = sh_map(sh.arena_size, &sh.map_result, &sh.map_size,
+                      &sh.arena)) == 0)
         goto err;
-    sh.arena = (char *)(sh.map_result + pgsize);
     sh_setbit(sh.arena, 0, sh.bittable);
     sh_add_to_list(&sh.freelist[0], sh.arena);
 
-    /* Now try to add guard pages and lock into memory. */
-    ret = 1;
+    if (large_size > 0) {
+        size_t pgsize = sh_pagesize();
 
-    /* Starting guard is already aligned from mmap. */
-    if (mprotect(sh.map_result, pgsize, PROT_NONE) < 0)
-        ret = 2;
-
-    /* Ending guard page - need to round up to page boundary */
-    aligned = (pgsize + sh.arena_size + (pgsize - 1)) & ~(pgsize - 1);
-    if (mprotect(sh.map_result + aligned, pgsize, PROT_NONE) < 0)
-        ret = 2;
-
-#if defined(OPENSSL_SYS_LINUX) && defined(MLOCK_ONFAULT) && defined(SYS_mlock2)
-    if (syscall(SYS_mlock2, sh.arena, sh.arena_size, MLOCK_ONFAULT) < 0) {
-        if (errno == ENOSYS) {
-            if (mlock(sh.arena, sh.arena_size) < 0)
-                ret = 2;
-        } else {
+        sh.large_size = (large_size + pgsize - 1) & ~(pgsize - 1);
+        if ((sh.extents = OPENSSL_zalloc(sizeof(*sh.extents))) == NULL)
+            goto err;
+        if ((lret = sh_map(sh.large_size, &sh.large_map_result,
+                           &sh.large_map_size, &sh.large)) == 0)
+            goto err;
+        if (lret == 2)
             ret = 2;
-        }
+        sh.extents->ptr = sh.large;
+        sh.extents->size = sh.large_size;
+    }
+
+    if ((flags & CRYPTO_SECURE_MALLOC_THREAD_CACHE) != 0) {
+        sh.chunk_list = OPENSSL_zalloc(sh.arena_size / sh.minsize);
+        if (sh.chunk_list == NULL
+                || !CRYPTO_THREAD_init_local(&sh.cache_key,
+                                             sh_cache_thread_stop))
+            goto err;
+        sh.cache_enabled = 1;
     }
-#else
-    if (mlock(sh.arena, sh.arena_size) < 0)
-        ret = 2;
-#endif
-#ifdef MADV_DONTDUMP
-    if (madvise(sh.arena, sh.arena_size, MADV_DONTDUMP) < 0)
-        ret = 2;
-#endif
 
     return ret;
 
@@ -499,17 +676,34 @@ static int sh_init(size_t size, int minsize)
 
 static void sh_done(void)
 {
+    SH_EXTENT *e, *next;
+    SH_CACHE *cache, *cnext;
+
+    if (sh.cache_enabled)
+        CRYPTO_THREAD_cleanup_local(&sh.cache_key);
+    for (cache = sh.caches; cache != NULL; cache = cnext) {
+        cnext = cache->next;
+        CRYPTO_THREAD_lock_free(cache->lock);
+        OPENSSL_free(cache);
+    }
+    OPENSSL_free(sh.chunk_list);
+    for (e = sh.extents; e != NULL; e = next) {
+        next = e->next;
+        OPENSSL_free(e);
+    }
     OPENSSL_free(sh.freelist);
     OPENSSL_free(sh.bittable);
     OPENSSL_free(sh.bitmalloc);
     if (sh.map_result != MAP_FAILED && sh.map_size)
         munmap(sh.map_result, sh.map_size);
+    if (sh.large_map_result != MAP_FAILED && sh.large_map_size)
+        munmap(sh.large_map_result, sh.large_map_size);
     memset(&sh, 0, sizeof(sh));
 }
 
 static int sh_allocated(const char *ptr)
 {
-    return WITHIN_ARENA(ptr) ? 1 : 0;
+    return WITHIN_ARENA(ptr) || WITHIN_LARGE(ptr) ? 1 : 0;
 }
 
 static char *sh_find_my_buddy(char *ptr, int list)
@@ -526,7 +720,7 @@ static char *sh_find_my_buddy(char *ptr, int list)
     return chunk;
 }
 
-static void *sh_malloc(size_t size)
+static void *sh_buddy_malloc(size_t size)
 {
     ossl_ssize_t list, slist;
     size_t i;
@@ -588,10 +782,13 @@ static void *sh_malloc(size_t size)
     /* zero the free list header as a precaution against information leakage */
     memset(chunk, 0, sizeof(SH_LIST));
 
+    if (sh.chunk_list != NULL)
+        sh.chunk_list[(chunk - sh.arena) / sh.minsize] = (unsigned char)(list + 1);
+
     return chunk;
 }
 
-static void sh_free(void *ptr)
+static void sh_buddy_free(void *ptr)
 {
     size_t list;
     void *buddy;
@@ -602,6 +799,9 @@ static void sh_free(void *ptr)
     if (!WITHIN_ARENA(ptr))
         return;
 
+    if (sh.chunk_list != NULL)
+        sh.chunk_list[((char *)ptr - sh.arena) / sh.minsize] = 0;
+
     list = sh_getlist(ptr);
     OPENSSL_assert(sh_testbit(ptr, list, sh.bittable));
     sh_clearbit(ptr, list, sh.bitmalloc);
@@ -632,7 +832,7 @@ static void sh_free(void *ptr)
     }
 }
 
-static size_t sh_actual_size(char *ptr)
+static size_t sh_buddy_actual_size(char *ptr)
 {
     int list;
 
@@ -643,4 +843,277 @@ static size_t sh_actual_size(char *ptr)
     OPENSSL_assert(sh_testbit(ptr, list, sh.bittable));
     return sh.arena_size / (ONE << list);
 }
+
+static SH_EXTENT *sh_large_find(const char *ptr)
+{
+    SH_EXTENT *e;
+
+    for (e = sh.extents; e != NULL; e = e->next)
+        if (e->ptr == ptr)
+            return e->used ? e : NULL;
+    return NULL;
+}
+
+static void *sh_large_malloc(size_t size)
+{
+    SH_EXTENT *e, *rest;
+
+    size = (size + SH_LARGE_ALIGN - 1) & ~(size_t)(SH_LARGE_ALIGN - 1);
+    for (e = sh.extents; e != NULL; e = e->next)
+        if (!e->used && e->size >= size)
+            break;
+    if (e == NULL)
+        return NULL;
+
+    /* split off what isn't needed */
+    if (e->size > size) {
+        if ((rest = OPENSSL_zalloc(sizeof(*rest))) == NULL)
+            return NULL;
+        rest->ptr = e->ptr + size;
+        rest->size = e->size - size;
+        rest->prev = e;
+        rest->next = e->next;
+        if (e->next != NULL)
+            e->next->prev = rest;
+        e->next = rest;
+        e->size = size;
+    }
+    e->used = 1;
+    return e->ptr;
+}
+
+/* Merges |e| with the free extent following it */
+static void sh_large_merge(SH_EXTENT *e)
+{
+    SH_EXTENT *next = e->next;
+
+    e->size += next->size;
+    e->next = next->next;
+    if (next->next != NULL)
+        next->next->prev = e;
+    OPENSSL_free(next);
+}
+
+static void sh_large_free(void *ptr)
+{
+    SH_EXTENT *e = sh_large_find(ptr);
+
+    OPENSSL_assert(e != NULL);
+    if (e == NULL)
+        return;
+    e->used = 0;
+    if (e->next != NULL && !e->next->used)
+        sh_large_merge(e);
+    if (e->prev != NULL && !e->prev->used)
+        sh_large_merge(e->prev);
+}
+
+static void *sh_malloc(size_t size)
+{
+    void *ret;
+
+    if (sh.large != NULL && size > SH_LARGE_MIN
+            && (ret = sh_large_malloc(size)) != NULL)
+        return ret;
+    return sh_buddy_malloc(size);
+}
+
+static void sh_free(void *ptr)
+{
+    if (ptr != NULL && WITHIN_LARGE(ptr))
+        sh_large_free(ptr);
+    else
+        sh_buddy_free(ptr);
+}
+
+static size_t sh_actual_size(char *ptr)
+{
+    if (WITHIN_LARGE(ptr)) {
+        SH_EXTENT *e = sh_large_find(ptr);
+
+        OPENSSL_assert(e != NULL);
+        return e != NULL ? e->size : 0;
+    }
+    return sh_buddy_actual_size(ptr);
+}
+
+static void sh_free_space(size_t *free_bytes, size_t *largest_free)
+{
+    ossl_ssize_t list;
+    SH_LIST *temp;
+    SH_EXTENT *e;
+
+    for (list = 0; list < sh.freelist_size; list++) {
+        size_t size = sh.arena_size >> list;
+
+        for (temp = (SH_LIST *)sh.freelist[list]; temp != NULL;
+             temp = temp->next) {
+            *free_bytes += size;
+            if (size > *largest_free)
+                *largest_free = size;
+        }
+    }
+    for (e = sh.extents; e != NULL; e = e->next) {
+        if (e->used)
+            continue;
+        *free_bytes += e->size;
+        if (e->size > *largest_free)
+            *largest_free = e->size;
+    }
+}
+
+static int sh_cache_class(size_t size)
+{
+    int cls = 0;
+    size_t i;
+
+    for (i = sh.minsize; i < size; i <<= 1)
+        cls++;
+    return cls;
+}
+
+/* Returns the chunks in |cache| to the heap, with sec_malloc_lock held */
+static void sh_cache_empty(SH_CACHE *cache)
+{
+    int cls;
+    char *chunk;
+
+    CRYPTO_THREAD_write_lock(cache->lock);
+    for (cls = 0; cls < SH_CACHE_CLASSES; cls++) {
+        while ((chunk = cache->chunks[cls]) != NULL) {
+            cache->chunks[cls] = *(char **)chunk;
+            memset(chunk, 0, sizeof(SH_LIST));
+            secure_mem_used -= sh_buddy_actual_size(chunk);
+            sh_buddy_free(chunk);
+        }
+        cache->count[cls] = 0;
+    }
+    CRYPTO_THREAD_unlock(cache->lock);
+}
+
+/* The thread local destructor, run when a thread with a cache exits */
+static void sh_cache_thread_stop(void *arg)
+{
+    SH_CACHE *cache = arg, **pp;
+
+    if (cache == NULL || !secure_mem_initialized)
+        return;
+    sec_malloc_lock_acquire();
+    for (pp = &sh.caches; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == cache) {
+            *pp = cache->next;
+            break;
+        }
+    }
+    sh_cache_empty(cache);
+    sh.stopped_cache_hits += cache->hits;
+    CRYPTO_THREAD_unlock(sec_malloc_lock);
+    CRYPTO_THREAD_lock_free(cache->lock);
+    OPENSSL_free(cache);
+}
+
+static SH_CACHE *sh_cache_own(int create)
+{
+    SH_CACHE *cache = CRYPTO_THREAD_get_local(&sh.cache_key);
+
+    if (cache != NULL || !create)
+        return cache;
+    if ((cache = OPENSSL_zalloc(sizeof(*cache))) == NULL)
+        return NULL;
+    if ((cache->lock = CRYPTO_THREAD_lock_new()) == NULL
+            || !CRYPTO_THREAD_set_local(&sh.cache_key, cache)) {
+        CRYPTO_THREAD_lock_free(cache->lock);
+        OPENSSL_free(cache);
+        return NULL;
+    }
+    sec_malloc_lock_acquire();
+    cache->next = sh.caches;
+    sh.caches = cache;
+    CRYPTO_THREAD_unlock(sec_malloc_lock);
+    return cache;
+}
+
+static void *sh_cache_get(size_t size)
+{
+    SH_CACHE *cache;
+    char *chunk;
+    int cls;
+
+    if (!sh.cache_enabled || size > SH_CACHE_MAX
+            || (cache = sh_cache_own(0)) == NULL)
+        return NULL;
+    cls = sh_cache_class(size);
+    CRYPTO_THREAD_write_lock(cache->lock);
+    if ((chunk = cache->chunks[cls]) != NULL) {
+        cache->chunks[cls] = *(char **)chunk;
+        cache->count[cls]--;
+        cache->hits++;
+    }
+    CRYPTO_THREAD_unlock(cache->lock);
+    /* The rest of the chunk was cleansed when it was cached */
+    if (chunk != NULL)
+        memset(chunk, 0, sizeof(SH_LIST));
+    return chunk;
+}
+
+static int sh_cache_put(void *ptr, size_t size)
+{
+    SH_CACHE *cache;
+    int cls = sh_cache_class(size), ret = 0;
+
+    if ((cache = sh_cache_own(1)) == NULL)
+        return 0;
+    CRYPTO_THREAD_write_lock(cache->lock);
+    if (cache->count[cls] < SH_CACHE_DEPTH) {
+        *(char **)ptr = cache->chunks[cls];
+        cache->chunks[cls] = ptr;
+        cache->count[cls]++;
+        ret = 1;
+    }
+    CRYPTO_THREAD_unlock(cache->lock);
+    return ret;
+}
+
+static size_t sh_cache_size(const char *ptr)
+{
+    size_t size;
+    unsigned char list;
+
+    if (!sh.cache_enabled || !WITHIN_ARENA(ptr))
+        return 0;
+    list = sh.chunk_list[(ptr - sh.arena) / sh.minsize];
+    if (list == 0)
+        return 0;
+    size = sh.arena_size >> (list - 1);
+    return size <= SH_CACHE_MAX ? size : 0;
+}
+
+static void sh_cache_drain(void)
+{
+    SH_CACHE *cache;
+
+    if (!sh.cache_enabled)
+        return;
+    sec_malloc_lock_acquire();
+    for (cache = sh.caches; cache != NULL; cache = cache->next)
+        sh_cache_empty(cache);
+    CRYPTO_THREAD_unlock(sec_malloc_lock);
+}
+
+static void sh_cache_stats(size_t *cached, uint64_t *hits)
+{
+    SH_CACHE *cache;
+    int cls;
+
+    if (hits != NULL)
+        *hits += sh.stopped_cache_hits;
+    for (cache = sh.caches; cache != NULL; cache = cache->next) {
+        CRYPTO_THREAD_write_lock(cache->lock);
+        for (cls = 0; cls < SH_CACHE_CLASSES; cls++)
+            *cached += cache->count[cls] * (sh.minsize << cls);
+        if (hits != NULL)
+            *hits += cache->hits;
+        CRYPTO_THREAD_unlock(cache->lock);
+    }
+}
 #endif /* OPENSSL_SECURE_MEMORY */
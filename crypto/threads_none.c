@@ -8,7 +8,7 @@
  */
 
 #include <openssl/crypto.h>
-#include "internal/cryptlib.h"
+#include "crypto/cryptlib.h"
 
 #if !defined(OPENSSL_THREADS) || defined(CRYPTO_TDEBUG)
 
@@ -45,6 +45,11 @@ int CRYPTO_THREAD_write_lock(CRYPTO_RWLOCK *lock)
     return 1;
 }
 
+int ossl_thread_try_write_lock(CRYPTO_RWLOCK *lock)
+{
+    return CRYPTO_THREAD_write_lock(lock);
+}
+
 int CRYPTO_THREAD_unlock(CRYPTO_RWLOCK *lock)
 {
     if (!ossl_assert(*(unsigned int *)lock == 1))
@@ -8,7 +8,7 @@
  */
 
 #include <openssl/crypto.h>
-#include "internal/cryptlib.h"
+#include "crypto/cryptlib.h"
 
 #if defined(OPENSSL_THREADS) && !defined(CRYPTO_TDEBUG) && !defined(OPENSSL_SYS_WINDOWS)
 
@@ -85,6 +85,15 @@ int CRYPTO_THREAD_write_lock(CRYPTO_RWLOCK *lock)
     return 1;
 }
 
+int ossl_thread_try_write_lock(CRYPTO_RWLOCK *lock)
+{
+# ifdef USE_RWLOCK
+    return pthread_rwlock_trywrlock(lock) == 0;
+# else
+    return pthread_mutex_trylock(lock) == 0;
+# endif
+}
+
 int CRYPTO_THREAD_unlock(CRYPTO_RWLOCK *lock)
 {
 # ifdef USE_RWLOCK
@@ -12,6 +12,7 @@
 #endif
 
 #include <openssl/crypto.h>
+#include "crypto/cryptlib.h"
 
 #if defined(OPENSSL_THREADS) && !defined(CRYPTO_TDEBUG) && defined(OPENSSL_SYS_WINDOWS)
 
@@ -49,6 +50,16 @@ int CRYPTO_THREAD_write_lock(CRYPTO_RWLOCK *lock)
     return 1;
 }
 
+int ossl_thread_try_write_lock(CRYPTO_RWLOCK *lock)
+{
+# if !defined(_WIN32_WCE)
+    return TryEnterCriticalSection(lock);
+# else
+    EnterCriticalSection(lock);
+    return 1;
+# endif
+}
+
 int CRYPTO_THREAD_unlock(CRYPTO_RWLOCK *lock)
 {
     LeaveCriticalSection(lock);
@@ -22,6 +22,7 @@
 #include <openssl/x509v3.h>
 #include <openssl/objects.h>
 #include "internal/dane.h"
+#include "crypto/evp.h"
 #include "crypto/x509.h"
 #include "x509_local.h"
 
@@ -1725,8 +1726,85 @@ int x509_check_cert_time(X509_STORE_CTX *ctx, X509 *x, int depth)
     return 1;
 }
 
-/* verify the issuer signatures and cert times of ctx->chain */
-static int internal_verify(X509_STORE_CTX *ctx)
+/*
+ * Returns 1 if |x| is signed in a way that X509_verify() would check with
+ * EVP_DigestVerify() and |pkey|'s default digest, and |pkey|'s method can
+ * verify signatures in batches.
+ */
+static int sig_batchable(X509 *x, EVP_PKEY *pkey)
+{
+    int mdnid, pknid, defnid;
+
+    return evp_pkey_can_verify_batch(pkey)
+        && X509_ALGOR_cmp(&x->sig_alg, &x->cert_info.signature) == 0
+        && (x->signature.flags & 0x7) == 0
+        && OBJ_find_sigid_algs(OBJ_obj2nid(x->sig_alg.algorithm), &mdnid,
+                               &pknid)
+        && EVP_PKEY_type(pknid) == EVP_PKEY_base_id(pkey)
+        && EVP_PKEY_get_default_digest_nid(pkey, &defnid) > 0
+        && mdnid == defnid;
+}
+
+/*
+ * Checks in a single EVP_DigestVerifyBatch() call the signatures of the
+ * certificates of the chain that are issued by the next one up, when at
+ * least two of them can be batched, e.g. with OQS keys. On return, sig_ok[n]
+ * is 1 if the signature of the cert at depth n is known to be good. All
+ * other signatures, including those found bad here, are checked one at a
+ * time by internal_verify_int(), which reports the errors.
+ */
+static void batch_verify_chain(X509_STORE_CTX *ctx, int *sig_ok)
+{
+    int num = sk_X509_num(ctx->chain);
+    EVP_PKEY_VERIFY_ITEM *items = NULL;
+    unsigned char **tbs = NULL;
+    int *depth = NULL;
+    int n, i, len, nitems = 0;
+
+    if (num < 3
+            || (items = OPENSSL_malloc(sizeof(*items) * (num - 1))) == NULL
+            || (tbs = OPENSSL_zalloc(sizeof(*tbs) * (num - 1))) == NULL
+            || (depth = OPENSSL_malloc(sizeof(*depth) * (num - 1))) == NULL)
+        goto end;
+
+    for (n = 0; n < num - 1; n++) {
+        X509 *xs = sk_X509_value(ctx->chain, n);
+        EVP_PKEY *pkey = X509_get0_pubkey(sk_X509_value(ctx->chain, n + 1));
+
+        if (pkey == NULL || !sig_batchable(xs, pkey)
+                || (len = ASN1_item_i2d((ASN1_VALUE *)&xs->cert_info,
+                                        &tbs[nitems],
+                                        ASN1_ITEM_rptr(X509_CINF))) <= 0)
+            continue;
+        items[nitems].pkey = pkey;
+        items[nitems].tbs = tbs[nitems];
+        items[nitems].tbslen = len;
+        items[nitems].sig = xs->signature.data;
+        items[nitems].siglen = xs->signature.length;
+        items[nitems].result = 0;
+        depth[nitems++] = n;
+    }
+
+    if (nitems >= 2) {
+        /* Bad signatures are reported when they are checked again */
+        ERR_set_mark();
+        if (!EVP_DigestVerifyBatch(items, nitems))
+            ERR_pop_to_mark();
+        else
+            ERR_clear_last_mark();
+        for (i = 0; i < nitems; i++)
+            sig_ok[depth[i]] = items[i].result == 1;
+    }
+
+ end:
+    for (i = 0; i < nitems; i++)
+        OPENSSL_free(tbs[i]);
+    OPENSSL_free(tbs);
+    OPENSSL_free(items);
+    OPENSSL_free(depth);
+}
+
+static int internal_verify_int(X509_STORE_CTX *ctx, const int *sig_ok)
 {
     int n = sk_X509_num(ctx->chain) - 1;
     X509 *xi = sk_X509_value(ctx->chain, n);
@@ -1804,7 +1882,8 @@ static int internal_verify(X509_STORE_CTX *ctx)
                 ret = X509_V_ERR_UNABLE_TO_DECODE_ISSUER_PUBLIC_KEY;
                 if (!verify_cb_cert(ctx, xi, issuer_depth, ret))
                     return 0;
-            } else if (X509_verify(xs, pkey) <= 0) {
+            } else if ((sig_ok == NULL || !sig_ok[n])
+                       && X509_verify(xs, pkey) <= 0) {
                 ret = X509_V_ERR_CERT_SIGNATURE_FAILURE;
                 if (!verify_cb_cert(ctx, xs, n, ret))
                     return 0;
@@ -1834,6 +1913,20 @@ static int internal_verify(X509_STORE_CTX *ctx)
     return 1;
 }
 
+/* verify the issuer signatures and cert times of ctx->chain */
+static int internal_verify(X509_STORE_CTX *ctx)
+{
+    int *sig_ok = OPENSSL_zalloc(sizeof(*sig_ok) * sk_X509_num(ctx->chain));
+    int ret;
+
+    /* Without memory for the batch, every signature is checked on its own */
+    if (sig_ok != NULL)
+        batch_verify_chain(ctx, sig_ok);
+    ret = internal_verify_int(ctx, sig_ok);
+    OPENSSL_free(sig_ok);
+    return ret;
+}
+
 int X509_cmp_current_time(const ASN1_TIME *ctm)
 {
     return X509_cmp_time(ctm, NULL);
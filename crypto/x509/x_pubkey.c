@@ -25,11 +25,30 @@ struct X509_pubkey_st {
 
 static int x509_pubkey_decode(EVP_PKEY **pk, X509_PUBKEY *key);
 
+/*
+ * OQS keys can reference the encoding in |pubkey->public_key| rather than
+ * copy it (see EVP_set_oqs_key_zero_copy()). Tell the cached key before the
+ * encoding goes away, so that it can take it over.
+ */
+static void x509_pubkey_release(X509_PUBKEY *pubkey)
+{
+    EVP_PKEY *pkey = pubkey->pkey;
+
+    if (pkey != NULL && pubkey->public_key != NULL && pkey->ameth != NULL
+            && IS_OQS_OPENSSL_SIG_NID(pkey->ameth->pkey_id)
+            && pkey->ameth->pkey_ctrl != NULL)
+        pkey->ameth->pkey_ctrl(pkey, ASN1_PKEY_CTRL_X509_PUBKEY_RELEASE, 0,
+                               pubkey->public_key);
+}
+
 /* Minor tweak to operation: free up EVP_PKEY */
 static int pubkey_cb(int operation, ASN1_VALUE **pval, const ASN1_ITEM *it,
                      void *exarg)
 {
-    if (operation == ASN1_OP_FREE_POST) {
+    if (operation == ASN1_OP_FREE_PRE || operation == ASN1_OP_D2I_PRE) {
+        if (*pval != NULL)
+            x509_pubkey_release((X509_PUBKEY *)*pval);
+    } else if (operation == ASN1_OP_FREE_POST) {
         X509_PUBKEY *pubkey = (X509_PUBKEY *)*pval;
         EVP_PKEY_free(pubkey->pkey);
     } else if (operation == ASN1_OP_D2I_POST) {
@@ -345,6 +364,7 @@ int X509_PUBKEY_set0_param(X509_PUBKEY *pub, ASN1_OBJECT *aobj,
     if (!X509_ALGOR_set0(pub->algor, aobj, ptype, pval))
         return 0;
     if (penc) {
+        x509_pubkey_release(pub);
         OPENSSL_free(pub->public_key->data);
         pub->public_key->data = penc;
         pub->public_key->length = penclen;
@@ -28,7 +28,11 @@
 #if defined(OPENSSL_SYS_UNIX) && defined(OPENSSL_THREADS)
 # undef ASYNC_POSIX
 # define ASYNC_POSIX
+# include <errno.h>
 # include <unistd.h>
+# include <poll.h>
+# include <pthread.h>
+# define DASYNC_OQS_OFFLOAD
 #elif defined(_WIN32)
 # undef ASYNC_WIN
 # define ASYNC_WIN
@@ -53,6 +57,11 @@ static int dasync_digests(ENGINE *e, const EVP_MD **digest,
                           const int **nids, int nid);
 
 static void dummy_pause_job(void);
+#ifdef DASYNC_OQS_OFFLOAD
+static int dasync_oqs_offload(int (*fn)(void *), void *arg);
+static int dasync_oqs_worker_start(void);
+static void dasync_oqs_worker_stop(void);
+#endif
 
 /* SHA1 */
 static int dasync_sha1_init(EVP_MD_CTX *ctx);
@@ -325,12 +334,21 @@ void engine_load_dasync_int(void)
 
 static int dasync_init(ENGINE *e)
 {
+#ifdef DASYNC_OQS_OFFLOAD
+    /* Leave OQS operations alone if another offload method is set */
+    if (dasync_oqs_worker_start() && !EVP_set_oqs_offload(dasync_oqs_offload))
+        dasync_oqs_worker_stop();
+#endif
     return 1;
 }
 
 
 static int dasync_finish(ENGINE *e)
 {
+#ifdef DASYNC_OQS_OFFLOAD
+    EVP_clear_oqs_offload(dasync_oqs_offload);
+    dasync_oqs_worker_stop();
+#endif
     return 1;
 }
 
@@ -407,22 +425,13 @@ static void wait_cleanup(ASYNC_WAIT_CTX *ctx, const void *key,
 
 #define DUMMY_CHAR 'X'
 
-static void dummy_pause_job(void) {
-    ASYNC_JOB *job;
-    ASYNC_WAIT_CTX *waitctx;
-    OSSL_ASYNC_FD pipefds[2] = {0, 0};
+/*
+ * Sets |pipefds| to the pipe used to wake jobs run with |waitctx|, creating
+ * it on first use
+ */
+static int get_wait_fds(ASYNC_WAIT_CTX *waitctx, OSSL_ASYNC_FD pipefds[2])
+{
     OSSL_ASYNC_FD *writefd;
-#if defined(ASYNC_WIN)
-    DWORD numwritten, numread;
-    char buf = DUMMY_CHAR;
-#elif defined(ASYNC_POSIX)
-    char buf = DUMMY_CHAR;
-#endif
-
-    if ((job = ASYNC_get_current_job()) == NULL)
-        return;
-
-    waitctx = ASYNC_get_wait_ctx(job);
 
     if (ASYNC_WAIT_CTX_get_fd(waitctx, engine_dasync_id, &pipefds[0],
                               (void **)&writefd)) {
@@ -430,16 +439,16 @@ static void dummy_pause_job(void) {
     } else {
         writefd = OPENSSL_malloc(sizeof(*writefd));
         if (writefd == NULL)
-            return;
+            return 0;
 #if defined(ASYNC_WIN)
         if (CreatePipe(&pipefds[0], &pipefds[1], NULL, 256) == 0) {
             OPENSSL_free(writefd);
-            return;
+            return 0;
         }
 #elif defined(ASYNC_POSIX)
         if (pipe(pipefds) != 0) {
             OPENSSL_free(writefd);
-            return;
+            return 0;
         }
 #endif
         *writefd = pipefds[1];
@@ -447,9 +456,28 @@ static void dummy_pause_job(void) {
         if (!ASYNC_WAIT_CTX_set_wait_fd(waitctx, engine_dasync_id, pipefds[0],
                                         writefd, wait_cleanup)) {
             wait_cleanup(waitctx, engine_dasync_id, pipefds[0], writefd);
-            return;
+            return 0;
         }
     }
+    return 1;
+}
+
+static void dummy_pause_job(void) {
+    ASYNC_JOB *job;
+    OSSL_ASYNC_FD pipefds[2] = {0, 0};
+#if defined(ASYNC_WIN)
+    DWORD numwritten, numread;
+    char buf = DUMMY_CHAR;
+#elif defined(ASYNC_POSIX)
+    char buf = DUMMY_CHAR;
+#endif
+
+    if ((job = ASYNC_get_current_job()) == NULL)
+        return;
+
+    if (!get_wait_fds(ASYNC_get_wait_ctx(job), pipefds))
+        return;
+
     /*
      * In the Dummy async engine we are cheating. We signal that the job
      * is complete by waking it before the call to ASYNC_pause_job(). A real
@@ -474,6 +502,129 @@ static void dummy_pause_job(void) {
 #endif
 }
 
+#ifdef DASYNC_OQS_OFFLOAD
+/*
+ * OQS operations, see EVP_run_oqs_op(). Unlike the other dummy async
+ * operations these really are asynchronous: they are queued to a worker
+ * thread, which runs them one at a time and wakes each paused job once its
+ * operation is done. The worker lives while the engine is initialised.
+ */
+typedef struct {
+    int (*fn)(void *);
+    void *arg;
+    int ret;
+    OSSL_ASYNC_FD writefd;
+} DASYNC_OQS_OP;
+
+static pthread_mutex_t oqs_worker_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t oqs_worker;
+static int oqs_worker_running = 0;
+/* Operations are queued by writing their address to oqs_queue[1] */
+static int oqs_queue[2] = { -1, -1 };
+
+static void *dasync_oqs_worker(void *arg)
+{
+    DASYNC_OQS_OP *op;
+    char buf = DUMMY_CHAR;
+
+    /* Ends when the write end of the queue is closed */
+    while (read(oqs_queue[0], &op, sizeof(op)) == sizeof(op)) {
+        op->ret = op->fn(op->arg);
+        /* Nothing more can be done for a job that can't be woken */
+        if (write(op->writefd, &buf, 1) < 0)
+            continue;
+    }
+    return NULL;
+}
+
+static int dasync_oqs_worker_start(void)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&oqs_worker_lock);
+    if (oqs_worker_running) {
+        ret = 1;
+    } else if (pipe(oqs_queue) == 0) {
+        if (pthread_create(&oqs_worker, NULL, dasync_oqs_worker, NULL) == 0) {
+            oqs_worker_running = ret = 1;
+        } else {
+            close(oqs_queue[0]);
+            close(oqs_queue[1]);
+        }
+    }
+    pthread_mutex_unlock(&oqs_worker_lock);
+    return ret;
+}
+
+/* Lets the worker finish the queued operations, then joins it */
+static void dasync_oqs_worker_stop(void)
+{
+    int running;
+
+    pthread_mutex_lock(&oqs_worker_lock);
+    running = oqs_worker_running;
+    if (running) {
+        oqs_worker_running = 0;
+        close(oqs_queue[1]);
+    }
+    pthread_mutex_unlock(&oqs_worker_lock);
+    if (running) {
+        pthread_join(oqs_worker, NULL);
+        close(oqs_queue[0]);
+    }
+}
+
+/* Returns 1 if |fd| is readable, without blocking */
+static int fd_ready(OSSL_ASYNC_FD fd)
+{
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) > 0;
+}
+
+static int dasync_oqs_offload(int (*fn)(void *), void *arg)
+{
+    ASYNC_JOB *job;
+    OSSL_ASYNC_FD pipefds[2] = {0, 0};
+    DASYNC_OQS_OP op, *opp = &op;
+    int queued = 0;
+    char buf;
+
+    if ((job = ASYNC_get_current_job()) == NULL
+            || !get_wait_fds(ASYNC_get_wait_ctx(job), pipefds))
+        return -1;
+
+    op.fn = fn;
+    op.arg = arg;
+    op.ret = 0;
+    op.writefd = pipefds[1];
+    pthread_mutex_lock(&oqs_worker_lock);
+    if (oqs_worker_running)
+        queued = write(oqs_queue[1], &opp, sizeof(opp)) == sizeof(opp);
+    pthread_mutex_unlock(&oqs_worker_lock);
+    if (!queued)
+        return -1;
+
+    /*
+     * The job may be resumed before the worker is done, e.g. by a caller that
+     * doesn't wait for the fd, so pause until it is. If the job can't be
+     * paused, the read below waits for the worker instead.
+     */
+    while (!fd_ready(pipefds[0]) && ASYNC_pause_job())
+        continue;
+
+    /* Clear the wake signal */
+    while (read(pipefds[0], &buf, 1) < 0) {
+        if (errno != EINTR)
+            return 0;
+    }
+    return op.ret;
+}
+#endif
+
 /*
  * SHA1 implementation. At the moment we just defer to the standard
  * implementation
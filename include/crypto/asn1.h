@@ -11,6 +11,14 @@
 
 #include <oqs/oqs.h>
 
+/*
+ * pkey_ctrl operation sent to an OQS key cached in an X509_PUBKEY before
+ * the X509_PUBKEY frees or replaces its encoding, passed as the
+ * ASN1_BIT_STRING in arg2. A key that references the encoding rather than
+ * holding a copy takes it over.
+ */
+# define ASN1_PKEY_CTRL_X509_PUBKEY_RELEASE 0x1000
+
 /* ASN1 public key method structure */
 
 struct evp_pkey_asn1_method_st {
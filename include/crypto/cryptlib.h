@@ -19,6 +19,9 @@ struct thread_local_inits_st {
 
 int ossl_init_thread_start(uint64_t opts);
 
+/* Takes |lock| for writing if that doesn't block, returns 1 on success */
+int ossl_thread_try_write_lock(CRYPTO_RWLOCK *lock);
+
 /*
  * OPENSSL_INIT flags. The primary list of these is in crypto.h. Flags below
  * are those omitted from crypto.h because they are "reserved for internal
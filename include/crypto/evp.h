@@ -88,11 +88,15 @@ struct evp_pkey_method_st {
     int (*param_check) (EVP_PKEY *pkey);
 
     int (*digest_custom) (EVP_PKEY_CTX *ctx, EVP_MD_CTX *mctx);
+
+    /* Verifies several one-shot signatures, see EVP_DigestVerifyBatch() */
+    int (*digestverify_batch) (EVP_PKEY_VERIFY_ITEM *items, size_t num);
 } /* EVP_PKEY_METHOD */ ;
 
 DEFINE_STACK_OF_CONST(EVP_PKEY_METHOD)
 
 void evp_pkey_set_cb_translate(BN_GENCB *cb, EVP_PKEY_CTX *ctx);
+int evp_pkey_can_verify_batch(const EVP_PKEY *pkey);
 
 extern const EVP_PKEY_METHOD cmac_pkey_meth;
 extern const EVP_PKEY_METHOD dh_pkey_meth;
@@ -457,6 +461,15 @@ void openssl_add_all_ciphers_int(void);
 void openssl_add_all_digests_int(void);
 void evp_cleanup_int(void);
 void evp_app_cleanup_int(void);
+void oqs_registry_cleanup_int(void);
+/*
+ * Returns the OQS signature descriptor, shared by the whole library, of a PQ
+ * or hybrid signature NID, or NULL
+ */
+const struct OQS_SIG *get_oqs_sig(int openssl_nid);
+/* Returns the NID of the classical half of a hybrid OQS scheme, or 0 */
+int get_oqs_classical_nid(int openssl_nid);
+
 
 /* Pulling defines out of C source files */
 
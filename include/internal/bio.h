@@ -24,6 +24,25 @@ struct bio_method_st {
     long (*callback_ctrl) (BIO *, int, BIO_info_cb *);
 };
 
+/*
+ * Kernel TLS state of a socket BIO. The record type of the next write is kept
+ * in its ptr while BIO_FLAGS_KTLS_TX_CTRL_MSG is set.
+ */
+#define BIO_FLAGS_KTLS_TX_CTRL_MSG 0x1000
+#define BIO_FLAGS_KTLS_RX          0x2000
+#define BIO_FLAGS_KTLS_TX          0x4000
+
+/* |info| is a ktls_crypto_info_t, see include/internal/ktls.h */
+#define BIO_set_ktls(b, info, is_tx) \
+         BIO_ctrl((b), BIO_CTRL_SET_KTLS, (is_tx), (info))
+/* Whether the kernel can take new keys for a direction that has some */
+#define BIO_get_ktls_rekey(b) \
+         BIO_ctrl((b), BIO_CTRL_GET_KTLS_REKEY, 0, NULL)
+#define BIO_set_ktls_ctrl_msg(b, record_type) \
+         BIO_ctrl((b), BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG, (record_type), NULL)
+#define BIO_clear_ktls_ctrl_msg(b) \
+         BIO_ctrl((b), BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG, 0, NULL)
+
 void bio_free_ex_data(BIO *bio);
 void bio_cleanup(void);
 
@@ -0,0 +1,233 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Linux kernel TLS (kTLS). Once the traffic keys of a direction are installed
+ * on a TCP socket, the kernel encrypts what is written to it into records, or
+ * decrypts the records that it receives, and the record type travels in a
+ * control message.
+ *
+ * OPENSSL_NO_KTLS is defined below if the kernel headers do not support it.
+ */
+
+#ifndef OSSL_INTERNAL_KTLS_H
+# define OSSL_INTERNAL_KTLS_H
+
+# include <openssl/e_os2.h>
+
+# ifndef OPENSSL_NO_KTLS
+#  ifdef OPENSSL_SYS_LINUX
+#   include <linux/version.h>
+/* Receive offload, and so TLS_RX, needs 4.17 */
+#   if LINUX_VERSION_CODE < KERNEL_VERSION(4, 17, 0)
+#    define OPENSSL_NO_KTLS
+#   endif
+#  else
+#   define OPENSSL_NO_KTLS
+#  endif
+# endif
+
+# ifndef OPENSSL_NO_KTLS
+#  include <errno.h>
+#  include <string.h>
+#  include <unistd.h>
+#  include <sys/types.h>
+#  include <sys/socket.h>
+#  include <netinet/in.h>
+#  include <arpa/inet.h>
+#  include <netinet/tcp.h>
+#  include <sys/sendfile.h>
+#  include <linux/tls.h>
+
+#  ifndef TCP_ULP
+#   define TCP_ULP 31
+#  endif
+#  ifndef SOL_TLS
+#   define SOL_TLS 282
+#  endif
+
+/* The size of the TLS record header that ktls_read_record() prepends */
+#  define KTLS_RECORD_HEADER_LENGTH     5
+/* The most plaintext that ktls_read_record() returns in one record */
+#  define KTLS_MAX_PLAIN_LENGTH         16384
+
+/* The keys of one direction of a connection, as the kernel takes them */
+typedef struct {
+    union {
+        struct tls_crypto_info info;
+        struct tls12_crypto_info_aes_gcm_128 aes_gcm_128;
+#  ifdef TLS_CIPHER_AES_GCM_256
+        struct tls12_crypto_info_aes_gcm_256 aes_gcm_256;
+#  endif
+#  ifdef TLS_CIPHER_CHACHA20_POLY1305
+        struct tls12_crypto_info_chacha20_poly1305 chacha20_poly1305;
+#  endif
+    } u;
+    size_t len;
+} ktls_crypto_info_t;
+
+/*
+ * Attaches the TLS upper layer protocol to the TCP socket |fd|, unless it
+ * already has it. The socket carries plain TCP until keys are installed.
+ */
+static ossl_inline int ktls_enable(int fd)
+{
+    return setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0
+           || errno == EEXIST;
+}
+
+/*
+ * Installs the keys in |info| for sending if |is_tx| is nonzero, or for
+ * receiving otherwise. Installing them again replaces the keys of a TLSv1.3
+ * key update, on kernels that support it.
+ */
+static ossl_inline int ktls_start(int fd, const ktls_crypto_info_t *info,
+                                  int is_tx)
+{
+    return setsockopt(fd, SOL_TLS, is_tx ? TLS_TX : TLS_RX, &info->u,
+                      (socklen_t)info->len) == 0;
+}
+
+/*
+ * Whether the kernel can replace the keys of a direction, as a TLSv1.3 key
+ * update needs. Only trying tells, so this installs keys twice on one end of
+ * a throwaway connection over the loopback interface.
+ */
+static ossl_inline int ktls_probe_rekey(void)
+{
+    int ret = 0;
+#  ifdef TLS_1_3_VERSION
+    struct sockaddr_in sa;
+    socklen_t salen = sizeof(sa);
+    int lfd, cfd = -1, afd = -1;
+    ktls_crypto_info_t info;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((lfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+        return 0;
+    if (bind(lfd, (struct sockaddr *)&sa, sizeof(sa)) == 0
+            && listen(lfd, 1) == 0
+            && getsockname(lfd, (struct sockaddr *)&sa, &salen) == 0
+            && (cfd = socket(AF_INET, SOCK_STREAM, 0)) >= 0
+            && connect(cfd, (struct sockaddr *)&sa, sizeof(sa)) == 0
+            && (afd = accept(lfd, NULL, NULL)) >= 0) {
+        memset(&info, 0, sizeof(info));
+        info.u.aes_gcm_128.info.version = TLS_1_3_VERSION;
+        info.u.aes_gcm_128.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        info.len = sizeof(info.u.aes_gcm_128);
+        ret = ktls_enable(cfd) && ktls_start(cfd, &info, 1)
+              && ktls_start(cfd, &info, 1);
+    }
+    if (afd >= 0)
+        close(afd);
+    if (cfd >= 0)
+        close(cfd);
+    close(lfd);
+#  endif
+    return ret;
+}
+
+/* Sends |data| as the payload of records of |record_type| */
+static ossl_inline int ktls_send_ctrl_message(int fd, unsigned char record_type,
+                                              const void *data, size_t length)
+{
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(unsigned char))];
+    } cmsgbuf;
+    struct iovec msg_iov;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = cmsgbuf.buf;
+    msg.msg_controllen = sizeof(cmsgbuf.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_TLS;
+    cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+    *((unsigned char *)CMSG_DATA(cmsg)) = record_type;
+    msg.msg_controllen = cmsg->cmsg_len;
+
+    msg_iov.iov_base = (void *)data;
+    msg_iov.iov_len = length;
+    msg.msg_iov = &msg_iov;
+    msg.msg_iovlen = 1;
+
+    return sendmsg(fd, &msg, 0);
+}
+
+/*
+ * Receives the payload of records of one type into |data|, after a TLS
+ * record header for it, so that the record layer parses it as it does a
+ * record read from the network. Returns the length of the header and the
+ * payload, or what recvmsg() returned if it did not succeed.
+ */
+static ossl_inline int ktls_read_record(int fd, void *data, size_t length)
+{
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(unsigned char))];
+    } cmsgbuf;
+    struct iovec msg_iov;
+    unsigned char *p = data;
+    int ret;
+
+    if (length <= KTLS_RECORD_HEADER_LENGTH) {
+        errno = EINVAL;
+        return -1;
+    }
+    length -= KTLS_RECORD_HEADER_LENGTH;
+    if (length > KTLS_MAX_PLAIN_LENGTH)
+        length = KTLS_MAX_PLAIN_LENGTH;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = cmsgbuf.buf;
+    msg.msg_controllen = sizeof(cmsgbuf.buf);
+
+    msg_iov.iov_base = p + KTLS_RECORD_HEADER_LENGTH;
+    msg_iov.iov_len = length;
+    msg.msg_iov = &msg_iov;
+    msg.msg_iovlen = 1;
+
+    ret = recvmsg(fd, &msg, 0);
+    if (ret <= 0)
+        return ret;
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_level != SOL_TLS
+            || cmsg->cmsg_type != TLS_GET_RECORD_TYPE) {
+        errno = EBADMSG;
+        return -1;
+    }
+    p[0] = *((unsigned char *)CMSG_DATA(cmsg));
+    p[1] = TLS_1_2_VERSION_MAJOR;
+    p[2] = TLS_1_2_VERSION_MINOR;
+    p[3] = (unsigned char)(ret >> 8);
+    p[4] = (unsigned char)ret;
+
+    return ret + KTLS_RECORD_HEADER_LENGTH;
+}
+
+/*
+ * Sends |size| bytes of the file |fd| from |off| as application data, which
+ * the kernel reads into records without a copy to user space.
+ */
+static ossl_inline ossl_ssize_t ktls_sendfile(int s, int fd, off_t off,
+                                              size_t size)
+{
+    return sendfile(s, fd, &off, size);
+}
+
+# endif /* OPENSSL_NO_KTLS */
+#endif /* OSSL_INTERNAL_KTLS_H */
@@ -141,6 +141,14 @@ extern "C" {
 
 # define BIO_CTRL_DGRAM_SET_PEEK_MODE      71
 
+/* Linux kernel TLS offload of the socket BIO */
+# define BIO_CTRL_SET_KTLS                  72
+# define BIO_CTRL_GET_KTLS_SEND             73
+# define BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG 74
+# define BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG    75
+# define BIO_CTRL_GET_KTLS_RECV             76
+# define BIO_CTRL_GET_KTLS_REKEY            77
+
 /* modifiers */
 # define BIO_FP_READ             0x02
 # define BIO_FP_WRITE            0x04
@@ -524,6 +532,12 @@ int BIO_ctrl_reset_read_request(BIO *b);
 # define BIO_dgram_get_mtu_overhead(b) \
          (unsigned int)BIO_ctrl((b), BIO_CTRL_DGRAM_GET_MTU_OVERHEAD, 0, NULL)
 
+/* ctrl macros for kernel TLS */
+# define BIO_get_ktls_send(b) \
+         (int)BIO_ctrl((b), BIO_CTRL_GET_KTLS_SEND, 0, NULL)
+# define BIO_get_ktls_recv(b) \
+         (int)BIO_ctrl((b), BIO_CTRL_GET_KTLS_RECV, 0, NULL)
+
 #define BIO_get_ex_new_index(l, p, newf, dupf, freef) \
     CRYPTO_get_ex_new_index(CRYPTO_EX_INDEX_BIO, l, p, newf, dupf, freef)
 int BIO_set_ex_data(BIO *bio, int idx, void *data);
@@ -34,6 +34,7 @@ int COMP_expand_block(COMP_CTX *ctx, unsigned char *out, int olen,
                       unsigned char *in, int ilen);
 
 COMP_METHOD *COMP_zlib(void);
+COMP_METHOD *COMP_zlib_oneshot(void);
 
 #if OPENSSL_API_COMPAT < 0x10100000L
 #define COMP_zlib_cleanup() while(0) continue
@@ -275,6 +275,10 @@ void *CRYPTO_clear_realloc(void *addr, size_t old_num, size_t num,
                            const char *file, int line);
 
 int CRYPTO_secure_malloc_init(size_t sz, int minsize);
+/* Flags for CRYPTO_secure_malloc_init_ex() */
+# define CRYPTO_SECURE_MALLOC_THREAD_CACHE      0x1
+int CRYPTO_secure_malloc_init_ex(size_t sz, int minsize, size_t large_sz,
+                                 int flags);
 int CRYPTO_secure_malloc_done(void);
 void *CRYPTO_secure_malloc(size_t num, const char *file, int line);
 void *CRYPTO_secure_zalloc(size_t num, const char *file, int line);
@@ -285,6 +289,9 @@ int CRYPTO_secure_allocated(const void *ptr);
 int CRYPTO_secure_malloc_initialized(void);
 size_t CRYPTO_secure_actual_size(void *ptr);
 size_t CRYPTO_secure_used(void);
+int CRYPTO_secure_malloc_stats(size_t *used, size_t *high_water,
+                               size_t *free_bytes, size_t *largest_free,
+                               uint64_t *cache_hits, uint64_t *contended);
 
 void OPENSSL_cleanse(void *ptr, size_t len);
 
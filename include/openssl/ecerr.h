@@ -210,6 +210,7 @@ int ERR_load_EC_strings(void);
 #  define EC_F_PKEY_OQS_CTRL                               303
 #  define EC_F_PKEY_OQS_DIGESTSIGN                         304
 #  define EC_F_PKEY_OQS_DIGESTVERIFY                       305
+#  define EC_F_PKEY_OQS_INIT                               307
 #  define EC_F_PKEY_OQS_KEYGEN                             306
 #  define EC_F_VALIDATE_ECX_DERIVE                         278
 
@@ -111,6 +111,17 @@ char* get_oqs_alg_name(int openssl_nid);
 extern "C" {
 #endif
 
+/* Offloading of OQS operations from ASYNC jobs, see EVP_set_oqs_offload(3) */
+typedef int (*EVP_OQS_OP_FN)(void *arg);
+typedef int (*EVP_OQS_OFFLOAD_FN)(EVP_OQS_OP_FN fn, void *arg);
+int EVP_set_oqs_offload(EVP_OQS_OFFLOAD_FN offload);
+void EVP_clear_oqs_offload(EVP_OQS_OFFLOAD_FN offload);
+int EVP_run_oqs_op(EVP_OQS_OP_FN fn, void *arg);
+
+/* See EVP_set_oqs_key_zero_copy(3) */
+void EVP_set_oqs_key_zero_copy(int on);
+int EVP_get_oqs_key_zero_copy(void);
+
 # define EVP_PKEY_MO_SIGN        0x0001
 # define EVP_PKEY_MO_VERIFY      0x0002
 # define EVP_PKEY_MO_ENCRYPT     0x0004
@@ -675,6 +686,18 @@ __owur int EVP_DigestVerify(EVP_MD_CTX *ctx, const unsigned char *sigret,
                             size_t siglen, const unsigned char *tbs,
                             size_t tbslen);
 
+/* One signature checked by EVP_DigestVerifyBatch() */
+typedef struct evp_pkey_verify_item_st {
+    EVP_PKEY *pkey;
+    const unsigned char *tbs;
+    size_t tbslen;
+    const unsigned char *sig;
+    size_t siglen;
+    int result;                 /* Set to what EVP_DigestVerify() returns */
+} EVP_PKEY_VERIFY_ITEM;
+
+__owur int EVP_DigestVerifyBatch(EVP_PKEY_VERIFY_ITEM *items, size_t num);
+
 /*__owur*/ int EVP_DigestSignInit(EVP_MD_CTX *ctx, EVP_PKEY_CTX **pctx,
                                   const EVP_MD *type, ENGINE *e,
                                   EVP_PKEY *pkey);
@@ -13,6 +13,9 @@
 # define HEADER_SSL_H
 
 # include <openssl/e_os2.h>
+# ifdef OPENSSL_SYS_UNIX
+#  include <sys/types.h>
+# endif
 # include <openssl/opensslconf.h>
 # include <openssl/comp.h>
 # include <openssl/bio.h>
@@ -506,6 +509,16 @@ typedef int (*SSL_verify_cb)(int preverify_ok, X509_STORE_CTX *x509_ctx);
  * - OpenSSL 1.1.1 and 1.1.1a
  */
 # define SSL_MODE_DTLS_SCTP_LABEL_LENGTH_BUG 0x00000400U
+/*
+ * Collect each flight of TLS handshake messages and send it in as few
+ * records, and BIO writes, as possible.
+ */
+# define SSL_MODE_COALESCE_FLIGHTS 0x00000800U
+/*
+ * Hand the record layer of a TLSv1.2 or TLSv1.3 connection over a socket BIO
+ * to the kernel (kTLS) once its traffic keys are in use, where supported.
+ */
+# define SSL_MODE_ENABLE_KTLS 0x00001000U
 
 /* Cert related flags */
 /*
@@ -1833,8 +1846,17 @@ __owur int SSL_get_changed_async_fds(SSL *s, OSSL_ASYNC_FD *addfd,
 __owur int SSL_accept(SSL *ssl);
 __owur int SSL_stateless(SSL *s);
 __owur int SSL_connect(SSL *ssl);
+
+/* A buffer for SSL_readv_ex() and SSL_writev_ex(), like a struct iovec */
+typedef struct ssl_iovec_st {
+    void *iov_base;
+    size_t iov_len;
+} SSL_IOVEC;
+
 __owur int SSL_read(SSL *ssl, void *buf, int num);
 __owur int SSL_read_ex(SSL *ssl, void *buf, size_t num, size_t *readbytes);
+__owur int SSL_readv_ex(SSL *s, const SSL_IOVEC *iov, size_t iovcnt,
+                        size_t *readbytes);
 
 # define SSL_READ_EARLY_DATA_ERROR   0
 # define SSL_READ_EARLY_DATA_SUCCESS 1
@@ -1846,6 +1868,14 @@ __owur int SSL_peek(SSL *ssl, void *buf, int num);
 __owur int SSL_peek_ex(SSL *ssl, void *buf, size_t num, size_t *readbytes);
 __owur int SSL_write(SSL *ssl, const void *buf, int num);
 __owur int SSL_write_ex(SSL *s, const void *buf, size_t num, size_t *written);
+__owur int SSL_writev_ex(SSL *s, const SSL_IOVEC *iov, size_t iovcnt,
+                         size_t *written);
+__owur int SSL_write_reserve(SSL *s, unsigned char **buf, size_t *len);
+__owur int SSL_write_commit(SSL *s, size_t len, size_t *written);
+# ifdef OPENSSL_SYS_UNIX
+__owur ossl_ssize_t SSL_sendfile(SSL *s, int fd, off_t offset, size_t size,
+                                 int flags);
+# endif
 __owur int SSL_write_early_data(SSL *s, const void *buf, size_t num,
                                 size_t *written);
 long SSL_ctrl(SSL *ssl, int cmd, long larg, void *parg);
@@ -2142,6 +2172,81 @@ size_t SSL_get_num_tickets(const SSL *s);
 int SSL_CTX_set_num_tickets(SSL_CTX *ctx, size_t num_tickets);
 size_t SSL_CTX_get_num_tickets(const SSL_CTX *ctx);
 
+__owur int SSL_CTX_set_oqs_kem_pool_depth(SSL_CTX *ctx, int nid, size_t depth);
+int SSL_CTX_fill_oqs_kem_pool(SSL_CTX *ctx);
+__owur int SSL_CTX_get_oqs_kem_pool_stats(const SSL_CTX *ctx, int nid,
+                                          size_t *available, uint64_t *hits,
+                                          uint64_t *misses,
+                                          uint64_t *refill_usec);
+
+__owur int SSL_CTX_set_key_share_cache_size(SSL_CTX *ctx, size_t size);
+size_t SSL_CTX_get_key_share_cache_size(const SSL_CTX *ctx);
+__owur int SSL_CTX_get_key_share_cache_stats(const SSL_CTX *ctx,
+                                             uint64_t *predicted,
+                                             uint64_t *hrr_avoided,
+                                             uint64_t *hrr);
+
+__owur int SSL_CTX_set1_cert_comp_preference(SSL_CTX *ctx, const int *algs,
+                                             size_t len);
+__owur int SSL_set1_cert_comp_preference(SSL *s, const int *algs, size_t len);
+int SSL_get_negotiated_server_cert_comp(const SSL *s);
+int SSL_get_negotiated_client_cert_comp(const SSL *s);
+__owur int SSL_CTX_get_cert_comp_stats(const SSL_CTX *ctx,
+                                       uint64_t *compressed,
+                                       uint64_t *cache_hits);
+
+__owur int SSL_CTX_set_cached_info_cache_size(SSL_CTX *ctx, size_t size);
+size_t SSL_CTX_get_cached_info_cache_size(const SSL_CTX *ctx);
+__owur int SSL_CTX_get_cached_info_stats(const SSL_CTX *ctx,
+                                         uint64_t *offered, uint64_t *used);
+int SSL_get_cached_info_used(const SSL *s);
+
+/* Candidate types for cost aware selection */
+# define SSL_COST_GROUP          0
+# define SSL_COST_SIGALG         1
+
+__owur int SSL_CTX_set_cost_aware_selection(SSL_CTX *ctx, int enable,
+                                            int min_secbits);
+__owur int SSL_CTX_measure_costs(SSL_CTX *ctx);
+__owur int SSL_CTX_set_cost(SSL_CTX *ctx, int type, const char *name,
+                            uint64_t cost);
+__owur int SSL_CTX_get_cost(const SSL_CTX *ctx, int type, const char *name,
+                            uint64_t *cost, uint64_t *selected);
+__owur int SSL_CTX_get_cost_selection_stats(const SSL_CTX *ctx, int type,
+                                            uint64_t *cheapest,
+                                            uint64_t *preference,
+                                            uint64_t *below_minimum);
+
+/* Handshake phases timed by SSL_CTX_set_handshake_timing() */
+# define SSL_HS_PHASE_TOTAL      0
+# define SSL_HS_PHASE_KEYGEN     1
+# define SSL_HS_PHASE_ENCAPS     2
+# define SSL_HS_PHASE_DECAPS     3
+# define SSL_HS_PHASE_DERIVE     4
+# define SSL_HS_PHASE_SIGN       5
+# define SSL_HS_PHASE_VERIFY     6
+# define SSL_HS_PHASE_CHAIN      7
+# define SSL_HS_PHASE_PEER_WAIT  8
+# define SSL_HS_PHASE_NUM        9
+
+/* Buckets of the histograms of SSL_CTX_get_handshake_histogram() */
+# define SSL_HS_TIMING_BUCKETS   32
+
+__owur int SSL_CTX_set_handshake_timing(SSL_CTX *ctx, int enable);
+const char *SSL_handshake_phase_name(int phase);
+__owur int SSL_get_handshake_phase(const SSL *s, int phase, uint64_t *nsec,
+                                   uint64_t *count);
+size_t SSL_get_handshake_transition_count(const SSL *s);
+__owur int SSL_get_handshake_transition(const SSL *s, size_t idx,
+                                        OSSL_HANDSHAKE_STATE *state,
+                                        const char **desc, uint64_t *nsec);
+size_t SSL_get_handshake_flight_count(const SSL *s);
+__owur int SSL_get_handshake_flight(const SSL *s, size_t idx, int *sent,
+                                    size_t *bytes, uint64_t *nsec);
+__owur int SSL_CTX_get_handshake_histogram(const SSL_CTX *ctx, int phase,
+                                           uint64_t *buckets,
+                                           size_t nbuckets);
+
 # if OPENSSL_API_COMPAT < 0x10100000L
 #  define SSL_cache_hit(s) SSL_session_reused(s)
 # endif
@@ -131,6 +131,12 @@ extern "C" {
 /* ExtensionType value from RFC7627 */
 # define TLSEXT_TYPE_extended_master_secret      23
 
+/* ExtensionType value from RFC7924 */
+# define TLSEXT_TYPE_cached_info                 25
+
+/* ExtensionType value from RFC8879 */
+# define TLSEXT_TYPE_compress_certificate        27
+
 /* ExtensionType value from RFC4507 */
 # define TLSEXT_TYPE_session_ticket              35
 
@@ -213,6 +219,17 @@ int SSL_set_tlsext_max_fragment_length(SSL *ssl, uint8_t mode);
 
 # define TLSEXT_MAXLEN_host_name 255
 
+/* Certificate compression algorithms from RFC8879 */
+# define TLSEXT_comp_cert_none                  0
+# define TLSEXT_comp_cert_zlib                  1
+# define TLSEXT_comp_cert_brotli                2
+# define TLSEXT_comp_cert_zstd                  3
+/* One more than the highest algorithm value above */
+# define TLSEXT_comp_cert_limit                 4
+
+/* CachedInformationType value from RFC7924 */
+# define TLSEXT_cached_info_cert                1
+
 __owur const char *SSL_get_servername(const SSL *s, const int type);
 __owur int SSL_get_servername_type(const SSL *s);
 /*
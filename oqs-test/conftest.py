@@ -6,6 +6,10 @@ def pytest_addoption(parser):
     parser.addoption("--ossl", action="store", help="ossl: Path to standalone OpenSSL executable.")
     parser.addoption("--ossl-config", action="store", help="ossl-config: Path to openssl.cnf file.")
     parser.addoption("--test-artifacts-dir", action="store", help="test-artifacts-dir: Path to directory containing files generated during the testing process.")
+    parser.addoption("--perf-baseline", action="store", default="oqs-test/perf_baseline.json", help="perf-baseline: Path to the JSON file with the baseline performance results.")
+    parser.addoption("--perf-threshold", action="store", type=float, default=0.2, help="perf-threshold: Largest allowed drop below the baseline, as a fraction.")
+    parser.addoption("--perf-seconds", action="store", type=int, default=2, help="perf-seconds: Seconds to run each performance measurement for.")
+    parser.addoption("--perf-update", action="store_true", help="perf-update: Record the results as the new baseline instead of checking them.")
 
 @pytest.fixture
 def ossl_config(request):
@@ -18,3 +22,19 @@ def ossl(request):
 @pytest.fixture
 def test_artifacts_dir(request):
     return os.path.normpath(request.config.getoption("--test-artifacts-dir"))
+
+@pytest.fixture(scope="session")
+def perf_baseline(request):
+    return os.path.normpath(request.config.getoption("--perf-baseline"))
+
+@pytest.fixture(scope="session")
+def perf_threshold(request):
+    return request.config.getoption("--perf-threshold")
+
+@pytest.fixture(scope="session")
+def perf_seconds(request):
+    return request.config.getoption("--perf-seconds")
+
+@pytest.fixture(scope="session")
+def perf_update(request):
+    return request.config.getoption("--perf-update")
@@ -0,0 +1,126 @@
+import common
+import json
+import os
+import pathlib
+import pytest
+import re
+
+# The classical signature algorithms are only timed in handshakes, since
+# `openssl speed -json` only covers the OQS algorithms
+oqs_key_exchanges = [i for i in common.key_exchanges if not i.endswith("oqs_kem_default")]
+oqs_signatures = [i for i in common.signatures if i not in ('ecdsap256', 'rsa3072')]
+
+class PerfResults:
+    """
+    The performance results of a test session, by kind ('kem', 'sig' or
+    'handshake'), algorithm and operation, in operations per second. Each
+    result is checked against the same one in the baseline.
+    """
+
+    def __init__(self, baseline_file, threshold, update):
+        self.baseline_file = baseline_file
+        self.threshold = threshold
+        self.update = update
+        self.results = {}
+        self.baseline = {}
+        if os.path.exists(baseline_file):
+            with open(baseline_file) as f:
+                self.baseline = json.load(f)
+
+    def check(self, kind, name, ops):
+        self.results.setdefault(kind, {})[name] = ops
+        if self.update:
+            return
+        baseline = self.baseline.get(kind, {}).get(name)
+        if baseline is None:
+            pytest.skip("No baseline for {} {}".format(kind, name))
+        regressions = []
+        for op, value in ops.items():
+            if op not in baseline:
+                continue
+            if value < baseline[op] * (1 - self.threshold):
+                regressions.append("{} {}: {:.1f}/s is {:.0%} below the baseline of {:.1f}/s".format(
+                                   name, op, value, 1 - value / baseline[op], baseline[op]))
+        assert not regressions, "\n".join(regressions)
+
+    def write(self, results_file):
+        with open(results_file, 'w') as f:
+            json.dump(self.results, f, indent=2, sort_keys=True)
+        if self.update:
+            # Keep the baseline of the algorithms that were not run
+            for kind, algs in self.results.items():
+                self.baseline.setdefault(kind, {}).update(algs)
+            with open(self.baseline_file, 'w') as f:
+                json.dump(self.baseline, f, indent=2, sort_keys=True)
+
+@pytest.fixture(scope='module')
+def perf(request, worker_id, perf_baseline, perf_threshold, perf_update):
+    # test_artifacts_dir is a function scoped fixture
+    test_artifacts_dir = os.path.normpath(request.config.getoption("--test-artifacts-dir"))
+    pathlib.Path(test_artifacts_dir).mkdir(parents=True, exist_ok=True)
+    results = PerfResults(perf_baseline, perf_threshold, perf_update)
+    yield results
+    results.write(os.path.join(test_artifacts_dir, '{}_perf.json'.format(worker_id)))
+
+def run_speed(ossl, test_artifacts_dir, perf_seconds, alg, worker_id):
+    json_file = os.path.join(test_artifacts_dir, '{}_{}_speed.json'.format(worker_id, alg))
+    pathlib.Path(test_artifacts_dir).mkdir(parents=True, exist_ok=True)
+    common.run_subprocess([ossl, 'speed', '-seconds', str(perf_seconds),
+                           '-json', json_file, alg])
+    with open(json_file) as f:
+        return json.load(f)
+
+def run_handshakes(ossl, perf_seconds, kex_name, port):
+    """
+    Returns the number of full handshakes per second that a client makes
+    with the server on |port| using |kex_name|.
+    """
+    output = common.run_subprocess([ossl, 's_time', '-new',
+                                           '-curves', kex_name,
+                                           '-time', str(perf_seconds),
+                                           '-connect', 'localhost:{}'.format(port)])
+    match = re.search(r'(\d+) connections in (\d+) real seconds', output)
+    assert match and int(match.group(1)) > 0, "No handshakes completed"
+    return int(match.group(1)) / max(int(match.group(2)), 1)
+
+@pytest.fixture(scope='module')
+def sig_default_server_port(request, worker_id):
+    config = request.config
+    ossl = os.path.normpath(config.getoption("--ossl"))
+    test_artifacts_dir = os.path.normpath(config.getoption("--test-artifacts-dir"))
+    common.gen_keys(ossl, os.path.normpath(config.getoption("--ossl-config")),
+                    'oqs_sig_default', test_artifacts_dir, worker_id)
+    server, port = common.start_server(ossl, test_artifacts_dir, 'oqs_sig_default', worker_id)
+    yield port
+    server.kill()
+
+@pytest.fixture(params=common.signatures)
+def parametrized_sig_server(request, ossl, ossl_config, test_artifacts_dir, worker_id):
+    common.gen_keys(ossl, ossl_config, request.param, test_artifacts_dir, worker_id)
+    server, port = common.start_server(ossl, test_artifacts_dir, request.param, worker_id)
+    yield request.param, port
+    server.kill()
+
+@pytest.mark.parametrize('kem_name', oqs_key_exchanges)
+def test_kem_perf(ossl, test_artifacts_dir, perf_seconds, perf, kem_name, worker_id):
+    run = run_speed(ossl, test_artifacts_dir, perf_seconds, kem_name, worker_id)['kem'][0]['runs'][0]
+    perf.check('kem', kem_name, {op: run[op]['ops_per_sec'] for op in ('keygen', 'encaps', 'decaps')})
+
+@pytest.mark.parametrize('sig_name', oqs_signatures)
+def test_sig_perf(ossl, test_artifacts_dir, perf_seconds, perf, sig_name, worker_id):
+    run = run_speed(ossl, test_artifacts_dir, perf_seconds, sig_name, worker_id)['sig'][0]['runs'][0]
+    perf.check('sig', sig_name, {op: run[op]['ops_per_sec'] for op in ('sign', 'verify')})
+
+@pytest.mark.parametrize('kex_name', oqs_key_exchanges)
+def test_kem_handshake_perf(ossl, sig_default_server_port, perf_seconds, perf, kex_name):
+    perf.check('handshake', '{}:oqs_sig_default'.format(kex_name),
+               {'handshake': run_handshakes(ossl, perf_seconds, kex_name, sig_default_server_port)})
+
+def test_sig_handshake_perf(parametrized_sig_server, ossl, perf_seconds, perf):
+    sig_name, port = parametrized_sig_server
+    perf.check('handshake', 'oqs_kem_default:{}'.format(sig_name),
+               {'handshake': run_handshakes(ossl, perf_seconds, 'oqs_kem_default', port)})
+
+if __name__ == "__main__":
+    import sys
+    pytest.main(sys.argv)
@@ -1,4 +1,5 @@
 import common
+import json
 import pytest
 import sys
 import os
@@ -9,13 +10,23 @@ input_msg = "[OpenSSL](https://openssl.org/) is an open-source implementation of
 def test_sig_speed(ossl, ossl_config, test_artifacts_dir, sig_name):
     common.run_subprocess([ossl, 'speed', '-seconds', '1', sig_name])
 
-# Hybrid KEMs are not integrated to EVP layer yet (issue #59), hence are not
-# speed tested: Thus exclude them from testing. Also exclude oqs_kem_default
-# as that may be set to a hybrid too
-@pytest.mark.parametrize('kem_name', [i for i in common.key_exchanges if not (i.startswith("p256_") or i.startswith("p384_") or i.startswith("p521_") or i == "oqs_kem_default")])
+# The oqs_kem_default aliases are not speed tested
+@pytest.mark.parametrize('kem_name', [i for i in common.key_exchanges if not i.endswith("oqs_kem_default")])
 def test_kem_speed(ossl, ossl_config, test_artifacts_dir, kem_name):
     common.run_subprocess([ossl, 'speed', '-seconds', '1', kem_name])
 
+def test_speed_threads_json(ossl, ossl_config, test_artifacts_dir):
+    json_file = os.path.join(test_artifacts_dir, 'speed.json')
+    common.run_subprocess([ossl, 'speed', '-seconds', '1', '-threads', '1,2',
+                           '-json', json_file, 'p256_kyber512', 'p256_dilithium2'])
+    with open(json_file) as f:
+        results = json.load(f)
+    assert [r['threads'] for r in results['kem'][0]['runs']] == [1, 2]
+    assert results['kem'][0]['hybrid']
+    for run in results['sig'][0]['runs']:
+        assert run['sign']['ops_per_sec'] > 0
+        assert run['verify']['p50_us'] <= run['verify']['p99_us']
+
 if __name__ == "__main__":
     import sys
     pytest.main(sys.argv)
@@ -0,0 +1,407 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Cached information extension (RFC7924) for the server certificate chain.
+ *
+ * A client returning to a server usually already holds the server's chain,
+ * which with PQC signatures runs to many kilobytes. When the client side
+ * cache is enabled the chain each server sent is remembered by SNI name, and
+ * the next ClientHello to that server carries its hash. A server whose chain
+ * has that hash then sends the hash in place of the chain in its Certificate
+ * message. The client rebuilds the Certificate message from its copy and
+ * verifies it as usual.
+ *
+ * The hash is SHA-256 over the TLSv1.2 form of the certificate_list, i.e.
+ * each certificate preceded by its 3 byte length, leaf first, so that it does
+ * not depend on the protocol version. Servers keep the hash of the chain for
+ * each certificate slot in the SSL_CTX and only recompute it when the chain
+ * changes.
+ */
+
+#include <string.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/lhash.h>
+#include "ssl_local.h"
+
+typedef struct cached_info_cache_entry_st CACHED_INFO_CACHE_ENTRY;
+
+struct cached_info_cache_entry_st {
+    char *hostname;
+    /* The certificate_list contents and their hash */
+    unsigned char *chain;
+    size_t chainlen;
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    /* Most recently used first */
+    CACHED_INFO_CACHE_ENTRY *prev;
+    CACHED_INFO_CACHE_ENTRY *next;
+};
+
+DEFINE_LHASH_OF(CACHED_INFO_CACHE_ENTRY);
+
+struct cached_info_cache_st {
+    CRYPTO_RWLOCK *lock;
+    LHASH_OF(CACHED_INFO_CACHE_ENTRY) *entries;
+    CACHED_INFO_CACHE_ENTRY *head;
+    CACHED_INFO_CACHE_ENTRY *tail;
+    size_t size;
+};
+
+static unsigned long cached_info_cache_hash(const CACHED_INFO_CACHE_ENTRY *e)
+{
+    return OPENSSL_LH_strhash(e->hostname);
+}
+
+static int cached_info_cache_cmp(const CACHED_INFO_CACHE_ENTRY *a,
+                                 const CACHED_INFO_CACHE_ENTRY *b)
+{
+    return strcmp(a->hostname, b->hostname);
+}
+
+static void cached_info_cache_unlink(CACHED_INFO_CACHE *cache,
+                                     CACHED_INFO_CACHE_ENTRY *e)
+{
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        cache->head = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    else
+        cache->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void cached_info_cache_push_front(CACHED_INFO_CACHE *cache,
+                                         CACHED_INFO_CACHE_ENTRY *e)
+{
+    e->prev = NULL;
+    e->next = cache->head;
+    if (cache->head != NULL)
+        cache->head->prev = e;
+    else
+        cache->tail = e;
+    cache->head = e;
+}
+
+static void cached_info_cache_entry_free(CACHED_INFO_CACHE_ENTRY *e)
+{
+    OPENSSL_free(e->hostname);
+    OPENSSL_free(e->chain);
+    OPENSSL_free(e);
+}
+
+/* Evicts the least recently used entries until at most |keep| remain */
+static void cached_info_cache_trim(CACHED_INFO_CACHE *cache, size_t keep)
+{
+    while (lh_CACHED_INFO_CACHE_ENTRY_num_items(cache->entries) > keep) {
+        CACHED_INFO_CACHE_ENTRY *e = cache->tail;
+
+        cached_info_cache_unlink(cache, e);
+        lh_CACHED_INFO_CACHE_ENTRY_delete(cache->entries, e);
+        cached_info_cache_entry_free(e);
+    }
+}
+
+void cached_info_cache_free(CACHED_INFO_CACHE *cache)
+{
+    if (cache == NULL)
+        return;
+    cached_info_cache_trim(cache, 0);
+    lh_CACHED_INFO_CACHE_ENTRY_free(cache->entries);
+    CRYPTO_THREAD_lock_free(cache->lock);
+    OPENSSL_free(cache);
+}
+
+void cached_info_hashes_free(SSL_CTX *ctx)
+{
+    size_t i;
+
+    for (i = 0; i < SSL_PKEY_NUM; i++)
+        sk_X509_pop_free(ctx->cached_info_hashes[i].chain, X509_free);
+}
+
+/* Counts a chain hash that was offered, or one that was used if |used| */
+void cached_info_note(SSL *s, int used)
+{
+    if (!CRYPTO_THREAD_write_lock(s->ctx->lock))
+        return;
+    if (used)
+        s->ctx->cached_info_used++;
+    else
+        s->ctx->cached_info_offered++;
+    CRYPTO_THREAD_unlock(s->ctx->lock);
+}
+
+/*
+ * Looks up the chain last sent by the server named in the SNI extension of
+ * |s| and, if there is one, makes it the chain that |s| offers. Returns 1 if a
+ * chain was found or 0 otherwise.
+ */
+int cached_info_lookup(SSL *s)
+{
+    CACHED_INFO_CACHE *cache = s->ctx->cached_info_cache;
+    CACHED_INFO_CACHE_ENTRY tmp, *e;
+
+    OPENSSL_free(s->ext.cached_info_chain);
+    s->ext.cached_info_chain = NULL;
+    s->ext.cached_info_chain_len = 0;
+
+    if (cache == NULL || s->ext.hostname == NULL)
+        return 0;
+
+    tmp.hostname = s->ext.hostname;
+    if (!CRYPTO_THREAD_write_lock(cache->lock))
+        return 0;
+    if ((e = lh_CACHED_INFO_CACHE_ENTRY_retrieve(cache->entries, &tmp)) != NULL
+            && (s->ext.cached_info_chain = OPENSSL_memdup(e->chain,
+                                                          e->chainlen))
+               != NULL) {
+        s->ext.cached_info_chain_len = e->chainlen;
+        memcpy(s->ext.cached_info_hash, e->hash, sizeof(e->hash));
+        cached_info_cache_unlink(cache, e);
+        cached_info_cache_push_front(cache, e);
+    }
+    CRYPTO_THREAD_unlock(cache->lock);
+
+    return s->ext.cached_info_chain != NULL;
+}
+
+/*
+ * Encodes |chain| as the contents of a TLSv1.2 certificate_list into a newly
+ * allocated buffer.
+ */
+static int cached_info_encode_chain(STACK_OF(X509) *chain, unsigned char **out,
+                                    size_t *outlen)
+{
+    unsigned char *buf, *p;
+    size_t len = 0;
+    int i, certlen;
+
+    for (i = 0; i < sk_X509_num(chain); i++) {
+        if ((certlen = i2d_X509(sk_X509_value(chain, i), NULL)) <= 0)
+            return 0;
+        len += 3 + (size_t)certlen;
+    }
+    if (len == 0 || (buf = OPENSSL_malloc(len)) == NULL)
+        return 0;
+
+    for (i = 0, p = buf; i < sk_X509_num(chain); i++) {
+        unsigned char *der = p + 3;
+
+        certlen = i2d_X509(sk_X509_value(chain, i), &der);
+        l2n3(certlen, p);
+        p = der;
+    }
+
+    *out = buf;
+    *outlen = len;
+    return 1;
+}
+
+/*
+ * Records the chain that the server named in the SNI extension of |s| sent in
+ * a full handshake.
+ */
+void cached_info_update(SSL *s)
+{
+    CACHED_INFO_CACHE *cache = s->ctx->cached_info_cache;
+    CACHED_INFO_CACHE_ENTRY tmp, *e;
+    unsigned char *chain = NULL;
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    size_t chainlen;
+
+    /* A chain rebuilt from the cache is already there */
+    if (cache == NULL || s->ext.hostname == NULL || s->hit
+            || s->ext.cached_info_used || s->session->peer_chain == NULL)
+        return;
+
+    /* A failure to remember the chain is not fatal to the handshake */
+    if (!cached_info_encode_chain(s->session->peer_chain, &chain, &chainlen)
+            || !EVP_Digest(chain, chainlen, hash, NULL, EVP_sha256(), NULL)) {
+        OPENSSL_free(chain);
+        return;
+    }
+
+    tmp.hostname = s->ext.hostname;
+    if (!CRYPTO_THREAD_write_lock(cache->lock)) {
+        OPENSSL_free(chain);
+        return;
+    }
+    if (cache->size == 0)
+        goto end;
+    if ((e = lh_CACHED_INFO_CACHE_ENTRY_retrieve(cache->entries, &tmp))
+            != NULL) {
+        OPENSSL_free(e->chain);
+        cached_info_cache_unlink(cache, e);
+        cached_info_cache_push_front(cache, e);
+    } else {
+        if ((e = OPENSSL_zalloc(sizeof(*e))) == NULL)
+            goto end;
+        if ((e->hostname = OPENSSL_strdup(s->ext.hostname)) == NULL) {
+            OPENSSL_free(e);
+            goto end;
+        }
+        lh_CACHED_INFO_CACHE_ENTRY_insert(cache->entries, e);
+        if (lh_CACHED_INFO_CACHE_ENTRY_error(cache->entries)) {
+            cached_info_cache_entry_free(e);
+            goto end;
+        }
+        cached_info_cache_push_front(cache, e);
+        cached_info_cache_trim(cache, cache->size);
+    }
+    e->chain = chain;
+    e->chainlen = chainlen;
+    memcpy(e->hash, hash, sizeof(hash));
+    chain = NULL;
+
+ end:
+    CRYPTO_THREAD_unlock(cache->lock);
+    OPENSSL_free(chain);
+}
+
+/* Writes the Certificate message body for the chain that |s| offered */
+int cached_info_construct_certificate(SSL *s, WPACKET *pkt)
+{
+    PACKET chain, cert;
+
+    if (!PACKET_buf_init(&chain, s->ext.cached_info_chain,
+                         s->ext.cached_info_chain_len)
+            || (SSL_IS_TLS13(s) && !WPACKET_put_bytes_u8(pkt, 0))
+            || !WPACKET_start_sub_packet_u24(pkt))
+        return 0;
+
+    while (PACKET_remaining(&chain) > 0) {
+        if (!PACKET_get_length_prefixed_3(&chain, &cert)
+                || !WPACKET_sub_memcpy_u24(pkt, PACKET_data(&cert),
+                                           PACKET_remaining(&cert))
+                || (SSL_IS_TLS13(s) && !WPACKET_put_bytes_u16(pkt, 0)))
+            return 0;
+    }
+
+    return WPACKET_close(pkt);
+}
+
+/*
+ * Sets |hash| to the hash of the chain that |s| would send for |cpk|. The
+ * result is kept in the SSL_CTX for as long as the chain stays the same.
+ */
+int cached_info_chain_hash(SSL *s, CERT_PKEY *cpk, unsigned char *hash)
+{
+    SSL_CTX *ctx = s->ctx;
+    CACHED_INFO_HASH *slot = &ctx->cached_info_hashes[cpk - s->cert->pkeys];
+    STACK_OF(X509) *chain = NULL;
+    unsigned char *buf = NULL;
+    size_t buflen;
+    int found;
+
+    if (!ssl_get_cert_chain(s, cpk, &chain)) {
+        /* SSLfatal() already called */
+        return 0;
+    }
+
+    if (!CRYPTO_THREAD_read_lock(ctx->lock)) {
+        sk_X509_pop_free(chain, X509_free);
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_CACHED_INFO_CHAIN_HASH,
+                 ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+    if ((found = ssl_cert_chain_same(slot->chain, chain)))
+        memcpy(hash, slot->hash, sizeof(slot->hash));
+    CRYPTO_THREAD_unlock(ctx->lock);
+    if (found) {
+        sk_X509_pop_free(chain, X509_free);
+        return 1;
+    }
+
+    if (!cached_info_encode_chain(chain, &buf, &buflen)
+            || !EVP_Digest(buf, buflen, hash, NULL, EVP_sha256(), NULL)) {
+        OPENSSL_free(buf);
+        sk_X509_pop_free(chain, X509_free);
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_CACHED_INFO_CHAIN_HASH,
+                 ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+    OPENSSL_free(buf);
+
+    /* A failure to remember the hash is not fatal to the handshake */
+    if (CRYPTO_THREAD_write_lock(ctx->lock)) {
+        STACK_OF(X509) *old = slot->chain;
+
+        slot->chain = chain;
+        memcpy(slot->hash, hash, sizeof(slot->hash));
+        chain = old;
+        CRYPTO_THREAD_unlock(ctx->lock);
+    }
+    sk_X509_pop_free(chain, X509_free);
+
+    return 1;
+}
+
+int SSL_CTX_set_cached_info_cache_size(SSL_CTX *ctx, size_t size)
+{
+    CACHED_INFO_CACHE *cache = ctx->cached_info_cache;
+
+    if (cache == NULL) {
+        if (size == 0)
+            return 1;
+        if ((cache = OPENSSL_zalloc(sizeof(*cache))) == NULL
+                || (cache->lock = CRYPTO_THREAD_lock_new()) == NULL
+                || (cache->entries =
+                        lh_CACHED_INFO_CACHE_ENTRY_new(cached_info_cache_hash,
+                                                       cached_info_cache_cmp))
+                   == NULL) {
+            SSLerr(SSL_F_SSL_CTX_SET_CACHED_INFO_CACHE_SIZE,
+                   ERR_R_MALLOC_FAILURE);
+            if (cache != NULL)
+                CRYPTO_THREAD_lock_free(cache->lock);
+            OPENSSL_free(cache);
+            return 0;
+        }
+        ctx->cached_info_cache = cache;
+    }
+
+    if (!CRYPTO_THREAD_write_lock(cache->lock))
+        return 0;
+    cache->size = size;
+    cached_info_cache_trim(cache, size);
+    CRYPTO_THREAD_unlock(cache->lock);
+    return 1;
+}
+
+size_t SSL_CTX_get_cached_info_cache_size(const SSL_CTX *ctx)
+{
+    CACHED_INFO_CACHE *cache = ctx->cached_info_cache;
+    size_t size;
+
+    if (cache == NULL || !CRYPTO_THREAD_read_lock(cache->lock))
+        return 0;
+    size = cache->size;
+    CRYPTO_THREAD_unlock(cache->lock);
+    return size;
+}
+
+int SSL_CTX_get_cached_info_stats(const SSL_CTX *ctx, uint64_t *offered,
+                                  uint64_t *used)
+{
+    if (!CRYPTO_THREAD_read_lock(ctx->lock))
+        return 0;
+    if (offered != NULL)
+        *offered = ctx->cached_info_offered;
+    if (used != NULL)
+        *used = ctx->cached_info_used;
+    CRYPTO_THREAD_unlock(ctx->lock);
+    return 1;
+}
+
+int SSL_get_cached_info_used(const SSL *s)
+{
+    return s->ext.cached_info_used;
+}
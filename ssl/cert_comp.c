@@ -0,0 +1,338 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * TLSv1.3 certificate compression (RFC8879).
+ *
+ * PQC certificate chains run to several times the size of RSA or ECDSA ones
+ * and make up most of the bytes of a full handshake. A peer that offers the
+ * compress_certificate extension is sent a CompressedCertificate message in
+ * place of Certificate. Since a server sends the same chain to every client,
+ * the SSL_CTX keeps the compressed form of the last few Certificate messages
+ * it produced, keyed by their uncompressed contents, so that the compression
+ * cost is paid once rather than on every handshake.
+ */
+
+#include <string.h>
+#include <openssl/crypto.h>
+#include <openssl/objects.h>
+#include "ssl_local.h"
+
+/* Number of distinct Certificate messages remembered per SSL_CTX */
+#define CERT_COMP_CACHE_SIZE    4
+
+typedef struct cert_comp_cache_entry_st {
+    int alg;
+    /* The uncompressed Certificate message body */
+    unsigned char *msg;
+    size_t msglen;
+    unsigned char *comp;
+    size_t complen;
+} CERT_COMP_CACHE_ENTRY;
+
+struct cert_comp_cache_st {
+    CRYPTO_RWLOCK *lock;
+    CERT_COMP_CACHE_ENTRY entries[CERT_COMP_CACHE_SIZE];
+    /* The entry to replace next */
+    size_t next;
+    uint64_t compressed;
+    uint64_t cache_hits;
+};
+
+#ifndef OPENSSL_NO_COMP
+static COMP_METHOD *cert_comp_method(int alg)
+{
+    COMP_METHOD *meth;
+
+    if (alg != TLSEXT_comp_cert_zlib)
+        return NULL;
+    meth = COMP_zlib_oneshot();
+    return COMP_get_type(meth) == NID_undef ? NULL : meth;
+}
+#endif
+
+int ssl_cert_comp_supported(int alg)
+{
+#ifndef OPENSSL_NO_COMP
+    return cert_comp_method(alg) != NULL;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Compresses |inlen| bytes at |in| with |alg| into a newly allocated buffer
+ * returned in |*out|.
+ */
+static int cert_comp_compress(int alg, const unsigned char *in, size_t inlen,
+                              unsigned char **out, size_t *outlen)
+{
+#ifndef OPENSSL_NO_COMP
+    COMP_METHOD *meth = cert_comp_method(alg);
+    COMP_CTX *cctx = NULL;
+    unsigned char *buf = NULL;
+    /* Worst case expansion, as for zlib's compressBound() */
+    size_t bound = inlen + (inlen >> 12) + (inlen >> 14) + (inlen >> 25) + 13;
+    int ret;
+
+    if (meth == NULL
+            || inlen > INT_MAX
+            || (cctx = COMP_CTX_new(meth)) == NULL
+            || (buf = OPENSSL_malloc(bound)) == NULL)
+        goto err;
+
+    ret = COMP_compress_block(cctx, buf, (int)bound, (unsigned char *)in,
+                              (int)inlen);
+    if (ret <= 0)
+        goto err;
+
+    COMP_CTX_free(cctx);
+    *out = buf;
+    *outlen = (size_t)ret;
+    return 1;
+
+ err:
+    COMP_CTX_free(cctx);
+    OPENSSL_free(buf);
+#endif
+    return 0;
+}
+
+int ssl_cert_comp_expand(int alg, unsigned char *out, size_t outlen,
+                         const unsigned char *in, size_t inlen)
+{
+#ifndef OPENSSL_NO_COMP
+    COMP_METHOD *meth = cert_comp_method(alg);
+    COMP_CTX *cctx;
+    int ret;
+
+    if (meth == NULL
+            || outlen > INT_MAX
+            || inlen > INT_MAX
+            || (cctx = COMP_CTX_new(meth)) == NULL)
+        return 0;
+
+    ret = COMP_expand_block(cctx, out, (int)outlen, (unsigned char *)in,
+                            (int)inlen);
+    COMP_CTX_free(cctx);
+    return ret >= 0 && (size_t)ret == outlen;
+#else
+    return 0;
+#endif
+}
+
+static CERT_COMP_CACHE_ENTRY *cert_comp_cache_find(CERT_COMP_CACHE *cache,
+                                                   int alg,
+                                                   const unsigned char *msg,
+                                                   size_t msglen)
+{
+    size_t i;
+
+    for (i = 0; i < CERT_COMP_CACHE_SIZE; i++) {
+        CERT_COMP_CACHE_ENTRY *e = &cache->entries[i];
+
+        if (e->msg != NULL && e->alg == alg && e->msglen == msglen
+                && memcmp(e->msg, msg, msglen) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+static void cert_comp_cache_entry_clear(CERT_COMP_CACHE_ENTRY *e)
+{
+    OPENSSL_free(e->msg);
+    OPENSSL_free(e->comp);
+    memset(e, 0, sizeof(*e));
+}
+
+/*
+ * Remembers |comp| as the compressed form of |msg|. Takes ownership of |comp|
+ * on success.
+ */
+static int cert_comp_cache_add(CERT_COMP_CACHE *cache, int alg,
+                               const unsigned char *msg, size_t msglen,
+                               unsigned char *comp, size_t complen)
+{
+    CERT_COMP_CACHE_ENTRY *e;
+    unsigned char *copy;
+
+    /* Another thread may have got here first */
+    if (cert_comp_cache_find(cache, alg, msg, msglen) != NULL
+            || (copy = OPENSSL_memdup(msg, msglen)) == NULL)
+        return 0;
+
+    e = &cache->entries[cache->next];
+    cache->next = (cache->next + 1) % CERT_COMP_CACHE_SIZE;
+    cert_comp_cache_entry_clear(e);
+    e->alg = alg;
+    e->msg = copy;
+    e->msglen = msglen;
+    e->comp = comp;
+    e->complen = complen;
+    return 1;
+}
+
+void cert_comp_cache_free(CERT_COMP_CACHE *cache)
+{
+    size_t i;
+
+    if (cache == NULL)
+        return;
+    for (i = 0; i < CERT_COMP_CACHE_SIZE; i++)
+        cert_comp_cache_entry_clear(&cache->entries[i]);
+    CRYPTO_THREAD_lock_free(cache->lock);
+    OPENSSL_free(cache);
+}
+
+/*
+ * Writes the body of a CompressedCertificate message holding the |inlen| byte
+ * Certificate message body at |in| compressed with |alg|.
+ */
+int ssl_cert_comp_compress(SSL *s, int alg, const unsigned char *in,
+                           size_t inlen, WPACKET *pkt)
+{
+    CERT_COMP_CACHE *cache = s->ctx->cert_comp_cache;
+    CERT_COMP_CACHE_ENTRY *e;
+    unsigned char *comp = NULL;
+    size_t complen;
+    int ok;
+
+    if (!WPACKET_put_bytes_u16(pkt, alg)
+            || !WPACKET_put_bytes_u24(pkt, inlen)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_CERT_COMP_COMPRESS,
+                 ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+
+    if (cache != NULL) {
+        if (!CRYPTO_THREAD_write_lock(cache->lock)) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_CERT_COMP_COMPRESS,
+                     ERR_R_INTERNAL_ERROR);
+            return 0;
+        }
+        if ((e = cert_comp_cache_find(cache, alg, in, inlen)) != NULL) {
+            cache->cache_hits++;
+            ok = WPACKET_sub_memcpy_u24(pkt, e->comp, e->complen);
+            CRYPTO_THREAD_unlock(cache->lock);
+            if (!ok) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                         SSL_F_SSL_CERT_COMP_COMPRESS, ERR_R_INTERNAL_ERROR);
+                return 0;
+            }
+            return 1;
+        }
+        CRYPTO_THREAD_unlock(cache->lock);
+    }
+
+    if (!cert_comp_compress(alg, in, inlen, &comp, &complen)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_CERT_COMP_COMPRESS,
+                 SSL_R_COMPRESSION_FAILURE);
+        return 0;
+    }
+    if (!WPACKET_sub_memcpy_u24(pkt, comp, complen)) {
+        OPENSSL_free(comp);
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_CERT_COMP_COMPRESS,
+                 ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+
+    /* A failure to remember the result is not fatal to the handshake */
+    if (cache != NULL && CRYPTO_THREAD_write_lock(cache->lock)) {
+        cache->compressed++;
+        if (cert_comp_cache_add(cache, alg, in, inlen, comp, complen))
+            comp = NULL;
+        CRYPTO_THREAD_unlock(cache->lock);
+    }
+    OPENSSL_free(comp);
+
+    return 1;
+}
+
+/*
+ * Sets |prefs| from the |len| algorithms in |algs|. Fails if any of them is
+ * repeated or not supported by this build.
+ */
+static int cert_comp_set_prefs(unsigned char *prefs, const int *algs,
+                               size_t len)
+{
+    unsigned char tmp[TLSEXT_comp_cert_limit];
+    size_t i;
+
+    if (len >= TLSEXT_comp_cert_limit)
+        return 0;
+
+    memset(tmp, 0, sizeof(tmp));
+    for (i = 0; i < len; i++) {
+        if (!ssl_cert_comp_supported(algs[i])
+                || memchr(tmp, algs[i], i) != NULL)
+            return 0;
+        tmp[i] = (unsigned char)algs[i];
+    }
+    memcpy(prefs, tmp, sizeof(tmp));
+    return 1;
+}
+
+int SSL_CTX_set1_cert_comp_preference(SSL_CTX *ctx, const int *algs,
+                                      size_t len)
+{
+    if (!cert_comp_set_prefs(ctx->cert_comp_prefs, algs, len)) {
+        SSLerr(SSL_F_SSL_CTX_SET1_CERT_COMP_PREFERENCE,
+               SSL_R_INVALID_COMPRESSION_ALGORITHM);
+        return 0;
+    }
+
+    if (len > 0 && ctx->cert_comp_cache == NULL) {
+        CERT_COMP_CACHE *cache = OPENSSL_zalloc(sizeof(*cache));
+
+        if (cache == NULL
+                || (cache->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+            SSLerr(SSL_F_SSL_CTX_SET1_CERT_COMP_PREFERENCE,
+                   ERR_R_MALLOC_FAILURE);
+            OPENSSL_free(cache);
+            return 0;
+        }
+        ctx->cert_comp_cache = cache;
+    }
+    return 1;
+}
+
+int SSL_set1_cert_comp_preference(SSL *s, const int *algs, size_t len)
+{
+    if (!cert_comp_set_prefs(s->cert_comp_prefs, algs, len)) {
+        SSLerr(SSL_F_SSL_SET1_CERT_COMP_PREFERENCE,
+               SSL_R_INVALID_COMPRESSION_ALGORITHM);
+        return 0;
+    }
+    return 1;
+}
+
+int SSL_get_negotiated_server_cert_comp(const SSL *s)
+{
+    return s->server ? s->ext.cert_comp_tx : s->ext.cert_comp_rx;
+}
+
+int SSL_get_negotiated_client_cert_comp(const SSL *s)
+{
+    return s->server ? s->ext.cert_comp_rx : s->ext.cert_comp_tx;
+}
+
+int SSL_CTX_get_cert_comp_stats(const SSL_CTX *ctx, uint64_t *compressed,
+                                uint64_t *cache_hits)
+{
+    CERT_COMP_CACHE *cache = ctx->cert_comp_cache;
+
+    if (cache == NULL || !CRYPTO_THREAD_read_lock(cache->lock))
+        return 0;
+    if (compressed != NULL)
+        *compressed = cache->compressed;
+    if (cache_hits != NULL)
+        *cache_hits = cache->cache_hits;
+    CRYPTO_THREAD_unlock(cache->lock);
+    return 1;
+}
@@ -0,0 +1,296 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Encoding of the certificate chains and CA name lists sent in handshakes.
+ *
+ * A server normally sends the same certificate chain, and asks for client
+ * certificates with the same CA names, in every handshake. Their DER encoding
+ * is kept, so that they are encoded once instead of twice in every handshake,
+ * and Certificate and CertificateRequest messages copy it.
+ *
+ * The encoding of a chain is kept with the CERT_PKEY of its leaf certificate,
+ * in a CERT_DER_CACHE that the SSLs created from an SSL_CTX share with it.
+ * Each cache has a lock of its own. The cache is replaced when the
+ * CERT_PKEY gets another certificate, so an SSL that is given a certificate
+ * of its own stops sharing it. A chain is still built for every handshake,
+ * because it may come from a certificate store, and the encoding is used for
+ * as long as the chain holds the same certificates.
+ *
+ * The CA name list encodings are kept in the SSL_CTX, and dropped when a list
+ * is set or added to.
+ */
+
+#include <string.h>
+#include "ssl_local.h"
+#include "internal/refcount.h"
+
+int ssl_cert_chain_same(const STACK_OF(X509) *a, const STACK_OF(X509) *b)
+{
+    int i;
+
+    if (a == NULL || sk_X509_num(a) != sk_X509_num(b))
+        return 0;
+    for (i = 0; i < sk_X509_num(a); i++) {
+        if (sk_X509_value(a, i) != sk_X509_value(b, i))
+            return 0;
+    }
+    return 1;
+}
+
+void ssl_cert_chain_der_free(CERT_CHAIN_DER *der)
+{
+    int i;
+
+    if (der == NULL)
+        return;
+    CRYPTO_DOWN_REF(&der->references, &i, der->lock);
+    REF_ASSERT_ISNT(i < 0);
+    if (i > 0)
+        return;
+    sk_X509_pop_free(der->chain, X509_free);
+    OPENSSL_free(der->der);
+    CRYPTO_THREAD_lock_free(der->lock);
+    OPENSSL_free(der);
+}
+
+void ssl_cert_der_cache_free(CERT_DER_CACHE *cache)
+{
+    int i;
+
+    if (cache == NULL)
+        return;
+    CRYPTO_DOWN_REF(&cache->references, &i, cache->lock);
+    REF_ASSERT_ISNT(i < 0);
+    if (i > 0)
+        return;
+    ssl_cert_chain_der_free(cache->der);
+    CRYPTO_THREAD_lock_free(cache->lock);
+    OPENSSL_free(cache);
+}
+
+/*
+ * Gives |cpk|, which has just been given a certificate, an empty cache of its
+ * own. Without memory for it, chains sent for |cpk| are not kept.
+ */
+void ssl_cert_der_cache_reset(CERT_PKEY *cpk)
+{
+    CERT_DER_CACHE *cache = OPENSSL_zalloc(sizeof(*cache));
+
+    if (cache != NULL) {
+        cache->references = 1;
+        if ((cache->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+            OPENSSL_free(cache);
+            cache = NULL;
+        }
+    }
+    ssl_cert_der_cache_free(cpk->der_cache);
+    cpk->der_cache = cache;
+}
+
+/* Encodes |chain| into a new CERT_CHAIN_DER, which takes ownership of it */
+static CERT_CHAIN_DER *cert_chain_der_new(STACK_OF(X509) *chain)
+{
+    CERT_CHAIN_DER *der = OPENSSL_zalloc(sizeof(*der));
+    unsigned char *p, *q;
+    int i, len;
+
+    if (der == NULL)
+        return NULL;
+    der->references = 1;
+    if ((der->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+        OPENSSL_free(der);
+        return NULL;
+    }
+
+    for (i = 0; i < sk_X509_num(chain); i++) {
+        if ((len = i2d_X509(sk_X509_value(chain, i), NULL)) <= 0)
+            goto err;
+        der->derlen += 3 + (size_t)len;
+    }
+    if (der->derlen > 0 && (der->der = OPENSSL_malloc(der->derlen)) == NULL)
+        goto err;
+    for (i = 0, p = der->der; i < sk_X509_num(chain); i++) {
+        q = p + 3;
+        len = i2d_X509(sk_X509_value(chain, i), &q);
+        l2n3(len, p);
+        p = q;
+    }
+    der->chain = chain;
+    return der;
+
+ err:
+    CRYPTO_THREAD_lock_free(der->lock);
+    OPENSSL_free(der->der);
+    OPENSSL_free(der);
+    return NULL;
+}
+
+/*
+ * Sets |*der| to the encoding of the chain that |s| sends for |cpk|, which
+ * the caller frees with ssl_cert_chain_der_free().
+ */
+int ssl_cert_chain_der(SSL *s, CERT_PKEY *cpk, CERT_CHAIN_DER **der)
+{
+    CERT_DER_CACHE *cache = cpk->der_cache;
+    STACK_OF(X509) *chain = NULL;
+    CERT_CHAIN_DER *ret = NULL, *old;
+    int i;
+
+    if (!ssl_get_cert_chain(s, cpk, &chain)) {
+        /* SSLfatal() already called */
+        return 0;
+    }
+
+    if (cache != NULL) {
+        if (!CRYPTO_THREAD_read_lock(cache->lock)) {
+            sk_X509_pop_free(chain, X509_free);
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_CERT_CHAIN_DER,
+                     ERR_R_INTERNAL_ERROR);
+            return 0;
+        }
+        if (cache->der != NULL
+                && ssl_cert_chain_same(cache->der->chain, chain)) {
+            ret = cache->der;
+            CRYPTO_UP_REF(&ret->references, &i, ret->lock);
+        }
+        CRYPTO_THREAD_unlock(cache->lock);
+    }
+    if (ret != NULL) {
+        sk_X509_pop_free(chain, X509_free);
+        *der = ret;
+        return 1;
+    }
+
+    if ((ret = cert_chain_der_new(chain)) == NULL) {
+        sk_X509_pop_free(chain, X509_free);
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_CERT_CHAIN_DER,
+                 ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+
+    /* A failure to keep the encoding is not fatal to the handshake */
+    if (cache != NULL && CRYPTO_THREAD_write_lock(cache->lock)) {
+        old = cache->der;
+        cache->der = ret;
+        CRYPTO_UP_REF(&ret->references, &i, ret->lock);
+        CRYPTO_THREAD_unlock(cache->lock);
+        ssl_cert_chain_der_free(old);
+    }
+    *der = ret;
+    return 1;
+}
+
+static void ca_names_der_clear(CA_NAMES_DER *der)
+{
+    OPENSSL_free(der->names);
+    OPENSSL_free(der->der);
+    memset(der, 0, sizeof(*der));
+}
+
+void ssl_ca_names_der_clear(SSL_CTX *ctx)
+{
+    if (!CRYPTO_THREAD_write_lock(ctx->lock))
+        return;
+    ca_names_der_clear(&ctx->ca_names_der);
+    ca_names_der_clear(&ctx->client_ca_names_der);
+    CRYPTO_THREAD_unlock(ctx->lock);
+}
+
+static int ca_names_der_current(const CA_NAMES_DER *der,
+                                const STACK_OF(X509_NAME) *ca_sk)
+{
+    int i;
+
+    if (der->der == NULL || der->num != sk_X509_NAME_num(ca_sk))
+        return 0;
+    for (i = 0; i < der->num; i++) {
+        if (der->names[i] != sk_X509_NAME_value(ca_sk, i))
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Writes the names of |ca_sk|, each with its 2 byte length, to |pkt|. The
+ * encoding of the CA name lists of the SSL_CTX is kept for later handshakes.
+ */
+int ssl_ca_names_der(SSL *s, const STACK_OF(X509_NAME) *ca_sk, WPACKET *pkt)
+{
+    SSL_CTX *ctx = s->ctx;
+    CA_NAMES_DER *cache = NULL, tmp;
+    unsigned char *p;
+    int i, len, ret;
+
+    if (ca_sk == ctx->ca_names)
+        cache = &ctx->ca_names_der;
+    else if (ca_sk == ctx->client_ca_names)
+        cache = &ctx->client_ca_names_der;
+
+    if (cache != NULL) {
+        if (!CRYPTO_THREAD_read_lock(ctx->lock))
+            return 0;
+        if (ca_names_der_current(cache, ca_sk)) {
+            ret = WPACKET_memcpy(pkt, cache->der, cache->derlen);
+            CRYPTO_THREAD_unlock(ctx->lock);
+            return ret;
+        }
+        CRYPTO_THREAD_unlock(ctx->lock);
+    }
+
+    memset(&tmp, 0, sizeof(tmp));
+    tmp.num = sk_X509_NAME_num(ca_sk);
+    for (i = 0; i < tmp.num; i++) {
+        X509_NAME *name = sk_X509_NAME_value(ca_sk, i);
+
+        if (name == NULL || (len = i2d_X509_NAME(name, NULL)) < 0
+                || len > 0xffff)
+            return 0;
+        tmp.derlen += 2 + (size_t)len;
+    }
+    if (tmp.derlen == 0)
+        return 1;
+    if ((tmp.der = OPENSSL_malloc(tmp.derlen)) == NULL
+            || (cache != NULL
+                && (tmp.names = OPENSSL_malloc(sizeof(*tmp.names) * tmp.num))
+                   == NULL)) {
+        ca_names_der_clear(&tmp);
+        return 0;
+    }
+    for (i = 0, p = tmp.der; i < tmp.num; i++) {
+        unsigned char *q = p + 2;
+
+        if (tmp.names != NULL)
+            tmp.names[i] = sk_X509_NAME_value(ca_sk, i);
+        len = i2d_X509_NAME(sk_X509_NAME_value(ca_sk, i), &q);
+        s2n(len, p);
+        p = q;
+    }
+
+    if (!WPACKET_memcpy(pkt, tmp.der, tmp.derlen)) {
+        ca_names_der_clear(&tmp);
+        return 0;
+    }
+
+    /* A failure to keep the encoding is not fatal to the handshake */
+    if (cache != NULL && CRYPTO_THREAD_write_lock(ctx->lock)) {
+        ca_names_der_clear(cache);
+        *cache = tmp;
+        CRYPTO_THREAD_unlock(ctx->lock);
+    } else {
+        ca_names_der_clear(&tmp);
+    }
+    return 1;
+}
+
+void ca_names_der_cache_free(SSL_CTX *ctx)
+{
+    ca_names_der_clear(&ctx->ca_names_der);
+    ca_names_der_clear(&ctx->client_ca_names_der);
+}
@@ -0,0 +1,488 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Cost aware selection of groups and signature algorithms on the server.
+ *
+ * By default a server picks the first group or signature algorithm in
+ * preference order that both sides support. The CPU cost of the server side
+ * operations differs by up to two orders of magnitude between PQC algorithms
+ * of the same security level, so a server can instead be asked to pick the
+ * cheapest of the candidates that meet a minimum number of security bits.
+ * Costs are given by the application or measured by SSL_CTX_measure_costs().
+ * Candidates without a known cost are only picked, in preference order, when
+ * none of the candidates has one.
+ */
+
+#include <string.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include "ssl_local.h"
+
+/* Measure for at least this long, or this many rounds, whichever is first */
+#define COST_MEASURE_MIN_NSEC   1000000
+#define COST_MEASURE_MAX_ROUNDS 32
+
+/* Why a candidate was selected */
+#define COST_REASON_CHEAPEST        0
+#define COST_REASON_PREFERENCE      1
+#define COST_REASON_BELOW_MINIMUM   2
+#define COST_REASON_NUM             3
+
+#define COST_TYPE_NUM               2
+
+typedef struct cost_entry_st {
+    uint16_t id;
+    /* Nanoseconds per server side operation */
+    uint64_t cost;
+    uint64_t selected;
+} COST_ENTRY;
+
+struct cost_table_st {
+    CRYPTO_RWLOCK *lock;
+    int enabled;
+    int min_secbits;
+    COST_ENTRY *entries[COST_TYPE_NUM];
+    size_t num_entries[COST_TYPE_NUM];
+    uint64_t reasons[COST_TYPE_NUM][COST_REASON_NUM];
+};
+
+void cost_table_free(COST_TABLE *table)
+{
+    size_t i;
+
+    if (table == NULL)
+        return;
+    for (i = 0; i < COST_TYPE_NUM; i++)
+        OPENSSL_free(table->entries[i]);
+    CRYPTO_THREAD_lock_free(table->lock);
+    OPENSSL_free(table);
+}
+
+static COST_TABLE *cost_table_get(SSL_CTX *ctx)
+{
+    COST_TABLE *table = ctx->cost_table;
+
+    if (table == NULL) {
+        if ((table = OPENSSL_zalloc(sizeof(*table))) == NULL
+                || (table->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+            OPENSSL_free(table);
+            return NULL;
+        }
+        ctx->cost_table = table;
+    }
+    return table;
+}
+
+/* Must be called with the lock held */
+static COST_ENTRY *cost_table_find(const COST_TABLE *table, int type,
+                                   uint16_t id)
+{
+    size_t i;
+
+    for (i = 0; i < table->num_entries[type]; i++) {
+        if (table->entries[type][i].id == id)
+            return &table->entries[type][i];
+    }
+    return NULL;
+}
+
+static int cost_table_set(COST_TABLE *table, int type, uint16_t id,
+                          uint64_t cost)
+{
+    COST_ENTRY *e, *tmp;
+    int ret = 0;
+
+    if (!CRYPTO_THREAD_write_lock(table->lock))
+        return 0;
+    if ((e = cost_table_find(table, type, id)) == NULL) {
+        tmp = OPENSSL_realloc(table->entries[type],
+                              (table->num_entries[type] + 1) * sizeof(*tmp));
+        if (tmp == NULL)
+            goto end;
+        table->entries[type] = tmp;
+        e = &tmp[table->num_entries[type]++];
+        memset(e, 0, sizeof(*e));
+        e->id = id;
+    }
+    e->cost = cost;
+    ret = 1;
+
+ end:
+    CRYPTO_THREAD_unlock(table->lock);
+    return ret;
+}
+
+static uint16_t cost_name2id(int type, const char *name)
+{
+    if (type == SSL_COST_GROUP)
+        return tls1_group_name2id(name);
+    if (type == SSL_COST_SIGALG)
+        return tls1_sigalg_name2id(name);
+    return 0;
+}
+
+/*
+ * Starts a selection of type |type| for |s|. Returns 1 if cost aware
+ * selection applies, in which case the candidates are passed to
+ * ssl_cost_pick_offer() and the result taken from ssl_cost_pick_done().
+ */
+int ssl_cost_pick_init(SSL *s, SSL_COST_PICK *pick, int type)
+{
+    COST_TABLE *table = s->ctx->cost_table;
+    int enabled;
+
+    if (!s->server || table == NULL || !CRYPTO_THREAD_read_lock(table->lock))
+        return 0;
+    enabled = table->enabled;
+    pick->min_secbits = table->min_secbits;
+    CRYPTO_THREAD_unlock(table->lock);
+
+    pick->type = type;
+    pick->first = pick->first_ok = pick->cheapest = -1;
+    pick->first_id = pick->first_ok_id = pick->cheapest_id = 0;
+    pick->cheapest_cost = 0;
+    return enabled;
+}
+
+/*
+ * Offers the candidate |idx| with id |id| and |secbits| bits of security.
+ * Candidates must be offered in preference order.
+ */
+void ssl_cost_pick_offer(SSL *s, SSL_COST_PICK *pick, int idx, uint16_t id,
+                         int secbits)
+{
+    COST_TABLE *table = s->ctx->cost_table;
+    const COST_ENTRY *e;
+    uint64_t cost = 0;
+    int known = 0;
+
+    if (pick->first == -1) {
+        pick->first = idx;
+        pick->first_id = id;
+    }
+    if (secbits < pick->min_secbits)
+        return;
+    if (pick->first_ok == -1) {
+        pick->first_ok = idx;
+        pick->first_ok_id = id;
+    }
+
+    if (!CRYPTO_THREAD_read_lock(table->lock))
+        return;
+    if ((e = cost_table_find(table, pick->type, id)) != NULL) {
+        cost = e->cost;
+        known = 1;
+    }
+    CRYPTO_THREAD_unlock(table->lock);
+
+    /* Ties go to the earlier candidate */
+    if (known && (pick->cheapest == -1 || cost < pick->cheapest_cost)) {
+        pick->cheapest = idx;
+        pick->cheapest_id = id;
+        pick->cheapest_cost = cost;
+    }
+}
+
+/*
+ * Returns the selected candidate, or -1 if none was offered, and records why
+ * it was selected.
+ */
+int ssl_cost_pick_done(SSL *s, SSL_COST_PICK *pick)
+{
+    COST_TABLE *table = s->ctx->cost_table;
+    COST_ENTRY *e;
+    uint16_t id;
+    int idx, reason;
+
+    if (pick->cheapest != -1) {
+        idx = pick->cheapest;
+        id = pick->cheapest_id;
+        reason = COST_REASON_CHEAPEST;
+    } else if (pick->first_ok != -1) {
+        idx = pick->first_ok;
+        id = pick->first_ok_id;
+        reason = COST_REASON_PREFERENCE;
+    } else if (pick->first != -1) {
+        idx = pick->first;
+        id = pick->first_id;
+        reason = COST_REASON_BELOW_MINIMUM;
+    } else {
+        return -1;
+    }
+
+    if (CRYPTO_THREAD_write_lock(table->lock)) {
+        table->reasons[pick->type][reason]++;
+        if ((e = cost_table_find(table, pick->type, id)) != NULL)
+            e->selected++;
+        CRYPTO_THREAD_unlock(table->lock);
+    }
+    return idx;
+}
+
+static EVP_PKEY *cost_keygen(uint16_t group_id)
+{
+    const TLS_GROUP_INFO *ginf = tls1_group_id_lookup(group_id);
+    EVP_PKEY_CTX *pctx = NULL;
+    EVP_PKEY *pkey = NULL;
+    int custom;
+
+    if (ginf == NULL)
+        return NULL;
+    custom = (ginf->flags & TLS_CURVE_TYPE) == TLS_CURVE_CUSTOM;
+    if ((pctx = EVP_PKEY_CTX_new_id(custom ? ginf->nid : EVP_PKEY_EC,
+                                    NULL)) == NULL
+            || EVP_PKEY_keygen_init(pctx) <= 0
+            || (!custom
+                && EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx,
+                                                          ginf->nid) <= 0)
+            || EVP_PKEY_keygen(pctx, &pkey) <= 0) {
+        EVP_PKEY_free(pkey);
+        pkey = NULL;
+    }
+    EVP_PKEY_CTX_free(pctx);
+    return pkey;
+}
+
+/* The server's share of an ECDHE exchange with |peer| */
+static int cost_ecdhe(uint16_t group_id, EVP_PKEY *peer)
+{
+    EVP_PKEY *pkey = cost_keygen(group_id);
+    EVP_PKEY_CTX *pctx = NULL;
+    unsigned char secret[EVP_MAX_KEY_LENGTH * 4];
+    size_t secretlen = sizeof(secret);
+    int ok;
+
+    ok = pkey != NULL
+         && (pctx = EVP_PKEY_CTX_new(pkey, NULL)) != NULL
+         && EVP_PKEY_derive_init(pctx) > 0
+         && EVP_PKEY_derive_set_peer(pctx, peer) > 0
+         && EVP_PKEY_derive(pctx, secret, &secretlen) > 0;
+    OPENSSL_cleanse(secret, sizeof(secret));
+    EVP_PKEY_CTX_free(pctx);
+    EVP_PKEY_free(pkey);
+    return ok;
+}
+
+/*
+ * Measures the server side cost of |group_id|: KEM encapsulation for an OQS
+ * group, ECDHE key generation and derivation for a classical one, and both
+ * for a hybrid one.
+ */
+static int cost_measure_group(uint16_t group_id, uint64_t *cost)
+{
+    const OQS_KEM *kem = NULL;
+    uint16_t classical_id = group_id;
+    unsigned char *pk = NULL, *sk = NULL, *ct = NULL, *ss = NULL;
+    EVP_PKEY *peer = NULL;
+    uint64_t begin, total = 0;
+    size_t rounds;
+    int ret = 0;
+
+    if (IS_OQS_KEM_CURVEID(group_id) || IS_OQS_KEM_HYBRID_CURVEID(group_id)) {
+        classical_id = oqs_kem_classical_group_id(group_id);
+        if ((kem = ssl_get_oqs_kem(oqs_kem_group_nid(group_id))) == NULL
+                || (pk = OPENSSL_malloc(kem->length_public_key)) == NULL
+                || (sk = OPENSSL_malloc(kem->length_secret_key)) == NULL
+                || (ct = OPENSSL_malloc(kem->length_ciphertext)) == NULL
+                || (ss = OPENSSL_malloc(kem->length_shared_secret)) == NULL
+                || OQS_KEM_keypair(kem, pk, sk) != OQS_SUCCESS)
+            goto end;
+    }
+    if (classical_id != 0 && (peer = cost_keygen(classical_id)) == NULL)
+        goto end;
+
+    for (rounds = 0; rounds < COST_MEASURE_MAX_ROUNDS
+                     && total < COST_MEASURE_MIN_NSEC; rounds++) {
+        begin = ssl_monotonic_nsec();
+        if ((kem != NULL && OQS_KEM_encaps(kem, ct, ss, pk) != OQS_SUCCESS)
+                || (classical_id != 0 && !cost_ecdhe(classical_id, peer)))
+            goto end;
+        total += ssl_monotonic_nsec() - begin;
+    }
+    *cost = total / rounds;
+    ret = 1;
+
+ end:
+    if (kem != NULL) {
+        OPENSSL_clear_free(sk, kem->length_secret_key);
+        OPENSSL_clear_free(ss, kem->length_shared_secret);
+    }
+    OPENSSL_free(pk);
+    OPENSSL_free(ct);
+    EVP_PKEY_free(peer);
+    return ret;
+}
+
+/* Measures the cost of a CertificateVerify signature with |lu| and |pkey| */
+static int cost_measure_sigalg(const SIGALG_LOOKUP *lu, EVP_PKEY *pkey,
+                               uint64_t *cost)
+{
+    /* About the size of the TLSv1.3 CertificateVerify input */
+    unsigned char tbs[130];
+    unsigned char *sig = NULL;
+    const EVP_MD *md = NULL;
+    EVP_MD_CTX *mctx = NULL;
+    EVP_PKEY_CTX *pctx;
+    uint64_t begin, total = 0;
+    size_t rounds, siglen, maxsiglen = EVP_PKEY_size(pkey);
+    int ret = 0;
+
+    memset(tbs, 0x20, sizeof(tbs));
+    if (!tls1_lookup_md(lu, &md)
+            || (sig = OPENSSL_malloc(maxsiglen)) == NULL
+            || (mctx = EVP_MD_CTX_new()) == NULL)
+        goto end;
+
+    for (rounds = 0; rounds < COST_MEASURE_MAX_ROUNDS
+                     && total < COST_MEASURE_MIN_NSEC; rounds++) {
+        siglen = maxsiglen;
+        begin = ssl_monotonic_nsec();
+        if (EVP_DigestSignInit(mctx, &pctx, md, NULL, pkey) <= 0
+                || (lu->sig == EVP_PKEY_RSA_PSS
+                    && (EVP_PKEY_CTX_set_rsa_padding(pctx,
+                                                     RSA_PKCS1_PSS_PADDING) <= 0
+                        || EVP_PKEY_CTX_set_rsa_pss_saltlen(pctx,
+                                                RSA_PSS_SALTLEN_DIGEST) <= 0))
+                || EVP_DigestSign(mctx, sig, &siglen, tbs, sizeof(tbs)) <= 0)
+            goto end;
+        total += ssl_monotonic_nsec() - begin;
+        EVP_MD_CTX_reset(mctx);
+    }
+    *cost = total / rounds;
+    ret = 1;
+
+ end:
+    EVP_MD_CTX_free(mctx);
+    OPENSSL_free(sig);
+    return ret;
+}
+
+int SSL_CTX_measure_costs(SSL_CTX *ctx)
+{
+    COST_TABLE *table = cost_table_get(ctx);
+    SSL *s = NULL;
+    const uint16_t *groups, *sigalgs;
+    size_t i, num_groups, num_sigalgs;
+    uint64_t cost;
+    int ret = 0;
+
+    if (table == NULL) {
+        SSLerr(SSL_F_SSL_CTX_MEASURE_COSTS, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    /* A throwaway SSL gives us the lists configured on |ctx| */
+    if ((s = SSL_new(ctx)) == NULL) {
+        SSLerr(SSL_F_SSL_CTX_MEASURE_COSTS, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+
+    tls1_get_supported_groups(s, &groups, &num_groups);
+    for (i = 0; i < num_groups; i++) {
+        if (!cost_measure_group(groups[i], &cost)
+                || !cost_table_set(table, SSL_COST_GROUP, groups[i], cost)) {
+            SSLerr(SSL_F_SSL_CTX_MEASURE_COSTS, SSL_R_COST_MEASUREMENT_FAILED);
+            goto end;
+        }
+    }
+
+    /* Only the signature algorithms we have a key for */
+    num_sigalgs = tls12_get_psigalgs(s, 1, &sigalgs);
+    for (i = 0; i < num_sigalgs; i++) {
+        const SIGALG_LOOKUP *lu = tls1_lookup_sigalg(sigalgs[i]);
+
+        if (lu == NULL || !ssl_has_cert(s, lu->sig_idx))
+            continue;
+        if (!cost_measure_sigalg(lu, s->cert->pkeys[lu->sig_idx].privatekey,
+                                 &cost)
+                || !cost_table_set(table, SSL_COST_SIGALG, lu->sigalg, cost)) {
+            SSLerr(SSL_F_SSL_CTX_MEASURE_COSTS, SSL_R_COST_MEASUREMENT_FAILED);
+            goto end;
+        }
+    }
+    ret = 1;
+
+ end:
+    SSL_free(s);
+    return ret;
+}
+
+int SSL_CTX_set_cost_aware_selection(SSL_CTX *ctx, int enable, int min_secbits)
+{
+    COST_TABLE *table = cost_table_get(ctx);
+
+    if (table == NULL) {
+        SSLerr(SSL_F_SSL_CTX_SET_COST_AWARE_SELECTION, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    if (!CRYPTO_THREAD_write_lock(table->lock))
+        return 0;
+    table->enabled = enable != 0;
+    table->min_secbits = min_secbits;
+    CRYPTO_THREAD_unlock(table->lock);
+    return 1;
+}
+
+int SSL_CTX_set_cost(SSL_CTX *ctx, int type, const char *name, uint64_t cost)
+{
+    COST_TABLE *table;
+    uint16_t id = cost_name2id(type, name);
+
+    if (id == 0) {
+        SSLerr(SSL_F_SSL_CTX_SET_COST, SSL_R_UNKNOWN_ALGORITHM_NAME);
+        return 0;
+    }
+    if ((table = cost_table_get(ctx)) == NULL
+            || !cost_table_set(table, type, id, cost)) {
+        SSLerr(SSL_F_SSL_CTX_SET_COST, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    return 1;
+}
+
+int SSL_CTX_get_cost(const SSL_CTX *ctx, int type, const char *name,
+                     uint64_t *cost, uint64_t *selected)
+{
+    COST_TABLE *table = ctx->cost_table;
+    const COST_ENTRY *e;
+    uint16_t id = cost_name2id(type, name);
+    int ret = 0;
+
+    if (id == 0 || table == NULL || !CRYPTO_THREAD_read_lock(table->lock))
+        return 0;
+    if ((e = cost_table_find(table, type, id)) != NULL) {
+        if (cost != NULL)
+            *cost = e->cost;
+        if (selected != NULL)
+            *selected = e->selected;
+        ret = 1;
+    }
+    CRYPTO_THREAD_unlock(table->lock);
+    return ret;
+}
+
+int SSL_CTX_get_cost_selection_stats(const SSL_CTX *ctx, int type,
+                                     uint64_t *cheapest, uint64_t *preference,
+                                     uint64_t *below_minimum)
+{
+    COST_TABLE *table = ctx->cost_table;
+
+    if (type < 0 || type >= COST_TYPE_NUM || table == NULL
+            || !CRYPTO_THREAD_read_lock(table->lock))
+        return 0;
+    if (cheapest != NULL)
+        *cheapest = table->reasons[type][COST_REASON_CHEAPEST];
+    if (preference != NULL)
+        *preference = table->reasons[type][COST_REASON_PREFERENCE];
+    if (below_minimum != NULL)
+        *below_minimum = table->reasons[type][COST_REASON_BELOW_MINIMUM];
+    CRYPTO_THREAD_unlock(table->lock);
+    return 1;
+}
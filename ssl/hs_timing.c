@@ -0,0 +1,350 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Handshake phase timing.
+ *
+ * When turned on for an SSL_CTX, each handshake of the connections created
+ * from it records a monotonic timestamp for every state machine transition,
+ * the time spent in each crypto step (key generation, KEM encapsulation and
+ * decapsulation, key derivation, signing, signature and chain verification)
+ * and in waiting for the peer, and the handshake bytes of every flight. The
+ * records of the last handshake are kept with the SSL, and the phase times of
+ * completed handshakes are added to per SSL_CTX histograms.
+ */
+
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+# include <sys/time.h>
+#endif
+#include <openssl/crypto.h>
+#include "ssl_local.h"
+
+/* Enough for a TLSv1.3 handshake with client authentication */
+#define HS_TIMING_MAX_TRANSITIONS   48
+#define HS_TIMING_MAX_FLIGHTS       12
+
+typedef struct hs_transition_st {
+    OSSL_HANDSHAKE_STATE state;
+    uint64_t nsec;
+} HS_TRANSITION;
+
+typedef struct hs_flight_st {
+    int sent;
+    size_t bytes;
+    uint64_t nsec;
+} HS_FLIGHT;
+
+struct ssl_hs_timing_st {
+    /* Set from the start of a handshake until it completes */
+    int active;
+    uint64_t start;
+    /* When the handshake started waiting for the peer, 0 if it isn't */
+    uint64_t wait_start;
+    uint64_t phase_nsec[SSL_HS_PHASE_NUM];
+    uint64_t phase_count[SSL_HS_PHASE_NUM];
+    HS_TRANSITION transitions[HS_TIMING_MAX_TRANSITIONS];
+    size_t num_transitions;
+    HS_FLIGHT flights[HS_TIMING_MAX_FLIGHTS];
+    size_t num_flights;
+};
+
+struct hs_timing_stats_st {
+    CRYPTO_RWLOCK *lock;
+    int enabled;
+    uint64_t histogram[SSL_HS_PHASE_NUM][SSL_HS_TIMING_BUCKETS];
+};
+
+static const char *phase_names[SSL_HS_PHASE_NUM] = {
+    "total",
+    "keygen",
+    "encaps",
+    "decaps",
+    "derive",
+    "sign",
+    "verify",
+    "chain",
+    "peer_wait"
+};
+
+/*
+ * Returns a monotonic timestamp in nanoseconds, or 0 if there is no clock.
+ * Also used to time the refills of the KEM keypair pool and to measure the
+ * costs for cost aware selection.
+ */
+uint64_t ssl_monotonic_nsec(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER count, freq;
+
+    if (!QueryPerformanceCounter(&count) || !QueryPerformanceFrequency(&freq))
+        return 0;
+    return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000
+           + (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000
+             / freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    struct timeval tv;
+
+    /* Not monotonic, but the best there is */
+    if (gettimeofday(&tv, NULL) != 0)
+        return 0;
+    return (uint64_t)tv.tv_sec * 1000000000 + (uint64_t)tv.tv_usec * 1000;
+#endif
+}
+
+void ssl_hs_timing_free(SSL_HS_TIMING *t)
+{
+    OPENSSL_free(t);
+}
+
+void hs_timing_stats_free(HS_TIMING_STATS *stats)
+{
+    if (stats == NULL)
+        return;
+    CRYPTO_THREAD_lock_free(stats->lock);
+    OPENSSL_free(stats);
+}
+
+/* The timing of |s| if the current handshake is being timed, else NULL */
+static ossl_inline SSL_HS_TIMING *hs_timing_active(const SSL *s)
+{
+    return s->hs_timing != NULL && s->hs_timing->active ? s->hs_timing : NULL;
+}
+
+void ssl_hs_timing_begin(SSL *s)
+{
+    HS_TIMING_STATS *stats = s->session_ctx->hs_timing_stats;
+
+    if (stats == NULL || !stats->enabled) {
+        if (s->hs_timing != NULL)
+            s->hs_timing->active = 0;
+        return;
+    }
+    if (s->hs_timing == NULL
+            && (s->hs_timing = OPENSSL_malloc(sizeof(*s->hs_timing))) == NULL)
+        return;
+    memset(s->hs_timing, 0, sizeof(*s->hs_timing));
+    s->hs_timing->start = ssl_monotonic_nsec();
+    s->hs_timing->active = 1;
+}
+
+/* The histogram bucket of a phase that took |nsec| */
+static size_t hs_timing_bucket(uint64_t nsec)
+{
+    uint64_t usec = nsec / 1000;
+    size_t bucket = 0;
+
+    while (usec > 1 && bucket < SSL_HS_TIMING_BUCKETS - 1) {
+        usec >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void ssl_hs_timing_end(SSL *s)
+{
+    SSL_HS_TIMING *t = hs_timing_active(s);
+    HS_TIMING_STATS *stats = s->session_ctx->hs_timing_stats;
+    int i;
+
+    if (t == NULL)
+        return;
+    t->active = 0;
+    t->phase_nsec[SSL_HS_PHASE_TOTAL] = ssl_monotonic_nsec() - t->start;
+    t->phase_count[SSL_HS_PHASE_TOTAL] = 1;
+
+    if (stats == NULL || !CRYPTO_THREAD_write_lock(stats->lock))
+        return;
+    for (i = 0; i < SSL_HS_PHASE_NUM; i++) {
+        if (t->phase_count[i] > 0)
+            stats->histogram[i][hs_timing_bucket(t->phase_nsec[i])]++;
+    }
+    CRYPTO_THREAD_unlock(stats->lock);
+}
+
+uint64_t ssl_hs_phase_start(SSL *s)
+{
+    return hs_timing_active(s) != NULL ? ssl_monotonic_nsec() : 0;
+}
+
+void ssl_hs_phase_end(SSL *s, int phase, uint64_t start)
+{
+    SSL_HS_TIMING *t = hs_timing_active(s);
+
+    if (t == NULL || start == 0)
+        return;
+    t->phase_nsec[phase] += ssl_monotonic_nsec() - start;
+    t->phase_count[phase]++;
+}
+
+void ssl_hs_timing_transition(SSL *s)
+{
+    SSL_HS_TIMING *t = hs_timing_active(s);
+    HS_TRANSITION *tr;
+
+    if (t == NULL || t->num_transitions == HS_TIMING_MAX_TRANSITIONS)
+        return;
+    tr = &t->transitions[t->num_transitions++];
+    tr->state = s->statem.hand_state;
+    tr->nsec = ssl_monotonic_nsec() - t->start;
+}
+
+void ssl_hs_timing_message(SSL *s, int sent, size_t bytes)
+{
+    SSL_HS_TIMING *t = hs_timing_active(s);
+    HS_FLIGHT *fl;
+
+    if (t == NULL)
+        return;
+    /*
+     * Waiting for the peer starts once we have sent something, even if the
+     * state machine is left before it starts to read the reply
+     */
+    if (sent)
+        t->wait_start = ssl_monotonic_nsec();
+    /* A flight is a run of messages in the same direction */
+    if (t->num_flights > 0 && t->flights[t->num_flights - 1].sent == sent) {
+        t->flights[t->num_flights - 1].bytes += bytes;
+        return;
+    }
+    if (t->num_flights == HS_TIMING_MAX_FLIGHTS)
+        return;
+    fl = &t->flights[t->num_flights++];
+    fl->sent = sent;
+    fl->bytes = bytes;
+    fl->nsec = ssl_monotonic_nsec() - t->start;
+}
+
+void ssl_hs_timing_wait_start(SSL *s)
+{
+    SSL_HS_TIMING *t = hs_timing_active(s);
+
+    /* Still set if the previous attempt to read would have blocked */
+    if (t != NULL && t->wait_start == 0)
+        t->wait_start = ssl_monotonic_nsec();
+}
+
+void ssl_hs_timing_wait_end(SSL *s)
+{
+    SSL_HS_TIMING *t = hs_timing_active(s);
+
+    if (t == NULL || t->wait_start == 0)
+        return;
+    t->phase_nsec[SSL_HS_PHASE_PEER_WAIT] +=
+        ssl_monotonic_nsec() - t->wait_start;
+    t->phase_count[SSL_HS_PHASE_PEER_WAIT]++;
+    t->wait_start = 0;
+}
+
+int SSL_CTX_set_handshake_timing(SSL_CTX *ctx, int enable)
+{
+    HS_TIMING_STATS *stats = ctx->hs_timing_stats;
+
+    if (stats == NULL) {
+        if (!enable)
+            return 1;
+        if ((stats = OPENSSL_zalloc(sizeof(*stats))) == NULL
+                || (stats->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+            OPENSSL_free(stats);
+            SSLerr(SSL_F_SSL_CTX_SET_HANDSHAKE_TIMING, ERR_R_MALLOC_FAILURE);
+            return 0;
+        }
+        ctx->hs_timing_stats = stats;
+    }
+    stats->enabled = enable != 0;
+    return 1;
+}
+
+const char *SSL_handshake_phase_name(int phase)
+{
+    if (phase < 0 || phase >= SSL_HS_PHASE_NUM)
+        return NULL;
+    return phase_names[phase];
+}
+
+int SSL_get_handshake_phase(const SSL *s, int phase, uint64_t *nsec,
+                            uint64_t *count)
+{
+    const SSL_HS_TIMING *t = s->hs_timing;
+
+    if (t == NULL || phase < 0 || phase >= SSL_HS_PHASE_NUM)
+        return 0;
+    if (nsec != NULL)
+        *nsec = t->phase_nsec[phase];
+    if (count != NULL)
+        *count = t->phase_count[phase];
+    return 1;
+}
+
+size_t SSL_get_handshake_transition_count(const SSL *s)
+{
+    return s->hs_timing != NULL ? s->hs_timing->num_transitions : 0;
+}
+
+int SSL_get_handshake_transition(const SSL *s, size_t idx,
+                                 OSSL_HANDSHAKE_STATE *state,
+                                 const char **desc, uint64_t *nsec)
+{
+    const HS_TRANSITION *tr;
+
+    if (idx >= SSL_get_handshake_transition_count(s))
+        return 0;
+    tr = &s->hs_timing->transitions[idx];
+    if (state != NULL)
+        *state = tr->state;
+    if (desc != NULL)
+        *desc = ssl_state_desc(tr->state);
+    if (nsec != NULL)
+        *nsec = tr->nsec;
+    return 1;
+}
+
+size_t SSL_get_handshake_flight_count(const SSL *s)
+{
+    return s->hs_timing != NULL ? s->hs_timing->num_flights : 0;
+}
+
+int SSL_get_handshake_flight(const SSL *s, size_t idx, int *sent,
+                             size_t *bytes, uint64_t *nsec)
+{
+    const HS_FLIGHT *fl;
+
+    if (idx >= SSL_get_handshake_flight_count(s))
+        return 0;
+    fl = &s->hs_timing->flights[idx];
+    if (sent != NULL)
+        *sent = fl->sent;
+    if (bytes != NULL)
+        *bytes = fl->bytes;
+    if (nsec != NULL)
+        *nsec = fl->nsec;
+    return 1;
+}
+
+int SSL_CTX_get_handshake_histogram(const SSL_CTX *ctx, int phase,
+                                    uint64_t *buckets, size_t nbuckets)
+{
+    HS_TIMING_STATS *stats = ctx->hs_timing_stats;
+    size_t i;
+
+    if (stats == NULL || phase < 0 || phase >= SSL_HS_PHASE_NUM
+            || !CRYPTO_THREAD_read_lock(stats->lock))
+        return 0;
+    for (i = 0; i < nbuckets; i++)
+        buckets[i] = i < SSL_HS_TIMING_BUCKETS ? stats->histogram[phase][i] : 0;
+    CRYPTO_THREAD_unlock(stats->lock);
+    return 1;
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Client side cache of the group each server selected, keyed by SNI name.
+ *
+ * A client only sends a key_share for its most preferred group, and with
+ * PQC groups a mismatch with the server's choice costs a HelloRetryRequest
+ * plus a second, often expensive, key generation. When the cache is enabled
+ * the first ClientHello to a known server carries a key_share for the group
+ * that server selected last time instead. Entries are evicted in least
+ * recently used order.
+ */
+
+#include <string.h>
+#include <openssl/crypto.h>
+#include <openssl/lhash.h>
+#include "ssl_local.h"
+
+typedef struct key_share_cache_entry_st KEY_SHARE_CACHE_ENTRY;
+
+struct key_share_cache_entry_st {
+    char *hostname;
+    uint16_t group_id;
+    /* Most recently used first */
+    KEY_SHARE_CACHE_ENTRY *prev;
+    KEY_SHARE_CACHE_ENTRY *next;
+};
+
+DEFINE_LHASH_OF(KEY_SHARE_CACHE_ENTRY);
+
+struct key_share_cache_st {
+    CRYPTO_RWLOCK *lock;
+    LHASH_OF(KEY_SHARE_CACHE_ENTRY) *entries;
+    KEY_SHARE_CACHE_ENTRY *head;
+    KEY_SHARE_CACHE_ENTRY *tail;
+    size_t size;
+    uint64_t predicted;
+    uint64_t hrr_avoided;
+    uint64_t hrr;
+};
+
+static unsigned long key_share_cache_hash(const KEY_SHARE_CACHE_ENTRY *e)
+{
+    return OPENSSL_LH_strhash(e->hostname);
+}
+
+static int key_share_cache_cmp(const KEY_SHARE_CACHE_ENTRY *a,
+                               const KEY_SHARE_CACHE_ENTRY *b)
+{
+    return strcmp(a->hostname, b->hostname);
+}
+
+static void key_share_cache_unlink(KEY_SHARE_CACHE *cache,
+                                   KEY_SHARE_CACHE_ENTRY *e)
+{
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        cache->head = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    else
+        cache->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void key_share_cache_push_front(KEY_SHARE_CACHE *cache,
+                                       KEY_SHARE_CACHE_ENTRY *e)
+{
+    e->prev = NULL;
+    e->next = cache->head;
+    if (cache->head != NULL)
+        cache->head->prev = e;
+    else
+        cache->tail = e;
+    cache->head = e;
+}
+
+static void key_share_cache_entry_free(KEY_SHARE_CACHE_ENTRY *e)
+{
+    OPENSSL_free(e->hostname);
+    OPENSSL_free(e);
+}
+
+/* Evicts the least recently used entries until at most |keep| remain */
+static void key_share_cache_trim(KEY_SHARE_CACHE *cache, size_t keep)
+{
+    while (lh_KEY_SHARE_CACHE_ENTRY_num_items(cache->entries) > keep) {
+        KEY_SHARE_CACHE_ENTRY *e = cache->tail;
+
+        key_share_cache_unlink(cache, e);
+        lh_KEY_SHARE_CACHE_ENTRY_delete(cache->entries, e);
+        key_share_cache_entry_free(e);
+    }
+}
+
+void key_share_cache_free(KEY_SHARE_CACHE *cache)
+{
+    if (cache == NULL)
+        return;
+    key_share_cache_trim(cache, 0);
+    lh_KEY_SHARE_CACHE_ENTRY_free(cache->entries);
+    CRYPTO_THREAD_lock_free(cache->lock);
+    OPENSSL_free(cache);
+}
+
+/*
+ * Returns the group |s| should send its first key_share for, or 0 if there is
+ * no usable prediction for the server named in the SNI extension.
+ */
+uint16_t key_share_cache_predict(SSL *s)
+{
+    KEY_SHARE_CACHE *cache = s->ctx->key_share_cache;
+    KEY_SHARE_CACHE_ENTRY tmp, *e;
+    const uint16_t *pgroups = NULL;
+    size_t i, num_groups = 0;
+    uint16_t group_id = 0;
+
+    if (cache == NULL || s->ext.hostname == NULL)
+        return 0;
+
+    tmp.hostname = s->ext.hostname;
+    if (!CRYPTO_THREAD_write_lock(cache->lock))
+        return 0;
+    if ((e = lh_KEY_SHARE_CACHE_ENTRY_retrieve(cache->entries, &tmp)) != NULL) {
+        group_id = e->group_id;
+        key_share_cache_unlink(cache, e);
+        key_share_cache_push_front(cache, e);
+    }
+    CRYPTO_THREAD_unlock(cache->lock);
+
+    if (group_id == 0)
+        return 0;
+
+    /* Our configuration may have changed since the entry was added */
+    tls1_get_supported_groups(s, &pgroups, &num_groups);
+    for (i = 0; i < num_groups; i++) {
+        if (pgroups[i] == group_id)
+            break;
+    }
+    if (i == num_groups
+            || !tls_curve_allowed(s, group_id, SSL_SECOP_CURVE_SUPPORTED))
+        return 0;
+    return group_id;
+}
+
+/* Counts a ClientHello whose key_share was chosen by the cache */
+void key_share_cache_note_predicted(SSL *s)
+{
+    KEY_SHARE_CACHE *cache = s->ctx->key_share_cache;
+
+    if (!CRYPTO_THREAD_write_lock(cache->lock))
+        return;
+    cache->predicted++;
+    CRYPTO_THREAD_unlock(cache->lock);
+}
+
+/* Counts a HelloRetryRequest received for a server named in SNI */
+void key_share_cache_note_hrr(SSL *s)
+{
+    KEY_SHARE_CACHE *cache = s->ctx->key_share_cache;
+
+    if (cache == NULL || s->ext.hostname == NULL
+            || !CRYPTO_THREAD_write_lock(cache->lock))
+        return;
+    cache->hrr++;
+    CRYPTO_THREAD_unlock(cache->lock);
+}
+
+/*
+ * Records that the server named in the SNI extension of |s| accepted a
+ * key_share for |group_id|.
+ */
+void key_share_cache_update(SSL *s, uint16_t group_id)
+{
+    KEY_SHARE_CACHE *cache = s->ctx->key_share_cache;
+    KEY_SHARE_CACHE_ENTRY tmp, *e;
+
+    if (cache == NULL || s->ext.hostname == NULL)
+        return;
+
+    tmp.hostname = s->ext.hostname;
+    if (!CRYPTO_THREAD_write_lock(cache->lock))
+        return;
+    if (s->s3->key_share_predicted
+            && s->hello_retry_request == SSL_HRR_NONE)
+        cache->hrr_avoided++;
+    if (cache->size == 0)
+        goto end;
+    if ((e = lh_KEY_SHARE_CACHE_ENTRY_retrieve(cache->entries, &tmp)) != NULL) {
+        e->group_id = group_id;
+        key_share_cache_unlink(cache, e);
+        key_share_cache_push_front(cache, e);
+    } else if ((e = OPENSSL_zalloc(sizeof(*e))) != NULL) {
+        if ((e->hostname = OPENSSL_strdup(s->ext.hostname)) == NULL) {
+            OPENSSL_free(e);
+            goto end;
+        }
+        e->group_id = group_id;
+        lh_KEY_SHARE_CACHE_ENTRY_insert(cache->entries, e);
+        if (lh_KEY_SHARE_CACHE_ENTRY_error(cache->entries)) {
+            key_share_cache_entry_free(e);
+            goto end;
+        }
+        key_share_cache_push_front(cache, e);
+        key_share_cache_trim(cache, cache->size);
+    }
+    /* A failure to remember the group is not fatal to the handshake */
+
+ end:
+    CRYPTO_THREAD_unlock(cache->lock);
+}
+
+int SSL_CTX_set_key_share_cache_size(SSL_CTX *ctx, size_t size)
+{
+    KEY_SHARE_CACHE *cache = ctx->key_share_cache;
+
+    if (cache == NULL) {
+        if (size == 0)
+            return 1;
+        if ((cache = OPENSSL_zalloc(sizeof(*cache))) == NULL
+                || (cache->lock = CRYPTO_THREAD_lock_new()) == NULL
+                || (cache->entries =
+                        lh_KEY_SHARE_CACHE_ENTRY_new(key_share_cache_hash,
+                                                     key_share_cache_cmp))
+                   == NULL) {
+            SSLerr(SSL_F_SSL_CTX_SET_KEY_SHARE_CACHE_SIZE,
+                   ERR_R_MALLOC_FAILURE);
+            if (cache != NULL)
+                CRYPTO_THREAD_lock_free(cache->lock);
+            OPENSSL_free(cache);
+            return 0;
+        }
+        ctx->key_share_cache = cache;
+    }
+
+    if (!CRYPTO_THREAD_write_lock(cache->lock))
+        return 0;
+    cache->size = size;
+    key_share_cache_trim(cache, size);
+    CRYPTO_THREAD_unlock(cache->lock);
+    return 1;
+}
+
+size_t SSL_CTX_get_key_share_cache_size(const SSL_CTX *ctx)
+{
+    KEY_SHARE_CACHE *cache = ctx->key_share_cache;
+    size_t size;
+
+    if (cache == NULL || !CRYPTO_THREAD_read_lock(cache->lock))
+        return 0;
+    size = cache->size;
+    CRYPTO_THREAD_unlock(cache->lock);
+    return size;
+}
+
+int SSL_CTX_get_key_share_cache_stats(const SSL_CTX *ctx, uint64_t *predicted,
+                                      uint64_t *hrr_avoided, uint64_t *hrr)
+{
+    KEY_SHARE_CACHE *cache = ctx->key_share_cache;
+
+    if (cache == NULL || !CRYPTO_THREAD_read_lock(cache->lock))
+        return 0;
+    if (predicted != NULL)
+        *predicted = cache->predicted;
+    if (hrr_avoided != NULL)
+        *hrr_avoided = cache->hrr_avoided;
+    if (hrr != NULL)
+        *hrr = cache->hrr;
+    CRYPTO_THREAD_unlock(cache->lock);
+    return 1;
+}
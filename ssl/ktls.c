@@ -0,0 +1,197 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Kernel TLS offload of the record layer.
+ *
+ * With SSL_MODE_ENABLE_KTLS, the traffic keys of a TLSv1.2 or TLSv1.3
+ * connection with an AES-GCM or ChaCha20-Poly1305 cipher are also installed
+ * on its socket when they take effect, and from then on the kernel protects
+ * the records in that direction. The record layer then writes and reads the
+ * record payloads through the socket BIO, see ssl3_write_bytes(),
+ * do_ssl3_write() and ssl3_get_record().
+ *
+ * Whatever the kernel cannot take, because its TLS module is not loaded or
+ * the connection uses a feature that it lacks, stays in user space. That
+ * includes TLSv1.3 on kernels that cannot replace the keys of a direction for
+ * a key update. Which directions the kernel has is recorded in the record
+ * layer, as the BIO ctrls that report it cannot be trusted through a filter
+ * BIO that answers every ctrl that it does not know.
+ */
+
+#include <string.h>
+#include "ssl_local.h"
+#include "internal/bio.h"
+#include "internal/ktls.h"
+
+#ifndef OPENSSL_NO_KTLS
+
+/*
+ * Whether the records of |s| in one direction can be handed to the kernel
+ * behind |bio|
+ */
+static int ktls_can_offload(SSL *s, BIO *bio, int sending)
+{
+    if ((s->mode & SSL_MODE_ENABLE_KTLS) == 0 || SSL_IS_DTLS(s))
+        return 0;
+
+    /*
+     * A key update, which the peer can ask for at any time, would end a
+     * TLSv1.3 connection whose kernel cannot take new keys
+     */
+    if (SSL_IS_TLS13(s) && BIO_get_ktls_rekey(bio) <= 0)
+        return 0;
+
+    if (sending) {
+        /* The kernel neither compresses nor pads, and fills whole records */
+        return s->compress == NULL
+               && s->record_padding_cb == NULL
+               && s->block_padding == 0
+               && ssl_get_max_send_fragment(s) == SSL3_RT_MAX_PLAIN_LENGTH;
+    }
+    /* Records that were read ahead are already past the kernel */
+    return s->expand == NULL && !RECORD_LAYER_read_pending(&s->rlayer);
+}
+
+# define KTLS_SET_GCM(gcm, type, version, key, iv, seq, tls13)               \
+    do {                                                                    \
+        (gcm)->info.version = (version);                                    \
+        (gcm)->info.cipher_type = (type);                                   \
+        memcpy((gcm)->key, (key), sizeof((gcm)->key));                      \
+        memcpy((gcm)->salt, (iv), sizeof((gcm)->salt));                     \
+        /* In TLSv1.2 the sequence number is the first explicit nonce */    \
+        memcpy((gcm)->iv, (tls13) ? (iv) + sizeof((gcm)->salt) : (seq),     \
+               sizeof((gcm)->iv));                                          \
+        memcpy((gcm)->rec_seq, (seq), sizeof((gcm)->rec_seq));              \
+    } while (0)
+
+/*
+ * Sets |info| to the traffic |key| and |iv| of one direction of |s|, with
+ * |seq| as the sequence number of its next record. In TLSv1.2 |iv| is the
+ * part of the nonce that comes from the key block.
+ */
+static int ktls_crypto_info(SSL *s, const unsigned char *key,
+                            const unsigned char *iv, const unsigned char *seq,
+                            ktls_crypto_info_t *info)
+{
+    int tls13 = SSL_IS_TLS13(s);
+    unsigned short version;
+
+    memset(info, 0, sizeof(*info));
+    if (tls13) {
+# ifdef TLS_1_3_VERSION
+        version = TLS_1_3_VERSION;
+# else
+        return 0;
+# endif
+    } else if (s->version == TLS1_2_VERSION) {
+        version = TLS_1_2_VERSION;
+    } else {
+        return 0;
+    }
+
+    switch (s->s3->tmp.new_cipher->algorithm_enc) {
+    case SSL_AES128GCM:
+        KTLS_SET_GCM(&info->u.aes_gcm_128, TLS_CIPHER_AES_GCM_128, version,
+                     key, iv, seq, tls13);
+        info->len = sizeof(info->u.aes_gcm_128);
+        return 1;
+# ifdef TLS_CIPHER_AES_GCM_256
+    case SSL_AES256GCM:
+        KTLS_SET_GCM(&info->u.aes_gcm_256, TLS_CIPHER_AES_GCM_256, version,
+                     key, iv, seq, tls13);
+        info->len = sizeof(info->u.aes_gcm_256);
+        return 1;
+# endif
+# ifdef TLS_CIPHER_CHACHA20_POLY1305
+    case SSL_CHACHA20POLY1305:
+        {
+            struct tls12_crypto_info_chacha20_poly1305 *chacha =
+                &info->u.chacha20_poly1305;
+
+            chacha->info.version = version;
+            chacha->info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+            memcpy(chacha->key, key, sizeof(chacha->key));
+            memcpy(chacha->iv, iv, sizeof(chacha->iv));
+            memcpy(chacha->rec_seq, seq, sizeof(chacha->rec_seq));
+            info->len = sizeof(*chacha);
+            return 1;
+        }
+# endif
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Called once |key| and |iv| have been installed for sending, if |sending| is
+ * nonzero, or for receiving. Hands them to the kernel as well if it already
+ * has the records of that direction or it can take them.
+ *
+ * Returns 1 on success, which includes leaving the records in user space, or
+ * 0 after SSLfatal() if the kernel has the records but not the new keys, as
+ * the connection cannot continue then.
+ */
+int ssl_ktls_change_cipher_state(SSL *s, int sending, const unsigned char *key,
+                                 const unsigned char *iv)
+{
+    BIO *bio = sending ? s->wbio : s->rbio;
+    unsigned int *offloaded = sending ? &s->rlayer.ktls_send
+                                      : &s->rlayer.ktls_recv;
+    ktls_crypto_info_t info;
+    int ret;
+
+    if (!*offloaded) {
+        if (!ktls_can_offload(s, bio, sending))
+            return 1;
+        /* What was written under the old keys goes out first */
+        if (sending && BIO_flush(bio) <= 0)
+            return 1;
+    }
+
+    ret = ktls_crypto_info(s, key, iv,
+                           sending ? s->rlayer.write_sequence
+                                   : s->rlayer.read_sequence, &info)
+          && BIO_set_ktls(bio, &info, sending) > 0;
+    OPENSSL_cleanse(&info, sizeof(info));
+
+    if (!ret) {
+        if (!*offloaded)
+            return 1;
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                 SSL_F_SSL_KTLS_CHANGE_CIPHER_STATE,
+                 SSL_R_KTLS_KEY_CHANGE_FAILED);
+        return 0;
+    }
+    *offloaded = 1;
+
+    /*
+     * Records must reach the kernel one at a time, with their type, so they
+     * are no longer collected in the buffering BIO, which is empty by now.
+     */
+    if (sending && !ssl_free_wbio_buffer(s)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                 SSL_F_SSL_KTLS_CHANGE_CIPHER_STATE, ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+    /* The kernel cannot take the keys of a renegotiated TLSv1.2 session */
+    if (!SSL_IS_TLS13(s))
+        s->options |= SSL_OP_NO_RENEGOTIATION;
+    return 1;
+}
+
+#else
+
+int ssl_ktls_change_cipher_state(SSL *s, int sending, const unsigned char *key,
+                                 const unsigned char *iv)
+{
+    return 1;
+}
+
+#endif
@@ -0,0 +1,369 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Pool of pre-generated ephemeral OQS KEM keypairs.
+ *
+ * PQC key generation can dominate the cost of building a ClientHello, so an
+ * SSL_CTX can be asked to keep a number of keypairs per group ready ahead of
+ * time. The pool is refilled by SSL_CTX_fill_oqs_kem_pool(), which is meant
+ * to be called from a worker thread owned by the application: the library
+ * does not start threads of its own. Every keypair is handed out exactly
+ * once, and secret keys are kept in the secure heap.
+ */
+
+#include <string.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include "ssl_local.h"
+
+/* Keypairs for one group, in a ring buffer of |depth| slots */
+typedef struct {
+    uint16_t group_id;
+    /* The classical group of a hybrid group, 0 otherwise */
+    uint16_t classical_group_id;
+    const OQS_KEM *kem;
+    size_t depth;
+    /* Number of keypairs being generated by SSL_CTX_fill_oqs_kem_pool() */
+    size_t pending;
+    size_t head;
+    size_t count;
+    OQS_KEM_KEYPAIR *ring;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t generated;
+    uint64_t refill_usec;
+} OQS_KEM_POOL_QUEUE;
+
+struct oqs_kem_pool_st {
+    CRYPTO_RWLOCK *lock;
+    OQS_KEM_POOL_QUEUE *queues;
+    size_t num_queues;
+};
+
+void oqs_kem_keypair_cleanup(const OQS_KEM *kem, OQS_KEM_KEYPAIR *kp)
+{
+    OPENSSL_free(kp->public_key);
+    if (kp->secret_key != NULL)
+        OPENSSL_secure_clear_free(kp->secret_key, kem->length_secret_key);
+    EVP_PKEY_free(kp->classical);
+    memset(kp, 0, sizeof(*kp));
+}
+
+/* Like ssl_generate_pkey_group(), without an SSL to report errors to */
+static EVP_PKEY *oqs_kem_pool_classical_keygen(uint16_t group_id)
+{
+    const TLS_GROUP_INFO *ginf = tls1_group_id_lookup(group_id);
+    EVP_PKEY_CTX *pctx = NULL;
+    EVP_PKEY *pkey = NULL;
+
+    if (ginf == NULL
+            || (pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL)) == NULL
+            || EVP_PKEY_keygen_init(pctx) <= 0
+            || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, ginf->nid) <= 0
+            || EVP_PKEY_keygen(pctx, &pkey) <= 0) {
+        EVP_PKEY_free(pkey);
+        pkey = NULL;
+    }
+    EVP_PKEY_CTX_free(pctx);
+    return pkey;
+}
+
+static int oqs_kem_keypair_generate(const OQS_KEM *kem,
+                                    uint16_t classical_group_id,
+                                    OQS_KEM_KEYPAIR *kp)
+{
+    memset(kp, 0, sizeof(*kp));
+    if ((kp->public_key = OPENSSL_malloc(kem->length_public_key)) == NULL
+            || (kp->secret_key =
+                    OPENSSL_secure_malloc(kem->length_secret_key)) == NULL
+            || OQS_KEM_keypair(kem, kp->public_key,
+                               kp->secret_key) != OQS_SUCCESS
+            || (classical_group_id != 0
+                && (kp->classical =
+                        oqs_kem_pool_classical_keygen(classical_group_id))
+                   == NULL)) {
+        oqs_kem_keypair_cleanup(kem, kp);
+        return 0;
+    }
+    return 1;
+}
+
+static OQS_KEM_POOL_QUEUE *oqs_kem_pool_find(const OQS_KEM_POOL *pool,
+                                             uint16_t group_id)
+{
+    size_t i;
+
+    for (i = 0; i < pool->num_queues; i++) {
+        if (pool->queues[i].group_id == group_id)
+            return &pool->queues[i];
+    }
+    return NULL;
+}
+
+/* Drops all but the oldest |keep| keypairs of |q| */
+static void oqs_kem_pool_queue_trim(OQS_KEM_POOL_QUEUE *q, size_t keep)
+{
+    while (q->count > keep) {
+        q->count--;
+        oqs_kem_keypair_cleanup(q->kem,
+                                &q->ring[(q->head + q->count) % q->depth]);
+    }
+}
+
+void oqs_kem_pool_free(OQS_KEM_POOL *pool)
+{
+    size_t i;
+
+    if (pool == NULL)
+        return;
+    for (i = 0; i < pool->num_queues; i++) {
+        oqs_kem_pool_queue_trim(&pool->queues[i], 0);
+        OPENSSL_free(pool->queues[i].ring);
+    }
+    OPENSSL_free(pool->queues);
+    CRYPTO_THREAD_lock_free(pool->lock);
+    OPENSSL_free(pool);
+}
+
+int oqs_kem_pool_pop(OQS_KEM_POOL *pool, uint16_t group_id,
+                     OQS_KEM_KEYPAIR *kp)
+{
+    OQS_KEM_POOL_QUEUE *q;
+    int ret = 0;
+
+    if (!CRYPTO_THREAD_write_lock(pool->lock))
+        return 0;
+    q = oqs_kem_pool_find(pool, group_id);
+    if (q != NULL && q->depth > 0) {
+        if (q->count > 0) {
+            *kp = q->ring[q->head];
+            memset(&q->ring[q->head], 0, sizeof(q->ring[q->head]));
+            q->head = (q->head + 1) % q->depth;
+            q->count--;
+            q->hits++;
+            ret = 1;
+        } else {
+            q->misses++;
+        }
+    }
+    CRYPTO_THREAD_unlock(pool->lock);
+    return ret;
+}
+
+/* Maps a PQC or hybrid KEM |nid| to its group */
+static int oqs_kem_pool_group(int nid, uint16_t *group_id,
+                              uint16_t *classical_group_id)
+{
+    const OQS_KEM_GROUP_INFO *ginf = oqs_kem_group_nid_lookup(nid);
+
+    if (ginf == NULL)
+        return 0;
+    if (nid == ginf->hybrid.nid) {
+        *group_id = ginf->hybrid_group_id;
+        *classical_group_id = ginf->classical_group_id;
+    } else {
+        *group_id = ginf->group_id;
+        *classical_group_id = 0;
+    }
+    return 1;
+}
+
+int SSL_CTX_set_oqs_kem_pool_depth(SSL_CTX *ctx, int nid, size_t depth)
+{
+    OQS_KEM_POOL *pool = ctx->oqs_kem_pool;
+    OQS_KEM_POOL_QUEUE *q;
+    OQS_KEM_KEYPAIR *ring = NULL;
+    const OQS_KEM *kem;
+    uint16_t group_id, classical_group_id;
+    size_t i;
+    int ret = 0;
+
+    if (!oqs_kem_pool_group(nid, &group_id, &classical_group_id)
+            || (kem = ssl_get_oqs_kem(nid)) == NULL) {
+        SSLerr(SSL_F_SSL_CTX_SET_OQS_KEM_POOL_DEPTH,
+               SSL_R_UNSUPPORTED_ELLIPTIC_CURVE);
+        return 0;
+    }
+
+    if (pool == NULL) {
+        if (depth == 0)
+            return 1;
+        if ((pool = OPENSSL_zalloc(sizeof(*pool))) == NULL
+                || (pool->lock = CRYPTO_THREAD_lock_new()) == NULL) {
+            SSLerr(SSL_F_SSL_CTX_SET_OQS_KEM_POOL_DEPTH, ERR_R_MALLOC_FAILURE);
+            OPENSSL_free(pool);
+            return 0;
+        }
+        ctx->oqs_kem_pool = pool;
+    }
+
+    if (depth > 0
+            && (ring = OPENSSL_zalloc(depth * sizeof(*ring))) == NULL) {
+        SSLerr(SSL_F_SSL_CTX_SET_OQS_KEM_POOL_DEPTH, ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+
+    if (!CRYPTO_THREAD_write_lock(pool->lock)) {
+        OPENSSL_free(ring);
+        return 0;
+    }
+    if ((q = oqs_kem_pool_find(pool, group_id)) == NULL) {
+        OQS_KEM_POOL_QUEUE *queues;
+
+        queues = OPENSSL_realloc(pool->queues,
+                                 (pool->num_queues + 1) * sizeof(*queues));
+        if (queues == NULL) {
+            SSLerr(SSL_F_SSL_CTX_SET_OQS_KEM_POOL_DEPTH, ERR_R_MALLOC_FAILURE);
+            OPENSSL_free(ring);
+            goto end;
+        }
+        pool->queues = queues;
+        q = &pool->queues[pool->num_queues++];
+        memset(q, 0, sizeof(*q));
+        q->group_id = group_id;
+        q->classical_group_id = classical_group_id;
+        q->kem = kem;
+    }
+
+    /* Keep the oldest keypairs that still fit */
+    oqs_kem_pool_queue_trim(q, depth);
+    for (i = 0; i < q->count; i++)
+        ring[i] = q->ring[(q->head + i) % q->depth];
+    OPENSSL_free(q->ring);
+    q->ring = ring;
+    q->depth = depth;
+    q->head = 0;
+    ret = 1;
+
+ end:
+    CRYPTO_THREAD_unlock(pool->lock);
+    return ret;
+}
+
+int SSL_CTX_fill_oqs_kem_pool(SSL_CTX *ctx)
+{
+    OQS_KEM_POOL *pool = ctx->oqs_kem_pool;
+    int generated = 0;
+
+    if (pool == NULL)
+        return 0;
+
+    for (;;) {
+        OQS_KEM_POOL_QUEUE *q = NULL;
+        OQS_KEM_KEYPAIR kp;
+        const OQS_KEM *kem;
+        uint16_t group_id, classical_group_id;
+        uint64_t nsec;
+        size_t i;
+        int ok;
+
+        /* Claim a free slot, then generate the keypair without the lock */
+        if (!CRYPTO_THREAD_write_lock(pool->lock))
+            return -1;
+        for (i = 0; i < pool->num_queues; i++) {
+            q = &pool->queues[i];
+            if (q->count + q->pending < q->depth)
+                break;
+        }
+        if (i == pool->num_queues) {
+            CRYPTO_THREAD_unlock(pool->lock);
+            return generated;
+        }
+        q->pending++;
+        group_id = q->group_id;
+        classical_group_id = q->classical_group_id;
+        kem = q->kem;
+        CRYPTO_THREAD_unlock(pool->lock);
+
+        nsec = ssl_monotonic_nsec();
+        ok = oqs_kem_keypair_generate(kem, classical_group_id, &kp);
+        nsec = ssl_monotonic_nsec() - nsec;
+
+        if (!CRYPTO_THREAD_write_lock(pool->lock)) {
+            if (ok)
+                oqs_kem_keypair_cleanup(kem, &kp);
+            return -1;
+        }
+        /* The queues may have been reallocated in the meantime */
+        q = oqs_kem_pool_find(pool, group_id);
+        q->pending--;
+        if (ok) {
+            q->generated++;
+            q->refill_usec += nsec / 1000;
+            /* The depth may have been lowered in the meantime */
+            if (q->count < q->depth) {
+                q->ring[(q->head + q->count) % q->depth] = kp;
+                q->count++;
+                memset(&kp, 0, sizeof(kp));
+            }
+        }
+        CRYPTO_THREAD_unlock(pool->lock);
+
+        if (!ok) {
+            SSLerr(SSL_F_SSL_CTX_FILL_OQS_KEM_POOL, ERR_R_INTERNAL_ERROR);
+            return -1;
+        }
+        oqs_kem_keypair_cleanup(kem, &kp);
+        generated++;
+    }
+}
+
+int SSL_CTX_get_oqs_kem_pool_stats(const SSL_CTX *ctx, int nid,
+                                   size_t *available, uint64_t *hits,
+                                   uint64_t *misses, uint64_t *refill_usec)
+{
+    OQS_KEM_POOL *pool = ctx->oqs_kem_pool;
+    const OQS_KEM_POOL_QUEUE *q;
+    uint16_t group_id, classical_group_id;
+
+    if (pool == NULL
+            || !oqs_kem_pool_group(nid, &group_id, &classical_group_id)
+            || !CRYPTO_THREAD_read_lock(pool->lock))
+        return 0;
+    if ((q = oqs_kem_pool_find(pool, group_id)) == NULL) {
+        CRYPTO_THREAD_unlock(pool->lock);
+        return 0;
+    }
+    if (available != NULL)
+        *available = q->count;
+    if (hits != NULL)
+        *hits = q->hits;
+    if (misses != NULL)
+        *misses = q->misses;
+    if (refill_usec != NULL)
+        *refill_usec = q->generated > 0 ? q->refill_usec / q->generated : 0;
+    CRYPTO_THREAD_unlock(pool->lock);
+    return 1;
+}
+
+/* OQS_KEM_JOB operations, with no SSL to report errors to */
+int oqs_kem_keypair_job(void *arg)
+{
+    OQS_KEM_JOB *job = arg;
+
+    return OQS_KEM_keypair(job->kem, job->public_key,
+                           job->secret_key) == OQS_SUCCESS;
+}
+
+int oqs_kem_encaps_job(void *arg)
+{
+    OQS_KEM_JOB *job = arg;
+
+    return OQS_KEM_encaps(job->kem, job->ciphertext, job->shared_secret,
+                          job->public_key) == OQS_SUCCESS;
+}
+
+int oqs_kem_decaps_job(void *arg)
+{
+    OQS_KEM_JOB *job = arg;
+
+    return OQS_KEM_decaps(job->kem, job->shared_secret, job->ciphertext,
+                          job->secret_key) == OQS_SUCCESS;
+}
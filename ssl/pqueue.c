@@ -10,15 +10,67 @@
 #include "ssl_local.h"
 #include <openssl/bn.h>
 
+/*
+ * The queue is a skip list ordered by priority. Level 0 links every item
+ * through |next|, so that peeking, popping and iterating stay trivial, and
+ * each higher level links about a quarter of the items of the level below,
+ * which makes insert and find logarithmic in the number of items. That
+ * matters for DTLS handshake messages, which with PQC keys and certificates
+ * can arrive in dozens of fragments.
+ */
 struct pqueue_st {
-    pitem *items;
-    int count;
+    /* The first item on each level */
+    pitem *heads[PQUEUE_MAX_LEVEL];
+    size_t count;
 };
 
+static uint64_t prio2u64(const unsigned char *prio64be)
+{
+    uint64_t v = 0;
+    size_t i;
+
+    for (i = 0; i < 8; i++)
+        v = (v << 8) | prio64be[i];
+    return v;
+}
+
+/*
+ * Picks the number of levels above 0 for an item: one more for every pair of
+ * low zero bits in a hash of its priority. Priorities are unique within a
+ * queue and mostly consecutive, so this spreads them like a random choice
+ * would, without needing the RNG.
+ */
+static size_t pitem_levels(const unsigned char *prio64be)
+{
+    uint64_t v = prio2u64(prio64be);
+    uint32_t h = (uint32_t)(v ^ (v >> 32));
+    size_t levels = 0;
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    while ((h & 3) == 0 && levels < PQUEUE_MAX_LEVEL - 1) {
+        levels++;
+        h >>= 2;
+    }
+    return levels;
+}
+
+/* The link from |item| to the next item on level |lvl| */
+static ossl_inline pitem **pitem_link(pitem *item, size_t lvl)
+{
+    return lvl == 0 ? &item->next : &item->skip[lvl - 1];
+}
+
 pitem *pitem_new(unsigned char *prio64be, void *data)
 {
-    pitem *item = OPENSSL_malloc(sizeof(*item));
+    size_t levels = pitem_levels(prio64be);
+    pitem *item;
 
+    item = OPENSSL_malloc(sizeof(*item)
+                          + (levels > 0 ? levels - 1 : 0) * sizeof(pitem *));
     if (item == NULL) {
         SSLerr(SSL_F_PITEM_NEW, ERR_R_MALLOC_FAILURE);
         return NULL;
@@ -27,6 +79,7 @@ pitem *pitem_new(unsigned char *prio64be, void *data)
     memcpy(item->priority, prio64be, sizeof(item->priority));
     item->data = data;
     item->next = NULL;
+    item->levels = levels;
     return item;
 }
 
@@ -50,80 +103,86 @@ void pqueue_free(pqueue *pq)
     OPENSSL_free(pq);
 }
 
-pitem *pqueue_insert(pqueue *pq, pitem *item)
+/*
+ * Sets |update[lvl]| to the link on each level that an item with priority
+ * |prio64be| would be inserted at, i.e. the link out of the last item on that
+ * level with a lower priority.
+ */
+static void pqueue_search(pqueue *pq, const unsigned char *prio64be,
+                          pitem **update[PQUEUE_MAX_LEVEL])
 {
-    pitem *curr, *next;
+    /* The last item found with a lower priority, NULL while there is none */
+    pitem *prev = NULL;
+    size_t lvl = PQUEUE_MAX_LEVEL;
 
-    if (pq->items == NULL) {
-        pq->items = item;
-        return item;
-    }
+    while (lvl-- > 0) {
+        /* |prev| was found on a higher level so it is on this one too */
+        pitem **link = prev == NULL ? &pq->heads[lvl] : pitem_link(prev, lvl);
 
-    for (curr = NULL, next = pq->items;
-         next != NULL; curr = next, next = next->next) {
         /*
          * we can compare 64-bit value in big-endian encoding with memcmp:-)
          */
-        int cmp = memcmp(next->priority, item->priority, 8);
-        if (cmp > 0) {          /* next > item */
-            item->next = next;
+        while (*link != NULL && memcmp((*link)->priority, prio64be, 8) < 0) {
+            prev = *link;
+            link = pitem_link(prev, lvl);
+        }
+        update[lvl] = link;
+    }
+}
 
-            if (curr == NULL)
-                pq->items = item;
-            else
-                curr->next = item;
+pitem *pqueue_insert(pqueue *pq, pitem *item)
+{
+    pitem **update[PQUEUE_MAX_LEVEL];
+    size_t lvl;
 
-            return item;
-        }
+    pqueue_search(pq, item->priority, update);
 
-        else if (cmp == 0)      /* duplicates not allowed */
-            return NULL;
-    }
+    /* duplicates not allowed */
+    if (*update[0] != NULL
+            && memcmp((*update[0])->priority, item->priority, 8) == 0)
+        return NULL;
 
-    item->next = NULL;
-    curr->next = item;
+    for (lvl = 0; lvl <= item->levels; lvl++) {
+        *pitem_link(item, lvl) = *update[lvl];
+        *update[lvl] = item;
+    }
+    pq->count++;
 
     return item;
 }
 
 pitem *pqueue_peek(pqueue *pq)
 {
-    return pq->items;
+    return pq->heads[0];
 }
 
 pitem *pqueue_pop(pqueue *pq)
 {
-    pitem *item = pq->items;
+    pitem *item = pq->heads[0];
+    size_t lvl;
+
+    if (item == NULL)
+        return NULL;
 
-    if (pq->items != NULL)
-        pq->items = pq->items->next;
+    /* The first item is also the first on each of its levels */
+    for (lvl = 0; lvl <= item->levels; lvl++)
+        pq->heads[lvl] = *pitem_link(item, lvl);
+    pq->count--;
 
     return item;
 }
 
 pitem *pqueue_find(pqueue *pq, unsigned char *prio64be)
 {
-    pitem *next;
-    pitem *found = NULL;
-
-    if (pq->items == NULL)
-        return NULL;
-
-    for (next = pq->items; next->next != NULL; next = next->next) {
-        if (memcmp(next->priority, prio64be, 8) == 0) {
-            found = next;
-            break;
-        }
-    }
-
-    /* check the one last node */
-    if (memcmp(next->priority, prio64be, 8) == 0)
-        found = next;
+    pitem **update[PQUEUE_MAX_LEVEL];
+    pitem *item;
 
-    if (!found)
+    pqueue_search(pq, prio64be, update);
+    item = *update[0];
+    if (item == NULL || memcmp(item->priority, prio64be, 8) != 0)
         return NULL;
 
-    return found;
+    return item;
 }
 
 pitem *pqueue_iterator(pqueue *pq)
@@ -147,12 +206,5 @@ pitem *pqueue_next(piterator *item)
 
 size_t pqueue_size(pqueue *pq)
 {
-    pitem *item = pq->items;
-    size_t count = 0;
-
-    while (item != NULL) {
-        count++;
-        item = item->next;
-    }
-    return count;
+    return pq->count;
 }
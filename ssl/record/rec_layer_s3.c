@@ -16,6 +16,8 @@
 #include <openssl/rand.h>
 #include "record_local.h"
 #include "../packet_local.h"
+#include "internal/bio.h"
+#include "internal/cryptlib.h"
 
 #if     defined(OPENSSL_SMALL_FOOTPRINT) || \
         !(      defined(AESNI_ASM) &&   ( \
@@ -52,6 +54,13 @@ void RECORD_LAYER_clear(RECORD_LAYER *rl)
     rl->wpend_type = 0;
     rl->wpend_ret = 0;
     rl->wpend_buf = NULL;
+    rl->wiov = NULL;
+    rl->wiovcnt = 0;
+    rl->wiov_off = 0;
+    rl->wreserve = NULL;
+    rl->wreserve_len = 0;
+    rl->ktls_send = 0;
+    rl->ktls_recv = 0;
 
     SSL3_BUFFER_clear(&rl->rbuf);
     ssl3_release_write_buffer(rl->s);
@@ -268,8 +277,12 @@ int ssl3_read_n(SSL *s, size_t n, size_t max, int extend, int clearold,
         return -1;
     }
 
-    /* We always act like read_ahead is set for DTLS */
-    if (!s->rlayer.read_ahead && !SSL_IS_DTLS(s))
+    /*
+     * We always act like read_ahead is set for DTLS, and for kTLS, where the
+     * kernel returns a record at a time
+     */
+    if (!s->rlayer.read_ahead && !SSL_IS_DTLS(s)
+            && !RECORD_LAYER_get_ktls_recv(&s->rlayer))
         /* ignore max parameter */
         max = n;
     else {
@@ -303,6 +316,14 @@ int ssl3_read_n(SSL *s, size_t n, size_t max, int extend, int clearold,
         }
 
         if (ret <= 0) {
+#ifdef EBADMSG
+            if (ret < 0 && get_last_sys_error() == EBADMSG
+                    && RECORD_LAYER_get_ktls_recv(&s->rlayer)) {
+                /* The kernel received a record that did not decrypt */
+                SSLfatal(s, SSL_AD_BAD_RECORD_MAC, SSL_F_SSL3_READ_N,
+                         SSL_R_DECRYPTION_FAILED_OR_BAD_RECORD_MAC);
+            }
+#endif
             rb->left = left;
             if (s->mode & SSL_MODE_RELEASE_BUFFERS && !SSL_IS_DTLS(s))
                 if (len + left == 0)
@@ -330,6 +351,87 @@ int ssl3_read_n(SSL *s, size_t n, size_t max, int extend, int clearold,
     return 1;
 }
 
+/* Whether the payload of a write of |type| is gathered from s->rlayer.wiov */
+#define WRITE_GATHERS(s, type) \
+    ((type) == SSL3_RT_APPLICATION_DATA && (s)->rlayer.wiov != NULL)
+
+/*
+ * Copies |len| bytes of the payload of a write of |type|, from |off| bytes in,
+ * to |out|. The payload is |buf| unless WRITE_GATHERS(), in which case |buf|
+ * only identifies the write.
+ */
+static void ssl3_copy_payload(SSL *s, int type, unsigned char *out,
+                              const unsigned char *buf, size_t off, size_t len)
+{
+    const SSL_IOVEC *iov = s->rlayer.wiov;
+    size_t i, n;
+
+    if (!WRITE_GATHERS(s, type)) {
+        /* The payload may already be in place, see ssl3_write_reserve() */
+        if (out != buf + off)
+            memmove(out, buf + off, len);
+        return;
+    }
+
+    off += s->rlayer.wiov_off;
+    for (i = 0; len > 0 && i < s->rlayer.wiovcnt; i++) {
+        if (off >= iov[i].iov_len) {
+            off -= iov[i].iov_len;
+            continue;
+        }
+        n = iov[i].iov_len - off;
+        if (n > len)
+            n = len;
+        memcpy(out, (const unsigned char *)iov[i].iov_base + off, n);
+        out += n;
+        len -= n;
+        off = 0;
+    }
+}
+
+/*
+ * Writes application data through a socket BIO that the kernel makes records
+ * of (kTLS), straight from the caller's buffer. |tot| bytes of |buf| have
+ * already been written.
+ */
+static int ktls_write_bytes(SSL *s, const unsigned char *buf, size_t len,
+                            size_t tot, size_t *written)
+{
+    size_t tmpwrit;
+    int i;
+
+    for (;;) {
+        /* If we have an alert to send, lets send it */
+        if (s->s3->alert_dispatch) {
+            i = s->method->ssl_dispatch_alert(s);
+            if (i <= 0) {
+                /* SSLfatal() already called if appropriate */
+                s->rlayer.wnum = tot;
+                return i;
+            }
+        }
+
+        if (tot == len) {
+            *written = tot;
+            return 1;
+        }
+
+        clear_sys_error();
+        s->rwstate = SSL_WRITING;
+        if (!BIO_write_ex(s->wbio, &buf[tot], len - tot, &tmpwrit)) {
+            s->rlayer.wnum = tot;
+            return -1;
+        }
+        s->rwstate = SSL_NOTHING;
+        tot += tmpwrit;
+
+        if ((s->mode & SSL_MODE_ENABLE_PARTIAL_WRITE) != 0) {
+            *written = tot;
+            return 1;
+        }
+    }
+}
+
 /*
  * Call this to write data in records of type 'type' It will return <= 0 if
  * not all data has been sent or non-blocking IO.
@@ -344,7 +446,7 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
     size_t nw;
 #endif
     SSL3_BUFFER *wb = &s->rlayer.wbuf[0];
-    int i;
+    int i, gather = WRITE_GATHERS(s, type);
     size_t tmpwrit;
 
     s->rwstate = SSL_NOTHING;
@@ -402,8 +504,8 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
      */
     if (wb->left != 0) {
         /* SSLfatal() already called if appropriate */
-        i = ssl3_write_pending(s, type, &buf[tot], s->rlayer.wpend_tot,
-                               &tmpwrit);
+        i = ssl3_write_pending(s, type, gather ? buf : &buf[tot],
+                               s->rlayer.wpend_tot, &tmpwrit);
         if (i <= 0) {
             /* XXX should we ssl3_release_write_buffer if i<0? */
             s->rlayer.wnum = tot;
@@ -411,6 +513,10 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
         }
         tot += tmpwrit;               /* this might be last fragment */
     }
+
+    if (type == SSL3_RT_APPLICATION_DATA
+            && RECORD_LAYER_get_ktls_send(&s->rlayer) && !gather)
+        return ktls_write_bytes(s, buf, len, tot, written);
 #if !defined(OPENSSL_NO_MULTIBLOCK) && EVP_CIPH_FLAG_TLS1_1_MULTIBLOCK
     /*
      * Depending on platform multi-block can deliver several *times*
@@ -418,7 +524,7 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
      * jumbo buffer to accommodate up to 8 records, but the
      * compromise is considered worthy.
      */
-    if (type == SSL3_RT_APPLICATION_DATA &&
+    if (type == SSL3_RT_APPLICATION_DATA && !gather &&
         len >= 4 * (max_send_fragment = ssl_get_max_send_fragment(s)) &&
         s->compress == NULL && s->msg_callback == NULL &&
         !SSL_WRITE_ETM(s) && SSL_USE_EXPLICIT_IV(s) &&
@@ -574,7 +680,8 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
         || s->enc_write_ctx == NULL
         || !(EVP_CIPHER_flags(EVP_CIPHER_CTX_cipher(s->enc_write_ctx))
              & EVP_CIPH_FLAG_PIPELINE)
-        || !SSL_USE_EXPLICIT_IV(s))
+        || !SSL_USE_EXPLICIT_IV(s)
+        || RECORD_LAYER_get_ktls_send(&s->rlayer))
         maxpipes = 1;
     if (max_send_fragment == 0 || split_send_fragment == 0
         || split_send_fragment > max_send_fragment) {
@@ -617,8 +724,14 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
             }
         }
 
-        i = do_ssl3_write(s, type, &(buf[tot]), pipelens, numpipes, 0,
-                          &tmpwrit);
+        if (gather) {
+            /* The records pack the buffers, across their boundaries */
+            s->rlayer.wiov_off = tot;
+            i = do_ssl3_write(s, type, buf, pipelens, numpipes, 0, &tmpwrit);
+        } else {
+            i = do_ssl3_write(s, type, &(buf[tot]), pipelens, numpipes, 0,
+                              &tmpwrit);
+        }
         if (i <= 0) {
             /* SSLfatal() already called if appropriate */
             /* XXX should we ssl3_release_write_buffer if i<0? */
@@ -649,6 +762,130 @@ int ssl3_write_bytes(SSL *s, int type, const void *buf_, size_t len,
     }
 }
 
+/* The length of the explicit IV in front of the payload of a record written */
+static int ssl3_write_eivlen(SSL *s)
+{
+    int eivlen = 0;
+
+    /* Explicit IV length, block ciphers appropriate version flag */
+    if (s->enc_write_ctx && SSL_USE_EXPLICIT_IV(s) && !SSL_TREAT_AS_TLS13(s)) {
+        int mode = EVP_CIPHER_CTX_mode(s->enc_write_ctx);
+        if (mode == EVP_CIPH_CBC_MODE) {
+            /* TODO(size_t): Convert me */
+            eivlen = EVP_CIPHER_CTX_iv_length(s->enc_write_ctx);
+            if (eivlen <= 1)
+                eivlen = 0;
+        } else if (mode == EVP_CIPH_GCM_MODE) {
+            /* Need explicit part of IV for GCM mode */
+            eivlen = EVP_GCM_TLS_EXPLICIT_IV_LEN;
+        } else if (mode == EVP_CIPH_CCM_MODE) {
+            eivlen = EVP_CCM_TLS_EXPLICIT_IV_LEN;
+        }
+    }
+    return eivlen;
+}
+
+/*
+ * Hands out the part of the write buffer that do_ssl3_write() will put the
+ * payload of the next application data record in, so that the caller can
+ * write the payload there and have it encrypted in place by
+ * ssl3_write_commit(). |*len| is set to the most that the record can hold.
+ */
+int ssl3_write_reserve(SSL *s, unsigned char **buf, size_t *len)
+{
+    SSL3_BUFFER *wb = &s->rlayer.wbuf[0];
+    size_t off, max, trailer, eivlen, maxalign = 0, align = 0;
+
+    if (s->rlayer.numwpipes == 0 || SSL3_BUFFER_get_buf(wb) == NULL) {
+        if (!ssl3_setup_write_buffer(s, 1, 0)) {
+            /* SSLfatal() already called */
+            return -1;
+        }
+    }
+
+    /* At most one record, in one pipeline, see ssl3_write_bytes() */
+    max = ssl_get_split_send_fragment(s);
+    eivlen = (size_t)ssl3_write_eivlen(s);
+    if (RECORD_LAYER_get_ktls_send(&s->rlayer)) {
+        off = 0;
+        trailer = 0;
+    } else {
+#if defined(SSL3_ALIGN_PAYLOAD) && SSL3_ALIGN_PAYLOAD != 0
+        maxalign = SSL3_ALIGN_PAYLOAD - 1;
+        align = (size_t)SSL3_BUFFER_get_buf(wb) + SSL3_RT_HEADER_LENGTH;
+        align = SSL3_ALIGN_PAYLOAD - 1 - ((align - 1) % SSL3_ALIGN_PAYLOAD);
+#endif
+        if (s->s3->need_empty_fragments) {
+            /*
+             * Leave room for the longest empty fragment that can go in front.
+             * The payload is moved down behind the one actually written.
+             */
+            off = maxalign + SSL3_RT_HEADER_LENGTH
+                  + SSL3_RT_SEND_MAX_ENCRYPTED_OVERHEAD
+                  + SSL3_RT_HEADER_LENGTH + eivlen;
+        } else {
+            off = align + SSL3_RT_HEADER_LENGTH + eivlen;
+        }
+        trailer = SSL3_RT_SEND_MAX_ENCRYPTED_OVERHEAD - eivlen;
+    }
+
+    if (!ossl_assert(SSL3_BUFFER_get_len(wb) > off + trailer)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_WRITE_RESERVE,
+                 ERR_R_INTERNAL_ERROR);
+        return -1;
+    }
+    if (max > SSL3_BUFFER_get_len(wb) - off - trailer)
+        max = SSL3_BUFFER_get_len(wb) - off - trailer;
+
+    s->rlayer.wreserve = SSL3_BUFFER_get_buf(wb) + off;
+    s->rlayer.wreserve_len = max;
+    *buf = s->rlayer.wreserve;
+    *len = max;
+    return 1;
+}
+
+/*
+ * Writes the first |len| bytes of the region handed out by
+ * ssl3_write_reserve() as an application data record.
+ */
+int ssl3_write_commit(SSL *s, size_t len, size_t *written)
+{
+    unsigned char *buf = s->rlayer.wreserve;
+    uint32_t partial_write;
+    int ret;
+
+    /*
+     * A retry only finishes writing out the record. Otherwise anything that
+     * would be written ahead of the record now would go over its payload.
+     */
+    if (buf == NULL
+            || (!RECORD_LAYER_write_pending(&s->rlayer)
+                && (SSL_in_init(s)
+                    || s->s3->renegotiate
+                    || s->key_update != SSL_KEY_UPDATE_NONE
+                    || s->s3->alert_dispatch))) {
+        s->rlayer.wreserve = NULL;
+        SSLerr(SSL_F_SSL3_WRITE_COMMIT, SSL_R_NO_WRITE_RESERVED);
+        return -1;
+    }
+    if (len > s->rlayer.wreserve_len) {
+        SSLerr(SSL_F_SSL3_WRITE_COMMIT, ERR_R_PASSED_INVALID_ARGUMENT);
+        return -1;
+    }
+
+    /* The record is written whole, even when the kernel makes it (kTLS) */
+    partial_write = s->mode & SSL_MODE_ENABLE_PARTIAL_WRITE;
+    s->mode &= ~SSL_MODE_ENABLE_PARTIAL_WRITE;
+    s->rlayer.wreserve = NULL;
+    ret = s->method->ssl_write(s, buf, len, written);
+    s->mode |= partial_write;
+
+    /* A write to be retried keeps the region for the retry */
+    if (ret <= 0 && SSL_want_write(s))
+        s->rlayer.wreserve = buf;
+    return ret;
+}
+
 int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
                   size_t *pipelens, size_t numpipes,
                   int create_empty_fragment, size_t *written)
@@ -669,6 +906,10 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
 
     for (j = 0; j < numpipes; j++)
         totlen += pipelens[j];
+
+    /* This record goes over any region that ssl3_write_reserve() handed out */
+    s->rlayer.wreserve = NULL;
+
     /*
      * first check if there is a SSL3_BUFFER still being written out.  This
      * will happen with non blocking IO
@@ -698,6 +939,33 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
     if (totlen == 0 && !create_empty_fragment)
         return 0;
 
+    if (RECORD_LAYER_get_ktls_send(&s->rlayer)) {
+        /*
+         * The kernel frames and protects the record, so only its payload goes
+         * in the write buffer. Its type goes with it unless it is application
+         * data.
+         */
+        wb = &s->rlayer.wbuf[0];
+        if (!ossl_assert(numpipes == 1 && totlen <= SSL3_BUFFER_get_len(wb))) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_DO_SSL3_WRITE,
+                     ERR_R_INTERNAL_ERROR);
+            return -1;
+        }
+        ssl3_copy_payload(s, type, SSL3_BUFFER_get_buf(wb), buf, 0, totlen);
+        SSL3_BUFFER_set_offset(wb, 0);
+        SSL3_BUFFER_set_left(wb, totlen);
+        if (type != SSL3_RT_APPLICATION_DATA)
+            BIO_set_ktls_ctrl_msg(s->wbio, type);
+
+        s->rlayer.wpend_tot = totlen;
+        s->rlayer.wpend_buf = buf;
+        s->rlayer.wpend_type = type;
+        s->rlayer.wpend_ret = totlen;
+
+        /* we now just need to write the buffer */
+        return ssl3_write_pending(s, type, buf, totlen, written);
+    }
+
     sess = s->session;
 
     if ((sess == NULL) ||
@@ -804,21 +1072,7 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         }
     }
 
-    /* Explicit IV length, block ciphers appropriate version flag */
-    if (s->enc_write_ctx && SSL_USE_EXPLICIT_IV(s) && !SSL_TREAT_AS_TLS13(s)) {
-        int mode = EVP_CIPHER_CTX_mode(s->enc_write_ctx);
-        if (mode == EVP_CIPH_CBC_MODE) {
-            /* TODO(size_t): Convert me */
-            eivlen = EVP_CIPHER_CTX_iv_length(s->enc_write_ctx);
-            if (eivlen <= 1)
-                eivlen = 0;
-        } else if (mode == EVP_CIPH_GCM_MODE) {
-            /* Need explicit part of IV for GCM mode */
-            eivlen = EVP_GCM_TLS_EXPLICIT_IV_LEN;
-        } else if (mode == EVP_CIPH_CCM_MODE) {
-            eivlen = EVP_CCM_TLS_EXPLICIT_IV_LEN;
-        }
-    }
+    eivlen = ssl3_write_eivlen(s);
 
     totlen = 0;
     /* Clear our SSL3_RECORD structures */
@@ -826,7 +1080,7 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
     for (j = 0; j < numpipes; j++) {
         unsigned int version = (s->version == TLS1_3_VERSION) ? TLS1_2_VERSION
                                                               : s->version;
-        unsigned char *compressdata = NULL;
+        unsigned char *compressdata = NULL, *gathered = NULL, *payload;
         size_t maxcomplen;
         unsigned int rectype;
 
@@ -878,8 +1132,8 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
         /* lets setup the record stuff. */
         SSL3_RECORD_set_data(thiswr, compressdata);
         SSL3_RECORD_set_length(thiswr, pipelens[j]);
-        SSL3_RECORD_set_input(thiswr, (unsigned char *)&buf[totlen]);
-        totlen += pipelens[j];
+        if (!WRITE_GATHERS(s, type))
+            SSL3_RECORD_set_input(thiswr, (unsigned char *)&buf[totlen]);
 
         /*
          * we now 'read' from thiswr->input, thiswr->length bytes into
@@ -888,20 +1142,39 @@ int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
 
         /* first we compress */
         if (s->compress != NULL) {
+            /* Compression needs the payload in one piece */
+            if (WRITE_GATHERS(s, type) && pipelens[j] > 0) {
+                if ((gathered = OPENSSL_malloc(pipelens[j])) == NULL) {
+                    SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_DO_SSL3_WRITE,
+                             ERR_R_MALLOC_FAILURE);
+                    goto err;
+                }
+                ssl3_copy_payload(s, type, gathered, buf, totlen,
+                                  pipelens[j]);
+                SSL3_RECORD_set_input(thiswr, gathered);
+            }
             if (!ssl3_do_compress(s, thiswr)
                     || !WPACKET_allocate_bytes(thispkt, thiswr->length, NULL)) {
+                OPENSSL_free(gathered);
                 SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_DO_SSL3_WRITE,
                          SSL_R_COMPRESSION_FAILURE);
                 goto err;
             }
+            OPENSSL_free(gathered);
         } else {
-            if (!WPACKET_memcpy(thispkt, thiswr->input, thiswr->length)) {
-                SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_DO_SSL3_WRITE,
-                         ERR_R_INTERNAL_ERROR);
-                goto err;
+            if (thiswr->length > 0) {
+                if (!WPACKET_allocate_bytes(thispkt, thiswr->length,
+                                            &payload)) {
+                    SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_DO_SSL3_WRITE,
+                             ERR_R_INTERNAL_ERROR);
+                    goto err;
+                }
+                ssl3_copy_payload(s, type, payload, buf, totlen,
+                                  thiswr->length);
             }
             SSL3_RECORD_reset_input(&wr[j]);
         }
+        totlen += pipelens[j];
 
         if (SSL_TREAT_AS_TLS13(s)
                 && s->enc_write_ctx != NULL
@@ -160,8 +160,29 @@ typedef struct record_layer_st {
     /* number of bytes submitted */
     size_t wpend_ret;
     const unsigned char *wpend_buf;
+    /*
+     * If set, the application data being written is gathered from these
+     * buffers (SSL_writev_ex()), starting wiov_off bytes in, rather than read
+     * from the buffer passed to the write functions
+     */
+    const SSL_IOVEC *wiov;
+    size_t wiovcnt;
+    size_t wiov_off;
+    /*
+     * The part of wbuf[0] handed out by SSL_write_reserve() for the payload
+     * of the next record, and its length. Anything else written through the
+     * buffer first drops it.
+     */
+    unsigned char *wreserve;
+    size_t wreserve_len;
     unsigned char read_sequence[SEQ_NUM_SIZE];
     unsigned char write_sequence[SEQ_NUM_SIZE];
+    /*
+     * Set once the kernel has taken the keys of the records that are sent or
+     * received, see ssl_ktls_change_cipher_state()
+     */
+    unsigned int ktls_send;
+    unsigned int ktls_recv;
     /* Set to true if this is the first record in a connection */
     unsigned int is_first_record;
     /* Count of the number of consecutive warning alerts received */
@@ -190,6 +211,11 @@ typedef struct record_layer_st {
                                                 ((rl)->d->unprocessed_rcds)
 #define RECORD_LAYER_get_rbuf(rl)               (&(rl)->rbuf)
 #define RECORD_LAYER_get_wbuf(rl)               ((rl)->wbuf)
+#define RECORD_LAYER_get_ktls_send(rl)          ((rl)->ktls_send)
+#define RECORD_LAYER_get_ktls_recv(rl)          ((rl)->ktls_recv)
+#define RECORD_LAYER_set_write_iov(rl, iov, cnt) \
+                                                ((rl)->wiov = (iov), \
+                                                 (rl)->wiovcnt = (cnt))
 
 void RECORD_LAYER_init(RECORD_LAYER *rl, SSL *s);
 void RECORD_LAYER_clear(RECORD_LAYER *rl);
@@ -207,6 +233,8 @@ __owur int ssl3_write_bytes(SSL *s, int type, const void *buf, size_t len,
 int do_ssl3_write(SSL *s, int type, const unsigned char *buf,
                   size_t *pipelens, size_t numpipes,
                   int create_empty_fragment, size_t *written);
+__owur int ssl3_write_reserve(SSL *s, unsigned char **buf, size_t *len);
+__owur int ssl3_write_commit(SSL *s, size_t len, size_t *written);
 __owur int ssl3_read_bytes(SSL *s, int type, int *recvd_type,
                            unsigned char *buf, size_t len, int peek,
                            size_t *readbytes);
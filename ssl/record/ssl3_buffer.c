@@ -165,6 +165,7 @@ int ssl3_release_write_buffer(SSL *s)
         pipes--;
     }
     s->rlayer.numwpipes = 0;
+    s->rlayer.wreserve = NULL;
     return 1;
 }
 
@@ -186,6 +186,8 @@ int ssl3_get_record(SSL *s)
     size_t num_recs = 0, max_recs, j;
     PACKET pkt, sslv2pkt;
     size_t first_rec_len;
+    /* The kernel has already decrypted the records and given their type */
+    int using_ktls = RECORD_LAYER_get_ktls_recv(&s->rlayer);
 
     rr = RECORD_LAYER_get_rrec(&s->rlayer);
     rbuf = RECORD_LAYER_get_rbuf(&s->rlayer);
@@ -339,7 +341,8 @@ int ssl3_get_record(SSL *s)
                     }
                 }
 
-                if (SSL_IS_TLS13(s) && s->enc_read_ctx != NULL) {
+                if (SSL_IS_TLS13(s) && s->enc_read_ctx != NULL
+                        && !using_ktls) {
                     if (thisrr->type != SSL3_RT_APPLICATION_DATA
                             && (thisrr->type != SSL3_RT_CHANGE_CIPHER_SPEC
                                 || !SSL_IS_FIRST_HANDSHAKE(s))
@@ -526,7 +529,10 @@ int ssl3_get_record(SSL *s)
 
     first_rec_len = rr[0].length;
 
-    enc_err = s->method->ssl3_enc->enc(s, rr, num_recs, 0);
+    if (using_ktls)
+        enc_err = 1;
+    else
+        enc_err = s->method->ssl3_enc->enc(s, rr, num_recs, 0);
 
     /*-
      * enc_err is:
@@ -574,7 +580,7 @@ int ssl3_get_record(SSL *s)
 #endif
 
     /* r->length is now the compressed data plus mac */
-    if ((sess != NULL) &&
+    if ((sess != NULL) && !using_ktls &&
         (s->enc_read_ctx != NULL) &&
         (!SSL_READ_ETM(s) && EVP_MD_CTX_md(s->read_hash) != NULL)) {
         /* s->read_hash != NULL => mac_size != -1 */
@@ -697,6 +703,7 @@ int ssl3_get_record(SSL *s)
 
         if (SSL_IS_TLS13(s)
                 && s->enc_read_ctx != NULL
+                && !using_ktls
                 && thisrr->type != SSL3_RT_ALERT) {
             size_t end;
 
@@ -3377,7 +3377,6 @@ int ssl3_clear(SSL *s)
 #endif
 
     /* Clear OQS artefacts */
-    OQS_KEM_free(s->s3->tmp.oqs_kem);
     s->s3->tmp.oqs_kem = NULL;
     return 1;
 }
@@ -4713,6 +4712,7 @@ EVP_PKEY *ssl_generate_pkey_group(SSL *s, uint16_t id)
     EVP_PKEY *pkey = NULL;
     const TLS_GROUP_INFO *ginf = tls1_group_id_lookup(id);
     uint16_t gtype;
+    uint64_t phase_start = ssl_hs_phase_start(s);
 
     if (ginf == NULL) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_GENERATE_PKEY_GROUP,
@@ -4749,6 +4749,7 @@ EVP_PKEY *ssl_generate_pkey_group(SSL *s, uint16_t id)
 
  err:
     EVP_PKEY_CTX_free(pctx);
+    ssl_hs_phase_end(s, SSL_HS_PHASE_KEYGEN, phase_start);
     return pkey;
 }
 
@@ -4797,6 +4798,7 @@ int ssl_derive(SSL *s, EVP_PKEY *privkey, EVP_PKEY *pubkey, int gensecret)
     unsigned char *pms = NULL;
     size_t pmslen = 0;
     EVP_PKEY_CTX *pctx;
+    uint64_t phase_start;
 
     if (privkey == NULL || pubkey == NULL) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_DERIVE,
@@ -4820,16 +4822,15 @@ int ssl_derive(SSL *s, EVP_PKEY *privkey, EVP_PKEY *pubkey, int gensecret)
                  ERR_R_MALLOC_FAILURE);
         goto err;
     }
-	struct timespec ts_begin;
-	timespec_get(&ts_begin, TIME_UTC);
+
+    phase_start = ssl_hs_phase_start(s);
     if (EVP_PKEY_derive(pctx, pms, &pmslen) <= 0) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_DERIVE,
                  ERR_R_INTERNAL_ERROR);
         goto err;
     }
-	struct timespec ts_end;
-    timespec_get(&ts_end, TIME_UTC);
-	printf("%ld,", ts_end.tv_nsec-ts_begin.tv_nsec);
+    ssl_hs_phase_end(s, SSL_HS_PHASE_DERIVE, phase_start);
+
     if (gensecret) {
         /* SSLfatal() called as appropriate in the below functions */
         if (SSL_IS_TLS13(s)) {
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * SSL_sendfile() sends part of a file as application data.
+ *
+ * Once the kernel makes the records of the connection (kTLS), sendfile()
+ * hands it the pages of the file, and they never reach user space. Otherwise
+ * the file is read with pread() straight into the payload of the next record
+ * in the write buffer, see ssl3_write_reserve(), rather than into a buffer of
+ * the caller's that is then copied. A file that is truncated meanwhile just
+ * ends the transfer early.
+ */
+
+#include "e_os.h"
+#include "ssl_local.h"
+#include "internal/ktls.h"
+
+#ifdef OPENSSL_SYS_UNIX
+# include <unistd.h>
+
+# ifndef OPENSSL_NO_KTLS
+static ossl_ssize_t sendfile_ktls(SSL *s, int fd, off_t offset, size_t size)
+{
+    ossl_ssize_t ret;
+    int i;
+
+    /* If we have an alert to send, lets send it */
+    if (s->s3->alert_dispatch) {
+        i = s->method->ssl_dispatch_alert(s);
+        if (i <= 0) {
+            /* SSLfatal() already called if appropriate */
+            return -1;
+        }
+    }
+
+    s->rwstate = SSL_WRITING;
+    BIO_clear_retry_flags(s->wbio);
+    clear_sys_error();
+    ret = ktls_sendfile(SSL_get_wfd(s), fd, offset, size);
+    if (ret < 0) {
+        if (BIO_sock_should_retry((int)ret)) {
+            BIO_set_retry_write(s->wbio);
+        } else {
+            s->rwstate = SSL_NOTHING;
+            SYSerr(SYS_F_SENDFILE, get_last_sys_error());
+            SSLerr(SSL_F_SSL_SENDFILE, ERR_R_SYS_LIB);
+        }
+        return -1;
+    }
+    s->rwstate = SSL_NOTHING;
+    return ret;
+}
+# endif
+
+static ossl_ssize_t sendfile_pread(int fd, unsigned char *buf, size_t len,
+                                   off_t offset)
+{
+    ossl_ssize_t ret;
+
+    do {
+        clear_sys_error();
+        ret = pread(fd, buf, len, offset);
+    } while (ret < 0 && get_last_sys_error() == EINTR);
+    if (ret < 0) {
+        SYSerr(SYS_F_PREAD, get_last_sys_error());
+        SSLerr(SSL_F_SSL_SENDFILE, ERR_R_SYS_LIB);
+    }
+    return ret;
+}
+
+/*
+ * Sends one record's worth of the file through a copy, for the connections
+ * whose records are not made in place: DTLS, compression, a handshake still
+ * in progress or a write to be retried that was not reserved.
+ */
+static ossl_ssize_t sendfile_copy(SSL *s, int fd, off_t offset, size_t size)
+{
+    const uint32_t modes = SSL_MODE_ENABLE_PARTIAL_WRITE
+                           | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER;
+    uint32_t oldmode = s->mode & modes;
+    unsigned char *buf;
+    size_t written;
+    ossl_ssize_t n;
+    int ret;
+
+    if (size > ssl_get_max_send_fragment(s))
+        size = ssl_get_max_send_fragment(s);
+    if ((buf = OPENSSL_malloc(size)) == NULL) {
+        SSLerr(SSL_F_SSL_SENDFILE, ERR_R_MALLOC_FAILURE);
+        return -1;
+    }
+    n = sendfile_pread(fd, buf, size, offset);
+    if (n <= 0) {
+        OPENSSL_free(buf);
+        return n;
+    }
+
+    /* A write that has to be retried is retried from another copy */
+    s->mode |= modes;
+    ret = s->method->ssl_write(s, buf, (size_t)n, &written);
+    s->mode = (s->mode & ~modes) | oldmode;
+    OPENSSL_free(buf);
+
+    return ret > 0 ? (ossl_ssize_t)written : -1;
+}
+
+static ossl_ssize_t sendfile_read(SSL *s, int fd, off_t offset, size_t size)
+{
+    unsigned char *buf;
+    size_t sent = 0, len, written;
+    ossl_ssize_t n;
+    int ret = 1;
+
+    /*
+     * A record to be retried was read from the file already, and the caller
+     * retries from the offset it was read from.
+     */
+    if (RECORD_LAYER_write_pending(&s->rlayer) && s->rlayer.wreserve != NULL) {
+        if (ssl3_write_commit(s, s->rlayer.wpend_tot, &written) <= 0)
+            return -1;
+        return (ossl_ssize_t)written;
+    }
+
+    if (SSL_IS_DTLS(s) || SSL_in_init(s) || s->compress != NULL
+            || RECORD_LAYER_write_pending(&s->rlayer))
+        return sendfile_copy(s, fd, offset, size);
+
+    while (sent < size && ret > 0) {
+        if (!SSL_write_reserve(s, &buf, &len)) {
+            ret = -1;
+            break;
+        }
+        if (len > size - sent)
+            len = size - sent;
+        n = sendfile_pread(fd, buf, len, offset + (off_t)sent);
+        if (n <= 0) {
+            ret = (int)n;
+            break;
+        }
+        ret = ssl3_write_commit(s, (size_t)n, &written);
+        if (ret > 0)
+            sent += written;
+    }
+
+    if (sent > 0)
+        return (ossl_ssize_t)sent;
+    return ret >= 0 ? 0 : -1;
+}
+
+ossl_ssize_t SSL_sendfile(SSL *s, int fd, off_t offset, size_t size, int flags)
+{
+    if (s->handshake_func == NULL) {
+        SSLerr(SSL_F_SSL_SENDFILE, SSL_R_UNINITIALIZED);
+        return -1;
+    }
+
+    if (s->shutdown & SSL_SENT_SHUTDOWN) {
+        s->rwstate = SSL_NOTHING;
+        SSLerr(SSL_F_SSL_SENDFILE, SSL_R_PROTOCOL_IS_SHUTDOWN);
+        return -1;
+    }
+
+    if (flags != 0 || offset < 0) {
+        SSLerr(SSL_F_SSL_SENDFILE, ERR_R_PASSED_INVALID_ARGUMENT);
+        return -1;
+    }
+
+    if (s->early_data_state == SSL_EARLY_DATA_CONNECT_RETRY
+                || s->early_data_state == SSL_EARLY_DATA_ACCEPT_RETRY
+                || s->early_data_state == SSL_EARLY_DATA_READ_RETRY) {
+        SSLerr(SSL_F_SSL_SENDFILE, ERR_R_SHOULD_NOT_HAVE_BEEN_CALLED);
+        return -1;
+    }
+
+    if (size == 0)
+        return 0;
+    if (size > (size_t)OSSL_SSIZE_MAX)
+        size = (size_t)OSSL_SSIZE_MAX;
+
+    /* If we are a client and haven't sent the Finished we better do that */
+    ossl_statem_check_finish_init(s, 1);
+
+# ifndef OPENSSL_NO_KTLS
+    /*
+     * The kernel can only take the file once the handshake, and any record
+     * still being written, are done.
+     */
+    if (RECORD_LAYER_get_ktls_send(&s->rlayer)
+            && !SSL_in_init(s)
+            && s->key_update == SSL_KEY_UPDATE_NONE
+            && s->rlayer.wnum == 0
+            && !RECORD_LAYER_write_pending(&s->rlayer))
+        return sendfile_ktls(s, fd, offset, size);
+# endif
+    return sendfile_read(s, fd, offset, size);
+}
+#else
+NON_EMPTY_TRANSLATION_UNIT
+#endif
@@ -74,7 +74,7 @@ CERT *ssl_cert_new(void)
 CERT *ssl_cert_dup(CERT *cert)
 {
     CERT *ret = OPENSSL_zalloc(sizeof(*ret));
-    int i;
+    int i, ref;
 
     if (ret == NULL) {
         SSLerr(SSL_F_SSL_CERT_DUP, ERR_R_MALLOC_FAILURE);
@@ -111,6 +111,12 @@ CERT *ssl_cert_dup(CERT *cert)
             EVP_PKEY_up_ref(cpk->privatekey);
         }
 
+        if (cpk->der_cache != NULL) {
+            rpk->der_cache = cpk->der_cache;
+            CRYPTO_UP_REF(&rpk->der_cache->references, &ref,
+                          rpk->der_cache->lock);
+        }
+
         if (cpk->chain) {
             rpk->chain = X509_chain_up_ref(cpk->chain);
             if (!rpk->chain) {
@@ -216,6 +222,8 @@ void ssl_cert_clear_certs(CERT *c)
         OPENSSL_free(cpk->serverinfo);
         cpk->serverinfo = NULL;
         cpk->serverinfo_length = 0;
+        ssl_cert_der_cache_free(cpk->der_cache);
+        cpk->der_cache = NULL;
     }
 }
 
@@ -367,6 +375,7 @@ int ssl_verify_cert_chain(SSL *s, STACK_OF(X509) *sk)
     X509_STORE *verify_store;
     X509_STORE_CTX *ctx = NULL;
     X509_VERIFY_PARAM *param;
+    uint64_t phase_start;
 
     if ((sk == NULL) || (sk_X509_num(sk) == 0))
         return 0;
@@ -421,10 +430,12 @@ int ssl_verify_cert_chain(SSL *s, STACK_OF(X509) *sk)
     if (s->verify_callback)
         X509_STORE_CTX_set_verify_cb(ctx, s->verify_callback);
 
+    phase_start = ssl_hs_phase_start(s);
     if (s->ctx->app_verify_callback != NULL)
         i = s->ctx->app_verify_callback(ctx, s->ctx->app_verify_arg);
     else
         i = X509_verify_cert(ctx);
+    ssl_hs_phase_end(s, SSL_HS_PHASE_CHAIN, phase_start);
 
     s->verify_result = X509_STORE_CTX_get_error(ctx);
     sk_X509_pop_free(s->verified_chain, X509_free);
@@ -484,6 +495,7 @@ void SSL_set0_CA_list(SSL *s, STACK_OF(X509_NAME) *name_list)
 void SSL_CTX_set0_CA_list(SSL_CTX *ctx, STACK_OF(X509_NAME) *name_list)
 {
     set0_CA_list(&ctx->ca_names, name_list);
+    ssl_ca_names_der_clear(ctx);
 }
 
 const STACK_OF(X509_NAME) *SSL_CTX_get0_CA_list(const SSL_CTX *ctx)
@@ -499,6 +511,7 @@ const STACK_OF(X509_NAME) *SSL_get0_CA_list(const SSL *s)
 void SSL_CTX_set_client_CA_list(SSL_CTX *ctx, STACK_OF(X509_NAME) *name_list)
 {
     set0_CA_list(&ctx->client_ca_names, name_list);
+    ssl_ca_names_der_clear(ctx);
 }
 
 STACK_OF(X509_NAME) *SSL_CTX_get_client_CA_list(const SSL_CTX *ctx)
@@ -550,6 +563,7 @@ int SSL_add1_to_CA_list(SSL *ssl, const X509 *x)
 
 int SSL_CTX_add1_to_CA_list(SSL_CTX *ctx, const X509 *x)
 {
+    ssl_ca_names_der_clear(ctx);
     return add_ca_name(&ctx->ca_names, x);
 }
 
@@ -564,6 +578,7 @@ int SSL_add_client_CA(SSL *ssl, X509 *x)
 
 int SSL_CTX_add_client_CA(SSL_CTX *ctx, X509 *x)
 {
+    ssl_ca_names_der_clear(ctx);
     return add_ca_name(&ctx->client_ca_names, x);
 }
 
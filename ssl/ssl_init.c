@@ -155,6 +155,13 @@ static void ssl_library_stop(void)
                 "ssl_comp_free_compression_methods_int()\n");
 # endif
         ssl_comp_free_compression_methods_int();
+#endif
+#ifndef OPENSSL_NO_EC
+# ifdef OPENSSL_INIT_DEBUG
+        fprintf(stderr, "OPENSSL_INIT: ssl_library_stop: "
+                "ssl_oqs_kem_registry_cleanup_int()\n");
+# endif
+        ssl_oqs_kem_registry_cleanup_int();
 #endif
     }
 
@@ -712,6 +712,8 @@ SSL *SSL_new(SSL_CTX *ctx)
     s->recv_max_early_data = ctx->recv_max_early_data;
     s->num_tickets = ctx->num_tickets;
     s->pha_enabled = ctx->pha_enabled;
+    memcpy(s->cert_comp_prefs, ctx->cert_comp_prefs,
+           sizeof(s->cert_comp_prefs));
 
     /* Shallow copy of the ciphersuites stack */
     s->tls13_ciphersuites = sk_SSL_CIPHER_dup(ctx->tls13_ciphersuites);
@@ -1160,6 +1162,7 @@ void SSL_free(SSL *s)
     BIO_free_all(s->rbio);
 
     BUF_MEM_free(s->init_buf);
+    ossl_statem_free(s);
 
     /* add extra stuff */
     sk_SSL_CIPHER_free(s->cipher_list);
@@ -1200,6 +1203,8 @@ void SSL_free(SSL *s)
     OPENSSL_free(s->ext.ocsp.resp);
     OPENSSL_free(s->ext.alpn);
     OPENSSL_free(s->ext.tls13_cookie);
+    OPENSSL_free(s->ext.cached_info_chain);
+    ssl_hs_timing_free(s->hs_timing);
     if (s->clienthello != NULL)
         OPENSSL_free(s->clienthello->pre_proc_exts);
     OPENSSL_free(s->clienthello);
@@ -1795,6 +1800,38 @@ int SSL_read_ex(SSL *s, void *buf, size_t num, size_t *readbytes)
     return ret;
 }
 
+int SSL_readv_ex(SSL *s, const SSL_IOVEC *iov, size_t iovcnt,
+                 size_t *readbytes)
+{
+    size_t i = 0, off, n;
+
+    /* Wait for data, as SSL_read_ex() does, only for the first buffer */
+    while (i + 1 < iovcnt && iov[i].iov_len == 0)
+        i++;
+    if (ssl_read_internal(s, iovcnt > 0 ? iov[i].iov_base : NULL,
+                          iovcnt > 0 ? iov[i].iov_len : 0, &n) <= 0)
+        return 0;
+    *readbytes = off = n;
+
+    /*
+     * Whatever is left of the records already decrypted is copied straight
+     * into the buffers that follow
+     */
+    while (SSL_pending(s) > 0) {
+        while (i < iovcnt && off == iov[i].iov_len) {
+            i++;
+            off = 0;
+        }
+        if (i == iovcnt
+                || ssl_read_internal(s, (unsigned char *)iov[i].iov_base + off,
+                                     iov[i].iov_len - off, &n) <= 0)
+            break;
+        off += n;
+        *readbytes += n;
+    }
+    return 1;
+}
+
 int SSL_read_early_data(SSL *s, void *buf, size_t num, size_t *readbytes)
 {
     int ret;
@@ -1986,6 +2023,93 @@ int SSL_write_ex(SSL *s, const void *buf, size_t num, size_t *written)
     return ret;
 }
 
+int SSL_writev_ex(SSL *s, const SSL_IOVEC *iov, size_t iovcnt,
+                  size_t *written)
+{
+    size_t i, num = 0;
+    int ret;
+
+    if (SSL_IS_DTLS(s)) {
+        SSLerr(SSL_F_SSL_WRITEV_EX, ERR_R_SHOULD_NOT_HAVE_BEEN_CALLED);
+        return 0;
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len > SIZE_MAX - num) {
+            SSLerr(SSL_F_SSL_WRITEV_EX, ERR_R_PASSED_INVALID_ARGUMENT);
+            return 0;
+        }
+        num += iov[i].iov_len;
+    }
+
+    /*
+     * The record layer fills each record from the buffers in turn, and only
+     * uses |iov| itself to check that a retry is the same write
+     */
+    RECORD_LAYER_set_write_iov(&s->rlayer, iov, iovcnt);
+    ret = ssl_write_internal(s, iov, num, written);
+    RECORD_LAYER_set_write_iov(&s->rlayer, NULL, 0);
+
+    if (ret < 0)
+        ret = 0;
+    return ret;
+}
+
+int SSL_write_reserve(SSL *s, unsigned char **buf, size_t *len)
+{
+    size_t written;
+
+    if (s->handshake_func == NULL) {
+        SSLerr(SSL_F_SSL_WRITE_RESERVE, SSL_R_UNINITIALIZED);
+        return 0;
+    }
+
+    if (s->shutdown & SSL_SENT_SHUTDOWN) {
+        s->rwstate = SSL_NOTHING;
+        SSLerr(SSL_F_SSL_WRITE_RESERVE, SSL_R_PROTOCOL_IS_SHUTDOWN);
+        return 0;
+    }
+
+    if (SSL_IS_DTLS(s)) {
+        SSLerr(SSL_F_SSL_WRITE_RESERVE, ERR_R_SHOULD_NOT_HAVE_BEEN_CALLED);
+        return 0;
+    }
+
+    /* An earlier write has to be finished first */
+    if (RECORD_LAYER_write_pending(&s->rlayer)) {
+        SSLerr(SSL_F_SSL_WRITE_RESERVE, SSL_R_BAD_WRITE_RETRY);
+        return 0;
+    }
+
+    /*
+     * Send whatever would otherwise be sent ahead of the record, and so be
+     * written over the region handed out: the rest of the handshake, a
+     * KeyUpdate or a pending alert.
+     */
+    if (s->s3->alert_dispatch && s->method->ssl_dispatch_alert(s) <= 0)
+        return 0;
+    if (ssl_write_internal(s, NULL, 0, &written) <= 0)
+        return 0;
+
+    /* Compressed records are not made in place */
+    if (SSL_in_init(s) || s->compress != NULL) {
+        SSLerr(SSL_F_SSL_WRITE_RESERVE, ERR_R_SHOULD_NOT_HAVE_BEEN_CALLED);
+        return 0;
+    }
+
+    return ssl3_write_reserve(s, buf, len) > 0;
+}
+
+int SSL_write_commit(SSL *s, size_t len, size_t *written)
+{
+    if (s->handshake_func == NULL) {
+        SSLerr(SSL_F_SSL_WRITE_COMMIT, SSL_R_UNINITIALIZED);
+        return 0;
+    }
+
+    return ssl3_write_commit(s, len, written) > 0;
+}
+
 int SSL_write_early_data(SSL *s, const void *buf, size_t num, size_t *written)
 {
     int ret, early_data_state;
@@ -3220,6 +3344,14 @@ void SSL_CTX_free(SSL_CTX *a)
 #endif
     OPENSSL_free(a->ext.alpn);
     OPENSSL_secure_free(a->ext.secure);
+    oqs_kem_pool_free(a->oqs_kem_pool);
+    key_share_cache_free(a->key_share_cache);
+    cert_comp_cache_free(a->cert_comp_cache);
+    cached_info_cache_free(a->cached_info_cache);
+    cached_info_hashes_free(a);
+    ca_names_der_cache_free(a);
+    cost_table_free(a->cost_table);
+    hs_timing_stats_free(a->hs_timing_stats);
 
     CRYPTO_THREAD_lock_free(a->lock);
 
@@ -3832,6 +3964,8 @@ SSL *SSL_dup(SSL *s)
     ret->min_proto_version = s->min_proto_version;
     ret->max_proto_version = s->max_proto_version;
     ret->mode = s->mode;
+    memcpy(ret->cert_comp_prefs, s->cert_comp_prefs,
+           sizeof(ret->cert_comp_prefs));
     SSL_set_max_cert_list(ret, SSL_get_max_cert_list(s));
     SSL_set_read_ahead(ret, SSL_get_read_ahead(s));
     ret->msg_callback = s->msg_callback;
@@ -3971,6 +4105,10 @@ int ssl_init_wbio_buffer(SSL *s)
         /* Already buffered. */
         return 1;
     }
+    if (RECORD_LAYER_get_ktls_send(&s->rlayer)) {
+        /* The kernel sends each record as it is written */
+        return 1;
+    }
 
     bbio = BIO_new(BIO_f_buffer());
     if (bbio == NULL || !BIO_set_read_buffer_size(bbio, 1)) {
@@ -3978,6 +4116,21 @@ int ssl_init_wbio_buffer(SSL *s)
         SSLerr(SSL_F_SSL_INIT_WBIO_BUFFER, ERR_R_BUF_LIB);
         return 0;
     }
+    if ((s->mode & SSL_MODE_COALESCE_FLIGHTS) != 0) {
+        size_t size = 0;
+
+        /* Make room for a whole flight so that it goes in one write */
+        if (CRYPTO_THREAD_read_lock(s->ctx->lock)) {
+            size = s->ctx->flight_buffer_size;
+            CRYPTO_THREAD_unlock(s->ctx->lock);
+        }
+        if (size > 0 && size <= INT_MAX
+                && !BIO_set_write_buffer_size(bbio, (long)size)) {
+            BIO_free(bbio);
+            SSLerr(SSL_F_SSL_INIT_WBIO_BUFFER, ERR_R_BUF_LIB);
+            return 0;
+        }
+    }
     s->bbio = bbio;
     s->wbio = BIO_push(bbio, s->wbio);
 
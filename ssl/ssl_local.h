@@ -495,285 +495,20 @@
 #define CERT_PRIVATE_KEY        2
 */
 
-/* Returns the curve ID for an OQS KEM NID */
-///// OQS_TEMPLATE_FRAGMENT_OQS_KEM_CURVEID_START
-#define OQS_KEM_CURVEID(nid) \
-  (nid == NID_oqs_kem_default ? 0x01FF : \
-  (nid == NID_frodo640aes ? 0x0200 : \
-  (nid == NID_frodo640shake ? 0x0201 : \
-  (nid == NID_frodo976aes ? 0x0202 : \
-  (nid == NID_frodo976shake ? 0x0203 : \
-  (nid == NID_frodo1344aes ? 0x0204 : \
-  (nid == NID_frodo1344shake ? 0x0205 : \
-  (nid == NID_bike1l1cpa ? 0x0206 : \
-  (nid == NID_bike1l3cpa ? 0x0207 : \
-  (nid == NID_bike1l1fo ? 0x0223 : \
-  (nid == NID_bike1l3fo ? 0x0224 : \
-  (nid == NID_kyber512 ? 0x020F : \
-  (nid == NID_kyber768 ? 0x0210 : \
-  (nid == NID_kyber1024 ? 0x0211 : \
-  (nid == NID_ntru_hps2048509 ? 0x0214 : \
-  (nid == NID_ntru_hps2048677 ? 0x0215 : \
-  (nid == NID_ntru_hps4096821 ? 0x0216 : \
-  (nid == NID_ntru_hrss701 ? 0x0217 : \
-  (nid == NID_lightsaber ? 0x0218 : \
-  (nid == NID_saber ? 0x0219 : \
-  (nid == NID_firesaber ? 0x021A : \
-  (nid == NID_sidhp434 ? 0x021B : \
-  (nid == NID_sidhp503 ? 0x021C : \
-  (nid == NID_sidhp610 ? 0x021D : \
-  (nid == NID_sidhp751 ? 0x021E : \
-  (nid == NID_sikep434 ? 0x021F : \
-  (nid == NID_sikep503 ? 0x0220 : \
-  (nid == NID_sikep610 ? 0x0221 : \
-  (nid == NID_sikep751 ? 0x0222 : \
-  (nid == NID_kyber90s512 ? 0x0229 : \
-  (nid == NID_kyber90s768 ? 0x022A : \
-  (nid == NID_kyber90s1024 ? 0x022B : \
-  (nid == NID_hqc128_1_cca2 ? 0x0232 : \
-  (nid == NID_hqc192_1_cca2 ? 0x0233 : \
-  (nid == NID_hqc192_2_cca2 ? 0x0234 : \
-  (nid == NID_hqc256_1_cca2 ? 0x0235 : \
-  (nid == NID_hqc256_2_cca2 ? 0x0236 : \
-  (nid == NID_hqc256_3_cca2 ? 0x0237 : \
-  0 \
-  ))))))))))))))))))))))))))))))))))))))
-///// OQS_TEMPLATE_FRAGMENT_OQS_KEM_CURVEID_END
-
-///// OQS_TEMPLATE_FRAGMENT_OQS_KEM_HYBRID_CURVEID_START
-#define OQS_KEM_HYBRID_CURVEID(nid) \
-  (nid == NID_p256_oqs_kem_default      ? 0x2FFF : \
-    (nid == NID_p256_frodo640aes ? 0x2F00 : \
-    (nid == NID_p256_frodo640shake ? 0x2F01 : \
-    (nid == NID_p384_frodo976aes ? 0x2F02 : \
-    (nid == NID_p384_frodo976shake ? 0x2F03 : \
-    (nid == NID_p521_frodo1344aes ? 0x2F04 : \
-    (nid == NID_p521_frodo1344shake ? 0x2F05 : \
-    (nid == NID_p256_bike1l1cpa ? 0x2F06 : \
-    (nid == NID_p384_bike1l3cpa ? 0x2F07 : \
-    (nid == NID_p256_bike1l1fo ? 0x2F23 : \
-    (nid == NID_p384_bike1l3fo ? 0x2F24 : \
-    (nid == NID_p256_kyber512 ? 0x2F0F : \
-    (nid == NID_p384_kyber768 ? 0x2F10 : \
-    (nid == NID_p521_kyber1024 ? 0x2F11 : \
-    (nid == NID_p256_ntru_hps2048509 ? 0x2F14 : \
-    (nid == NID_p384_ntru_hps2048677 ? 0x2F15 : \
-    (nid == NID_p521_ntru_hps4096821 ? 0x2F16 : \
-    (nid == NID_p384_ntru_hrss701 ? 0x2F17 : \
-    (nid == NID_p256_lightsaber ? 0x2F18 : \
-    (nid == NID_p384_saber ? 0x2F19 : \
-    (nid == NID_p521_firesaber ? 0x2F1A : \
-    (nid == NID_p256_sidhp434 ? 0x2F1B : \
-    (nid == NID_p256_sidhp503 ? 0x2F1C : \
-    (nid == NID_p384_sidhp610 ? 0x2F1D : \
-    (nid == NID_p521_sidhp751 ? 0x2F1E : \
-    (nid == NID_p256_sikep434 ? 0x2F1F : \
-    (nid == NID_p256_sikep503 ? 0x2F20 : \
-    (nid == NID_p384_sikep610 ? 0x2F21 : \
-    (nid == NID_p521_sikep751 ? 0x2F22 : \
-    (nid == NID_p256_kyber90s512 ? 0x2F29 : \
-    (nid == NID_p384_kyber90s768 ? 0x2F2A : \
-    (nid == NID_p521_kyber90s1024 ? 0x2F2B : \
-    (nid == NID_p256_hqc128_1_cca2 ? 0x2F32 : \
-    (nid == NID_p384_hqc192_1_cca2 ? 0x2F33 : \
-    (nid == NID_p384_hqc192_2_cca2 ? 0x2F34 : \
-    (nid == NID_p521_hqc256_1_cca2 ? 0x2F35 : \
-    (nid == NID_p521_hqc256_2_cca2 ? 0x2F36 : \
-    (nid == NID_p521_hqc256_3_cca2 ? 0x2F37 : \
-  0 \
-  ))))))))))))))))))))))))))))))))))))))
-///// OQS_TEMPLATE_FRAGMENT_OQS_KEM_HYBRID_CURVEID_END
-
-  /* Returns the non-hybrid OQS KEM NID for a PQ or hybrid curve ID */
-///// OQS_TEMPLATE_FRAGMENT_OQS_KEM_NID_START
-#define OQS_KEM_NID(curveID) \
-  (curveID == 0x01FF || curveID == 0x2FFF ? NID_oqs_kem_default : \
-  (curveID == 0x0200 || curveID == 0x2F00 ? NID_frodo640aes : \
-  (curveID == 0x0201 || curveID == 0x2F01 ? NID_frodo640shake : \
-  (curveID == 0x0202 || curveID == 0x2F02 ? NID_frodo976aes : \
-  (curveID == 0x0203 || curveID == 0x2F03 ? NID_frodo976shake : \
-  (curveID == 0x0204 || curveID == 0x2F04 ? NID_frodo1344aes : \
-  (curveID == 0x0205 || curveID == 0x2F05 ? NID_frodo1344shake : \
-  (curveID == 0x0206 || curveID == 0x2F06 ? NID_bike1l1cpa : \
-  (curveID == 0x0207 || curveID == 0x2F07 ? NID_bike1l3cpa : \
-  (curveID == 0x0223 || curveID == 0x2F23 ? NID_bike1l1fo : \
-  (curveID == 0x0224 || curveID == 0x2F24 ? NID_bike1l3fo : \
-  (curveID == 0x020F || curveID == 0x2F0F ? NID_kyber512 : \
-  (curveID == 0x0210 || curveID == 0x2F10 ? NID_kyber768 : \
-  (curveID == 0x0211 || curveID == 0x2F11 ? NID_kyber1024 : \
-  (curveID == 0x0214 || curveID == 0x2F14 ? NID_ntru_hps2048509 : \
-  (curveID == 0x0215 || curveID == 0x2F15 ? NID_ntru_hps2048677 : \
-  (curveID == 0x0216 || curveID == 0x2F16 ? NID_ntru_hps4096821 : \
-  (curveID == 0x0217 || curveID == 0x2F17 ? NID_ntru_hrss701 : \
-  (curveID == 0x0218 || curveID == 0x2F18 ? NID_lightsaber : \
-  (curveID == 0x0219 || curveID == 0x2F19 ? NID_saber : \
-  (curveID == 0x021A || curveID == 0x2F1A ? NID_firesaber : \
-  (curveID == 0x021B || curveID == 0x2F1B ? NID_sidhp434 : \
-  (curveID == 0x021C || curveID == 0x2F1C ? NID_sidhp503 : \
-  (curveID == 0x021D || curveID == 0x2F1D ? NID_sidhp610 : \
-  (curveID == 0x021E || curveID == 0x2F1E ? NID_sidhp751 : \
-  (curveID == 0x021F || curveID == 0x2F1F ? NID_sikep434 : \
-  (curveID == 0x0220 || curveID == 0x2F20 ? NID_sikep503 : \
-  (curveID == 0x0221 || curveID == 0x2F21 ? NID_sikep610 : \
-  (curveID == 0x0222 || curveID == 0x2F22 ? NID_sikep751 : \
-  (curveID == 0x0229 || curveID == 0x2F29 ? NID_kyber90s512 : \
-  (curveID == 0x022A || curveID == 0x2F2A ? NID_kyber90s768 : \
-  (curveID == 0x022B || curveID == 0x2F2B ? NID_kyber90s1024 : \
-  (curveID == 0x0232 || curveID == 0x2F32 ? NID_hqc128_1_cca2 : \
-  (curveID == 0x0233 || curveID == 0x2F33 ? NID_hqc192_1_cca2 : \
-  (curveID == 0x0234 || curveID == 0x2F34 ? NID_hqc192_2_cca2 : \
-  (curveID == 0x0235 || curveID == 0x2F35 ? NID_hqc256_1_cca2 : \
-  (curveID == 0x0236 || curveID == 0x2F36 ? NID_hqc256_2_cca2 : \
-  (curveID == 0x0237 || curveID == 0x2F37 ? NID_hqc256_3_cca2 : \
-  0 \
-  ))))))))))))))))))))))))))))))))))))))
-///// OQS_TEMPLATE_FRAGMENT_OQS_KEM_NID_END
-
-  /* Returns the hybrid OQS KEM NID for a hybrid curve ID */
-///// OQS_TEMPLATE_FRAGMENT_OQS_HYBRID_KEM_NID_START
-#define OQS_HYBRID_KEM_NID(curveID) \
-  (curveID == 0x2FFF ? NID_p256_oqs_kem_default : \
-    (curveID == 0x2F00 ? NID_p256_frodo640aes : \
-    (curveID == 0x2F01 ? NID_p256_frodo640shake : \
-    (curveID == 0x2F02 ? NID_p384_frodo976aes : \
-    (curveID == 0x2F03 ? NID_p384_frodo976shake : \
-    (curveID == 0x2F04 ? NID_p521_frodo1344aes : \
-    (curveID == 0x2F05 ? NID_p521_frodo1344shake : \
-    (curveID == 0x2F06 ? NID_p256_bike1l1cpa : \
-    (curveID == 0x2F07 ? NID_p384_bike1l3cpa : \
-    (curveID == 0x2F23 ? NID_p256_bike1l1fo : \
-    (curveID == 0x2F24 ? NID_p384_bike1l3fo : \
-    (curveID == 0x2F0F ? NID_p256_kyber512 : \
-    (curveID == 0x2F10 ? NID_p384_kyber768 : \
-    (curveID == 0x2F11 ? NID_p521_kyber1024 : \
-    (curveID == 0x2F14 ? NID_p256_ntru_hps2048509 : \
-    (curveID == 0x2F15 ? NID_p384_ntru_hps2048677 : \
-    (curveID == 0x2F16 ? NID_p521_ntru_hps4096821 : \
-    (curveID == 0x2F17 ? NID_p384_ntru_hrss701 : \
-    (curveID == 0x2F18 ? NID_p256_lightsaber : \
-    (curveID == 0x2F19 ? NID_p384_saber : \
-    (curveID == 0x2F1A ? NID_p521_firesaber : \
-    (curveID == 0x2F1B ? NID_p256_sidhp434 : \
-    (curveID == 0x2F1C ? NID_p256_sidhp503 : \
-    (curveID == 0x2F1D ? NID_p384_sidhp610 : \
-    (curveID == 0x2F1E ? NID_p521_sidhp751 : \
-    (curveID == 0x2F1F ? NID_p256_sikep434 : \
-    (curveID == 0x2F20 ? NID_p256_sikep503 : \
-    (curveID == 0x2F21 ? NID_p384_sikep610 : \
-    (curveID == 0x2F22 ? NID_p521_sikep751 : \
-    (curveID == 0x2F29 ? NID_p256_kyber90s512 : \
-    (curveID == 0x2F2A ? NID_p384_kyber90s768 : \
-    (curveID == 0x2F2B ? NID_p521_kyber90s1024 : \
-    (curveID == 0x2F32 ? NID_p256_hqc128_1_cca2 : \
-    (curveID == 0x2F33 ? NID_p384_hqc192_1_cca2 : \
-    (curveID == 0x2F34 ? NID_p384_hqc192_2_cca2 : \
-    (curveID == 0x2F35 ? NID_p521_hqc256_1_cca2 : \
-    (curveID == 0x2F36 ? NID_p521_hqc256_2_cca2 : \
-    (curveID == 0x2F37 ? NID_p521_hqc256_3_cca2 : \
-  0 \
-  ))))))))))))))))))))))))))))))))))))))
-///// OQS_TEMPLATE_FRAGMENT_OQS_HYBRID_KEM_NID_END
+/* TLS group id ranges reserved for the OQS KEM groups */
+#define OQS_KEM_GROUP_ID_FIRST          0x01FF
+#define OQS_KEM_GROUP_ID_LAST           0x0250
+#define OQS_KEM_HYBRID_GROUP_ID_FIRST   0x2F00
+#define OQS_KEM_HYBRID_GROUP_ID_LAST    0x2FFF
 
 /* Returns true if the curve ID is for an OQS KEM */
-// TBD, ideally, this bracket is also generated
-#define IS_OQS_KEM_CURVEID(id) (id >= 0x01FF && id <= 0x0250)
+#define IS_OQS_KEM_CURVEID(id) \
+    ((id) >= OQS_KEM_GROUP_ID_FIRST && (id) <= OQS_KEM_GROUP_ID_LAST)
 
 /* Returns true if the curve ID is for an OQS hybrid KEM */
-// TBD, ideally, this bracket is also generated
-#define IS_OQS_KEM_HYBRID_CURVEID(id) (id >= 0x2F00 && id <= 0x2FFF)
-
-/* Returns the OQS alg ID for OQS API */
-///// OQS_TEMPLATE_FRAGMENT_OQS_ALG_NAME_START
-#define OQS_ALG_NAME(nid) \
-  (nid == NID_oqs_kem_default ? OQS_KEM_alg_default : \
-  (nid == NID_frodo640aes ? OQS_KEM_alg_frodokem_640_aes : \
-  (nid == NID_frodo640shake ? OQS_KEM_alg_frodokem_640_shake : \
-  (nid == NID_frodo976aes ? OQS_KEM_alg_frodokem_976_aes : \
-  (nid == NID_frodo976shake ? OQS_KEM_alg_frodokem_976_shake : \
-  (nid == NID_frodo1344aes ? OQS_KEM_alg_frodokem_1344_aes : \
-  (nid == NID_frodo1344shake ? OQS_KEM_alg_frodokem_1344_shake : \
-  (nid == NID_bike1l1cpa ? OQS_KEM_alg_bike1_l1_cpa : \
-  (nid == NID_bike1l3cpa ? OQS_KEM_alg_bike1_l3_cpa : \
-  (nid == NID_bike1l1fo ? OQS_KEM_alg_bike1_l1_fo : \
-  (nid == NID_bike1l3fo ? OQS_KEM_alg_bike1_l3_fo : \
-  (nid == NID_kyber512 ? OQS_KEM_alg_kyber_512 : \
-  (nid == NID_kyber768 ? OQS_KEM_alg_kyber_768 : \
-  (nid == NID_kyber1024 ? OQS_KEM_alg_kyber_1024 : \
-  (nid == NID_ntru_hps2048509 ? OQS_KEM_alg_ntru_hps2048509 : \
-  (nid == NID_ntru_hps2048677 ? OQS_KEM_alg_ntru_hps2048677 : \
-  (nid == NID_ntru_hps4096821 ? OQS_KEM_alg_ntru_hps4096821 : \
-  (nid == NID_ntru_hrss701 ? OQS_KEM_alg_ntru_hrss701 : \
-  (nid == NID_lightsaber ? OQS_KEM_alg_saber_lightsaber : \
-  (nid == NID_saber ? OQS_KEM_alg_saber_saber : \
-  (nid == NID_firesaber ? OQS_KEM_alg_saber_firesaber : \
-  (nid == NID_sidhp434 ? OQS_KEM_alg_sidh_p434 : \
-  (nid == NID_sidhp503 ? OQS_KEM_alg_sidh_p503 : \
-  (nid == NID_sidhp610 ? OQS_KEM_alg_sidh_p610 : \
-  (nid == NID_sidhp751 ? OQS_KEM_alg_sidh_p751 : \
-  (nid == NID_sikep434 ? OQS_KEM_alg_sike_p434 : \
-  (nid == NID_sikep503 ? OQS_KEM_alg_sike_p503 : \
-  (nid == NID_sikep610 ? OQS_KEM_alg_sike_p610 : \
-  (nid == NID_sikep751 ? OQS_KEM_alg_sike_p751 : \
-  (nid == NID_kyber90s512 ? OQS_KEM_alg_kyber_512_90s : \
-  (nid == NID_kyber90s768 ? OQS_KEM_alg_kyber_768_90s : \
-  (nid == NID_kyber90s1024 ? OQS_KEM_alg_kyber_1024_90s : \
-  (nid == NID_hqc128_1_cca2 ? OQS_KEM_alg_hqc_128_1_cca2 : \
-  (nid == NID_hqc192_1_cca2 ? OQS_KEM_alg_hqc_192_1_cca2 : \
-  (nid == NID_hqc192_2_cca2 ? OQS_KEM_alg_hqc_192_2_cca2 : \
-  (nid == NID_hqc256_1_cca2 ? OQS_KEM_alg_hqc_256_1_cca2 : \
-  (nid == NID_hqc256_2_cca2 ? OQS_KEM_alg_hqc_256_2_cca2 : \
-  (nid == NID_hqc256_3_cca2 ? OQS_KEM_alg_hqc_256_3_cca2 : \
-  0 \
-  ))))))))))))))))))))))))))))))))))))))
-///// OQS_TEMPLATE_FRAGMENT_OQS_ALG_NAME_END
-
-/* Returns the classic curve ID for a given hybrid curve */
-///// OQS_TEMPLATE_FRAGMENT_OQS_MAP_HYBRID_START
-#define OQS_MAP_HYBRID2CURVE(cid) \
-  (cid == 0x01FF || cid == 0x2FFF ? 23 : \
-  (cid == 0x2F00 ?23: \
-  (cid == 0x2F01 ?23: \
-  (cid == 0x2F02 ?24: \
-  (cid == 0x2F03 ?24: \
-  (cid == 0x2F04 ?25: \
-  (cid == 0x2F05 ?25: \
-  (cid == 0x2F06 ?23: \
-  (cid == 0x2F07 ?24: \
-  (cid == 0x2F23 ?23: \
-  (cid == 0x2F24 ?24: \
-  (cid == 0x2F0F ?23: \
-  (cid == 0x2F10 ?24: \
-  (cid == 0x2F11 ?25: \
-  (cid == 0x2F14 ?23: \
-  (cid == 0x2F15 ?24: \
-  (cid == 0x2F16 ?25: \
-  (cid == 0x2F17 ?24: \
-  (cid == 0x2F18 ?23: \
-  (cid == 0x2F19 ?24: \
-  (cid == 0x2F1A ?25: \
-  (cid == 0x2F1B ?23: \
-  (cid == 0x2F1C ?23: \
-  (cid == 0x2F1D ?24: \
-  (cid == 0x2F1E ?25: \
-  (cid == 0x2F1F ?23: \
-  (cid == 0x2F20 ?23: \
-  (cid == 0x2F21 ?24: \
-  (cid == 0x2F22 ?25: \
-  (cid == 0x2F29 ?23: \
-  (cid == 0x2F2A ?24: \
-  (cid == 0x2F2B ?25: \
-  (cid == 0x2F32 ?23: \
-  (cid == 0x2F33 ?24: \
-  (cid == 0x2F34 ?24: \
-  (cid == 0x2F35 ?25: \
-  (cid == 0x2F36 ?25: \
-  (cid == 0x2F37 ?25: \
-  23 \
-  ))))))))))))))))))))))))))))))))))))))
-///// OQS_TEMPLATE_FRAGMENT_OQS_MAP_HYBRID_END
-
-/* Returns the classical nid for an hybrid alg */
-#define OQS_KEM_CLASSICAL_CURVEID(curveID) (IS_OQS_KEM_HYBRID_CURVEID(curveID) ? OQS_MAP_HYBRID2CURVE(curveID) : 0)
+#define IS_OQS_KEM_HYBRID_CURVEID(id) \
+    ((id) >= OQS_KEM_HYBRID_GROUP_ID_FIRST \
+     && (id) <= OQS_KEM_HYBRID_GROUP_ID_LAST)
 
 /* Post-Handshake Authentication state */
 typedef enum {
@@ -1091,6 +826,8 @@ typedef enum tlsext_index_en {
     TLSEXT_IDX_cryptopro_bug,
     TLSEXT_IDX_early_data,
     TLSEXT_IDX_certificate_authorities,
+    TLSEXT_IDX_compress_certificate,
+    TLSEXT_IDX_cached_info,
     TLSEXT_IDX_padding,
     TLSEXT_IDX_psk,
     /* Dummy index - must always be the last entry */
@@ -1109,6 +846,81 @@ typedef struct ssl_ctx_ext_secure_st {
     unsigned char tick_aes_key[TLSEXT_TICK_KEY_LENGTH];
 } SSL_CTX_EXT_SECURE;
 
+/* Pre-generated ephemeral OQS KEM keypairs, see oqs_kem_pool.c */
+typedef struct oqs_kem_pool_st OQS_KEM_POOL;
+
+/* Group selected by each server, by SNI name, see key_share_cache.c */
+typedef struct key_share_cache_st KEY_SHARE_CACHE;
+
+/* Compressed forms of our Certificate messages, see cert_comp.c */
+typedef struct cert_comp_cache_st CERT_COMP_CACHE;
+
+/* Certificate chain each server sent, by SNI name, see cached_info.c */
+typedef struct cached_info_cache_st CACHED_INFO_CACHE;
+
+/* Server side cost of each group and sigalg, see cost_select.c */
+typedef struct cost_table_st COST_TABLE;
+
+/* Handshake timing of a connection and of an SSL_CTX, see hs_timing.c */
+typedef struct ssl_hs_timing_st SSL_HS_TIMING;
+typedef struct hs_timing_stats_st HS_TIMING_STATS;
+
+/* State of one cost aware selection among a list of candidates */
+typedef struct ssl_cost_pick_st {
+    int type;
+    int min_secbits;
+    /* Index and id of the first candidate, and of the first strong enough */
+    int first;
+    uint16_t first_id;
+    int first_ok;
+    uint16_t first_ok_id;
+    /* Cheapest strong enough candidate with a known cost */
+    int cheapest;
+    uint16_t cheapest_id;
+    uint64_t cheapest_cost;
+} SSL_COST_PICK;
+
+/* RFC7924 hash of the chain last sent for a certificate slot */
+typedef struct cached_info_hash_st {
+    STACK_OF(X509) *chain;
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+} CACHED_INFO_HASH;
+
+/*
+ * The DER encoding of the certificate chain of a CERT_PKEY, shared by the
+ * handshakes that send the same chain, see cert_der.c
+ */
+typedef struct cert_chain_der_st {
+    CRYPTO_REF_COUNT references;
+    CRYPTO_RWLOCK *lock;
+    /* The encoded chain, leaf first */
+    STACK_OF(X509) *chain;
+    /* Each certificate prefixed by its 3 byte length */
+    unsigned char *der;
+    size_t derlen;
+} CERT_CHAIN_DER;
+
+/*
+ * Where a CERT_PKEY keeps the encoding of its chain. Shared with the copies
+ * of the CERT_PKEY that each SSL gets, until one of them changes certificate.
+ */
+typedef struct cert_der_cache_st {
+    CRYPTO_REF_COUNT references;
+    /* Protects |der| */
+    CRYPTO_RWLOCK *lock;
+    CERT_CHAIN_DER *der;
+} CERT_DER_CACHE;
+
+/* The DER encoding of a CA name list of an SSL_CTX, see cert_der.c */
+typedef struct ca_names_der_st {
+    /* The encoded names, only compared by address */
+    const X509_NAME **names;
+    int num;
+    /* Each name prefixed by its 2 byte length, NULL until first used */
+    unsigned char *der;
+    size_t derlen;
+} CA_NAMES_DER;
+
 struct ssl_ctx_st {
     const SSL_METHOD *method;
     STACK_OF(SSL_CIPHER) *cipher_list;
@@ -1440,6 +1252,46 @@ struct ssl_ctx_st {
 
     /* Do we advertise Post-handshake auth support? */
     int pha_enabled;
+
+    /* Pool of ephemeral OQS KEM keypairs, NULL unless configured */
+    OQS_KEM_POOL *oqs_kem_pool;
+
+    /* Client key_share predictions by server name, NULL unless configured */
+    KEY_SHARE_CACHE *key_share_cache;
+
+    /*
+     * Write buffer size that held the largest coalesced flight so far,
+     * protected by |lock|
+     */
+    size_t flight_buffer_size;
+
+    /*
+     * RFC8879 certificate compression algorithms in preference order,
+     * terminated by TLSEXT_comp_cert_none
+     */
+    unsigned char cert_comp_prefs[TLSEXT_comp_cert_limit];
+    /* Allocated when |cert_comp_prefs| is first set */
+    CERT_COMP_CACHE *cert_comp_cache;
+
+    /* Client cached_info chains by server name, NULL unless configured */
+    CACHED_INFO_CACHE *cached_info_cache;
+    /*
+     * Server side hash of the chain for each certificate slot and cached_info
+     * statistics, protected by |lock|
+     */
+    CACHED_INFO_HASH cached_info_hashes[SSL_PKEY_NUM];
+    uint64_t cached_info_offered;
+    uint64_t cached_info_used;
+
+    /* Costs for cost aware group and sigalg selection, see cost_select.c */
+    COST_TABLE *cost_table;
+
+    /* Handshake timing histograms, NULL unless turned on */
+    HS_TIMING_STATS *hs_timing_stats;
+
+    /* Encoded |ca_names| and |client_ca_names|, protected by |lock| */
+    CA_NAMES_DER ca_names_der;
+    CA_NAMES_DER client_ca_names_der;
 };
 
 struct ssl_st {
@@ -1741,6 +1593,25 @@ struct ssl_st {
          * selected.
          */
         int tick_identity;
+
+        /*
+         * RFC8879 algorithm used to compress the Certificate message we sent
+         * and the one the peer sent, or TLSEXT_comp_cert_none
+         */
+        int cert_comp_tx;
+        int cert_comp_rx;
+
+        /*
+         * RFC7924 cached_info: the hash of the certificate chain that the
+         * client offered, and on the client side the chain itself as a
+         * TLSv1.2 certificate_list without its length prefix. |cached_info_used|
+         * is set when the server sends the hash in place of the chain.
+         */
+        unsigned char *cached_info_chain;
+        size_t cached_info_chain_len;
+        unsigned char cached_info_hash[SHA256_DIGEST_LENGTH];
+        int cached_info_offered;
+        int cached_info_used;
     } ext;
 
     /*
@@ -1794,6 +1665,8 @@ struct ssl_st {
     size_t pha_context_len;
     int certreqs_sent;
     EVP_MD_CTX *pha_dgst; /* this is just the digest through ClientFinished */
+    /* Certificate compression algorithms we accept, see SSL_CTX */
+    unsigned char cert_comp_prefs[TLSEXT_comp_cert_limit];
 
 # ifndef OPENSSL_NO_SRP
     /* ctx for SRP authentication */
@@ -1856,6 +1729,9 @@ struct ssl_st {
      */
     const struct sigalg_lookup_st **shared_sigalgs;
     size_t shared_sigalgslen;
+
+    /* Timing of the last handshake, NULL unless it was timed */
+    SSL_HS_TIMING *hs_timing;
 };
 
 /*
@@ -1887,6 +1763,37 @@ typedef struct tls_group_info_st {
     uint16_t flags;             /* Flags: currently just group type */
 } TLS_GROUP_INFO;
 
+/*
+ * An OQS KEM together with its hybrid (ECDH + KEM) variant, see
+ * oqs_kem_group_list[] in t1_lib.c.
+ */
+typedef struct oqs_kem_group_info_st {
+    TLS_GROUP_INFO pq;          /* PQ-only group */
+    TLS_GROUP_INFO hybrid;      /* Hybrid group */
+    uint16_t group_id;          /* TLS group id of the PQ-only group */
+    uint16_t hybrid_group_id;   /* TLS group id of the hybrid group */
+    uint16_t classical_group_id; /* Curve used by the hybrid group */
+} OQS_KEM_GROUP_INFO;
+
+/* An ephemeral OQS KEM keypair taken from an OQS_KEM_POOL */
+typedef struct oqs_kem_keypair_st {
+    unsigned char *public_key;
+    unsigned char *secret_key;  /* Allocated from the secure heap */
+    EVP_PKEY *classical;        /* ECDH key of a hybrid group, or NULL */
+} OQS_KEM_KEYPAIR;
+
+/*
+ * An OQS KEM operation, run with EVP_run_oqs_op(). Inputs and outputs depend
+ * on the operation.
+ */
+typedef struct oqs_kem_job_st {
+    const OQS_KEM *kem;
+    unsigned char *public_key;
+    unsigned char *secret_key;
+    unsigned char *ciphertext;
+    unsigned char *shared_secret;
+} OQS_KEM_JOB;
+
 /* flags values */
 # define TLS_CURVE_TYPE          0x3 /* Mask for group type */
 # define TLS_CURVE_PRIME         0x0
@@ -2028,7 +1935,7 @@ typedef struct ssl3_state_st {
          * OQS artefacts.
          */
         int oqs_kem_curve_id; /* curve_id of the kex */
-        OQS_KEM* oqs_kem; /* KEM context */
+        const OQS_KEM *oqs_kem; /* KEM descriptor, from ssl_get_oqs_kem() */
         int oqs_peer_msg_len; /* save peer message's len */
         void* oqs_kem_client; /* oqs client private key (in extensions_clnt.c) or message (in extensions_srvr.c) */
     } tmp;
@@ -2081,6 +1988,9 @@ typedef struct ssl3_state_st {
     EVP_PKEY *peer_tmp;
 # endif
 
+    /* Set if the key share cache chose our first key_share */
+    int key_share_predicted;
+
 } SSL3_STATE;
 
 /* DTLS structures */
@@ -2134,10 +2044,19 @@ typedef struct hm_fragment_st {
 typedef struct pqueue_st pqueue;
 typedef struct pitem_st pitem;
 
+/* Number of levels in the skip list behind a pqueue, see pqueue.c */
+# define PQUEUE_MAX_LEVEL    8
+
 struct pitem_st {
     unsigned char priority[8];  /* 64-bit value in big-endian encoding */
     void *data;
     pitem *next;
+    /*
+     * The next item on each of the levels 1 to |levels| of the skip list,
+     * allocated with the item
+     */
+    size_t levels;
+    pitem *skip[1];
 };
 
 typedef struct pitem_st *piterator;
@@ -2210,6 +2129,8 @@ struct cert_pkey_st {
      */
     unsigned char *serverinfo;
     size_t serverinfo_length;
+    /* Encoding of the chain sent for |x509|, or NULL, see cert_der.c */
+    CERT_DER_CACHE *der_cache;
 };
 /* Retrieve Suite B flags */
 # define tls1_suiteb(s)  (s->cert->cert_flags & SSL_CERT_FLAG_SUITEB_128_LOS)
@@ -2714,6 +2635,50 @@ __owur int ssl_cert_add1_chain_cert(SSL *s, SSL_CTX *ctx, X509 *x);
 __owur int ssl_cert_select_current(CERT *c, X509 *x);
 __owur int ssl_cert_set_current(CERT *c, long arg);
 void ssl_cert_set_cert_cb(CERT *c, int (*cb) (SSL *ssl, void *arg), void *arg);
+__owur int ssl_cert_comp_supported(int alg);
+__owur int ssl_cert_comp_compress(SSL *s, int alg, const unsigned char *in,
+                                  size_t inlen, WPACKET *pkt);
+__owur int ssl_cert_comp_expand(int alg, unsigned char *out, size_t outlen,
+                                const unsigned char *in, size_t inlen);
+void cert_comp_cache_free(CERT_COMP_CACHE *cache);
+__owur int ssl_get_cert_chain(SSL *s, CERT_PKEY *cpk, STACK_OF(X509) **chain);
+__owur int cached_info_lookup(SSL *s);
+void cached_info_update(SSL *s);
+__owur int cached_info_chain_hash(SSL *s, CERT_PKEY *cpk, unsigned char *hash);
+__owur int cached_info_construct_certificate(SSL *s, WPACKET *pkt);
+void cached_info_note(SSL *s, int used);
+void cached_info_cache_free(CACHED_INFO_CACHE *cache);
+void cached_info_hashes_free(SSL_CTX *ctx);
+__owur int ssl_cert_chain_same(const STACK_OF(X509) *a,
+                               const STACK_OF(X509) *b);
+__owur int ssl_cert_chain_der(SSL *s, CERT_PKEY *cpk, CERT_CHAIN_DER **der);
+void ssl_cert_chain_der_free(CERT_CHAIN_DER *der);
+void ssl_cert_der_cache_free(CERT_DER_CACHE *cache);
+void ssl_cert_der_cache_reset(CERT_PKEY *cpk);
+__owur int ssl_ca_names_der(SSL *s, const STACK_OF(X509_NAME) *ca_sk,
+                            WPACKET *pkt);
+void ssl_ca_names_der_clear(SSL_CTX *ctx);
+void ca_names_der_cache_free(SSL_CTX *ctx);
+__owur int ssl_ktls_change_cipher_state(SSL *s, int sending,
+                                        const unsigned char *key,
+                                        const unsigned char *iv);
+__owur int ssl_cost_pick_init(SSL *s, SSL_COST_PICK *pick, int type);
+void ssl_cost_pick_offer(SSL *s, SSL_COST_PICK *pick, int idx, uint16_t id,
+                         int secbits);
+__owur int ssl_cost_pick_done(SSL *s, SSL_COST_PICK *pick);
+void cost_table_free(COST_TABLE *table);
+uint64_t ssl_monotonic_nsec(void);
+void ssl_hs_timing_begin(SSL *s);
+void ssl_hs_timing_end(SSL *s);
+uint64_t ssl_hs_phase_start(SSL *s);
+void ssl_hs_phase_end(SSL *s, int phase, uint64_t start);
+void ssl_hs_timing_transition(SSL *s);
+void ssl_hs_timing_message(SSL *s, int sent, size_t bytes);
+void ssl_hs_timing_wait_start(SSL *s);
+void ssl_hs_timing_wait_end(SSL *s);
+void ssl_hs_timing_free(SSL_HS_TIMING *t);
+void hs_timing_stats_free(HS_TIMING_STATS *stats);
+const char *ssl_state_desc(OSSL_HANDSHAKE_STATE state);
 
 __owur int ssl_verify_cert_chain(SSL *s, STACK_OF(X509) *sk);
 __owur int ssl_build_cert_chain(SSL *s, SSL_CTX *ctx, int flags);
@@ -2761,6 +2726,8 @@ __owur int ssl3_setup_key_block(SSL *s);
 __owur int ssl3_change_cipher_state(SSL *s, int which);
 void ssl3_cleanup_key_block(SSL *s);
 __owur int ssl3_do_write(SSL *s, int type);
+__owur int ssl3_queue_handshake(SSL *s);
+__owur int ssl3_write_flight(SSL *s);
 int ssl3_send_alert(SSL *s, int level, int desc);
 __owur int ssl3_generate_master_secret(SSL *s, unsigned char *out,
                                        unsigned char *p, size_t len,
@@ -2929,12 +2896,31 @@ SSL_COMP *ssl3_comp_find(STACK_OF(SSL_COMP) *sk, int n);
 #  ifndef OPENSSL_NO_EC
 
 __owur const TLS_GROUP_INFO *tls1_group_id_lookup(uint16_t curve_id);
+__owur const OQS_KEM_GROUP_INFO *oqs_kem_group_id_lookup(uint16_t group_id);
+__owur const OQS_KEM_GROUP_INFO *oqs_kem_group_nid_lookup(int nid);
+__owur int oqs_kem_group_nid(uint16_t group_id);
+__owur uint16_t oqs_kem_classical_group_id(uint16_t group_id);
+__owur const OQS_KEM *ssl_get_oqs_kem(int nid);
+void ssl_oqs_kem_registry_cleanup_int(void);
+int oqs_kem_pool_pop(OQS_KEM_POOL *pool, uint16_t group_id,
+                     OQS_KEM_KEYPAIR *kp);
+void oqs_kem_keypair_cleanup(const OQS_KEM *kem, OQS_KEM_KEYPAIR *kp);
+void oqs_kem_pool_free(OQS_KEM_POOL *pool);
+__owur uint16_t key_share_cache_predict(SSL *s);
+void key_share_cache_note_predicted(SSL *s);
+void key_share_cache_note_hrr(SSL *s);
+void key_share_cache_update(SSL *s, uint16_t group_id);
+void key_share_cache_free(KEY_SHARE_CACHE *cache);
+int oqs_kem_keypair_job(void *arg);
+int oqs_kem_encaps_job(void *arg);
+int oqs_kem_decaps_job(void *arg);
 __owur int tls1_check_group_id(SSL *s, uint16_t group_id, int check_own_curves);
 __owur uint16_t tls1_shared_group(SSL *s, int nmatch);
 __owur int tls1_set_groups(uint16_t **pext, size_t *pextlen,
                            int *curves, size_t ncurves);
 __owur int tls1_set_groups_list(uint16_t **pext, size_t *pextlen,
                                 const char *str);
+__owur uint16_t tls1_group_name2id(const char *name);
 void tls1_get_formatlist(SSL *s, const unsigned char **pformats,
                          size_t *num_formats);
 __owur int tls1_check_ec_tmp_key(SSL *s, unsigned long id);
@@ -2972,6 +2958,7 @@ __owur int tls_use_ticket(SSL *s);
 void ssl_set_sig_mask(uint32_t *pmask_a, SSL *s, int op);
 
 __owur int tls1_set_sigalgs_list(CERT *c, const char *str, int client);
+__owur uint16_t tls1_sigalg_name2id(const char *name);
 __owur int tls1_set_raw_sigalgs(CERT *c, const uint16_t *psigs, size_t salglen,
                                 int client);
 __owur int tls1_set_sigalgs(CERT *c, const int *salg, size_t salglen,
@@ -3003,6 +2990,7 @@ __owur int tls1_save_u16(PACKET *pkt, uint16_t **pdest, size_t *pdestlen);
 __owur int tls1_save_sigalgs(SSL *s, PACKET *pkt, int cert);
 __owur int tls1_process_sigalgs(SSL *s);
 __owur int tls1_set_peer_legacy_sigalg(SSL *s, const EVP_PKEY *pkey);
+__owur const SIGALG_LOOKUP *tls1_lookup_sigalg(uint16_t sigalg);
 __owur int tls1_lookup_md(const SIGALG_LOOKUP *lu, const EVP_MD **pmd);
 __owur size_t tls12_get_psigalgs(SSL *s, int sent, const uint16_t **psigs);
 #  ifndef OPENSSL_NO_EC
@@ -16,7 +16,13 @@ const char *SSL_state_string_long(const SSL *s)
     if (ossl_statem_in_error(s))
         return "error";
 
-    switch (SSL_get_state(s)) {
+    return ssl_state_desc(SSL_get_state(s));
+}
+
+/* The long description of handshake state |state| */
+const char *ssl_state_desc(OSSL_HANDSHAKE_STATE state)
+{
+    switch (state) {
     case TLS_ST_CR_CERT_STATUS:
         return "SSLv3/TLS read certificate status";
     case TLS_ST_CW_NEXT_PROTO:
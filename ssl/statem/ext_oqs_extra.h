@@ -1,62 +1,64 @@
 /* Extras for OQS extension */
 
-#define ENCODE_UINT16(pbuf, i)  (pbuf)[index]   = (unsigned char)((i>>8) & 0xff); \
-                                (pbuf)[index+1] = (unsigned char)((i   ) & 0xff)
-#define DECODE_UINT16(i, pbuf)  i  = ((uint16_t) (pbuf)[index])   << 8; \
-                                i |= ((uint16_t) (pbuf)[index+1])
-
-/* Encodes two messages (classical and PQC) into one hybrid message:
-   msg1_len || msg1 || msg2_len || msg2
-   hybrid_msg is allocated in this function.
-   Follows format specified in https://tools.ietf.org/html/draft-stebila-tls-hybrid-design-03
+/*
+ * The key_exchange field of an OQS hybrid KeyShareEntry carries the classical
+ * and the PQC message as
+ *     msg1_len || msg1 || msg2_len || msg2
+ * following the format specified in
+ * https://tools.ietf.org/html/draft-stebila-tls-hybrid-design-03
+ * Classical and PQC-only groups carry their single message as is.
+ * The helpers below encode and decode that field in place in the handshake
+ * buffers, so that the (possibly large) PQC messages are never copied into
+ * intermediate buffers.
  */
-static int OQS_encode_hybrid_message(const unsigned char* msg1, uint16_t  msg1_len,
-                                     const unsigned char* msg2, uint16_t  msg2_len,
-                                     unsigned char** hybrid_msg, uint16_t* hybrid_msg_len) {
-  int index = 0;
-  *hybrid_msg_len = msg1_len + msg2_len + (2 * sizeof(uint16_t));
-  *hybrid_msg = OPENSSL_malloc(*hybrid_msg_len);
-  if (*hybrid_msg == NULL) {
-    return 0;
-  }
 
-  ENCODE_UINT16(*hybrid_msg, msg1_len);  
-  index += sizeof(uint16_t);
-  memcpy(*hybrid_msg + index, msg1, msg1_len);
-  index += msg1_len;
+/*
+ * Writes the length-prefixed key_exchange field of a KeyShareEntry to |pkt|.
+ * |classical| is the encoded classical point, or NULL for a PQC-only group.
+ * If |pqc| is not NULL, |pqc_len| bytes are reserved for the PQC message and
+ * |*pqc| is set to point at them: the caller must fill them in before writing
+ * anything else to |pkt|.
+ */
+static ossl_inline int OQS_put_key_share(WPACKET *pkt,
+                                         const unsigned char *classical,
+                                         size_t classical_len,
+                                         unsigned char **pqc, size_t pqc_len)
+{
+    int do_hybrid = classical != NULL && pqc != NULL;
 
-  ENCODE_UINT16(*hybrid_msg, msg2_len);  
-  index += sizeof(uint16_t);
-  memcpy(*hybrid_msg + index, msg2, msg2_len);
-  
-  return 1;
+    if (!WPACKET_start_sub_packet_u16(pkt))
+        return 0;
+    if (classical != NULL
+            && !(do_hybrid ? WPACKET_sub_memcpy_u16(pkt, classical, classical_len)
+                           : WPACKET_memcpy(pkt, classical, classical_len)))
+        return 0;
+    if (pqc != NULL
+            && !(do_hybrid ? WPACKET_sub_allocate_bytes_u16(pkt, pqc_len, pqc)
+                           : WPACKET_allocate_bytes(pkt, pqc_len, pqc)))
+        return 0;
+    return WPACKET_close(pkt);
 }
 
-/* Decodes hybrid message returning the classical and PQC messages:
-   msg1_len || msg1 || msg2_len || msg2
-   msg1 and msg2 are allocated in this function.
-   Follows format specified in https://tools.ietf.org/html/draft-stebila-tls-hybrid-design-03
+/*
+ * Splits the key_exchange field |key_share| of a KeyShareEntry into its
+ * classical and PQC messages. |classical| and |pqc| are views into the
+ * underlying buffer of |key_share|; the one not used by the group is empty.
  */
-static int OQS_decode_hybrid_message(const unsigned char* hybrid_msg,
-                                     unsigned char** msg1, uint16_t* msg1_len,
-                                     unsigned char** msg2, uint16_t* msg2_len) {
-  int index = 0;
-  DECODE_UINT16(*msg1_len, hybrid_msg);
-  index += sizeof(uint16_t);
-  *msg1 = OPENSSL_malloc(*msg1_len);
-  if (*msg1 == NULL) {
-    return 0;
-  }
-  memcpy(*msg1, hybrid_msg + index, *msg1_len);
-  index += *msg1_len;
-
-  DECODE_UINT16(*msg2_len, hybrid_msg);
-  index += sizeof(uint16_t);
-  *msg2 = OPENSSL_malloc(*msg2_len);
-  if (*msg2 == NULL) {
-    return 0;
-  }
-  memcpy(*msg2, hybrid_msg + index, *msg2_len);
+static ossl_inline int OQS_parse_key_share(const PACKET *key_share,
+                                           int do_pqc, int do_hybrid,
+                                           PACKET *classical, PACKET *pqc)
+{
+    PACKET ks = *key_share;
 
-  return 1;
+    PACKET_null_init(classical);
+    PACKET_null_init(pqc);
+    if (do_hybrid)
+        return PACKET_get_length_prefixed_2(&ks, classical)
+               && PACKET_get_length_prefixed_2(&ks, pqc)
+               && PACKET_remaining(&ks) == 0;
+    if (do_pqc)
+        *pqc = ks;
+    else
+        *classical = ks;
+    return 1;
 }
@@ -39,6 +39,15 @@ static EXT_RETURN tls_construct_certificate_authorities(SSL *s, WPACKET *pkt,
 static int tls_parse_certificate_authorities(SSL *s, PACKET *pkt,
                                              unsigned int context, X509 *x,
                                              size_t chainidx);
+static int init_compress_certificate(SSL *s, unsigned int context);
+static EXT_RETURN tls_construct_compress_certificate(SSL *s, WPACKET *pkt,
+                                                     unsigned int context,
+                                                     X509 *x,
+                                                     size_t chainidx);
+static int tls_parse_compress_certificate(SSL *s, PACKET *pkt,
+                                          unsigned int context, X509 *x,
+                                          size_t chainidx);
+static int init_cached_info(SSL *s, unsigned int context);
 #ifndef OPENSSL_NO_SRP
 static int init_srp(SSL *s, unsigned int context);
 #endif
@@ -373,6 +382,24 @@ static const EXTENSION_DEFINITION ext_defs[] = {
         tls_construct_certificate_authorities,
         tls_construct_certificate_authorities, NULL,
     },
+    {
+        TLSEXT_TYPE_compress_certificate,
+        SSL_EXT_CLIENT_HELLO | SSL_EXT_TLS1_3_CERTIFICATE_REQUEST
+        | SSL_EXT_TLS_IMPLEMENTATION_ONLY | SSL_EXT_TLS1_3_ONLY,
+        init_compress_certificate,
+        tls_parse_compress_certificate, tls_parse_compress_certificate,
+        tls_construct_compress_certificate,
+        tls_construct_compress_certificate, NULL
+    },
+    {
+        /* The server response must come after certificate selection */
+        TLSEXT_TYPE_cached_info,
+        SSL_EXT_CLIENT_HELLO | SSL_EXT_TLS1_2_SERVER_HELLO
+        | SSL_EXT_TLS1_3_ENCRYPTED_EXTENSIONS | SSL_EXT_TLS_IMPLEMENTATION_ONLY,
+        init_cached_info, tls_parse_ctos_cached_info,
+        tls_parse_stoc_cached_info, tls_construct_stoc_cached_info,
+        tls_construct_ctos_cached_info, NULL
+    },
     {
         /* Must be immediately before pre_shared_key */
         TLSEXT_TYPE_padding,
@@ -1258,6 +1285,92 @@ static int tls_parse_certificate_authorities(SSL *s, PACKET *pkt,
     return 1;
 }
 
+static int init_compress_certificate(SSL *s, unsigned int context)
+{
+    /* An offer only applies to the Certificate message that answers it */
+    s->ext.cert_comp_tx = TLSEXT_comp_cert_none;
+    return 1;
+}
+
+static EXT_RETURN tls_construct_compress_certificate(SSL *s, WPACKET *pkt,
+                                                     unsigned int context,
+                                                     X509 *x,
+                                                     size_t chainidx)
+{
+    size_t i;
+
+    if (s->cert_comp_prefs[0] == TLSEXT_comp_cert_none)
+        return EXT_RETURN_NOT_SENT;
+
+    if (!WPACKET_put_bytes_u16(pkt, TLSEXT_TYPE_compress_certificate)
+            || !WPACKET_start_sub_packet_u16(pkt)
+            || !WPACKET_start_sub_packet_u8(pkt)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                 SSL_F_TLS_CONSTRUCT_COMPRESS_CERTIFICATE,
+                 ERR_R_INTERNAL_ERROR);
+        return EXT_RETURN_FAIL;
+    }
+
+    for (i = 0; i < TLSEXT_comp_cert_limit
+                && s->cert_comp_prefs[i] != TLSEXT_comp_cert_none; i++) {
+        if (!WPACKET_put_bytes_u16(pkt, s->cert_comp_prefs[i])) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                     SSL_F_TLS_CONSTRUCT_COMPRESS_CERTIFICATE,
+                     ERR_R_INTERNAL_ERROR);
+            return EXT_RETURN_FAIL;
+        }
+    }
+
+    if (!WPACKET_close(pkt) || !WPACKET_close(pkt)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                 SSL_F_TLS_CONSTRUCT_COMPRESS_CERTIFICATE,
+                 ERR_R_INTERNAL_ERROR);
+        return EXT_RETURN_FAIL;
+    }
+
+    return EXT_RETURN_SENT;
+}
+
+static int tls_parse_compress_certificate(SSL *s, PACKET *pkt,
+                                          unsigned int context, X509 *x,
+                                          size_t chainidx)
+{
+    PACKET algs;
+    unsigned int alg;
+    size_t i, best = TLSEXT_comp_cert_limit;
+
+    if (!PACKET_as_length_prefixed_1(pkt, &algs)
+            || PACKET_remaining(&algs) == 0
+            || (PACKET_remaining(&algs) & 1) != 0) {
+        SSLfatal(s, SSL_AD_DECODE_ERROR,
+                 SSL_F_TLS_PARSE_COMPRESS_CERTIFICATE, SSL_R_BAD_EXTENSION);
+        return 0;
+    }
+
+    /* Use the peer's algorithm that comes first in our own preferences */
+    while (PACKET_get_net_2(&algs, &alg)) {
+        for (i = 0; i < best
+                    && s->cert_comp_prefs[i] != TLSEXT_comp_cert_none; i++) {
+            if (s->cert_comp_prefs[i] == alg) {
+                best = i;
+                break;
+            }
+        }
+    }
+    if (best < TLSEXT_comp_cert_limit)
+        s->ext.cert_comp_tx = s->cert_comp_prefs[best];
+
+    return 1;
+}
+
+static int init_cached_info(SSL *s, unsigned int context)
+{
+    if (s->server)
+        s->ext.cached_info_offered = 0;
+    s->ext.cached_info_used = 0;
+    return 1;
+}
+
 #ifndef OPENSSL_NO_SRTP
 static int init_srtp(SSL *s, unsigned int context)
 {
@@ -1370,6 +1483,8 @@ static int final_key_share(SSL *s, unsigned int context, int sent)
                 const uint16_t *pgroups, *clntgroups;
                 size_t num_groups, clnt_num_groups, i;
                 unsigned int group_id = 0;
+                SSL_COST_PICK pick;
+                int idx;
 
                 /* Check if a shared group exists */
 
@@ -1377,15 +1492,39 @@ static int final_key_share(SSL *s, unsigned int context, int sent)
                 tls1_get_peer_groups(s, &clntgroups, &clnt_num_groups);
                 tls1_get_supported_groups(s, &pgroups, &num_groups);
 
-                /*
-                 * Find the first group we allow that is also in client's list
-                 */
-                for (i = 0; i < num_groups; i++) {
-                    group_id = pgroups[i];
+                if (ssl_cost_pick_init(s, &pick, SSL_COST_GROUP)) {
+                    /*
+                     * Find the cheapest group we allow that is also in
+                     * client's list
+                     */
+                    for (i = 0; i < num_groups; i++) {
+                        const TLS_GROUP_INFO *ginf;
+
+                        group_id = pgroups[i];
+                        if (!check_in_list(s, group_id, clntgroups,
+                                           clnt_num_groups, 1))
+                            continue;
+                        ginf = tls1_group_id_lookup(group_id);
+                        ssl_cost_pick_offer(s, &pick, (int)i, group_id,
+                                            ginf != NULL ? ginf->secbits : 0);
+                    }
+                    idx = ssl_cost_pick_done(s, &pick);
+                    if (idx >= 0) {
+                        i = (size_t)idx;
+                        group_id = pgroups[i];
+                    }
+                } else {
+                    /*
+                     * Find the first group we allow that is also in client's
+                     * list
+                     */
+                    for (i = 0; i < num_groups; i++) {
+                        group_id = pgroups[i];
 
-                    if (check_in_list(s, group_id, clntgroups, clnt_num_groups,
-                                      1))
-                        break;
+                        if (check_in_list(s, group_id, clntgroups,
+                                          clnt_num_groups, 1))
+                            break;
+                    }
                 }
 
                 if (i < num_groups) {
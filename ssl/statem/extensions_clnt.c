@@ -514,6 +514,35 @@ EXT_RETURN tls_construct_ctos_ems(SSL *s, WPACKET *pkt, unsigned int context,
     return EXT_RETURN_SENT;
 }
 
+EXT_RETURN tls_construct_ctos_cached_info(SSL *s, WPACKET *pkt,
+                                          unsigned int context, X509 *x,
+                                          size_t chainidx)
+{
+    /* A second ClientHello offers the same chain as the first */
+    if (s->hello_retry_request == SSL_HRR_NONE && !cached_info_lookup(s))
+        return EXT_RETURN_NOT_SENT;
+    if (s->ext.cached_info_chain == NULL)
+        return EXT_RETURN_NOT_SENT;
+
+    if (!WPACKET_put_bytes_u16(pkt, TLSEXT_TYPE_cached_info)
+            || !WPACKET_start_sub_packet_u16(pkt)
+            || !WPACKET_start_sub_packet_u16(pkt)
+            || !WPACKET_put_bytes_u8(pkt, TLSEXT_cached_info_cert)
+            || !WPACKET_sub_memcpy_u8(pkt, s->ext.cached_info_hash,
+                                      sizeof(s->ext.cached_info_hash))
+            || !WPACKET_close(pkt)
+            || !WPACKET_close(pkt)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                 SSL_F_TLS_CONSTRUCT_CTOS_CACHED_INFO, ERR_R_INTERNAL_ERROR);
+        return EXT_RETURN_FAIL;
+    }
+
+    if (s->hello_retry_request == SSL_HRR_NONE)
+        cached_info_note(s, 0);
+
+    return EXT_RETURN_SENT;
+}
+
 EXT_RETURN tls_construct_ctos_supported_versions(SSL *s, WPACKET *pkt,
                                                  unsigned int context, X509 *x,
                                                  size_t chainidx)
@@ -594,99 +623,111 @@ EXT_RETURN tls_construct_ctos_psk_kex_modes(SSL *s, WPACKET *pkt,
 #ifndef OPENSSL_NO_TLS1_3
 static int add_key_share(SSL *s, WPACKET *pkt, unsigned int curve_id)
 {
-    unsigned char *encoded_point = NULL, *classical_encoded_point = NULL, *oqs_encoded_point = NULL;
+    unsigned char *encoded_point = NULL, *oqs_encoded_point = NULL;
     EVP_PKEY *key_share_key = NULL;
+    const OQS_KEM *oqs_kem = NULL;
+    OQS_KEM_KEYPAIR pooled = { NULL, NULL, NULL };
+    OQS_KEM_JOB kem_job;
     size_t encodedlen = 0;
-    uint16_t classical_encodedlen = 0, oqs_encodedlen = 0;
+    uint64_t phase_start;
     int do_pqc = IS_OQS_KEM_CURVEID(curve_id); /* 1 if post-quantum alg, 0 otherwise */
     int do_hybrid = IS_OQS_KEM_HYBRID_CURVEID(curve_id); /* 1 if post-quantum hybrid alg, 0 otherwise */
+
+    if (do_pqc || do_hybrid) {
+        /* This is a group handled by OQS: look up the kex */
+        if ((oqs_kem = ssl_get_oqs_kem(oqs_kem_group_nid(curve_id))) == NULL) {
+            /* TODO: provide a better error message for non-enabled OQS schemes.
+               Perhaps even check if the alg is available earlier in the stack. (FIXMEOQS) */
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_ADD_KEY_SHARE, ERR_R_INTERNAL_ERROR);
+            return 0;
+        }
+        /*
+         * Take a pre-generated keypair if the SSL_CTX keeps a pool of them,
+         * unless an HRR left the classical key to reuse, which a hybrid
+         * keypair from the pool would come with.
+         */
+        if (s->ctx->oqs_kem_pool != NULL && s->s3->tmp.pkey == NULL)
+            oqs_kem_pool_pop(s->ctx->oqs_kem_pool, curve_id, &pooled);
+    }
+
     if (s->s3->tmp.pkey != NULL) {
         if (!ossl_assert(s->hello_retry_request == SSL_HRR_PENDING)) {
             SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_ADD_KEY_SHARE, ERR_R_INTERNAL_ERROR);
-            return 0;
+            goto err;
         }
         /*
          * Could happen if we got an HRR that wasn't requesting a new key_share
          */
         key_share_key = s->s3->tmp.pkey;
-    } else {
-      if (do_pqc || do_hybrid) {
-        /* This is a group handled by OQS */
-        int has_error = 0;
-        int oqs_nid = OQS_KEM_NID(curve_id);
-        const char* oqs_alg_name = OQS_ALG_NAME(oqs_nid);
-        /* initialize the kex */
-        if ((s->s3->tmp.oqs_kem = OQS_KEM_new(oqs_alg_name)) == NULL) {
-          /* TODO: provide a better error message for non-enabled OQS schemes.
-             Perhaps even check if the alg is available earlier in the stack. (FIXMEOQS) */
-          SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_ADD_KEY_SHARE, ERR_R_INTERNAL_ERROR);
-          has_error = 1;
-          goto oqs_cleanup;
-        }
-        /* compute the client's key and first message (encoded in encoded_point) */
-        if ((oqs_encoded_point = malloc(s->s3->tmp.oqs_kem->length_public_key)) == NULL ||
-            (s->s3->tmp.oqs_kem_client = malloc(s->s3->tmp.oqs_kem->length_secret_key)) == NULL ||
-            OQS_KEM_keypair(s->s3->tmp.oqs_kem, oqs_encoded_point, s->s3->tmp.oqs_kem_client) != OQS_SUCCESS) {
-          SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_ADD_KEY_SHARE, ERR_R_INTERNAL_ERROR);
-          has_error = 1;
-          goto oqs_cleanup;
-        }
-        oqs_encodedlen = s->s3->tmp.oqs_kem->length_public_key;
-
-      oqs_cleanup:
-        if (has_error) {
-          if (s->s3->tmp.oqs_kem_client) OQS_MEM_secure_free(s->s3->tmp.oqs_kem_client, s->s3->tmp.oqs_kem->length_secret_key);
-          OQS_MEM_insecure_free(oqs_encoded_point);
-          s->s3->tmp.oqs_kem_client = NULL;
-          if (s->s3->tmp.oqs_kem) OQS_KEM_free(s->s3->tmp.oqs_kem);
-          s->s3->tmp.oqs_kem = NULL;
-          return 0;
-        }
-      }
-      if (!do_pqc) {
+    } else if (pooled.classical != NULL) {
+        key_share_key = pooled.classical;
+        pooled.classical = NULL;
+    } else if (!do_pqc) {
         /* get the curve_id for the classical alg */
-        int classical_curve_id = do_hybrid ? OQS_KEM_CLASSICAL_CURVEID(curve_id) : curve_id;
+        int classical_curve_id = do_hybrid ? oqs_kem_classical_group_id(curve_id) : curve_id;
         key_share_key = ssl_generate_pkey_group(s, classical_curve_id);
         if (key_share_key == NULL) {
             /* SSLfatal() already called */
-            return 0;
+            goto err;
         }
-      }
     }
 
     if (!do_pqc) {
-      /* Encode the public key. */
-      classical_encodedlen = EVP_PKEY_get1_tls_encodedpoint(key_share_key, &classical_encoded_point);
-      if (classical_encodedlen == 0) {
-        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_ADD_KEY_SHARE, ERR_R_EC_LIB);
-        goto err;
-      }
-    }
-
-    if (do_hybrid) {
-      uint16_t encodedlen16;
-      if (!OQS_encode_hybrid_message(classical_encoded_point, classical_encodedlen, oqs_encoded_point, oqs_encodedlen, &encoded_point, &encodedlen16)) {
-        goto err;
-      }
-      encodedlen = encodedlen16;
-      OPENSSL_free(classical_encoded_point);
-      OPENSSL_free(oqs_encoded_point);
-    } else if (do_pqc) {
-      encoded_point = oqs_encoded_point;
-      encodedlen = oqs_encodedlen;
-    } else {
-      encoded_point = classical_encoded_point;
-      encodedlen = classical_encodedlen;
+        /* Encode the public key. */
+        encodedlen = EVP_PKEY_get1_tls_encodedpoint(key_share_key, &encoded_point);
+        if (encodedlen == 0) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_ADD_KEY_SHARE, ERR_R_EC_LIB);
+            goto err;
+        }
     }
 
-    /* Create KeyShareEntry */
+    /*
+     * Create KeyShareEntry. The OQS public key is generated directly into the
+     * space reserved for it in the packet.
+     */
     if (!WPACKET_put_bytes_u16(pkt, curve_id)
-            || !WPACKET_sub_memcpy_u16(pkt, encoded_point, encodedlen)) {
+            || !OQS_put_key_share(pkt, encoded_point, encodedlen,
+                                  oqs_kem != NULL ? &oqs_encoded_point : NULL,
+                                  oqs_kem != NULL ? oqs_kem->length_public_key : 0)) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_ADD_KEY_SHARE,
                  ERR_R_INTERNAL_ERROR);
         goto err;
     }
 
+    if (oqs_kem != NULL) {
+        /* A secret key left over from before an HRR can't be reused */
+        if (s->s3->tmp.oqs_kem_client != NULL)
+            OPENSSL_secure_clear_free(s->s3->tmp.oqs_kem_client,
+                                      s->s3->tmp.oqs_kem->length_secret_key);
+        s->s3->tmp.oqs_kem = oqs_kem;
+        /*
+         * use the pooled keypair, or compute the client's key and first
+         * message
+         */
+        if (pooled.secret_key != NULL) {
+            memcpy(oqs_encoded_point, pooled.public_key,
+                   oqs_kem->length_public_key);
+            s->s3->tmp.oqs_kem_client = pooled.secret_key;
+            pooled.secret_key = NULL;
+        } else {
+            if ((s->s3->tmp.oqs_kem_client =
+                     OPENSSL_secure_malloc(oqs_kem->length_secret_key)) == NULL) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_ADD_KEY_SHARE, ERR_R_INTERNAL_ERROR);
+                goto err;
+            }
+            kem_job.kem = oqs_kem;
+            kem_job.public_key = oqs_encoded_point;
+            kem_job.secret_key = s->s3->tmp.oqs_kem_client;
+            phase_start = ssl_hs_phase_start(s);
+            if (!EVP_run_oqs_op(oqs_kem_keypair_job, &kem_job)) {
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_ADD_KEY_SHARE, ERR_R_INTERNAL_ERROR);
+                goto err;
+            }
+            ssl_hs_phase_end(s, SSL_HS_PHASE_KEYGEN, phase_start);
+        }
+        oqs_kem_keypair_cleanup(oqs_kem, &pooled);
+    }
+
     /*
      * TODO(TLS1.3): When changing to send more than one key_share we're
      * going to need to be able to save more than one EVP_PKEY. For now
@@ -700,6 +741,13 @@ static int add_key_share(SSL *s, WPACKET *pkt, unsigned int curve_id)
  err:
     if (s->s3->tmp.pkey == NULL)
         EVP_PKEY_free(key_share_key);
+    if (oqs_kem != NULL)
+        oqs_kem_keypair_cleanup(oqs_kem, &pooled);
+    if (s->s3->tmp.oqs_kem_client != NULL)
+        OPENSSL_secure_clear_free(s->s3->tmp.oqs_kem_client,
+                                  s->s3->tmp.oqs_kem->length_secret_key);
+    s->s3->tmp.oqs_kem_client = NULL;
+    s->s3->tmp.oqs_kem = NULL;
     OPENSSL_free(encoded_point);
     return 0;
 }
@@ -734,6 +782,8 @@ EXT_RETURN tls_construct_ctos_key_share(SSL *s, WPACKET *pkt,
     if (s->s3->group_id != 0) {
         curve_id = s->s3->group_id;
     } else {
+        uint16_t predicted = key_share_cache_predict(s);
+
         for (i = 0; i < num_groups; i++) {
 
             if (!tls_curve_allowed(s, pgroups[i], SSL_SECOP_CURVE_SUPPORTED))
@@ -742,6 +792,13 @@ EXT_RETURN tls_construct_ctos_key_share(SSL *s, WPACKET *pkt,
             curve_id = pgroups[i];
             break;
         }
+
+        /* Send the group this server picked last time, see key_share_cache.c */
+        if (predicted != 0 && predicted != curve_id) {
+            curve_id = predicted;
+            s->s3->key_share_predicted = 1;
+            key_share_cache_note_predicted(s);
+        }
     }
 
     if (curve_id == 0) {
@@ -1812,6 +1869,38 @@ int tls_parse_stoc_ems(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
     return 1;
 }
 
+int tls_parse_stoc_cached_info(SSL *s, PACKET *pkt, unsigned int context,
+                               X509 *x, size_t chainidx)
+{
+    PACKET types;
+    unsigned int type;
+
+    if (!PACKET_as_length_prefixed_2(pkt, &types)
+            || PACKET_remaining(&types) == 0) {
+        SSLfatal(s, SSL_AD_DECODE_ERROR, SSL_F_TLS_PARSE_STOC_CACHED_INFO,
+                 SSL_R_BAD_EXTENSION);
+        return 0;
+    }
+
+    /*
+     * The server may only name the types we offered, and there is no
+     * Certificate message to replace on resumption.
+     */
+    while (PACKET_get_1(&types, &type)) {
+        if (type != TLSEXT_cached_info_cert || s->hit
+                || s->ext.cached_info_chain == NULL) {
+            SSLfatal(s, SSL_AD_ILLEGAL_PARAMETER,
+                     SSL_F_TLS_PARSE_STOC_CACHED_INFO, SSL_R_BAD_EXTENSION);
+            return 0;
+        }
+    }
+
+    s->ext.cached_info_used = 1;
+    cached_info_note(s, 1);
+
+    return 1;
+}
+
 int tls_parse_stoc_supported_versions(SSL *s, PACKET *pkt, unsigned int context,
                                       X509 *x, size_t chainidx)
 {
@@ -1851,15 +1940,15 @@ int tls_parse_stoc_key_share(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
 {
 #ifndef OPENSSL_NO_TLS1_3
     unsigned int group_id;
-    PACKET encoded_pt;
-    unsigned char *classical_encoded_pt = NULL, *oqs_encoded_pt = NULL;
-    uint16_t classical_encodedlen, oqs_encodedlen;
+    PACKET encoded_pt, classical_pt, oqs_pt;
     unsigned char *shared_secret = NULL, *oqs_shared_secret = NULL;
     size_t shared_secret_len = 0, oqs_shared_secret_len = 0;
     EVP_PKEY *ckey = s->s3->tmp.pkey, *skey = NULL;
+    OQS_KEM_JOB kem_job;
     int do_pqc = 0;
     int do_hybrid = 0;
     int has_error = 0;
+    uint64_t phase_start;
 
     /* OQS note: this block has been moved up to learn the group_id sooner */
     if (!PACKET_get_net_2(pkt, &group_id)) {
@@ -1870,8 +1959,13 @@ int tls_parse_stoc_key_share(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
     do_pqc = IS_OQS_KEM_CURVEID(group_id); /* 1 if post-quantum alg, 0 otherwise */
     do_hybrid = IS_OQS_KEM_HYBRID_CURVEID(group_id); /* 1 if post-quantum hybrid alg, 0 otherwise */
 
-    /* Sanity check */
-    if ((!do_pqc || do_hybrid) && (ckey == NULL || s->s3->peer_tmp != NULL)) {
+    /*
+     * Sanity check. An HRR names the group to use next, which may need a
+     * classical key even though the key_share we sent (PQC-only) did not.
+     */
+    if (s->s3->peer_tmp != NULL
+            || ((context & SSL_EXT_TLS1_3_HELLO_RETRY_REQUEST) == 0
+                && (!do_pqc || do_hybrid) && ckey == NULL)) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS_PARSE_STOC_KEY_SHARE,
                  ERR_R_INTERNAL_ERROR);
         return 0;
@@ -1910,6 +2004,7 @@ int tls_parse_stoc_key_share(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
             return 0;
         }
 
+        key_share_cache_note_hrr(s);
         s->s3->group_id = group_id;
         EVP_PKEY_free(s->s3->tmp.pkey);
         s->s3->tmp.pkey = NULL;
@@ -1925,6 +2020,7 @@ int tls_parse_stoc_key_share(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
                  SSL_R_BAD_KEY_SHARE);
         return 0;
     }
+    key_share_cache_update(s, group_id);
 
     if (!PACKET_as_length_prefixed_2(pkt, &encoded_pt)
             || PACKET_remaining(&encoded_pt) == 0) {
@@ -1933,18 +2029,12 @@ int tls_parse_stoc_key_share(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
         return 0;
     }
 
-    /* parse the encoded_pt, which is either a classical, PQC, or hybrid (both) message. */
-    if (do_hybrid) {
-      if (!OQS_decode_hybrid_message(PACKET_data(&encoded_pt), &classical_encoded_pt, &classical_encodedlen, &oqs_encoded_pt, &oqs_encodedlen)) {
-        has_error = 1;
-        goto oqs_cleanup;
-      }
-    } else if (do_pqc) {
-      oqs_encoded_pt = (unsigned char*) PACKET_data(&encoded_pt);
-      oqs_encodedlen = PACKET_remaining(&encoded_pt);
-    } else {
-      classical_encoded_pt = (unsigned char*) PACKET_data(&encoded_pt);
-      classical_encodedlen = PACKET_remaining(&encoded_pt);
+    /* split the encoded_pt, which is either a classical, PQC, or hybrid (both) message. */
+    if (!OQS_parse_key_share(&encoded_pt, do_pqc, do_hybrid, &classical_pt, &oqs_pt)) {
+      SSLfatal(s, SSL_AD_DECODE_ERROR, SSL_F_TLS_PARSE_STOC_KEY_SHARE,
+               SSL_R_LENGTH_MISMATCH);
+      has_error = 1;
+      goto oqs_cleanup;
     }
 
     if (!do_pqc || do_hybrid) {
@@ -1955,7 +2045,8 @@ int tls_parse_stoc_key_share(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
         has_error = 1;
         goto oqs_cleanup;
       }
-      if (!EVP_PKEY_set1_tls_encodedpoint(skey, classical_encoded_pt, classical_encodedlen)) {
+      if (!EVP_PKEY_set1_tls_encodedpoint(skey, PACKET_data(&classical_pt),
+                                          PACKET_remaining(&classical_pt))) {
         SSLfatal(s, SSL_AD_ILLEGAL_PARAMETER, SSL_F_TLS_PARSE_STOC_KEY_SHARE,
                  SSL_R_BAD_ECPOINT);
         EVP_PKEY_free(skey);
@@ -1978,13 +2069,29 @@ int tls_parse_stoc_key_share(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
           has_error = 1;
           goto oqs_cleanup;
         }
-        /* compute the shared secret */
-        if ((oqs_shared_secret = malloc(s->s3->tmp.oqs_kem->length_shared_secret)) == NULL ||
-            OQS_KEM_decaps(s->s3->tmp.oqs_kem, oqs_shared_secret, oqs_encoded_pt, s->s3->tmp.oqs_kem_client) != OQS_SUCCESS) {
+        if (PACKET_remaining(&oqs_pt) != s->s3->tmp.oqs_kem->length_ciphertext) {
+          SSLfatal(s, SSL_AD_DECODE_ERROR, SSL_F_TLS_PARSE_STOC_KEY_SHARE,
+                   SSL_R_LENGTH_MISMATCH);
+          has_error = 1;
+          goto oqs_cleanup;
+        }
+        /* compute the shared secret, decapsulating straight from the packet */
+        phase_start = ssl_hs_phase_start(s);
+        if ((oqs_shared_secret = malloc(s->s3->tmp.oqs_kem->length_shared_secret)) == NULL) {
+          SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS_PARSE_STOC_KEY_SHARE, ERR_R_INTERNAL_ERROR);
+          has_error = 1;
+          goto oqs_cleanup;
+        }
+        kem_job.kem = s->s3->tmp.oqs_kem;
+        kem_job.secret_key = s->s3->tmp.oqs_kem_client;
+        kem_job.ciphertext = (unsigned char *)PACKET_data(&oqs_pt);
+        kem_job.shared_secret = oqs_shared_secret;
+        if (!EVP_run_oqs_op(oqs_kem_decaps_job, &kem_job)) {
           SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS_PARSE_STOC_KEY_SHARE, ERR_R_INTERNAL_ERROR);
           has_error = 1;
           goto oqs_cleanup;
         }
+        ssl_hs_phase_end(s, SSL_HS_PHASE_DECAPS, phase_start);
         oqs_shared_secret_len = s->s3->tmp.oqs_kem->length_shared_secret;
         /* We save the group_id so it can be printed out later in s_client's output. */
         s->s3->tmp.oqs_kem_curve_id = group_id;
@@ -2027,16 +2134,13 @@ int tls_parse_stoc_key_share(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
     oqs_cleanup:
         /* we free the OQS artefacts on success or error */
         OQS_MEM_secure_free(shared_secret, shared_secret_len);
-        OQS_MEM_secure_free(s->s3->tmp.oqs_kem_client, s->s3->tmp.oqs_kem->length_secret_key);
+        if (s->s3->tmp.oqs_kem != NULL) {
+          if (oqs_shared_secret != shared_secret)
+            OQS_MEM_secure_free(oqs_shared_secret, s->s3->tmp.oqs_kem->length_shared_secret);
+          OPENSSL_secure_clear_free(s->s3->tmp.oqs_kem_client, s->s3->tmp.oqs_kem->length_secret_key);
+        }
         s->s3->tmp.oqs_kem_client = NULL;
-        OQS_KEM_free(s->s3->tmp.oqs_kem);
         s->s3->tmp.oqs_kem = NULL;
-        if (do_hybrid) {
-        /* we allocated these in the hybrid case. in the non-hybrid case, these are
-           just pointers into the packet, and openssl will clean them up */
-          OPENSSL_free(classical_encoded_pt);
-          OPENSSL_free(oqs_encoded_pt);
-        }
         if (has_error) {
           return 0;
         }
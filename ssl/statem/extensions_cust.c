@@ -520,10 +520,12 @@ int SSL_extension_supported(unsigned int ext_type)
     case TLSEXT_TYPE_encrypt_then_mac:
     case TLSEXT_TYPE_supported_versions:
     case TLSEXT_TYPE_extended_master_secret:
+    case TLSEXT_TYPE_cached_info:
     case TLSEXT_TYPE_psk_kex_modes:
     case TLSEXT_TYPE_cookie:
     case TLSEXT_TYPE_early_data:
     case TLSEXT_TYPE_certificate_authorities:
+    case TLSEXT_TYPE_compress_certificate:
     case TLSEXT_TYPE_psk:
     case TLSEXT_TYPE_post_handshake_auth:
         return 1;
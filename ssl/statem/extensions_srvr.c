@@ -626,15 +626,15 @@ int tls_parse_ctos_key_share(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
 {
 #ifndef OPENSSL_NO_TLS1_3
     unsigned int group_id;
-    PACKET key_share_list, encoded_pt;
+    PACKET key_share_list, encoded_pt, classical_pt, oqs_pt;
     const uint16_t *clntgroups, *srvrgroups;
     size_t clnt_num_groups, srvr_num_groups;
     int found = 0;
     int do_pqc = 0; /* 1 if post-quantum alg, 0 otherwise */
     int do_hybrid = 0; /* 1 if post-quantum hybrid alg, 0 otherwise */
-    unsigned char *classical_encoded_pt = NULL, *oqs_encoded_pt = NULL;
-    uint16_t classical_encodedlen = 0, oqs_encodedlen = 0;
-    int has_error = 0;
+    unsigned int cost_group_id = 0;
+    int cost_idx;
+    SSL_COST_PICK pick;
 
     if (s->hit && (s->ext.psk_kex_mode & TLSEXT_KEX_MODE_FLAG_KE_DHE) == 0)
         return 1;
@@ -678,6 +678,28 @@ int tls_parse_ctos_key_share(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
         return 0;
     }
 
+    /*
+     * With cost aware selection we use the cheapest of the usable shares
+     * rather than the first. Malformed shares are left for the loop below to
+     * reject.
+     */
+    if (s->s3->group_id == 0 && ssl_cost_pick_init(s, &pick, SSL_COST_GROUP)) {
+        PACKET shares = key_share_list;
+
+        while (PACKET_get_net_2(&shares, &group_id)
+                && PACKET_get_length_prefixed_2(&shares, &encoded_pt)) {
+            const TLS_GROUP_INFO *ginf = tls1_group_id_lookup(group_id);
+
+            if (check_in_list(s, group_id, clntgroups, clnt_num_groups, 0)
+                    && check_in_list(s, group_id, srvrgroups, srvr_num_groups,
+                                     1))
+                ssl_cost_pick_offer(s, &pick, (int)group_id, group_id,
+                                    ginf != NULL ? ginf->secbits : 0);
+        }
+        if ((cost_idx = ssl_cost_pick_done(s, &pick)) > 0)
+            cost_group_id = (unsigned int)cost_idx;
+    }
+
     while (PACKET_remaining(&key_share_list) > 0) {
         if (!PACKET_get_net_2(&key_share_list, &group_id)
                 || !PACKET_get_length_prefixed_2(&key_share_list, &encoded_pt)
@@ -714,7 +736,8 @@ int tls_parse_ctos_key_share(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
         }
 
         /* Check if this share is for a group we can use */
-        if (!check_in_list(s, group_id, srvrgroups, srvr_num_groups, 1)) {
+        if (!check_in_list(s, group_id, srvrgroups, srvr_num_groups, 1)
+                || (cost_group_id != 0 && group_id != cost_group_id)) {
             /* Share not suitable */
             continue;
         }
@@ -723,26 +746,41 @@ int tls_parse_ctos_key_share(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
         do_pqc = IS_OQS_KEM_CURVEID(group_id);
         do_hybrid = IS_OQS_KEM_HYBRID_CURVEID(group_id);
 
-        /* parse the encoded_pt, which is either a classical, PQC, or hybrid (both) message. */
-        if (do_hybrid) {
-          if (!OQS_decode_hybrid_message(PACKET_data(&encoded_pt), &classical_encoded_pt, &classical_encodedlen, &oqs_encoded_pt, &oqs_encodedlen)) {
-            has_error = 1;
-            goto oqs_cleanup;
-          }
-        } else if (do_pqc) {
-          oqs_encoded_pt = (unsigned char*) PACKET_data(&encoded_pt);
-          oqs_encodedlen = PACKET_remaining(&encoded_pt);
-        } else {
-          classical_encoded_pt = (unsigned char*) PACKET_data(&encoded_pt);
-          classical_encodedlen = PACKET_remaining(&encoded_pt);
+        /* split the encoded_pt, which is either a classical, PQC, or hybrid (both) message. */
+        if (!OQS_parse_key_share(&encoded_pt, do_pqc, do_hybrid, &classical_pt, &oqs_pt)) {
+            SSLfatal(s, SSL_AD_DECODE_ERROR, SSL_F_TLS_PARSE_CTOS_KEY_SHARE,
+                     SSL_R_LENGTH_MISMATCH);
+            return 0;
         }
 
         if (do_pqc || do_hybrid) {
-          const unsigned char* peer_msg = oqs_encoded_pt;
-          s->s3->tmp.oqs_peer_msg_len = oqs_encodedlen;
-          unsigned char* peer_key = OPENSSL_malloc(s->s3->tmp.oqs_peer_msg_len);
-          memcpy(peer_key, peer_msg, s->s3->tmp.oqs_peer_msg_len); /* FIXMEOQS: when should I free that? */
+          const OQS_KEM *oqs_kem = ssl_get_oqs_kem(oqs_kem_group_nid(group_id));
+          unsigned char *peer_key = NULL;
+          size_t peer_key_len;
+
+          if (oqs_kem == NULL) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS_PARSE_CTOS_KEY_SHARE,
+                     ERR_R_INTERNAL_ERROR);
+            return 0;
+          }
+          if (PACKET_remaining(&oqs_pt) != oqs_kem->length_public_key) {
+            SSLfatal(s, SSL_AD_ILLEGAL_PARAMETER,
+                     SSL_F_TLS_PARSE_CTOS_KEY_SHARE, SSL_R_BAD_KEY_SHARE);
+            return 0;
+          }
+          /*
+           * The ClientHello buffer gets reused for the ServerHello, so this is
+           * the one place the client's public key has to be copied: we
+           * encapsulate to it when constructing our key_share.
+           */
+          if (!PACKET_memdup(&oqs_pt, &peer_key, &peer_key_len)) {
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS_PARSE_CTOS_KEY_SHARE,
+                     ERR_R_MALLOC_FAILURE);
+            return 0;
+          }
+          OPENSSL_free(s->s3->tmp.oqs_kem_client);
           s->s3->tmp.oqs_kem_client = peer_key;
+          s->s3->tmp.oqs_peer_msg_len = (int)peer_key_len;
           /* OQS note: we are not using peer_tmp in the oqs case, but the kex fails if this
              value is null, so we instantiate it but we don't assign any value. It will get
              cleaned up later.
@@ -751,28 +789,25 @@ int tls_parse_ctos_key_share(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
           if (!do_hybrid && (s->s3->peer_tmp = EVP_PKEY_new()) == NULL) {
             SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS_PARSE_CTOS_KEY_SHARE,
                      ERR_R_INTERNAL_ERROR);
-            has_error = 1;
-            goto oqs_cleanup;
+            return 0;
           }
           /* ---------- end oqs note */
         }
         if (!do_pqc) {
           /* get the curve_id for the classical alg */
-          int classical_group_id = do_hybrid ? OQS_KEM_CLASSICAL_CURVEID(group_id) : group_id;
+          int classical_group_id = do_hybrid ? oqs_kem_classical_group_id(group_id) : group_id;
           if ((s->s3->peer_tmp = ssl_generate_param_group(classical_group_id)) == NULL) {
             SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS_PARSE_CTOS_KEY_SHARE,
                      SSL_R_UNABLE_TO_FIND_ECDH_PARAMETERS);
-            has_error = 1;
-            goto oqs_cleanup;
+            return 0;
           }
 
           if (!EVP_PKEY_set1_tls_encodedpoint(s->s3->peer_tmp,
-                                              classical_encoded_pt,
-                                              classical_encodedlen)) {
+                                              PACKET_data(&classical_pt),
+                                              PACKET_remaining(&classical_pt))) {
             SSLfatal(s, SSL_AD_ILLEGAL_PARAMETER,
                      SSL_F_TLS_PARSE_CTOS_KEY_SHARE, SSL_R_BAD_ECPOINT);
-            has_error = 1;
-            goto oqs_cleanup;
+            return 0;
           }
         }
         s->s3->group_id = group_id;
@@ -780,17 +815,6 @@ int tls_parse_ctos_key_share(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
     }
 #endif
 
-    oqs_cleanup:
-      if (do_hybrid) {
-        /* we allocated these in the hybrid case. in the non-hybrid case, these are
-           just pointers into the packet, and openssl will clean them up */
-        OPENSSL_free(classical_encoded_pt);
-        OPENSSL_free(oqs_encoded_pt);
-      }
-      if (has_error) {
-        return 0;
-      }
-
     return 1;
 }
 
@@ -1065,6 +1089,42 @@ int tls_parse_ctos_ems(SSL *s, PACKET *pkt, unsigned int context, X509 *x,
     return 1;
 }
 
+int tls_parse_ctos_cached_info(SSL *s, PACKET *pkt, unsigned int context,
+                               X509 *x, size_t chainidx)
+{
+    PACKET list, hash;
+    unsigned int type;
+
+    if (!PACKET_as_length_prefixed_2(pkt, &list)
+            || PACKET_remaining(&list) == 0) {
+        SSLfatal(s, SSL_AD_DECODE_ERROR, SSL_F_TLS_PARSE_CTOS_CACHED_INFO,
+                 SSL_R_BAD_EXTENSION);
+        return 0;
+    }
+
+    while (PACKET_remaining(&list) > 0) {
+        if (!PACKET_get_1(&list, &type)
+                || !PACKET_get_length_prefixed_1(&list, &hash)
+                || PACKET_remaining(&hash) == 0) {
+            SSLfatal(s, SSL_AD_DECODE_ERROR, SSL_F_TLS_PARSE_CTOS_CACHED_INFO,
+                     SSL_R_BAD_EXTENSION);
+            return 0;
+        }
+        /*
+         * Other types and hash lengths cannot match anything we send. We only
+         * remember the first certificate chain that the client has cached.
+         */
+        if (type != TLSEXT_cached_info_cert || s->ext.cached_info_offered
+                || !PACKET_copy_bytes(&hash, s->ext.cached_info_hash,
+                                      sizeof(s->ext.cached_info_hash))
+                || PACKET_remaining(&hash) != 0)
+            continue;
+        s->ext.cached_info_offered = 1;
+    }
+
+    return 1;
+}
+
 
 int tls_parse_ctos_early_data(SSL *s, PACKET *pkt, unsigned int context,
                               X509 *x, size_t chainidx)
@@ -1720,6 +1780,60 @@ EXT_RETURN tls_construct_stoc_ems(SSL *s, WPACKET *pkt, unsigned int context,
     return EXT_RETURN_SENT;
 }
 
+EXT_RETURN tls_construct_stoc_cached_info(SSL *s, WPACKET *pkt,
+                                          unsigned int context, X509 *x,
+                                          size_t chainidx)
+{
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    CERT_PKEY *cpk = s->s3->tmp.cert;
+    custom_ext_methods *exts = &s->cert->custext;
+    size_t i;
+
+    if (!s->ext.cached_info_offered || s->hit || cpk == NULL)
+        return EXT_RETURN_NOT_SENT;
+    if (!SSL_IS_TLS13(s)
+            && (s->s3->tmp.new_cipher->algorithm_auth
+                & (SSL_aNULL | SSL_aSRP | SSL_aPSK)) != 0)
+        return EXT_RETURN_NOT_SENT;
+
+    /*
+     * A TLSv1.3 Certificate message may carry per certificate extensions,
+     * which the client could not recover from the hash alone.
+     */
+    if (SSL_IS_TLS13(s)) {
+        if (s->ext.status_expected)
+            return EXT_RETURN_NOT_SENT;
+        for (i = 0; i < exts->meths_count; i++) {
+            if ((exts->meths[i].context & SSL_EXT_TLS1_3_CERTIFICATE) != 0)
+                return EXT_RETURN_NOT_SENT;
+        }
+    }
+
+    if (!cached_info_chain_hash(s, cpk, hash)) {
+        /* SSLfatal() already called */
+        return EXT_RETURN_FAIL;
+    }
+    cached_info_note(s, 0);
+    if (CRYPTO_memcmp(hash, s->ext.cached_info_hash, sizeof(hash)) != 0)
+        return EXT_RETURN_NOT_SENT;
+
+    if (!WPACKET_put_bytes_u16(pkt, TLSEXT_TYPE_cached_info)
+            || !WPACKET_start_sub_packet_u16(pkt)
+            || !WPACKET_start_sub_packet_u16(pkt)
+            || !WPACKET_put_bytes_u8(pkt, TLSEXT_cached_info_cert)
+            || !WPACKET_close(pkt)
+            || !WPACKET_close(pkt)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                 SSL_F_TLS_CONSTRUCT_STOC_CACHED_INFO, ERR_R_INTERNAL_ERROR);
+        return EXT_RETURN_FAIL;
+    }
+
+    s->ext.cached_info_used = 1;
+    cached_info_note(s, 1);
+
+    return EXT_RETURN_SENT;
+}
+
 EXT_RETURN tls_construct_stoc_supported_versions(SSL *s, WPACKET *pkt,
                                                  unsigned int context, X509 *x,
                                                  size_t chainidx)
@@ -1749,12 +1863,14 @@ EXT_RETURN tls_construct_stoc_key_share(SSL *s, WPACKET *pkt,
                                         size_t chainidx)
 {
 #ifndef OPENSSL_NO_TLS1_3
-    unsigned char *encodedPoint = NULL, *classical_encodedPoint = NULL, *oqs_encodedPoint = NULL;
-    size_t encoded_pt_len = 0;
-    uint16_t classical_encoded_pt_len = 0, oqs_encoded_pt_len = 0;
+    unsigned char *classical_encodedPoint = NULL, *oqs_encodedPoint = NULL;
+    size_t classical_encoded_pt_len = 0;
     unsigned char* shared_secret = NULL, *oqs_shared_secret = NULL;
     size_t shared_secret_len = 0, oqs_shared_secret_len = 0;
     EVP_PKEY *ckey = s->s3->peer_tmp, *skey = NULL;
+    const OQS_KEM *oqs_kem = NULL;
+    OQS_KEM_JOB kem_job;
+    uint64_t phase_start;
     int do_pqc = 0; /* 1 if post-quantum alg, 0 otherwise */
     int do_hybrid = 0; /* 1 if post-quantum hybrid alg, 0 otherwise */
 
@@ -1786,22 +1902,28 @@ EXT_RETURN tls_construct_stoc_key_share(SSL *s, WPACKET *pkt,
         return EXT_RETURN_NOT_SENT;
     }
 
-    if (!WPACKET_put_bytes_u16(pkt, TLSEXT_TYPE_key_share)
-            || !WPACKET_start_sub_packet_u16(pkt)
-            || !WPACKET_put_bytes_u16(pkt, s->s3->group_id)) {
+    do_pqc = IS_OQS_KEM_CURVEID(s->s3->group_id);
+    do_hybrid = IS_OQS_KEM_HYBRID_CURVEID(s->s3->group_id);
+    if (do_pqc || do_hybrid) {
+      /* This is a group handled by OQS: look up the kex */
+      oqs_kem = ssl_get_oqs_kem(oqs_kem_group_nid(s->s3->group_id));
+      if (oqs_kem == NULL) {
+        /* TODO: provide a better error message for non-enabled OQS schemes.
+           Perhaps even check if the alg is available earlier in the stack. (FIXMEOQS) */
         SSLfatal(s, SSL_AD_INTERNAL_ERROR,
                  SSL_F_TLS_CONSTRUCT_STOC_KEY_SHARE, ERR_R_INTERNAL_ERROR);
         return EXT_RETURN_FAIL;
+      }
     }
 
-    do_pqc = IS_OQS_KEM_CURVEID(s->s3->group_id);
-    do_hybrid = IS_OQS_KEM_HYBRID_CURVEID(s->s3->group_id);
     if (!do_pqc || do_hybrid) {
+      phase_start = ssl_hs_phase_start(s);
       skey = ssl_generate_pkey(ckey);
+      ssl_hs_phase_end(s, SSL_HS_PHASE_KEYGEN, phase_start);
       if (skey == NULL) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS_CONSTRUCT_STOC_KEY_SHARE,
                  ERR_R_MALLOC_FAILURE);
-        return EXT_RETURN_FAIL;
+        goto err;
       }
 
       /* Generate encoding of server key */
@@ -1809,8 +1931,7 @@ EXT_RETURN tls_construct_stoc_key_share(SSL *s, WPACKET *pkt,
       if (classical_encoded_pt_len == 0) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS_CONSTRUCT_STOC_KEY_SHARE,
                  ERR_R_EC_LIB);
-        EVP_PKEY_free(skey);
-        return EXT_RETURN_FAIL;
+        goto err;
       }
 
       /* this code has been moved up from the bottom of the function, because
@@ -1819,37 +1940,51 @@ EXT_RETURN tls_construct_stoc_key_share(SSL *s, WPACKET *pkt,
          shared key will be store in s->s3->tmp.pms */
       if (ssl_derive(s, skey, ckey, do_hybrid ? 0 : 1) == 0) {
         /* SSLfatal() already called */
-        return EXT_RETURN_FAIL;
+        goto err;
       }
 
     }
 
-    if (do_pqc || do_hybrid) {
-      /* This is a group handled by OQS */
-      int oqs_nid = OQS_KEM_NID(s->s3->group_id);
-      OQS_KEM* oqs_kem = NULL;
+    /*
+     * Write our KeyShareEntry. The OQS ciphertext is encapsulated directly
+     * into the space reserved for it in the packet below.
+     */
+    if (!WPACKET_put_bytes_u16(pkt, TLSEXT_TYPE_key_share)
+            || !WPACKET_start_sub_packet_u16(pkt)
+            || !WPACKET_put_bytes_u16(pkt, s->s3->group_id)
+            || !OQS_put_key_share(pkt, classical_encodedPoint,
+                                  classical_encoded_pt_len,
+                                  oqs_kem != NULL ? &oqs_encodedPoint : NULL,
+                                  oqs_kem != NULL ? oqs_kem->length_ciphertext : 0)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS_CONSTRUCT_STOC_KEY_SHARE,
+                 ERR_R_INTERNAL_ERROR);
+        goto err;
+    }
+    OPENSSL_free(classical_encodedPoint);
+    classical_encodedPoint = NULL;
+
+    if (oqs_kem != NULL) {
       unsigned char* client_msg = s->s3->tmp.oqs_kem_client;
       int has_error = 0;
-      const char* oqs_alg_name = OQS_ALG_NAME(oqs_nid);
-      /* initialize the kex */
-      if ((oqs_kem = OQS_KEM_new(oqs_alg_name)) == NULL) {
-        /* TODO: provide a better error message for non-enabled OQS schemes.
-           Perhaps even check if the alg is available earlier in the stack. (FIXMEOQS) */
+      /* compute the servers's shared secret and message */
+      phase_start = ssl_hs_phase_start(s);
+      if ((oqs_shared_secret = malloc(oqs_kem->length_shared_secret)) == NULL) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR,
                  SSL_F_TLS_CONSTRUCT_STOC_KEY_SHARE, ERR_R_INTERNAL_ERROR);
         has_error = 1;
         goto oqs_cleanup;
       }
-      /* compute the servers's shared secret and message (encoded in encoded_point) */
-      if ((oqs_encodedPoint = malloc(oqs_kem->length_ciphertext)) == NULL ||
-          (oqs_shared_secret = malloc(oqs_kem->length_shared_secret)) == NULL ||
-          OQS_KEM_encaps(oqs_kem, oqs_encodedPoint, oqs_shared_secret, client_msg) != OQS_SUCCESS) {
+      kem_job.kem = oqs_kem;
+      kem_job.public_key = client_msg;
+      kem_job.ciphertext = oqs_encodedPoint;
+      kem_job.shared_secret = oqs_shared_secret;
+      if (!EVP_run_oqs_op(oqs_kem_encaps_job, &kem_job)) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR,
                  SSL_F_TLS_CONSTRUCT_STOC_KEY_SHARE, ERR_R_INTERNAL_ERROR);
         has_error = 1;
         goto oqs_cleanup;
       }
-      oqs_encoded_pt_len = oqs_kem->length_ciphertext;
+      ssl_hs_phase_end(s, SSL_HS_PHASE_ENCAPS, phase_start);
       oqs_shared_secret_len = oqs_kem->length_shared_secret;
 
         /* derive the ssl secret */
@@ -1888,39 +2023,22 @@ EXT_RETURN tls_construct_stoc_key_share(SSL *s, WPACKET *pkt,
       }
     oqs_cleanup:
       OQS_MEM_secure_free(shared_secret, shared_secret_len);
-      OQS_KEM_free(oqs_kem);
+      if (oqs_shared_secret != shared_secret)
+        OQS_MEM_secure_free(oqs_shared_secret, oqs_kem->length_shared_secret);
       OPENSSL_free(s->s3->tmp.oqs_kem_client);
+      s->s3->tmp.oqs_kem_client = NULL;
       if (has_error) {
+        EVP_PKEY_free(skey);
         return EXT_RETURN_FAIL;
       }
     }
 
-    if (do_hybrid) {
-      uint16_t encoded_pt_len16;
-      int ret = OQS_encode_hybrid_message(classical_encodedPoint, classical_encoded_pt_len, oqs_encodedPoint, oqs_encoded_pt_len, &encodedPoint, &encoded_pt_len16);
-      encoded_pt_len = encoded_pt_len16;
-      OPENSSL_free(classical_encodedPoint);
-      OPENSSL_free(oqs_encodedPoint);
-      if (!ret) {
-        return EXT_RETURN_FAIL;
-      }
-    } else if (do_pqc) {
-      encodedPoint = oqs_encodedPoint;
-      encoded_pt_len = oqs_encoded_pt_len;
-    } else {
-      encodedPoint = classical_encodedPoint;
-      encoded_pt_len = classical_encoded_pt_len;
-    }
-
-    if (!WPACKET_sub_memcpy_u16(pkt, encodedPoint, encoded_pt_len)
-            || !WPACKET_close(pkt)) {
+    if (!WPACKET_close(pkt)) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS_CONSTRUCT_STOC_KEY_SHARE,
                  ERR_R_INTERNAL_ERROR);
         EVP_PKEY_free(skey);
-        OPENSSL_free(encodedPoint);
         return EXT_RETURN_FAIL;
     }
-    OPENSSL_free(encodedPoint);
 
     /* This causes the crypto state to be updated based on the derived keys */
     s->s3->tmp.pkey = skey;
@@ -1933,6 +2051,10 @@ EXT_RETURN tls_construct_stoc_key_share(SSL *s, WPACKET *pkt,
     }
     */
     return EXT_RETURN_SENT;
+ err:
+    OPENSSL_free(classical_encodedPoint);
+    EVP_PKEY_free(skey);
+    return EXT_RETURN_FAIL;
 #else
     return EXT_RETURN_FAIL;
 #endif
@@ -100,6 +100,15 @@ void ossl_statem_clear(SSL *s)
     s->statem.hand_state = TLS_ST_BEFORE;
     s->statem.in_init = 1;
     s->statem.no_cert_verify = 0;
+    if (s->statem.flight != NULL)
+        s->statem.flight->length = 0;
+    s->statem.flight_off = 0;
+}
+
+void ossl_statem_free(SSL *s)
+{
+    BUF_MEM_free(s->statem.flight);
+    s->statem.flight = NULL;
 }
 
 /*
@@ -346,6 +355,8 @@ static int state_machine(SSL *s, int server)
             if (SSL_IS_FIRST_HANDSHAKE(s) || !SSL_IS_TLS13(s))
                 cb(s, SSL_CB_HANDSHAKE_START, 1);
         }
+        if (SSL_IS_FIRST_HANDSHAKE(s) || !SSL_IS_TLS13(s))
+            ssl_hs_timing_begin(s);
 
         /*
          * Fatal errors in this block don't send an alert because we have
@@ -569,6 +580,7 @@ static SUB_STATE_RETURN read_state_machine(SSL *s)
     while (1) {
         switch (st->read_state) {
         case READ_STATE_HEADER:
+            ssl_hs_timing_wait_start(s);
             /* Get the state the peer wants to move to */
             if (SSL_IS_DTLS(s)) {
                 /*
@@ -583,6 +595,7 @@ static SUB_STATE_RETURN read_state_machine(SSL *s)
                 /* Could be non-blocking IO */
                 return SUB_STATE_ERROR;
             }
+            ssl_hs_timing_wait_end(s);
 
             if (cb != NULL) {
                 /* Notify callback of an impending state change */
@@ -597,6 +610,7 @@ static SUB_STATE_RETURN read_state_machine(SSL *s)
              */
             if (!transition(s, mt))
                 return SUB_STATE_ERROR;
+            ssl_hs_timing_transition(s);
 
             if (s->s3->tmp.message_size > max_message_size(s)) {
                 SSLfatal(s, SSL_AD_ILLEGAL_PARAMETER, SSL_F_READ_STATE_MACHINE,
@@ -628,6 +642,11 @@ static SUB_STATE_RETURN read_state_machine(SSL *s)
             }
 
             s->first_packet = 0;
+            /* A ChangeCipherSpec isn't a handshake message */
+            if (s->s3->tmp.message_type != SSL3_MT_CHANGE_CIPHER_SPEC)
+                ssl_hs_timing_message(s, 0, len + (SSL_IS_DTLS(s)
+                                                   ? DTLS1_HM_HEADER_LENGTH
+                                                   : SSL3_HM_HEADER_LENGTH));
             if (!PACKET_buf_init(&pkt, s->init_msg, len)) {
                 SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_READ_STATE_MACHINE,
                          ERR_R_INTERNAL_ERROR);
@@ -703,13 +722,35 @@ static int statem_do_write(SSL *s)
         || st->hand_state == TLS_ST_SW_CHANGE) {
         if (SSL_IS_DTLS(s))
             return dtls1_do_write(s, SSL3_RT_CHANGE_CIPHER_SPEC);
-        else
-            return ssl3_do_write(s, SSL3_RT_CHANGE_CIPHER_SPEC);
+        /* Queued handshake messages go before the ChangeCipherSpec */
+        if (ssl3_write_flight(s) <= 0)
+            return -1;
+        return ssl3_do_write(s, SSL3_RT_CHANGE_CIPHER_SPEC);
+    } else if ((s->mode & SSL_MODE_COALESCE_FLIGHTS) != 0
+               && !SSL_IS_DTLS(s)) {
+        return ssl3_queue_handshake(s);
     } else {
         return ssl_do_write(s);
     }
 }
 
+/*
+ * Whether the post work for the message just sent can change the write keys
+ * without first flushing, so that any queued flight must be sent before it.
+ */
+static int statem_keys_change_after(SSL *s)
+{
+    switch (s->statem.hand_state) {
+    case TLS_ST_CW_CLNT_HELLO:
+    case TLS_ST_CW_END_OF_EARLY_DATA:
+        return 1;
+    case TLS_ST_SW_SRVR_HELLO:
+        return SSL_IS_TLS13(s);
+    default:
+        return 0;
+    }
+}
+
 /*
  * Initialise the MSG_FLOW_WRITING sub-state machine
  */
@@ -792,6 +833,7 @@ static SUB_STATE_RETURN write_state_machine(SSL *s)
             }
             switch (transition(s)) {
             case WRITE_TRAN_CONTINUE:
+                ssl_hs_timing_transition(s);
                 st->write_state = WRITE_STATE_PRE_WORK;
                 st->write_state_work = WORK_MORE_A;
                 break;
@@ -852,6 +894,8 @@ static SUB_STATE_RETURN write_state_machine(SSL *s)
                          ERR_R_INTERNAL_ERROR);
                 return SUB_STATE_ERROR;
             }
+            if (mt != SSL3_MT_CHANGE_CIPHER_SPEC)
+                ssl_hs_timing_message(s, 1, s->init_num);
 
             /* Fall through */
 
@@ -868,6 +912,8 @@ static SUB_STATE_RETURN write_state_machine(SSL *s)
             /* Fall through */
 
         case WRITE_STATE_POST_WORK:
+            if (statem_keys_change_after(s) && ssl3_write_flight(s) <= 0)
+                return SUB_STATE_ERROR;
             switch (st->write_state_work = post_work(s, st->write_state_work)) {
             case WORK_ERROR:
                 check_fatal(s, SSL_F_WRITE_STATE_MACHINE);
@@ -899,6 +945,8 @@ static SUB_STATE_RETURN write_state_machine(SSL *s)
  */
 int statem_flush(SSL *s)
 {
+    if (ssl3_write_flight(s) <= 0)
+        return 0;
     s->rwstate = SSL_WRITING;
     if (BIO_flush(s->wbio) <= 0) {
         return 0;
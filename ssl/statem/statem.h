@@ -118,6 +118,9 @@ struct ossl_statem_st {
     int use_timer;
     ENC_WRITE_STATES enc_write_state;
     ENC_READ_STATES enc_read_state;
+    /* Handshake messages queued under SSL_MODE_COALESCE_FLIGHTS */
+    BUF_MEM *flight;
+    size_t flight_off;
 };
 typedef struct ossl_statem_st OSSL_STATEM;
 
@@ -155,3 +158,4 @@ __owur int ossl_statem_export_early_allowed(SSL *s);
 
 /* Flush the write BIO */
 int statem_flush(SSL *s);
+void ossl_statem_free(SSL *s);
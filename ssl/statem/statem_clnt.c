@@ -125,7 +125,7 @@ static int ossl_statem_client13_read_transition(SSL *s, int mt)
                 st->hand_state = TLS_ST_CR_CERT_REQ;
                 return 1;
             }
-            if (mt == SSL3_MT_CERTIFICATE) {
+            if (tls13_is_certificate_msg(s, mt)) {
                 st->hand_state = TLS_ST_CR_CERT;
                 return 1;
             }
@@ -133,7 +133,7 @@ static int ossl_statem_client13_read_transition(SSL *s, int mt)
         break;
 
     case TLS_ST_CR_CERT_REQ:
-        if (mt == SSL3_MT_CERTIFICATE) {
+        if (tls13_is_certificate_msg(s, mt)) {
             st->hand_state = TLS_ST_CR_CERT;
             return 1;
         }
@@ -919,8 +919,13 @@ int ossl_statem_client_construct_message(SSL *s, WPACKET *pkt,
         break;
 
     case TLS_ST_CW_CERT:
-        *confunc = tls_construct_client_certificate;
-        *mt = SSL3_MT_CERTIFICATE;
+        if (s->ext.cert_comp_tx != TLSEXT_comp_cert_none) {
+            *confunc = tls_construct_client_compressed_certificate;
+            *mt = SSL3_MT_COMPRESSED_CERTIFICATE;
+        } else {
+            *confunc = tls_construct_client_certificate;
+            *mt = SSL3_MT_CERTIFICATE;
+        }
         break;
 
     case TLS_ST_CW_KEY_EXCH:
@@ -1041,6 +1046,11 @@ MSG_PROCESS_RETURN ossl_statem_client_process_message(SSL *s, PACKET *pkt)
         return dtls_process_hello_verify(s, pkt);
 
     case TLS_ST_CR_CERT:
+        if (s->ext.cached_info_used)
+            return tls_process_cached_server_certificate(s, pkt);
+        if (s->s3->tmp.message_type == SSL3_MT_COMPRESSED_CERTIFICATE)
+            return tls13_process_compressed_certificate(s, pkt,
+                    tls_process_server_certificate);
         return tls_process_server_certificate(s, pkt);
 
     case TLS_ST_CR_CERT_VRFY:
@@ -1990,6 +2000,60 @@ MSG_PROCESS_RETURN tls_process_server_certificate(SSL *s, PACKET *pkt)
     return ret;
 }
 
+/*
+ * Processes a Certificate message that holds just the hash of the chain that
+ * we offered in the cached_info extension (RFC7924). The chain is rebuilt from
+ * our copy and processed as if the server had sent it.
+ */
+MSG_PROCESS_RETURN tls_process_cached_server_certificate(SSL *s, PACKET *pkt)
+{
+    PACKET hash, cert;
+    BUF_MEM *buf = NULL;
+    WPACKET wpkt;
+    size_t len;
+    MSG_PROCESS_RETURN ret;
+
+    if (s->s3->tmp.message_type != SSL3_MT_CERTIFICATE
+            || !PACKET_get_length_prefixed_1(pkt, &hash)
+            || PACKET_remaining(pkt) != 0) {
+        SSLfatal(s, SSL_AD_DECODE_ERROR,
+                 SSL_F_TLS_PROCESS_CACHED_SERVER_CERTIFICATE,
+                 SSL_R_LENGTH_MISMATCH);
+        return MSG_PROCESS_ERROR;
+    }
+    if (!PACKET_equal(&hash, s->ext.cached_info_hash,
+                      sizeof(s->ext.cached_info_hash))) {
+        SSLfatal(s, SSL_AD_ILLEGAL_PARAMETER,
+                 SSL_F_TLS_PROCESS_CACHED_SERVER_CERTIFICATE,
+                 SSL_R_CACHED_INFO_MISMATCH);
+        return MSG_PROCESS_ERROR;
+    }
+
+    if ((buf = BUF_MEM_new()) == NULL
+            || !WPACKET_init(&wpkt, buf)) {
+        BUF_MEM_free(buf);
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                 SSL_F_TLS_PROCESS_CACHED_SERVER_CERTIFICATE,
+                 ERR_R_MALLOC_FAILURE);
+        return MSG_PROCESS_ERROR;
+    }
+    if (!cached_info_construct_certificate(s, &wpkt)
+            || !WPACKET_get_total_written(&wpkt, &len)
+            || !WPACKET_finish(&wpkt)
+            || !PACKET_buf_init(&cert, (unsigned char *)buf->data, len)) {
+        WPACKET_cleanup(&wpkt);
+        BUF_MEM_free(buf);
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                 SSL_F_TLS_PROCESS_CACHED_SERVER_CERTIFICATE,
+                 ERR_R_INTERNAL_ERROR);
+        return MSG_PROCESS_ERROR;
+    }
+
+    ret = tls_process_server_certificate(s, &cert);
+    BUF_MEM_free(buf);
+    return ret;
+}
+
 static int tls_process_ske_psk_preamble(SSL *s, PACKET *pkt)
 {
 #ifndef OPENSSL_NO_PSK
@@ -2262,6 +2326,7 @@ MSG_PROCESS_RETURN tls_process_key_exchange(SSL *s, PACKET *pkt)
     EVP_MD_CTX *md_ctx = NULL;
     EVP_PKEY_CTX *pctx = NULL;
     PACKET save_param_start, signature;
+    uint64_t phase_start;
 
     alg_k = s->s3->tmp.new_cipher->algorithm_mkey;
 
@@ -2403,8 +2468,10 @@ MSG_PROCESS_RETURN tls_process_key_exchange(SSL *s, PACKET *pkt)
             goto err;
         }
 
+        phase_start = ssl_hs_phase_start(s);
         rv = EVP_DigestVerify(md_ctx, PACKET_data(&signature),
                               PACKET_remaining(&signature), tbs, tbslen);
+        ssl_hs_phase_end(s, SSL_HS_PHASE_VERIFY, phase_start);
         OPENSSL_free(tbs);
         if (rv <= 0) {
             SSLfatal(s, SSL_AD_DECRYPT_ERROR, SSL_F_TLS_PROCESS_KEY_EXCHANGE,
@@ -3063,6 +3130,7 @@ static int tls_construct_cke_dhe(SSL *s, WPACKET *pkt)
     const BIGNUM *pub_key;
     EVP_PKEY *ckey = NULL, *skey = NULL;
     unsigned char *keybytes = NULL;
+    uint64_t phase_start;
 
     skey = s->s3->peer_tmp;
     if (skey == NULL) {
@@ -3071,7 +3139,9 @@ static int tls_construct_cke_dhe(SSL *s, WPACKET *pkt)
         goto err;
     }
 
+    phase_start = ssl_hs_phase_start(s);
     ckey = ssl_generate_pkey(skey);
+    ssl_hs_phase_end(s, SSL_HS_PHASE_KEYGEN, phase_start);
     if (ckey == NULL) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS_CONSTRUCT_CKE_DHE,
                  ERR_R_INTERNAL_ERROR);
@@ -3121,6 +3191,7 @@ static int tls_construct_cke_ecdhe(SSL *s, WPACKET *pkt)
     size_t encoded_pt_len = 0;
     EVP_PKEY *ckey = NULL, *skey = NULL;
     int ret = 0;
+    uint64_t phase_start;
 
     skey = s->s3->peer_tmp;
     if (skey == NULL) {
@@ -3129,7 +3200,9 @@ static int tls_construct_cke_ecdhe(SSL *s, WPACKET *pkt)
         return 0;
     }
 
+    phase_start = ssl_hs_phase_start(s);
     ckey = ssl_generate_pkey(skey);
+    ssl_hs_phase_end(s, SSL_HS_PHASE_KEYGEN, phase_start);
     if (ckey == NULL) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS_CONSTRUCT_CKE_ECDHE,
                  ERR_R_MALLOC_FAILURE);
@@ -3576,6 +3649,12 @@ int tls_construct_client_certificate(SSL *s, WPACKET *pkt)
     return 1;
 }
 
+int tls_construct_client_compressed_certificate(SSL *s, WPACKET *pkt)
+{
+    return tls13_construct_compressed_certificate(s, pkt,
+                                            tls_construct_client_certificate);
+}
+
 int ssl3_check_cert_and_algorithm(SSL *s)
 {
     const SSL_CERT_LOOKUP *clu;
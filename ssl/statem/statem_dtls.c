@@ -53,41 +53,34 @@ static void dtls1_set_message_header_int(SSL *s, unsigned char mt,
                                          size_t frag_len);
 static int dtls_get_reassembled_message(SSL *s, int *errtype, size_t *len);
 
+/*
+ * Allocates a fragment together with its |frag_len| byte buffer and, if
+ * |reassembly| is set, its reassembly bitmask, so that a message arriving in
+ * many pieces costs one allocation rather than three.
+ */
 static hm_fragment *dtls1_hm_fragment_new(size_t frag_len, int reassembly)
 {
     hm_fragment *frag = NULL;
-    unsigned char *buf = NULL;
-    unsigned char *bitmask = NULL;
+    size_t bitmask_len = reassembly ? RSMBLY_BITMASK_SIZE(frag_len) : 0;
 
-    if ((frag = OPENSSL_malloc(sizeof(*frag))) == NULL) {
+    if (frag_len > SIZE_MAX - sizeof(*frag) - bitmask_len
+            || (frag = OPENSSL_malloc(sizeof(*frag) + frag_len
+                                      + bitmask_len)) == NULL) {
         SSLerr(SSL_F_DTLS1_HM_FRAGMENT_NEW, ERR_R_MALLOC_FAILURE);
         return NULL;
     }
 
-    if (frag_len) {
-        if ((buf = OPENSSL_malloc(frag_len)) == NULL) {
-            SSLerr(SSL_F_DTLS1_HM_FRAGMENT_NEW, ERR_R_MALLOC_FAILURE);
-            OPENSSL_free(frag);
-            return NULL;
-        }
-    }
-
     /* zero length fragment gets zero frag->fragment */
-    frag->fragment = buf;
+    frag->fragment = frag_len > 0 ? (unsigned char *)(frag + 1) : NULL;
 
     /* Initialize reassembly bitmask if necessary */
     if (reassembly) {
-        bitmask = OPENSSL_zalloc(RSMBLY_BITMASK_SIZE(frag_len));
-        if (bitmask == NULL) {
-            SSLerr(SSL_F_DTLS1_HM_FRAGMENT_NEW, ERR_R_MALLOC_FAILURE);
-            OPENSSL_free(buf);
-            OPENSSL_free(frag);
-            return NULL;
-        }
+        frag->reassembly = (unsigned char *)(frag + 1) + frag_len;
+        memset(frag->reassembly, 0, bitmask_len);
+    } else {
+        frag->reassembly = NULL;
     }
 
-    frag->reassembly = bitmask;
-
     return frag;
 }
 
@@ -100,8 +93,6 @@ void dtls1_hm_fragment_free(hm_fragment *frag)
                             saved_retransmit_state.enc_write_ctx);
         EVP_MD_CTX_free(frag->msg_header.saved_retransmit_state.write_hash);
     }
-    OPENSSL_free(frag->fragment);
-    OPENSSL_free(frag->reassembly);
     OPENSSL_free(frag);
 }
 
@@ -605,10 +596,9 @@ dtls1_reassemble_fragment(SSL *s, const struct hm_header_st *msg_hdr)
     RSMBLY_BITMASK_IS_COMPLETE(frag->reassembly, (long)msg_hdr->msg_len,
                                is_complete);
 
-    if (is_complete) {
-        OPENSSL_free(frag->reassembly);
+    /* The bitmask was allocated with |frag|, so there is nothing to free */
+    if (is_complete)
         frag->reassembly = NULL;
-    }
 
     if (item == NULL) {
         item = pitem_new(seq64be, frag);
@@ -19,6 +19,9 @@
 #include <openssl/evp.h>
 #include <openssl/x509.h>
 
+/* Room in a coalesced flight's write buffer for what was written before it */
+#define FLIGHT_BUFFER_SLACK             4096
+
 /*
  * Map error codes to TLS/SSL alart types.
  */
@@ -34,6 +37,19 @@ const unsigned char hrrrandom[] = {
     0x07, 0x9e, 0x09, 0xe2, 0xc8, 0xa8, 0x33, 0x9c
 };
 
+/*
+ * Whether the handshake message being written goes into the transcript. This
+ * should not be done for 'Hello Request's, but in that case we'll ignore the
+ * result anyway. TLS1.3 KeyUpdate and NewSessionTicket do not need to be added
+ */
+static int ssl3_in_transcript(SSL *s)
+{
+    return !SSL_IS_TLS13(s)
+           || (s->statem.hand_state != TLS_ST_SW_SESSION_TICKET
+               && s->statem.hand_state != TLS_ST_CW_KEY_UPDATE
+               && s->statem.hand_state != TLS_ST_SW_KEY_UPDATE);
+}
+
 /*
  * send s->init_buf in records of type 'type' (SSL3_RT_HANDSHAKE or
  * SSL3_RT_CHANGE_CIPHER_SPEC)
@@ -47,19 +63,11 @@ int ssl3_do_write(SSL *s, int type)
                            s->init_num, &written);
     if (ret < 0)
         return -1;
-    if (type == SSL3_RT_HANDSHAKE)
-        /*
-         * should not be done for 'Hello Request's, but in that case we'll
-         * ignore the result anyway
-         * TLS1.3 KeyUpdate and NewSessionTicket do not need to be added
-         */
-        if (!SSL_IS_TLS13(s) || (s->statem.hand_state != TLS_ST_SW_SESSION_TICKET
-                                 && s->statem.hand_state != TLS_ST_CW_KEY_UPDATE
-                                 && s->statem.hand_state != TLS_ST_SW_KEY_UPDATE))
-            if (!ssl3_finish_mac(s,
-                                 (unsigned char *)&s->init_buf->data[s->init_off],
-                                 written))
-                return -1;
+    if (type == SSL3_RT_HANDSHAKE && ssl3_in_transcript(s)
+            && !ssl3_finish_mac(s,
+                                (unsigned char *)&s->init_buf->data[s->init_off],
+                                written))
+        return -1;
     if (written == s->init_num) {
         if (s->msg_callback)
             s->msg_callback(1, s->version, type, s->init_buf->data,
@@ -72,6 +80,80 @@ int ssl3_do_write(SSL *s, int type)
     return 0;
 }
 
+/*
+ * Appends the handshake message in s->init_buf to the flight being collected
+ * under SSL_MODE_COALESCE_FLIGHTS, to be sent by ssl3_write_flight().
+ */
+int ssl3_queue_handshake(SSL *s)
+{
+    BUF_MEM *flight = s->statem.flight;
+    const unsigned char *msg =
+        (unsigned char *)&s->init_buf->data[s->init_off];
+    size_t len;
+
+    if (flight == NULL && (flight = s->statem.flight = BUF_MEM_new()) == NULL) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_QUEUE_HANDSHAKE,
+                 ERR_R_MALLOC_FAILURE);
+        return -1;
+    }
+    len = flight->length;
+    if (!BUF_MEM_grow(flight, len + s->init_num)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_QUEUE_HANDSHAKE,
+                 ERR_R_MALLOC_FAILURE);
+        return -1;
+    }
+    memcpy(flight->data + len, msg, s->init_num);
+
+    if (ssl3_in_transcript(s) && !ssl3_finish_mac(s, msg, s->init_num))
+        return -1;
+    if (s->msg_callback)
+        s->msg_callback(1, s->version, SSL3_RT_HANDSHAKE, s->init_buf->data,
+                        (size_t)(s->init_off + s->init_num), s,
+                        s->msg_callback_arg);
+    return 1;
+}
+
+/*
+ * Sends the flight queued by ssl3_queue_handshake(), if any, in records that
+ * are as full as the maximum fragment length allows. Returns 1 once all of
+ * it has been written or <= 0 if the write needs to be retried.
+ */
+int ssl3_write_flight(SSL *s)
+{
+    BUF_MEM *flight = s->statem.flight;
+    size_t written;
+
+    if (flight == NULL || flight->length == 0)
+        return 1;
+
+    if (s->statem.flight_off == 0) {
+        size_t frag = ssl_get_max_send_fragment(s);
+        size_t size = FLIGHT_BUFFER_SLACK + flight->length
+                      + (flight->length / frag + 1)
+                        * (SSL3_RT_HEADER_LENGTH
+                           + SSL3_RT_MAX_ENCRYPTED_OVERHEAD);
+
+        /* Remembered so that later handshakes buffer a flight this large */
+        if (CRYPTO_THREAD_write_lock(s->ctx->lock)) {
+            if (size > s->ctx->flight_buffer_size)
+                s->ctx->flight_buffer_size = size;
+            CRYPTO_THREAD_unlock(s->ctx->lock);
+        }
+    }
+
+    while (s->statem.flight_off < flight->length) {
+        if (ssl3_write_bytes(s, SSL3_RT_HANDSHAKE,
+                             flight->data + s->statem.flight_off,
+                             flight->length - s->statem.flight_off,
+                             &written) <= 0)
+            return -1;
+        s->statem.flight_off += written;
+    }
+    flight->length = 0;
+    s->statem.flight_off = 0;
+    return 1;
+}
+
 int tls_close_construct_packet(SSL *s, WPACKET *pkt, int htype)
 {
     size_t msglen;
@@ -95,6 +177,7 @@ int tls_setup_handshake(SSL *s)
 
     /* Reset any extension flags */
     memset(s->ext.extflags, 0, sizeof(s->ext.extflags));
+    s->ext.cert_comp_tx = s->ext.cert_comp_rx = TLSEXT_comp_cert_none;
 
     if (s->server) {
         STACK_OF(SSL_CIPHER) *ciphers = SSL_get_ciphers(s);
@@ -238,6 +321,7 @@ int tls_construct_cert_verify(SSL *s, WPACKET *pkt)
     unsigned char *sig = NULL;
     unsigned char tls13tbs[TLS13_TBS_PREAMBLE_SIZE + EVP_MAX_MD_SIZE];
     const SIGALG_LOOKUP *lu = s->s3->tmp.sigalg;
+    uint64_t phase_start;
 
     if (lu == NULL || s->s3->tmp.cert == NULL) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_TLS_CONSTRUCT_CERT_VERIFY,
@@ -293,6 +377,7 @@ int tls_construct_cert_verify(SSL *s, WPACKET *pkt)
             goto err;
         }
     }
+    phase_start = ssl_hs_phase_start(s);
     if (s->version == SSL3_VERSION) {
         if (EVP_DigestSignUpdate(mctx, hdata, hdatalen) <= 0
             || !EVP_MD_CTX_ctrl(mctx, EVP_CTRL_SSL3_MASTER_SECRET,
@@ -309,6 +394,7 @@ int tls_construct_cert_verify(SSL *s, WPACKET *pkt)
                  ERR_R_EVP_LIB);
         goto err;
     }
+    ssl_hs_phase_end(s, SSL_HS_PHASE_SIGN, phase_start);
 
 #ifndef OPENSSL_NO_GOST
     {
@@ -351,6 +437,7 @@ MSG_PROCESS_RETURN tls_process_cert_verify(SSL *s, PACKET *pkt)
 #endif
     MSG_PROCESS_RETURN ret = MSG_PROCESS_ERROR;
     int j;
+    uint64_t phase_start;
     unsigned int len;
     X509 *peer;
     const EVP_MD *md = NULL;
@@ -484,6 +571,7 @@ MSG_PROCESS_RETURN tls_process_cert_verify(SSL *s, PACKET *pkt)
             goto err;
         }
     }
+    phase_start = ssl_hs_phase_start(s);
     if (s->version == SSL3_VERSION) {
         if (EVP_DigestVerifyUpdate(mctx, hdata, hdatalen) <= 0
                 || !EVP_MD_CTX_ctrl(mctx, EVP_CTRL_SSL3_MASTER_SECRET,
@@ -506,6 +594,7 @@ MSG_PROCESS_RETURN tls_process_cert_verify(SSL *s, PACKET *pkt)
             goto err;
         }
     }
+    ssl_hs_phase_end(s, SSL_HS_PHASE_VERIFY, phase_start);
 
     /*
      * In TLSv1.3 on the client side we make sure we prepare the client
@@ -668,6 +757,129 @@ MSG_PROCESS_RETURN tls_process_key_update(SSL *s, PACKET *pkt)
     return MSG_PROCESS_FINISHED_READING;
 }
 
+/*
+ * Returns 1 if |mt| is a Certificate message, or a CompressedCertificate
+ * message answering a compress_certificate extension that we sent.
+ */
+int tls13_is_certificate_msg(SSL *s, int mt)
+{
+    if (mt == SSL3_MT_CERTIFICATE)
+        return 1;
+    return mt == SSL3_MT_COMPRESSED_CERTIFICATE
+           && SSL_IS_TLS13(s)
+           && (s->ext.extflags[TLSEXT_IDX_compress_certificate]
+               & SSL_EXT_FLAG_SENT) != 0;
+}
+
+/*
+ * Constructs a CompressedCertificate message (RFC8879) around the Certificate
+ * message body that |construct| produces.
+ */
+int tls13_construct_compressed_certificate(SSL *s, WPACKET *pkt,
+                                           confunc_f construct)
+{
+    BUF_MEM *buf;
+    WPACKET cert;
+    size_t len;
+    int ret = 0;
+
+    if ((buf = BUF_MEM_new()) == NULL || !WPACKET_init(&cert, buf)) {
+        BUF_MEM_free(buf);
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                 SSL_F_TLS13_CONSTRUCT_COMPRESSED_CERTIFICATE,
+                 ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+
+    if (!construct(s, &cert)) {
+        /* SSLfatal() already called */
+        WPACKET_cleanup(&cert);
+        goto err;
+    }
+    if (!WPACKET_get_total_written(&cert, &len) || !WPACKET_finish(&cert)) {
+        WPACKET_cleanup(&cert);
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                 SSL_F_TLS13_CONSTRUCT_COMPRESSED_CERTIFICATE,
+                 ERR_R_INTERNAL_ERROR);
+        goto err;
+    }
+
+    if (!ssl_cert_comp_compress(s, s->ext.cert_comp_tx,
+                                (unsigned char *)buf->data, len, pkt)) {
+        /* SSLfatal() already called */
+        goto err;
+    }
+    ret = 1;
+
+ err:
+    BUF_MEM_free(buf);
+    return ret;
+}
+
+/*
+ * Decompresses a CompressedCertificate message (RFC8879) and hands the
+ * Certificate message body within to |process|.
+ */
+MSG_PROCESS_RETURN tls13_process_compressed_certificate(SSL *s, PACKET *pkt,
+        MSG_PROCESS_RETURN (*process)(SSL *s, PACKET *pkt))
+{
+    unsigned int alg;
+    unsigned long len;
+    PACKET comp, cert;
+    unsigned char *buf;
+    MSG_PROCESS_RETURN ret;
+
+    if (!PACKET_get_net_2(pkt, &alg)
+            || !PACKET_get_net_3(pkt, &len)
+            || !PACKET_get_length_prefixed_3(pkt, &comp)
+            || PACKET_remaining(&comp) == 0
+            || PACKET_remaining(pkt) != 0) {
+        SSLfatal(s, SSL_AD_DECODE_ERROR,
+                 SSL_F_TLS13_PROCESS_COMPRESSED_CERTIFICATE,
+                 SSL_R_LENGTH_MISMATCH);
+        return MSG_PROCESS_ERROR;
+    }
+
+    /* The peer may only use an algorithm that we offered */
+    if (alg == TLSEXT_comp_cert_none || alg >= TLSEXT_comp_cert_limit
+            || memchr(s->cert_comp_prefs, alg,
+                      sizeof(s->cert_comp_prefs)) == NULL) {
+        SSLfatal(s, SSL_AD_ILLEGAL_PARAMETER,
+                 SSL_F_TLS13_PROCESS_COMPRESSED_CERTIFICATE,
+                 SSL_R_INVALID_COMPRESSION_ALGORITHM);
+        return MSG_PROCESS_ERROR;
+    }
+
+    /* Apply the same limit as to an uncompressed Certificate message */
+    if (len == 0 || len > s->max_cert_list) {
+        SSLfatal(s, SSL_AD_BAD_CERTIFICATE,
+                 SSL_F_TLS13_PROCESS_COMPRESSED_CERTIFICATE,
+                 SSL_R_EXCESSIVE_MESSAGE_SIZE);
+        return MSG_PROCESS_ERROR;
+    }
+
+    if ((buf = OPENSSL_malloc(len)) == NULL) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                 SSL_F_TLS13_PROCESS_COMPRESSED_CERTIFICATE,
+                 ERR_R_MALLOC_FAILURE);
+        return MSG_PROCESS_ERROR;
+    }
+    if (!ssl_cert_comp_expand(alg, buf, len, PACKET_data(&comp),
+                              PACKET_remaining(&comp))
+            || !PACKET_buf_init(&cert, buf, len)) {
+        OPENSSL_free(buf);
+        SSLfatal(s, SSL_AD_BAD_CERTIFICATE,
+                 SSL_F_TLS13_PROCESS_COMPRESSED_CERTIFICATE,
+                 SSL_R_BAD_DECOMPRESSION);
+        return MSG_PROCESS_ERROR;
+    }
+    s->ext.cert_comp_rx = alg;
+
+    ret = process(s, &cert);
+    OPENSSL_free(buf);
+    return ret;
+}
+
 /*
  * ssl3_take_mac calculates the Finished MAC for the handshakes messages seen
  * to far.
@@ -878,37 +1090,13 @@ int tls_construct_change_cipher_spec(SSL *s, WPACKET *pkt)
     return 1;
 }
 
-/* Add a certificate to the WPACKET */
-static int ssl_add_cert_to_wpacket(SSL *s, WPACKET *pkt, X509 *x, int chain)
-{
-    int len;
-    unsigned char *outbytes;
-
-    len = i2d_X509(x, NULL);
-    if (len < 0) {
-        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_TO_WPACKET,
-                 ERR_R_BUF_LIB);
-        return 0;
-    }
-    if (!WPACKET_sub_allocate_bytes_u24(pkt, len, &outbytes)
-            || i2d_X509(x, &outbytes) != len) {
-        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_TO_WPACKET,
-                 ERR_R_INTERNAL_ERROR);
-        return 0;
-    }
-
-    if (SSL_IS_TLS13(s)
-            && !tls_construct_extensions(s, pkt, SSL_EXT_TLS1_3_CERTIFICATE, x,
-                                         chain)) {
-        /* SSLfatal() already called */
-        return 0;
-    }
-
-    return 1;
-}
-
-/* Add certificate chain to provided WPACKET */
-static int ssl_add_cert_chain(SSL *s, WPACKET *pkt, CERT_PKEY *cpk)
+/*
+ * Calls |cb| for each certificate of the chain that would be sent for |cpk|,
+ * leaf first, with its position in the chain.
+ */
+static int ssl_walk_cert_chain(SSL *s, CERT_PKEY *cpk,
+                               int (*cb)(SSL *s, X509 *x, int idx, void *arg),
+                               void *arg)
 {
     int i, chain_count;
     X509 *x;
@@ -976,7 +1164,7 @@ static int ssl_add_cert_chain(SSL *s, WPACKET *pkt, CERT_PKEY *cpk)
         for (i = 0; i < chain_count; i++) {
             x = sk_X509_value(chain, i);
 
-            if (!ssl_add_cert_to_wpacket(s, pkt, x, i)) {
+            if (!cb(s, x, i, arg)) {
                 /* SSLfatal() already called */
                 X509_STORE_CTX_free(xs_ctx);
                 return 0;
@@ -989,13 +1177,13 @@ static int ssl_add_cert_chain(SSL *s, WPACKET *pkt, CERT_PKEY *cpk)
             SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_ADD_CERT_CHAIN, i);
             return 0;
         }
-        if (!ssl_add_cert_to_wpacket(s, pkt, x, 0)) {
+        if (!cb(s, x, 0, arg)) {
             /* SSLfatal() already called */
             return 0;
         }
         for (i = 0; i < sk_X509_num(extra_certs); i++) {
             x = sk_X509_value(extra_certs, i);
-            if (!ssl_add_cert_to_wpacket(s, pkt, x, i + 1)) {
+            if (!cb(s, x, i + 1, arg)) {
                 /* SSLfatal() already called */
                 return 0;
             }
@@ -1004,16 +1192,84 @@ static int ssl_add_cert_chain(SSL *s, WPACKET *pkt, CERT_PKEY *cpk)
     return 1;
 }
 
+static int ssl_push_cert_cb(SSL *s, X509 *x, int idx, void *arg)
+{
+    if (!sk_X509_push((STACK_OF(X509) *)arg, x)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_GET_CERT_CHAIN,
+                 ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    X509_up_ref(x);
+    return 1;
+}
+
+/*
+ * Returns in |*chain| a new stack holding references to the certificates that
+ * ssl3_output_cert_chain() would send for |cpk|, leaf first.
+ */
+int ssl_get_cert_chain(SSL *s, CERT_PKEY *cpk, STACK_OF(X509) **chain)
+{
+    STACK_OF(X509) *sk = sk_X509_new_null();
+
+    if (sk == NULL) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL_GET_CERT_CHAIN,
+                 ERR_R_MALLOC_FAILURE);
+        return 0;
+    }
+    if (!ssl_walk_cert_chain(s, cpk, ssl_push_cert_cb, sk)) {
+        /* SSLfatal() already called */
+        sk_X509_pop_free(sk, X509_free);
+        return 0;
+    }
+    *chain = sk;
+    return 1;
+}
+
 unsigned long ssl3_output_cert_chain(SSL *s, WPACKET *pkt, CERT_PKEY *cpk)
 {
+    CERT_CHAIN_DER *der = NULL;
+    PACKET certs, cert;
+    int i;
+
     if (!WPACKET_start_sub_packet_u24(pkt)) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_OUTPUT_CERT_CHAIN,
                  ERR_R_INTERNAL_ERROR);
         return 0;
     }
 
-    if (!ssl_add_cert_chain(s, pkt, cpk))
-        return 0;
+    if (cpk != NULL && cpk->x509 != NULL) {
+        /* Copy the certificates from their encoding kept in the SSL_CTX */
+        if (!ssl_cert_chain_der(s, cpk, &der)) {
+            /* SSLfatal() already called */
+            return 0;
+        }
+        if (!PACKET_buf_init(&certs, der->der, der->derlen)) {
+            ssl_cert_chain_der_free(der);
+            SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_OUTPUT_CERT_CHAIN,
+                     ERR_R_INTERNAL_ERROR);
+            return 0;
+        }
+        for (i = 0; PACKET_remaining(&certs) > 0; i++) {
+            if (!PACKET_get_length_prefixed_3(&certs, &cert)
+                    || !WPACKET_sub_memcpy_u24(pkt, PACKET_data(&cert),
+                                               PACKET_remaining(&cert))) {
+                ssl_cert_chain_der_free(der);
+                SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                         SSL_F_SSL3_OUTPUT_CERT_CHAIN, ERR_R_INTERNAL_ERROR);
+                return 0;
+            }
+            if (SSL_IS_TLS13(s)
+                    && !tls_construct_extensions(s, pkt,
+                                                 SSL_EXT_TLS1_3_CERTIFICATE,
+                                                 sk_X509_value(der->chain, i),
+                                                 i)) {
+                /* SSLfatal() already called */
+                ssl_cert_chain_der_free(der);
+                return 0;
+            }
+        }
+        ssl_cert_chain_der_free(der);
+    }
 
     if (!WPACKET_close(pkt)) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_SSL3_OUTPUT_CERT_CHAIN,
@@ -1078,6 +1334,7 @@ WORK_STATE tls_finish_handshake(SSL *s, WORK_STATE wst, int clearbufs, int stop)
         s->ext.ticket_expected = 0;
 
         ssl3_cleanup_key_block(s);
+        ssl_hs_timing_end(s);
 
         if (s->server) {
             /*
@@ -1108,6 +1365,8 @@ WORK_STATE tls_finish_handshake(SSL *s, WORK_STATE wst, int clearbufs, int stop)
             }
             if (s->hit)
                 tsan_counter(&s->session_ctx->stats.sess_hit);
+            else
+                cached_info_update(s);
 
             s->handshake_func = ossl_statem_connect;
             tsan_counter(&s->session_ctx->stats.sess_connect_good);
@@ -2326,24 +2585,10 @@ int construct_ca_names(SSL *s, const STACK_OF(X509_NAME) *ca_sk, WPACKET *pkt)
         return 0;
     }
 
-    if (ca_sk != NULL) {
-        int i;
-
-        for (i = 0; i < sk_X509_NAME_num(ca_sk); i++) {
-            unsigned char *namebytes;
-            X509_NAME *name = sk_X509_NAME_value(ca_sk, i);
-            int namelen;
-
-            if (name == NULL
-                    || (namelen = i2d_X509_NAME(name, NULL)) < 0
-                    || !WPACKET_sub_allocate_bytes_u16(pkt, namelen,
-                                                       &namebytes)
-                    || i2d_X509_NAME(name, &namebytes) != namelen) {
-                SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_CONSTRUCT_CA_NAMES,
-                         ERR_R_INTERNAL_ERROR);
-                return 0;
-            }
-        }
+    if (ca_sk != NULL && !ssl_ca_names_der(s, ca_sk, pkt)) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR, SSL_F_CONSTRUCT_CA_NAMES,
+                 ERR_R_INTERNAL_ERROR);
+        return 0;
     }
 
     if (!WPACKET_close(pkt)) {
@@ -84,7 +84,7 @@ static int ossl_statem_server13_read_transition(SSL *s, int mt)
     case TLS_ST_SR_END_OF_EARLY_DATA:
     case TLS_ST_SW_FINISHED:
         if (s->s3->tmp.cert_request) {
-            if (mt == SSL3_MT_CERTIFICATE) {
+            if (tls13_is_certificate_msg(s, mt)) {
                 st->hand_state = TLS_ST_SR_CERT;
                 return 1;
             }
@@ -125,7 +125,7 @@ static int ossl_statem_server13_read_transition(SSL *s, int mt)
         if (s->early_data_state == SSL_EARLY_DATA_READING)
             break;
 
-        if (mt == SSL3_MT_CERTIFICATE
+        if (tls13_is_certificate_msg(s, mt)
                 && s->post_handshake_auth == SSL_PHA_REQUESTED) {
             st->hand_state = TLS_ST_SR_CERT;
             return 1;
@@ -1053,8 +1053,16 @@ int ossl_statem_server_construct_message(SSL *s, WPACKET *pkt,
         break;
 
     case TLS_ST_SW_CERT:
-        *confunc = tls_construct_server_certificate;
-        *mt = SSL3_MT_CERTIFICATE;
+        if (s->ext.cached_info_used) {
+            *confunc = tls_construct_server_cached_certificate;
+            *mt = SSL3_MT_CERTIFICATE;
+        } else if (s->ext.cert_comp_tx != TLSEXT_comp_cert_none) {
+            *confunc = tls_construct_server_compressed_certificate;
+            *mt = SSL3_MT_COMPRESSED_CERTIFICATE;
+        } else {
+            *confunc = tls_construct_server_certificate;
+            *mt = SSL3_MT_CERTIFICATE;
+        }
         break;
 
     case TLS_ST_SW_CERT_VRFY:
@@ -1203,6 +1211,9 @@ MSG_PROCESS_RETURN ossl_statem_server_process_message(SSL *s, PACKET *pkt)
         return tls_process_end_of_early_data(s, pkt);
 
     case TLS_ST_SR_CERT:
+        if (s->s3->tmp.message_type == SSL3_MT_COMPRESSED_CERTIFICATE)
+            return tls13_process_compressed_certificate(s, pkt,
+                    tls_process_client_certificate);
         return tls_process_client_certificate(s, pkt);
 
     case TLS_ST_SR_KEY_EXCH:
@@ -2506,6 +2517,7 @@ int tls_construct_server_key_exchange(SSL *s, WPACKET *pkt)
     EVP_MD_CTX *md_ctx = EVP_MD_CTX_new();
     EVP_PKEY_CTX *pctx = NULL;
     size_t paramlen, paramoffset;
+    uint64_t phase_start;
 
     if (!WPACKET_get_total_written(pkt, &paramoffset)) {
         SSLfatal(s, SSL_AD_INTERNAL_ERROR,
@@ -2580,7 +2592,9 @@ int tls_construct_server_key_exchange(SSL *s, WPACKET *pkt)
             goto err;
         }
 
+        phase_start = ssl_hs_phase_start(s);
         s->s3->tmp.pkey = ssl_generate_pkey(pkdhp);
+        ssl_hs_phase_end(s, SSL_HS_PHASE_KEYGEN, phase_start);
         if (s->s3->tmp.pkey == NULL) {
             /* SSLfatal() already called */
             goto err;
@@ -2827,7 +2841,9 @@ int tls_construct_server_key_exchange(SSL *s, WPACKET *pkt)
             /* SSLfatal() already called */
             goto err;
         }
+        phase_start = ssl_hs_phase_start(s);
         rv = EVP_DigestSign(md_ctx, sigbytes1, &siglen, tbs, tbslen);
+        ssl_hs_phase_end(s, SSL_HS_PHASE_SIGN, phase_start);
         OPENSSL_free(tbs);
         if (rv <= 0 || !WPACKET_sub_allocate_bytes_u16(pkt, siglen, &sigbytes2)
             || sigbytes1 != sigbytes2) {
@@ -3812,6 +3828,29 @@ int tls_construct_server_certificate(SSL *s, WPACKET *pkt)
     return 1;
 }
 
+int tls_construct_server_compressed_certificate(SSL *s, WPACKET *pkt)
+{
+    return tls13_construct_compressed_certificate(s, pkt,
+                                            tls_construct_server_certificate);
+}
+
+/*
+ * The client holds our certificate chain already, so we only send back the
+ * hash that it offered (RFC7924).
+ */
+int tls_construct_server_cached_certificate(SSL *s, WPACKET *pkt)
+{
+    if (!WPACKET_sub_memcpy_u8(pkt, s->ext.cached_info_hash,
+                               sizeof(s->ext.cached_info_hash))) {
+        SSLfatal(s, SSL_AD_INTERNAL_ERROR,
+                 SSL_F_TLS_CONSTRUCT_SERVER_CACHED_CERTIFICATE,
+                 ERR_R_INTERNAL_ERROR);
+        return 0;
+    }
+
+    return 1;
+}
+
 static int create_ticket_prequel(SSL *s, WPACKET *pkt, uint32_t age_add,
                                  unsigned char *tick_nonce)
 {
@@ -314,6 +314,12 @@ int tls1_change_cipher_state(SSL *s, int which)
     }
     s->statem.enc_write_state = ENC_WRITE_STATE_VALID;
 
+    if (!ssl_ktls_change_cipher_state(s, (which & SSL3_CC_WRITE) != 0, key,
+                                      iv)) {
+        /* SSLfatal() already called */
+        goto err;
+    }
+
 #ifdef SSL_DEBUG
     printf("which = %04X\nkey=", which);
     {
@@ -18,6 +18,7 @@
 #include <openssl/dh.h>
 #include <openssl/bn.h>
 #include "internal/nelem.h"
+#include "internal/thread_once.h"
 #include "ssl_local.h"
 #include <openssl/ct.h>
 #include <oqs/oqs.h>
@@ -180,92 +181,191 @@ static const TLS_GROUP_INFO nid_list[] = {
     {EVP_PKEY_X448, 224, TLS_CURVE_CUSTOM}, /* X448 (30) */
 };
 
-/* OQS groups. The values are arbitraty, since the TLS spec does not specify values for non finite field and elliptic curve "groups". Security level is classical.
+/*
+ * OQS KEM groups. Each entry describes a post-quantum KEM and its hybrid
+ * variant. The values are arbitrary, since the TLS spec does not specify
+ * values for non finite field and elliptic curve "groups". Security level
+ * is classical.
+ * The entries follow the KEM NID allocation in objects.txt, where each KEM
+ * NID is immediately followed by its hybrid NID: entry i describes NIDs
+ * NID_oqs_kem_default + 2 * i and NID_oqs_kem_default + 2 * i + 1.
  */
-static const TLS_GROUP_INFO oqs_nid_list[] = {
-    {NID_oqs_kem_default, 128, TLS_CURVE_CUSTOM}, /* OQS KEM default (0x01FF) */
-///// OQS_TEMPLATE_FRAGMENT_OQS_NID_LIST_START
-    {NID_frodo640aes, 128, TLS_CURVE_CUSTOM}, /* frodo640aes (0x0200) */
-    {NID_frodo640shake, 128, TLS_CURVE_CUSTOM}, /* frodo640shake (0x0201) */
-    {NID_frodo976aes, 192, TLS_CURVE_CUSTOM}, /* frodo976aes (0x0202) */
-    {NID_frodo976shake, 192, TLS_CURVE_CUSTOM}, /* frodo976shake (0x0203) */
-    {NID_frodo1344aes, 256, TLS_CURVE_CUSTOM}, /* frodo1344aes (0x0204) */
-    {NID_frodo1344shake, 256, TLS_CURVE_CUSTOM}, /* frodo1344shake (0x0205) */
-    {NID_bike1l1cpa, 128, TLS_CURVE_CUSTOM}, /* bike1l1cpa (0x0206) */
-    {NID_bike1l3cpa, 192, TLS_CURVE_CUSTOM}, /* bike1l3cpa (0x0207) */
-    {NID_bike1l1fo, 128, TLS_CURVE_CUSTOM}, /* bike1l1fo (0x0223) */
-    {NID_bike1l3fo, 192, TLS_CURVE_CUSTOM}, /* bike1l3fo (0x0224) */
-    {NID_kyber512, 128, TLS_CURVE_CUSTOM}, /* kyber512 (0x020F) */
-    {NID_kyber768, 192, TLS_CURVE_CUSTOM}, /* kyber768 (0x0210) */
-    {NID_kyber1024, 256, TLS_CURVE_CUSTOM}, /* kyber1024 (0x0211) */
-    {NID_ntru_hps2048509, 128, TLS_CURVE_CUSTOM}, /* ntru_hps2048509 (0x0214) */
-    {NID_ntru_hps2048677, 192, TLS_CURVE_CUSTOM}, /* ntru_hps2048677 (0x0215) */
-    {NID_ntru_hps4096821, 256, TLS_CURVE_CUSTOM}, /* ntru_hps4096821 (0x0216) */
-    {NID_ntru_hrss701, 192, TLS_CURVE_CUSTOM}, /* ntru_hrss701 (0x0217) */
-    {NID_lightsaber, 128, TLS_CURVE_CUSTOM}, /* lightsaber (0x0218) */
-    {NID_saber, 192, TLS_CURVE_CUSTOM}, /* saber (0x0219) */
-    {NID_firesaber, 256, TLS_CURVE_CUSTOM}, /* firesaber (0x021A) */
-    {NID_sidhp434, 128, TLS_CURVE_CUSTOM}, /* sidhp434 (0x021B) */
-    {NID_sidhp503, 128, TLS_CURVE_CUSTOM}, /* sidhp503 (0x021C) */
-    {NID_sidhp610, 192, TLS_CURVE_CUSTOM}, /* sidhp610 (0x021D) */
-    {NID_sidhp751, 256, TLS_CURVE_CUSTOM}, /* sidhp751 (0x021E) */
-    {NID_sikep434, 128, TLS_CURVE_CUSTOM}, /* sikep434 (0x021F) */
-    {NID_sikep503, 128, TLS_CURVE_CUSTOM}, /* sikep503 (0x0220) */
-    {NID_sikep610, 192, TLS_CURVE_CUSTOM}, /* sikep610 (0x0221) */
-    {NID_sikep751, 256, TLS_CURVE_CUSTOM}, /* sikep751 (0x0222) */
-    {NID_kyber90s512, 128, TLS_CURVE_CUSTOM}, /* kyber90s512 (0x0229) */
-    {NID_kyber90s768, 192, TLS_CURVE_CUSTOM}, /* kyber90s768 (0x022A) */
-    {NID_kyber90s1024, 256, TLS_CURVE_CUSTOM}, /* kyber90s1024 (0x022B) */
-    {NID_hqc128_1_cca2, 128, TLS_CURVE_CUSTOM}, /* hqc128_1_cca2 (0x0232) */
-    {NID_hqc192_1_cca2, 192, TLS_CURVE_CUSTOM}, /* hqc192_1_cca2 (0x0233) */
-    {NID_hqc192_2_cca2, 192, TLS_CURVE_CUSTOM}, /* hqc192_2_cca2 (0x0234) */
-    {NID_hqc256_1_cca2, 256, TLS_CURVE_CUSTOM}, /* hqc256_1_cca2 (0x0235) */
-    {NID_hqc256_2_cca2, 256, TLS_CURVE_CUSTOM}, /* hqc256_2_cca2 (0x0236) */
-    {NID_hqc256_3_cca2, 256, TLS_CURVE_CUSTOM}, /* hqc256_3_cca2 (0x0237) */
-///// OQS_TEMPLATE_FRAGMENT_OQS_NID_LIST_END
+static const OQS_KEM_GROUP_INFO oqs_kem_group_list[] = {
+    {{NID_oqs_kem_default, 128, TLS_CURVE_CUSTOM},
+     {NID_p256_oqs_kem_default, 128, TLS_CURVE_CUSTOM},
+     0x01FF, 0x2FFF, 23}, /* OQS KEM default */
+///// OQS_TEMPLATE_FRAGMENT_OQS_KEM_GROUP_LIST_START
+    {{NID_frodo640aes, 128, TLS_CURVE_CUSTOM},
+     {NID_p256_frodo640aes, 128, TLS_CURVE_CUSTOM},
+     0x0200, 0x2F00, 23}, /* frodo640aes */
+    {{NID_frodo640shake, 128, TLS_CURVE_CUSTOM},
+     {NID_p256_frodo640shake, 128, TLS_CURVE_CUSTOM},
+     0x0201, 0x2F01, 23}, /* frodo640shake */
+    {{NID_frodo976aes, 192, TLS_CURVE_CUSTOM},
+     {NID_p384_frodo976aes, 192, TLS_CURVE_CUSTOM},
+     0x0202, 0x2F02, 24}, /* frodo976aes */
+    {{NID_frodo976shake, 192, TLS_CURVE_CUSTOM},
+     {NID_p384_frodo976shake, 192, TLS_CURVE_CUSTOM},
+     0x0203, 0x2F03, 24}, /* frodo976shake */
+    {{NID_frodo1344aes, 256, TLS_CURVE_CUSTOM},
+     {NID_p521_frodo1344aes, 256, TLS_CURVE_CUSTOM},
+     0x0204, 0x2F04, 25}, /* frodo1344aes */
+    {{NID_frodo1344shake, 256, TLS_CURVE_CUSTOM},
+     {NID_p521_frodo1344shake, 256, TLS_CURVE_CUSTOM},
+     0x0205, 0x2F05, 25}, /* frodo1344shake */
+    {{NID_bike1l1cpa, 128, TLS_CURVE_CUSTOM},
+     {NID_p256_bike1l1cpa, 128, TLS_CURVE_CUSTOM},
+     0x0206, 0x2F06, 23}, /* bike1l1cpa */
+    {{NID_bike1l3cpa, 192, TLS_CURVE_CUSTOM},
+     {NID_p384_bike1l3cpa, 192, TLS_CURVE_CUSTOM},
+     0x0207, 0x2F07, 24}, /* bike1l3cpa */
+    {{NID_bike1l1fo, 128, TLS_CURVE_CUSTOM},
+     {NID_p256_bike1l1fo, 128, TLS_CURVE_CUSTOM},
+     0x0223, 0x2F23, 23}, /* bike1l1fo */
+    {{NID_bike1l3fo, 192, TLS_CURVE_CUSTOM},
+     {NID_p384_bike1l3fo, 192, TLS_CURVE_CUSTOM},
+     0x0224, 0x2F24, 24}, /* bike1l3fo */
+    {{NID_kyber512, 128, TLS_CURVE_CUSTOM},
+     {NID_p256_kyber512, 128, TLS_CURVE_CUSTOM},
+     0x020F, 0x2F0F, 23}, /* kyber512 */
+    {{NID_kyber768, 192, TLS_CURVE_CUSTOM},
+     {NID_p384_kyber768, 192, TLS_CURVE_CUSTOM},
+     0x0210, 0x2F10, 24}, /* kyber768 */
+    {{NID_kyber1024, 256, TLS_CURVE_CUSTOM},
+     {NID_p521_kyber1024, 256, TLS_CURVE_CUSTOM},
+     0x0211, 0x2F11, 25}, /* kyber1024 */
+    {{NID_ntru_hps2048509, 128, TLS_CURVE_CUSTOM},
+     {NID_p256_ntru_hps2048509, 128, TLS_CURVE_CUSTOM},
+     0x0214, 0x2F14, 23}, /* ntru_hps2048509 */
+    {{NID_ntru_hps2048677, 192, TLS_CURVE_CUSTOM},
+     {NID_p384_ntru_hps2048677, 192, TLS_CURVE_CUSTOM},
+     0x0215, 0x2F15, 24}, /* ntru_hps2048677 */
+    {{NID_ntru_hps4096821, 256, TLS_CURVE_CUSTOM},
+     {NID_p521_ntru_hps4096821, 256, TLS_CURVE_CUSTOM},
+     0x0216, 0x2F16, 25}, /* ntru_hps4096821 */
+    {{NID_ntru_hrss701, 192, TLS_CURVE_CUSTOM},
+     {NID_p384_ntru_hrss701, 192, TLS_CURVE_CUSTOM},
+     0x0217, 0x2F17, 24}, /* ntru_hrss701 */
+    {{NID_lightsaber, 128, TLS_CURVE_CUSTOM},
+     {NID_p256_lightsaber, 128, TLS_CURVE_CUSTOM},
+     0x0218, 0x2F18, 23}, /* lightsaber */
+    {{NID_saber, 192, TLS_CURVE_CUSTOM},
+     {NID_p384_saber, 192, TLS_CURVE_CUSTOM},
+     0x0219, 0x2F19, 24}, /* saber */
+    {{NID_firesaber, 256, TLS_CURVE_CUSTOM},
+     {NID_p521_firesaber, 256, TLS_CURVE_CUSTOM},
+     0x021A, 0x2F1A, 25}, /* firesaber */
+    {{NID_sidhp434, 128, TLS_CURVE_CUSTOM},
+     {NID_p256_sidhp434, 128, TLS_CURVE_CUSTOM},
+     0x021B, 0x2F1B, 23}, /* sidhp434 */
+    {{NID_sidhp503, 128, TLS_CURVE_CUSTOM},
+     {NID_p256_sidhp503, 128, TLS_CURVE_CUSTOM},
+     0x021C, 0x2F1C, 23}, /* sidhp503 */
+    {{NID_sidhp610, 192, TLS_CURVE_CUSTOM},
+     {NID_p384_sidhp610, 192, TLS_CURVE_CUSTOM},
+     0x021D, 0x2F1D, 24}, /* sidhp610 */
+    {{NID_sidhp751, 256, TLS_CURVE_CUSTOM},
+     {NID_p521_sidhp751, 256, TLS_CURVE_CUSTOM},
+     0x021E, 0x2F1E, 25}, /* sidhp751 */
+    {{NID_sikep434, 128, TLS_CURVE_CUSTOM},
+     {NID_p256_sikep434, 128, TLS_CURVE_CUSTOM},
+     0x021F, 0x2F1F, 23}, /* sikep434 */
+    {{NID_sikep503, 128, TLS_CURVE_CUSTOM},
+     {NID_p256_sikep503, 128, TLS_CURVE_CUSTOM},
+     0x0220, 0x2F20, 23}, /* sikep503 */
+    {{NID_sikep610, 192, TLS_CURVE_CUSTOM},
+     {NID_p384_sikep610, 192, TLS_CURVE_CUSTOM},
+     0x0221, 0x2F21, 24}, /* sikep610 */
+    {{NID_sikep751, 256, TLS_CURVE_CUSTOM},
+     {NID_p521_sikep751, 256, TLS_CURVE_CUSTOM},
+     0x0222, 0x2F22, 25}, /* sikep751 */
+    {{NID_kyber90s512, 128, TLS_CURVE_CUSTOM},
+     {NID_p256_kyber90s512, 128, TLS_CURVE_CUSTOM},
+     0x0229, 0x2F29, 23}, /* kyber90s512 */
+    {{NID_kyber90s768, 192, TLS_CURVE_CUSTOM},
+     {NID_p384_kyber90s768, 192, TLS_CURVE_CUSTOM},
+     0x022A, 0x2F2A, 24}, /* kyber90s768 */
+    {{NID_kyber90s1024, 256, TLS_CURVE_CUSTOM},
+     {NID_p521_kyber90s1024, 256, TLS_CURVE_CUSTOM},
+     0x022B, 0x2F2B, 25}, /* kyber90s1024 */
+    {{NID_hqc128_1_cca2, 128, TLS_CURVE_CUSTOM},
+     {NID_p256_hqc128_1_cca2, 128, TLS_CURVE_CUSTOM},
+     0x0232, 0x2F32, 23}, /* hqc128_1_cca2 */
+    {{NID_hqc192_1_cca2, 192, TLS_CURVE_CUSTOM},
+     {NID_p384_hqc192_1_cca2, 192, TLS_CURVE_CUSTOM},
+     0x0233, 0x2F33, 24}, /* hqc192_1_cca2 */
+    {{NID_hqc192_2_cca2, 192, TLS_CURVE_CUSTOM},
+     {NID_p384_hqc192_2_cca2, 192, TLS_CURVE_CUSTOM},
+     0x0234, 0x2F34, 24}, /* hqc192_2_cca2 */
+    {{NID_hqc256_1_cca2, 256, TLS_CURVE_CUSTOM},
+     {NID_p521_hqc256_1_cca2, 256, TLS_CURVE_CUSTOM},
+     0x0235, 0x2F35, 25}, /* hqc256_1_cca2 */
+    {{NID_hqc256_2_cca2, 256, TLS_CURVE_CUSTOM},
+     {NID_p521_hqc256_2_cca2, 256, TLS_CURVE_CUSTOM},
+     0x0236, 0x2F36, 25}, /* hqc256_2_cca2 */
+    {{NID_hqc256_3_cca2, 256, TLS_CURVE_CUSTOM},
+     {NID_p521_hqc256_3_cca2, 256, TLS_CURVE_CUSTOM},
+     0x0237, 0x2F37, 25}, /* hqc256_3_cca2 */
+///// OQS_TEMPLATE_FRAGMENT_OQS_KEM_GROUP_LIST_END
 };
-    /* Hybrid OQS groups. Security level is classical. */
-static const TLS_GROUP_INFO oqs_hybrid_nid_list[] = {
-    {NID_p256_oqs_kem_default, 128, TLS_CURVE_CUSTOM}, /* p256 + OQS KEM default hybrid (0x2FFF) */
-///// OQS_TEMPLATE_FRAGMENT_OQS_NID_LIST_HYBRID_START
- {NID_p256_frodo640aes, 128, TLS_CURVE_CUSTOM}, /* p256/384/521 + frodo640aes hybrid (0x0200) */
- {NID_p256_frodo640shake, 128, TLS_CURVE_CUSTOM}, /* p256/384/521 + frodo640shake hybrid (0x0201) */
- {NID_p384_frodo976aes, 192, TLS_CURVE_CUSTOM}, /* p256/384/521 + frodo976aes hybrid (0x0202) */
- {NID_p384_frodo976shake, 192, TLS_CURVE_CUSTOM}, /* p256/384/521 + frodo976shake hybrid (0x0203) */
- {NID_p521_frodo1344aes, 256, TLS_CURVE_CUSTOM}, /* p256/384/521 + frodo1344aes hybrid (0x0204) */
- {NID_p521_frodo1344shake, 256, TLS_CURVE_CUSTOM}, /* p256/384/521 + frodo1344shake hybrid (0x0205) */
- {NID_p256_bike1l1cpa, 128, TLS_CURVE_CUSTOM}, /* p256/384/521 + bike1l1cpa hybrid (0x0206) */
- {NID_p384_bike1l3cpa, 192, TLS_CURVE_CUSTOM}, /* p256/384/521 + bike1l3cpa hybrid (0x0207) */
- {NID_p256_bike1l1fo, 128, TLS_CURVE_CUSTOM}, /* p256/384/521 + bike1l1fo hybrid (0x0223) */
- {NID_p384_bike1l3fo, 192, TLS_CURVE_CUSTOM}, /* p256/384/521 + bike1l3fo hybrid (0x0224) */
- {NID_p256_kyber512, 128, TLS_CURVE_CUSTOM}, /* p256/384/521 + kyber512 hybrid (0x020F) */
- {NID_p384_kyber768, 192, TLS_CURVE_CUSTOM}, /* p256/384/521 + kyber768 hybrid (0x0210) */
- {NID_p521_kyber1024, 256, TLS_CURVE_CUSTOM}, /* p256/384/521 + kyber1024 hybrid (0x0211) */
- {NID_p256_ntru_hps2048509, 128, TLS_CURVE_CUSTOM}, /* p256/384/521 + ntru_hps2048509 hybrid (0x0214) */
- {NID_p384_ntru_hps2048677, 192, TLS_CURVE_CUSTOM}, /* p256/384/521 + ntru_hps2048677 hybrid (0x0215) */
- {NID_p521_ntru_hps4096821, 256, TLS_CURVE_CUSTOM}, /* p256/384/521 + ntru_hps4096821 hybrid (0x0216) */
- {NID_p384_ntru_hrss701, 192, TLS_CURVE_CUSTOM}, /* p256/384/521 + ntru_hrss701 hybrid (0x0217) */
- {NID_p256_lightsaber, 128, TLS_CURVE_CUSTOM}, /* p256/384/521 + lightsaber hybrid (0x0218) */
- {NID_p384_saber, 192, TLS_CURVE_CUSTOM}, /* p256/384/521 + saber hybrid (0x0219) */
- {NID_p521_firesaber, 256, TLS_CURVE_CUSTOM}, /* p256/384/521 + firesaber hybrid (0x021A) */
- {NID_p256_sidhp434, 128, TLS_CURVE_CUSTOM}, /* p256/384/521 + sidhp434 hybrid (0x021B) */
- {NID_p256_sidhp503, 128, TLS_CURVE_CUSTOM}, /* p256/384/521 + sidhp503 hybrid (0x021C) */
- {NID_p384_sidhp610, 192, TLS_CURVE_CUSTOM}, /* p256/384/521 + sidhp610 hybrid (0x021D) */
- {NID_p521_sidhp751, 256, TLS_CURVE_CUSTOM}, /* p256/384/521 + sidhp751 hybrid (0x021E) */
- {NID_p256_sikep434, 128, TLS_CURVE_CUSTOM}, /* p256/384/521 + sikep434 hybrid (0x021F) */
- {NID_p256_sikep503, 128, TLS_CURVE_CUSTOM}, /* p256/384/521 + sikep503 hybrid (0x0220) */
- {NID_p384_sikep610, 192, TLS_CURVE_CUSTOM}, /* p256/384/521 + sikep610 hybrid (0x0221) */
- {NID_p521_sikep751, 256, TLS_CURVE_CUSTOM}, /* p256/384/521 + sikep751 hybrid (0x0222) */
- {NID_p256_kyber90s512, 128, TLS_CURVE_CUSTOM}, /* p256/384/521 + kyber90s512 hybrid (0x0229) */
- {NID_p384_kyber90s768, 192, TLS_CURVE_CUSTOM}, /* p256/384/521 + kyber90s768 hybrid (0x022A) */
- {NID_p521_kyber90s1024, 256, TLS_CURVE_CUSTOM}, /* p256/384/521 + kyber90s1024 hybrid (0x022B) */
- {NID_p256_hqc128_1_cca2, 128, TLS_CURVE_CUSTOM}, /* p256/384/521 + hqc128_1_cca2 hybrid (0x0232) */
- {NID_p384_hqc192_1_cca2, 192, TLS_CURVE_CUSTOM}, /* p256/384/521 + hqc192_1_cca2 hybrid (0x0233) */
- {NID_p384_hqc192_2_cca2, 192, TLS_CURVE_CUSTOM}, /* p256/384/521 + hqc192_2_cca2 hybrid (0x0234) */
- {NID_p521_hqc256_1_cca2, 256, TLS_CURVE_CUSTOM}, /* p256/384/521 + hqc256_1_cca2 hybrid (0x0235) */
- {NID_p521_hqc256_2_cca2, 256, TLS_CURVE_CUSTOM}, /* p256/384/521 + hqc256_2_cca2 hybrid (0x0236) */
- {NID_p521_hqc256_3_cca2, 256, TLS_CURVE_CUSTOM}, /* p256/384/521 + hqc256_3_cca2 hybrid (0x0237) */
-///// OQS_TEMPLATE_FRAGMENT_OQS_NID_LIST_HYBRID_END
+
+/*
+ * Maps OQS group ids to oqs_kem_group_list[]: the value stored for a group
+ * id is the index of its entry plus one, or 0 if the code point is unused.
+ */
+static const unsigned char oqs_kem_group_index[OQS_KEM_GROUP_ID_LAST
+                                               - OQS_KEM_GROUP_ID_FIRST + 1] = {
+///// OQS_TEMPLATE_FRAGMENT_OQS_KEM_GROUP_INDEX_START
+     1,  2,  3,  4,  5,  6,  7,  8, /* 0x01FF */
+     9,  0,  0,  0,  0,  0,  0,  0, /* 0x0207 */
+    12, 13, 14,  0,  0, 15, 16, 17, /* 0x020F */
+    18, 19, 20, 21, 22, 23, 24, 25, /* 0x0217 */
+    26, 27, 28, 29, 10, 11,  0,  0, /* 0x021F */
+     0,  0, 30, 31, 32,  0,  0,  0, /* 0x0227 */
+     0,  0,  0, 33, 34, 35, 36, 37, /* 0x022F */
+    38,  0,  0,  0,  0,  0,  0,  0, /* 0x0237 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x023F */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x0247 */
+     0,  0, /* 0x024F */
+///// OQS_TEMPLATE_FRAGMENT_OQS_KEM_GROUP_INDEX_END
+};
+
+static const unsigned char oqs_kem_hybrid_group_index[OQS_KEM_HYBRID_GROUP_ID_LAST
+                                                      - OQS_KEM_HYBRID_GROUP_ID_FIRST + 1] = {
+///// OQS_TEMPLATE_FRAGMENT_OQS_KEM_HYBRID_GROUP_INDEX_START
+     2,  3,  4,  5,  6,  7,  8,  9, /* 0x2F00 */
+     0,  0,  0,  0,  0,  0,  0, 12, /* 0x2F08 */
+    13, 14,  0,  0, 15, 16, 17, 18, /* 0x2F10 */
+    19, 20, 21, 22, 23, 24, 25, 26, /* 0x2F18 */
+    27, 28, 29, 10, 11,  0,  0,  0, /* 0x2F20 */
+     0, 30, 31, 32,  0,  0,  0,  0, /* 0x2F28 */
+     0,  0, 33, 34, 35, 36, 37, 38, /* 0x2F30 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2F38 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2F40 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2F48 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2F50 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2F58 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2F60 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2F68 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2F70 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2F78 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2F80 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2F88 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2F90 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2F98 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2FA0 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2FA8 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2FB0 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2FB8 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2FC0 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2FC8 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2FD0 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2FD8 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2FE0 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2FE8 */
+     0,  0,  0,  0,  0,  0,  0,  0, /* 0x2FF0 */
+     0,  0,  0,  0,  0,  0,  0,  1, /* 0x2FF8 */
+///// OQS_TEMPLATE_FRAGMENT_OQS_KEM_HYBRID_GROUP_INDEX_END
 };
 
 static const unsigned char ecformats_default[] = {
@@ -394,25 +494,114 @@ static const uint16_t suiteb_curves[] = {
     TLSEXT_curve_P_384
 };
 
-const TLS_GROUP_INFO *tls1_group_id_lookup(uint16_t group_id)
+const OQS_KEM_GROUP_INFO *oqs_kem_group_id_lookup(uint16_t group_id)
+{
+    unsigned char idx;
+
+    if (IS_OQS_KEM_CURVEID(group_id))
+        idx = oqs_kem_group_index[group_id - OQS_KEM_GROUP_ID_FIRST];
+    else if (IS_OQS_KEM_HYBRID_CURVEID(group_id))
+        idx = oqs_kem_hybrid_group_index[group_id
+                                         - OQS_KEM_HYBRID_GROUP_ID_FIRST];
+    else
+        return NULL;
+    return idx == 0 ? NULL : &oqs_kem_group_list[idx - 1];
+}
+
+const OQS_KEM_GROUP_INFO *oqs_kem_group_nid_lookup(int nid)
 {
+    const OQS_KEM_GROUP_INFO *ginf;
     size_t i;
-    /* check if it is an OQS group */
-    if (IS_OQS_KEM_CURVEID(group_id)) {
-        int oqs_nid = OQS_KEM_NID(group_id);
-        for (i = 0; i < OSSL_NELEM(oqs_nid_list); i++) {
-            if (oqs_nid_list[i].nid == oqs_nid) {
-                return &oqs_nid_list[i];
-            }
-        }
+
+    if (nid < NID_oqs_kem_default)
+        return NULL;
+    i = (size_t)(nid - NID_oqs_kem_default) / 2;
+    if (i >= OSSL_NELEM(oqs_kem_group_list))
+        return NULL;
+    ginf = &oqs_kem_group_list[i];
+    if (ginf->pq.nid != nid && ginf->hybrid.nid != nid)
+        return NULL;
+    return ginf;
+}
+
+/* Returns the PQ KEM NID used by an OQS or OQS hybrid group */
+int oqs_kem_group_nid(uint16_t group_id)
+{
+    const OQS_KEM_GROUP_INFO *ginf = oqs_kem_group_id_lookup(group_id);
+
+    return ginf == NULL ? NID_undef : ginf->pq.nid;
+}
+
+/* Returns the classical curve used by an OQS hybrid group, or 0 */
+uint16_t oqs_kem_classical_group_id(uint16_t group_id)
+{
+    const OQS_KEM_GROUP_INFO *ginf;
+
+    if (!IS_OQS_KEM_HYBRID_CURVEID(group_id)
+            || (ginf = oqs_kem_group_id_lookup(group_id)) == NULL)
+        return 0;
+    return ginf->classical_group_id;
+}
+
+/*
+ * Registry of OQS KEM descriptors.
+ *
+ * OQS_KEM_new() allocates a fresh descriptor on each call, but the
+ * descriptors are immutable and only ever read by the handshake. We therefore
+ * instantiate every KEM once, the first time any of them is needed, and hand
+ * out shared read-only pointers, stored at the index of the KEM in
+ * oqs_kem_group_list[]. The PQ-only and hybrid groups share one descriptor.
+ */
+static CRYPTO_ONCE oqs_kem_registry_once = CRYPTO_ONCE_STATIC_INIT;
+static OQS_KEM *oqs_kem_registry[OSSL_NELEM(oqs_kem_group_list)];
+
+DEFINE_RUN_ONCE_STATIC(do_oqs_kem_registry_init)
+{
+    const char *name;
+    size_t i;
+
+    for (i = 0; i < OSSL_NELEM(oqs_kem_group_list); i++) {
+        /* NULL for schemes not enabled in liboqs: lookups will fail */
+        if ((name = get_oqs_alg_name(oqs_kem_group_list[i].pq.nid)) != NULL)
+            oqs_kem_registry[i] = OQS_KEM_new(name);
     }
-    if (IS_OQS_KEM_HYBRID_CURVEID(group_id)) {
-        int oqs_nid = OQS_HYBRID_KEM_NID(group_id);
-        for (i = 0; i < OSSL_NELEM(oqs_nid_list); i++) {
-            if (oqs_hybrid_nid_list[i].nid == oqs_nid) {
-                return &oqs_hybrid_nid_list[i];
-            }
-        }
+    return 1;
+}
+
+/*
+ * Returns the shared OQS KEM descriptor for a PQ or hybrid KEM NID, or NULL
+ * if the NID is unknown or the scheme isn't enabled in liboqs. The returned
+ * object is owned by the library and must not be freed.
+ */
+const OQS_KEM *ssl_get_oqs_kem(int nid)
+{
+    const OQS_KEM_GROUP_INFO *ginf = oqs_kem_group_nid_lookup(nid);
+
+    if (ginf == NULL
+            || !RUN_ONCE(&oqs_kem_registry_once, do_oqs_kem_registry_init))
+        return NULL;
+    return oqs_kem_registry[ginf - oqs_kem_group_list];
+}
+
+void ssl_oqs_kem_registry_cleanup_int(void)
+{
+    size_t i;
+
+    for (i = 0; i < OSSL_NELEM(oqs_kem_registry); i++) {
+        OQS_KEM_free(oqs_kem_registry[i]);
+        oqs_kem_registry[i] = NULL;
+    }
+}
+
+const TLS_GROUP_INFO *tls1_group_id_lookup(uint16_t group_id)
+{
+    /* check if it is an OQS group */
+    if (IS_OQS_KEM_CURVEID(group_id) || IS_OQS_KEM_HYBRID_CURVEID(group_id)) {
+        const OQS_KEM_GROUP_INFO *ginf = oqs_kem_group_id_lookup(group_id);
+
+        if (ginf == NULL)
+            return NULL;
+        return group_id == ginf->group_id ? &ginf->pq : &ginf->hybrid;
     }
 
     /* ECC curves from RFC 4492 and RFC 7027 */
@@ -424,16 +613,11 @@ const TLS_GROUP_INFO *tls1_group_id_lookup(uint16_t group_id)
 static uint16_t tls1_nid2group_id(int nid)
 {
     size_t i;
+    const OQS_KEM_GROUP_INFO *ginf;
 
     /* check if it is an OQS group */
-    int oqs_group_id = OQS_KEM_CURVEID(nid);
-    if (oqs_group_id != 0) {
-      return oqs_group_id;
-    }
-    oqs_group_id = OQS_KEM_HYBRID_CURVEID(nid);
-    if (oqs_group_id != 0) {
-      return oqs_group_id;
-    }
+    if ((ginf = oqs_kem_group_nid_lookup(nid)) != NULL)
+        return nid == ginf->pq.nid ? ginf->group_id : ginf->hybrid_group_id;
 
     for (i = 0; i < OSSL_NELEM(nid_list); i++) {
         if (nid_list[i].nid == nid)
@@ -539,7 +723,9 @@ uint16_t tls1_shared_group(SSL *s, int nmatch)
 {
     const uint16_t *pref, *supp;
     size_t num_pref, num_supp, i;
-    int k;
+    int k, idx;
+    SSL_COST_PICK pick;
+    int costed = 0;
 
     /* Can't do anything on client side */
     if (s->server == 0)
@@ -559,7 +745,11 @@ uint16_t tls1_shared_group(SSL *s, int nmatch)
             /* Should never happen */
             return 0;
         }
-        /* If not Suite B just return first preference shared curve */
+        /*
+         * If not Suite B return the cheapest shared curve if cost aware
+         * selection is on, otherwise the first preference one
+         */
+        costed = ssl_cost_pick_init(s, &pick, SSL_COST_GROUP);
         nmatch = 0;
     }
     /*
@@ -580,10 +770,21 @@ uint16_t tls1_shared_group(SSL *s, int nmatch)
         if (!tls1_in_list(id, supp, num_supp)
             || !tls_curve_allowed(s, id, SSL_SECOP_CURVE_SHARED))
                     continue;
+        if (costed) {
+            const TLS_GROUP_INFO *ginf = tls1_group_id_lookup(id);
+
+            ssl_cost_pick_offer(s, &pick, (int)i, id,
+                                ginf != NULL ? ginf->secbits : 0);
+            continue;
+        }
         if (nmatch == k)
             return id;
          k++;
     }
+    if (costed) {
+        idx = ssl_cost_pick_done(s, &pick);
+        return idx >= 0 ? pref[idx] : 0;
+    }
     if (nmatch == -1)
         return k;
     /* Out of range (nmatch > k). */
@@ -629,8 +830,7 @@ int tls1_set_groups(uint16_t **pext, size_t *pextlen,
 }
 
 # define MAX_CURVELIST   (OSSL_NELEM(nid_list) + \
-		          OSSL_NELEM(oqs_nid_list) + \
-			  OSSL_NELEM(oqs_hybrid_nid_list))
+                         2 * OSSL_NELEM(oqs_kem_group_list))
 
 typedef struct {
     size_t nidcnt;
@@ -683,6 +883,18 @@ int tls1_set_groups_list(uint16_t **pext, size_t *pextlen, const char *str)
         return 1;
     return tls1_set_groups(pext, pextlen, ncb.nid_arr, ncb.nidcnt);
 }
+
+/* Return the group id of a single group name, or 0 if it is not known */
+uint16_t tls1_group_name2id(const char *name)
+{
+    nid_cb_st ncb;
+
+    ncb.nidcnt = 0;
+    if (!nid_cb(name, strlen(name), &ncb))
+        return 0;
+    return tls1_nid2group_id(ncb.nid_arr[0]);
+}
+
 /* Return group id of a key */
 static uint16_t tls1_get_group_id(EVP_PKEY *pkey)
 {
@@ -1185,7 +1397,7 @@ static const uint16_t tls_default_sigalg[] = {
 };
 
 /* Lookup TLS signature algorithm */
-static const SIGALG_LOOKUP *tls1_lookup_sigalg(uint16_t sigalg)
+const SIGALG_LOOKUP *tls1_lookup_sigalg(uint16_t sigalg)
 {
     size_t i;
     const SIGALG_LOOKUP *s;
@@ -2483,6 +2695,21 @@ int tls1_set_sigalgs_list(CERT *c, const char *str, int client)
     return tls1_set_raw_sigalgs(c, sig.sigalgs, sig.sigalgcnt, client);
 }
 
+/*
+ * Return the TLSEXT_SIGALG_XXX value of a single signature algorithm name, in
+ * either of the forms accepted by tls1_set_sigalgs_list(), or 0 if it is not
+ * known
+ */
+uint16_t tls1_sigalg_name2id(const char *name)
+{
+    sig_cb_st sig;
+
+    sig.sigalgcnt = 0;
+    if (!sig_cb(name, strlen(name), &sig))
+        return 0;
+    return sig.sigalgs[0];
+}
+
 int tls1_set_raw_sigalgs(CERT *c, const uint16_t *psigs, size_t salglen,
                      int client)
 {
@@ -3161,6 +3388,11 @@ static const SIGALG_LOOKUP *find_sig_alg(SSL *s, X509 *x, EVP_PKEY *pkey)
     int curve = -1;
 #endif
     EVP_PKEY *tmppkey;
+    SSL_COST_PICK pick;
+    int idx, costed;
+
+    /* A server choosing among its own certificates may weigh their cost */
+    costed = pkey == NULL && ssl_cost_pick_init(s, &pick, SSL_COST_SIGALG);
 
     /* Look for a shared sigalgs matching possible certificates */
     for (i = 0; i < s->shared_sigalgslen; i++) {
@@ -3198,9 +3430,18 @@ static const SIGALG_LOOKUP *find_sig_alg(SSL *s, X509 *x, EVP_PKEY *pkey)
             if (!rsa_pss_check_min_key_size(EVP_PKEY_get0(tmppkey), lu))
                 continue;
         }
+        if (costed) {
+            ssl_cost_pick_offer(s, &pick, (int)i, lu->sigalg,
+                                EVP_PKEY_security_bits(tmppkey));
+            continue;
+        }
         break;
     }
 
+    if (costed) {
+        idx = ssl_cost_pick_done(s, &pick);
+        return idx >= 0 ? s->shared_sigalgs[idx] : NULL;
+    }
     if (i == s->shared_sigalgslen)
         return NULL;
 
@@ -3245,6 +3486,8 @@ int tls_choose_sigalg(SSL *s, int fatalerrs)
         if (SSL_USE_SIGALGS(s)) {
             size_t i;
             if (s->s3->tmp.peer_sigalgs != NULL) {
+                SSL_COST_PICK pick;
+                int idx, costed;
 #ifndef OPENSSL_NO_EC
                 int curve;
 
@@ -3259,8 +3502,9 @@ int tls_choose_sigalg(SSL *s, int fatalerrs)
 
                 /*
                  * Find highest preference signature algorithm matching
-                 * cert type
+                 * cert type, or the cheapest one if cost aware selection is on
                  */
+                costed = ssl_cost_pick_init(s, &pick, SSL_COST_SIGALG);
                 for (i = 0; i < s->shared_sigalgslen; i++) {
                     lu = s->shared_sigalgs[i];
 
@@ -3285,9 +3529,22 @@ int tls_choose_sigalg(SSL *s, int fatalerrs)
                             continue;
                     }
 #ifndef OPENSSL_NO_EC
-                    if (curve == -1 || lu->curve == curve)
+                    if (curve != -1 && lu->curve != curve)
+                        continue;
 #endif
-                        break;
+                    if (costed) {
+                        EVP_PKEY *pkey = s->cert->pkeys[sig_idx].privatekey;
+
+                        ssl_cost_pick_offer(s, &pick, (int)i, lu->sigalg,
+                                            EVP_PKEY_security_bits(pkey));
+                        continue;
+                    }
+                    break;
+                }
+                if (costed && (idx = ssl_cost_pick_done(s, &pick)) >= 0) {
+                    i = (size_t)idx;
+                    lu = s->shared_sigalgs[i];
+                    sig_idx = tls12_get_cert_sigalg_idx(s, lu);
                 }
 #ifndef OPENSSL_NO_GOST
                 /*
@@ -97,6 +97,7 @@ static const ssl_trace_tbl ssl_handshake_tbl[] = {
     {SSL3_MT_CERTIFICATE_STATUS, "CertificateStatus"},
     {SSL3_MT_SUPPLEMENTAL_DATA, "SupplementalData"},
     {SSL3_MT_KEY_UPDATE, "KeyUpdate"},
+    {SSL3_MT_COMPRESSED_CERTIFICATE, "CompressedCertificate"},
 # ifndef OPENSSL_NO_NEXTPROTONEG
     {SSL3_MT_NEXT_PROTO, "NextProto"},
 # endif
@@ -475,6 +476,8 @@ static const ssl_trace_tbl ssl_exts_tbl[] = {
     {TLSEXT_TYPE_padding, "padding"},
     {TLSEXT_TYPE_encrypt_then_mac, "encrypt_then_mac"},
     {TLSEXT_TYPE_extended_master_secret, "extended_master_secret"},
+    {TLSEXT_TYPE_cached_info, "cached_info"},
+    {TLSEXT_TYPE_compress_certificate, "compress_certificate"},
     {TLSEXT_TYPE_session_ticket, "session_ticket"},
     {TLSEXT_TYPE_psk, "psk"},
     {TLSEXT_TYPE_early_data, "early_data"},
@@ -530,85 +533,85 @@ static const ssl_trace_tbl ssl_groups_tbl[] = {
     /* OQS groups, using private code points. The TLS 1.3 spec only reserves
        FF and EC ranges for code points; we'll update our values if/when
        this gets updated for PQC. */
-    {OQS_KEM_CURVEID(NID_oqs_kem_default), "OQS KEM default"},
+    {0x01FF, "OQS KEM default"},
 ///// OQS_TEMPLATE_FRAGMENT_SSL_GROUPS_TBL_START
-    {OQS_KEM_CURVEID(NID_frodo640aes), "frodo640aes"},
-    {OQS_KEM_CURVEID(NID_frodo640shake), "frodo640shake"},
-    {OQS_KEM_CURVEID(NID_frodo976aes), "frodo976aes"},
-    {OQS_KEM_CURVEID(NID_frodo976shake), "frodo976shake"},
-    {OQS_KEM_CURVEID(NID_frodo1344aes), "frodo1344aes"},
-    {OQS_KEM_CURVEID(NID_frodo1344shake), "frodo1344shake"},
-    {OQS_KEM_CURVEID(NID_bike1l1cpa), "bike1l1cpa"},
-    {OQS_KEM_CURVEID(NID_bike1l3cpa), "bike1l3cpa"},
-    {OQS_KEM_CURVEID(NID_bike1l1fo), "bike1l1fo"},
-    {OQS_KEM_CURVEID(NID_bike1l3fo), "bike1l3fo"},
-    {OQS_KEM_CURVEID(NID_kyber512), "kyber512"},
-    {OQS_KEM_CURVEID(NID_kyber768), "kyber768"},
-    {OQS_KEM_CURVEID(NID_kyber1024), "kyber1024"},
-    {OQS_KEM_CURVEID(NID_ntru_hps2048509), "ntru_hps2048509"},
-    {OQS_KEM_CURVEID(NID_ntru_hps2048677), "ntru_hps2048677"},
-    {OQS_KEM_CURVEID(NID_ntru_hps4096821), "ntru_hps4096821"},
-    {OQS_KEM_CURVEID(NID_ntru_hrss701), "ntru_hrss701"},
-    {OQS_KEM_CURVEID(NID_lightsaber), "lightsaber"},
-    {OQS_KEM_CURVEID(NID_saber), "saber"},
-    {OQS_KEM_CURVEID(NID_firesaber), "firesaber"},
-    {OQS_KEM_CURVEID(NID_sidhp434), "sidhp434"},
-    {OQS_KEM_CURVEID(NID_sidhp503), "sidhp503"},
-    {OQS_KEM_CURVEID(NID_sidhp610), "sidhp610"},
-    {OQS_KEM_CURVEID(NID_sidhp751), "sidhp751"},
-    {OQS_KEM_CURVEID(NID_sikep434), "sikep434"},
-    {OQS_KEM_CURVEID(NID_sikep503), "sikep503"},
-    {OQS_KEM_CURVEID(NID_sikep610), "sikep610"},
-    {OQS_KEM_CURVEID(NID_sikep751), "sikep751"},
-    {OQS_KEM_CURVEID(NID_kyber90s512), "kyber90s512"},
-    {OQS_KEM_CURVEID(NID_kyber90s768), "kyber90s768"},
-    {OQS_KEM_CURVEID(NID_kyber90s1024), "kyber90s1024"},
-    {OQS_KEM_CURVEID(NID_hqc128_1_cca2), "hqc128_1_cca2"},
-    {OQS_KEM_CURVEID(NID_hqc192_1_cca2), "hqc192_1_cca2"},
-    {OQS_KEM_CURVEID(NID_hqc192_2_cca2), "hqc192_2_cca2"},
-    {OQS_KEM_CURVEID(NID_hqc256_1_cca2), "hqc256_1_cca2"},
-    {OQS_KEM_CURVEID(NID_hqc256_2_cca2), "hqc256_2_cca2"},
-    {OQS_KEM_CURVEID(NID_hqc256_3_cca2), "hqc256_3_cca2"},
+    {0x0200, "frodo640aes"},
+    {0x0201, "frodo640shake"},
+    {0x0202, "frodo976aes"},
+    {0x0203, "frodo976shake"},
+    {0x0204, "frodo1344aes"},
+    {0x0205, "frodo1344shake"},
+    {0x0206, "bike1l1cpa"},
+    {0x0207, "bike1l3cpa"},
+    {0x0223, "bike1l1fo"},
+    {0x0224, "bike1l3fo"},
+    {0x020F, "kyber512"},
+    {0x0210, "kyber768"},
+    {0x0211, "kyber1024"},
+    {0x0214, "ntru_hps2048509"},
+    {0x0215, "ntru_hps2048677"},
+    {0x0216, "ntru_hps4096821"},
+    {0x0217, "ntru_hrss701"},
+    {0x0218, "lightsaber"},
+    {0x0219, "saber"},
+    {0x021A, "firesaber"},
+    {0x021B, "sidhp434"},
+    {0x021C, "sidhp503"},
+    {0x021D, "sidhp610"},
+    {0x021E, "sidhp751"},
+    {0x021F, "sikep434"},
+    {0x0220, "sikep503"},
+    {0x0221, "sikep610"},
+    {0x0222, "sikep751"},
+    {0x0229, "kyber90s512"},
+    {0x022A, "kyber90s768"},
+    {0x022B, "kyber90s1024"},
+    {0x0232, "hqc128_1_cca2"},
+    {0x0233, "hqc192_1_cca2"},
+    {0x0234, "hqc192_2_cca2"},
+    {0x0235, "hqc256_1_cca2"},
+    {0x0236, "hqc256_2_cca2"},
+    {0x0237, "hqc256_3_cca2"},
 ///// OQS_TEMPLATE_FRAGMENT_SSL_GROUPS_TBL_END
-    {OQS_KEM_CURVEID(NID_p256_oqs_kem_default), "p256 - OQS KEM default hybrid"},
+    {0x2FFF, "p256 - OQS KEM default hybrid"},
 ///// OQS_TEMPLATE_FRAGMENT_SSL_GROUPS_TBL_HYBRID_START
-    {OQS_KEM_CURVEID(NID_p256_frodo640aes), "p256 - frodo640aes hybrid"},
-    {OQS_KEM_CURVEID(NID_p256_frodo640shake), "p256 - frodo640shake hybrid"},
-    {OQS_KEM_CURVEID(NID_p384_frodo976aes), "p384 - frodo976aes hybrid"},
-    {OQS_KEM_CURVEID(NID_p384_frodo976shake), "p384 - frodo976shake hybrid"},
-    {OQS_KEM_CURVEID(NID_p521_frodo1344aes), "p521 - frodo1344aes hybrid"},
-    {OQS_KEM_CURVEID(NID_p521_frodo1344shake), "p521 - frodo1344shake hybrid"},
-    {OQS_KEM_CURVEID(NID_p256_bike1l1cpa), "p256 - bike1l1cpa hybrid"},
-    {OQS_KEM_CURVEID(NID_p384_bike1l3cpa), "p384 - bike1l3cpa hybrid"},
-    {OQS_KEM_CURVEID(NID_p256_bike1l1fo), "p256 - bike1l1fo hybrid"},
-    {OQS_KEM_CURVEID(NID_p384_bike1l3fo), "p384 - bike1l3fo hybrid"},
-    {OQS_KEM_CURVEID(NID_p256_kyber512), "p256 - kyber512 hybrid"},
-    {OQS_KEM_CURVEID(NID_p384_kyber768), "p384 - kyber768 hybrid"},
-    {OQS_KEM_CURVEID(NID_p521_kyber1024), "p521 - kyber1024 hybrid"},
-    {OQS_KEM_CURVEID(NID_p256_ntru_hps2048509), "p256 - ntru_hps2048509 hybrid"},
-    {OQS_KEM_CURVEID(NID_p384_ntru_hps2048677), "p384 - ntru_hps2048677 hybrid"},
-    {OQS_KEM_CURVEID(NID_p521_ntru_hps4096821), "p521 - ntru_hps4096821 hybrid"},
-    {OQS_KEM_CURVEID(NID_p384_ntru_hrss701), "p384 - ntru_hrss701 hybrid"},
-    {OQS_KEM_CURVEID(NID_p256_lightsaber), "p256 - lightsaber hybrid"},
-    {OQS_KEM_CURVEID(NID_p384_saber), "p384 - saber hybrid"},
-    {OQS_KEM_CURVEID(NID_p521_firesaber), "p521 - firesaber hybrid"},
-    {OQS_KEM_CURVEID(NID_p256_sidhp434), "p256 - sidhp434 hybrid"},
-    {OQS_KEM_CURVEID(NID_p256_sidhp503), "p256 - sidhp503 hybrid"},
-    {OQS_KEM_CURVEID(NID_p384_sidhp610), "p384 - sidhp610 hybrid"},
-    {OQS_KEM_CURVEID(NID_p521_sidhp751), "p521 - sidhp751 hybrid"},
-    {OQS_KEM_CURVEID(NID_p256_sikep434), "p256 - sikep434 hybrid"},
-    {OQS_KEM_CURVEID(NID_p256_sikep503), "p256 - sikep503 hybrid"},
-    {OQS_KEM_CURVEID(NID_p384_sikep610), "p384 - sikep610 hybrid"},
-    {OQS_KEM_CURVEID(NID_p521_sikep751), "p521 - sikep751 hybrid"},
-    {OQS_KEM_CURVEID(NID_p256_kyber90s512), "p256 - kyber90s512 hybrid"},
-    {OQS_KEM_CURVEID(NID_p384_kyber90s768), "p384 - kyber90s768 hybrid"},
-    {OQS_KEM_CURVEID(NID_p521_kyber90s1024), "p521 - kyber90s1024 hybrid"},
-    {OQS_KEM_CURVEID(NID_p256_hqc128_1_cca2), "p256 - hqc128_1_cca2 hybrid"},
-    {OQS_KEM_CURVEID(NID_p384_hqc192_1_cca2), "p384 - hqc192_1_cca2 hybrid"},
-    {OQS_KEM_CURVEID(NID_p384_hqc192_2_cca2), "p384 - hqc192_2_cca2 hybrid"},
-    {OQS_KEM_CURVEID(NID_p521_hqc256_1_cca2), "p521 - hqc256_1_cca2 hybrid"},
-    {OQS_KEM_CURVEID(NID_p521_hqc256_2_cca2), "p521 - hqc256_2_cca2 hybrid"},
-    {OQS_KEM_CURVEID(NID_p521_hqc256_3_cca2), "p521 - hqc256_3_cca2 hybrid"},
+    {0x2F00, "p256 - frodo640aes hybrid"},
+    {0x2F01, "p256 - frodo640shake hybrid"},
+    {0x2F02, "p384 - frodo976aes hybrid"},
+    {0x2F03, "p384 - frodo976shake hybrid"},
+    {0x2F04, "p521 - frodo1344aes hybrid"},
+    {0x2F05, "p521 - frodo1344shake hybrid"},
+    {0x2F06, "p256 - bike1l1cpa hybrid"},
+    {0x2F07, "p384 - bike1l3cpa hybrid"},
+    {0x2F23, "p256 - bike1l1fo hybrid"},
+    {0x2F24, "p384 - bike1l3fo hybrid"},
+    {0x2F0F, "p256 - kyber512 hybrid"},
+    {0x2F10, "p384 - kyber768 hybrid"},
+    {0x2F11, "p521 - kyber1024 hybrid"},
+    {0x2F14, "p256 - ntru_hps2048509 hybrid"},
+    {0x2F15, "p384 - ntru_hps2048677 hybrid"},
+    {0x2F16, "p521 - ntru_hps4096821 hybrid"},
+    {0x2F17, "p384 - ntru_hrss701 hybrid"},
+    {0x2F18, "p256 - lightsaber hybrid"},
+    {0x2F19, "p384 - saber hybrid"},
+    {0x2F1A, "p521 - firesaber hybrid"},
+    {0x2F1B, "p256 - sidhp434 hybrid"},
+    {0x2F1C, "p256 - sidhp503 hybrid"},
+    {0x2F1D, "p384 - sidhp610 hybrid"},
+    {0x2F1E, "p521 - sidhp751 hybrid"},
+    {0x2F1F, "p256 - sikep434 hybrid"},
+    {0x2F20, "p256 - sikep503 hybrid"},
+    {0x2F21, "p384 - sikep610 hybrid"},
+    {0x2F22, "p521 - sikep751 hybrid"},
+    {0x2F29, "p256 - kyber90s512 hybrid"},
+    {0x2F2A, "p384 - kyber90s768 hybrid"},
+    {0x2F2B, "p521 - kyber90s1024 hybrid"},
+    {0x2F32, "p256 - hqc128_1_cca2 hybrid"},
+    {0x2F33, "p384 - hqc192_1_cca2 hybrid"},
+    {0x2F34, "p384 - hqc192_2_cca2 hybrid"},
+    {0x2F35, "p521 - hqc256_1_cca2 hybrid"},
+    {0x2F36, "p521 - hqc256_2_cca2 hybrid"},
+    {0x2F37, "p521 - hqc256_3_cca2 hybrid"},
 ///// OQS_TEMPLATE_FRAGMENT_SSL_GROUPS_TBL_HYBRID_END
     {0xFF01, "arbitrary_explicit_prime_curves"},
     {0xFF02, "arbitrary_explicit_char2_curves"}
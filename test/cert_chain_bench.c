@@ -0,0 +1,209 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * In-process benchmark of the server side CPU time of handshakes that send a
+ * long certificate chain and ask for a client certificate with a long list of
+ * CA names, which is where the server encodes certificates and names.  Extra
+ * copies of the server certificate in its chain, and of its subject in the CA
+ * names, stand in for the large chains and CA lists of real deployments.  For
+ * TLSv1.2 and TLSv1.3 it reports the CPU time of the server and of the client
+ * per handshake and the size of the server's Certificate and CA names.
+ *
+ * Usage: cert_chain_bench certfile keyfile [options]
+ *   -n=num           handshakes per protocol version, default 200
+ *   -chain=num       copies of the certificate added to its chain, default 8
+ *   -canames=num     copies of its subject sent as CA names, default 32
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <openssl/bio.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include "ssltestlib.h"
+#include "testutil.h"
+#include "testutil/output.h"
+
+static char *cert, *privkey;
+static int handshakes = 200;
+static int chain_copies = 8;
+static int ca_names = 32;
+
+#if defined(CLOCK_MONOTONIC)
+# ifdef CLOCK_THREAD_CPUTIME_ID
+#  define CPU_CLOCK CLOCK_THREAD_CPUTIME_ID
+# else
+#  define CPU_CLOCK CLOCK_MONOTONIC
+# endif
+
+static uint64_t cpu_ns_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CPU_CLOCK, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+#else
+static uint64_t cpu_ns_now(void)
+{
+    return (uint64_t)clock() * (1000000000 / CLOCKS_PER_SEC);
+}
+#endif
+
+/* Drives one handshake by alternating the client and the server */
+static int do_handshake(SSL *serverssl, SSL *clientssl, uint64_t *client_ns,
+                        uint64_t *server_ns)
+{
+    int retc = 0, rets = 0, loops;
+    uint64_t start;
+
+    for (loops = 0; retc != 1 || rets != 1; loops++) {
+        if (loops == 100) {
+            TEST_info("Handshake did not complete");
+            return 0;
+        }
+        if (retc != 1) {
+            start = cpu_ns_now();
+            retc = SSL_connect(clientssl);
+            *client_ns += cpu_ns_now() - start;
+            if (retc <= 0
+                    && SSL_get_error(clientssl, retc) != SSL_ERROR_WANT_READ) {
+                TEST_info("SSL_connect failed");
+                return 0;
+            }
+        }
+        if (rets != 1) {
+            start = cpu_ns_now();
+            rets = SSL_accept(serverssl);
+            *server_ns += cpu_ns_now() - start;
+            if (rets <= 0
+                    && SSL_get_error(serverssl, rets) != SSL_ERROR_WANT_READ) {
+                TEST_info("SSL_accept failed");
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* The size of the encoding of the chain and CA names that |sctx| sends */
+static size_t encoded_size(SSL_CTX *sctx, X509 *x)
+{
+    STACK_OF(X509) *chain = NULL;
+    STACK_OF(X509_NAME) *names = SSL_CTX_get_client_CA_list(sctx);
+    size_t size = i2d_X509(x, NULL);
+    int i;
+
+    SSL_CTX_get0_chain_certs(sctx, &chain);
+    for (i = 0; i < sk_X509_num(chain); i++)
+        size += i2d_X509(sk_X509_value(chain, i), NULL);
+    for (i = 0; i < sk_X509_NAME_num(names); i++)
+        size += i2d_X509_NAME(sk_X509_NAME_value(names, i), NULL);
+    return size;
+}
+
+static int bench_chain(int idx)
+{
+    int version = idx == 0 ? TLS1_2_VERSION : TLS1_3_VERSION;
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    BIO *certbio = NULL;
+    X509 *x = NULL;
+    uint64_t client_ns = 0, server_ns = 0;
+    int i, ret = 0;
+
+#ifdef OPENSSL_NO_TLS1_2
+    if (version == TLS1_2_VERSION)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_3
+    if (version == TLS1_3_VERSION)
+        return 1;
+#endif
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), version, version,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set1_groups_list(sctx, "X25519:P-256"))
+            || !TEST_true(SSL_CTX_set1_groups_list(cctx, "X25519:P-256"))
+            || !TEST_true(SSL_CTX_set_num_tickets(sctx, 0))
+            || !TEST_ptr(certbio = BIO_new_file(cert, "r"))
+            || !TEST_ptr(x = PEM_read_bio_X509(certbio, NULL, NULL, NULL)))
+        goto end;
+    SSL_CTX_set_session_cache_mode(cctx, SSL_SESS_CACHE_OFF);
+    SSL_CTX_set_verify(sctx, SSL_VERIFY_PEER, NULL);
+    for (i = 0; i < chain_copies; i++) {
+        if (!TEST_true(SSL_CTX_add1_chain_cert(sctx, x)))
+            goto end;
+    }
+    for (i = 0; i < ca_names; i++) {
+        if (!TEST_true(SSL_CTX_add_client_CA(sctx, x)))
+            goto end;
+    }
+
+    for (i = 0; i < handshakes; i++) {
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+                || !TEST_true(do_handshake(serverssl, clientssl, &client_ns,
+                                           &server_ns)))
+            goto end;
+        SSL_free(serverssl);
+        SSL_free(clientssl);
+        serverssl = clientssl = NULL;
+    }
+
+    test_printf_stdout("%-8s %6d %8d %10zu %10.1f %10.1f\n",
+                       version == TLS1_2_VERSION ? "TLSv1.2" : "TLSv1.3",
+                       chain_copies + 1, ca_names, encoded_size(sctx, x),
+                       server_ns / 1e3 / handshakes,
+                       client_ns / 1e3 / handshakes);
+    ret = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    X509_free(x);
+    BIO_free(certbio);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return ret;
+}
+
+int setup_tests(void)
+{
+    const char *arg;
+
+    if (!TEST_ptr(cert = test_get_argument(0))
+            || !TEST_ptr(privkey = test_get_argument(1)))
+        return 0;
+
+    if ((arg = test_get_option_argument("-n=")) != NULL
+            && (handshakes = atoi(arg)) <= 0) {
+        TEST_error("bad handshake count %s", arg);
+        return 0;
+    }
+    if ((arg = test_get_option_argument("-chain=")) != NULL
+            && (chain_copies = atoi(arg)) < 0) {
+        TEST_error("bad chain length %s", arg);
+        return 0;
+    }
+    if ((arg = test_get_option_argument("-canames=")) != NULL
+            && (ca_names = atoi(arg)) < 0) {
+        TEST_error("bad CA name count %s", arg);
+        return 0;
+    }
+
+    test_printf_stdout("%-8s %6s %8s %10s %10s %10s\n", "version", "certs",
+                       "CA names", "DER bytes", "server us", "client us");
+    ADD_ALL_TESTS(bench_chain, 2);
+    return 1;
+}
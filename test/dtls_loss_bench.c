@@ -0,0 +1,392 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * In-process DTLS handshake benchmark under packet loss.  The client and the
+ * server talk over a pair of memory datagram BIOs behind a filter that drops
+ * each datagram with a given probability, and the handshake is driven by the
+ * retransmission timers.  For each loss rate it reports how many handshakes
+ * completed, their completion time, and the datagrams sent, dropped and
+ * retransmitted per handshake.  Extra copies of the server certificate in its
+ * chain stand in for the large certificates of PQC signature algorithms, so
+ * that the Certificate message is reassembled from many fragments.
+ *
+ * Usage: dtls_loss_bench certfile keyfile [options]
+ *   -loss=p1:p2...   loss rates in percent, default 0:1:2:5:10:20
+ *   -n=num           handshakes per loss rate, default 20
+ *   -mtu=bytes       link MTU, default 1200
+ *   -chain=num       copies of the certificate added to its chain, default 8
+ *   -timeout=usec    initial retransmission timeout, default 10000
+ *   -seed=num        seed for the loss pattern, default 1
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <openssl/bio.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include "internal/nelem.h"
+#include "ssltestlib.h"
+#include "testutil.h"
+#include "testutil/output.h"
+
+#define MAX_RATES       32
+/* Give up on a handshake after this long */
+#define MAX_HANDSHAKE_NS    (60 * (uint64_t)1000000000)
+/* As for the default timer, the timeout doubles up to this */
+#define MAX_TIMEOUT_US      (60 * 1000000U)
+
+static char *cert, *privkey;
+static double rates[MAX_RATES];
+static size_t num_rates;
+static char *rate_list;
+static int handshakes = 20;
+static long mtu = 1200;
+static int chain_copies = 8;
+static unsigned int initial_timeout = 10000;
+static uint32_t rng_state = 1;
+
+/* Per handshake counts, updated by the loss filter */
+static uint64_t sent, dropped;
+static double loss;
+
+static BIO_METHOD *meth_loss = NULL;
+
+#if defined(CLOCK_MONOTONIC)
+static uint64_t ns_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+#else
+static uint64_t ns_now(void)
+{
+    return (uint64_t)clock() * (1000000000 / CLOCKS_PER_SEC);
+}
+#endif
+
+/* xorshift32: the loss pattern only needs to be cheap and repeatable */
+static double next_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state / 4294967296.0;
+}
+
+/* Each write is a datagram: drop it or pass it on */
+static int loss_write(BIO *bio, const char *in, int inl)
+{
+    BIO *next = BIO_next(bio);
+    int ret;
+
+    if (inl <= 0)
+        return 0;
+    sent++;
+    if (next_random() < loss) {
+        dropped++;
+        return inl;
+    }
+    BIO_clear_retry_flags(bio);
+    ret = BIO_write(next, in, inl);
+    BIO_copy_next_retry(bio);
+    return ret;
+}
+
+static int loss_read(BIO *bio, char *out, int outl)
+{
+    BIO *next = BIO_next(bio);
+    int ret;
+
+    BIO_clear_retry_flags(bio);
+    ret = BIO_read(next, out, outl);
+    BIO_copy_next_retry(bio);
+    return ret;
+}
+
+static long loss_ctrl(BIO *bio, int cmd, long num, void *ptr)
+{
+    BIO *next = BIO_next(bio);
+
+    if (next == NULL)
+        return 0;
+    return BIO_ctrl(next, cmd, num, ptr);
+}
+
+static int loss_new(BIO *bio)
+{
+    BIO_set_init(bio, 1);
+    return 1;
+}
+
+static const BIO_METHOD *bio_f_loss(void)
+{
+    if (meth_loss == NULL) {
+        if (!TEST_ptr(meth_loss = BIO_meth_new(BIO_TYPE_FILTER,
+                                               "Datagram loss filter"))
+                || !TEST_true(BIO_meth_set_write(meth_loss, loss_write))
+                || !TEST_true(BIO_meth_set_read(meth_loss, loss_read))
+                || !TEST_true(BIO_meth_set_ctrl(meth_loss, loss_ctrl))
+                || !TEST_true(BIO_meth_set_create(meth_loss, loss_new)))
+            return NULL;
+    }
+    return meth_loss;
+}
+
+static unsigned int timer_cb(SSL *s, unsigned int timer_us)
+{
+    if (timer_us == 0)
+        return initial_timeout;
+    return timer_us >= MAX_TIMEOUT_US / 2 ? MAX_TIMEOUT_US : 2 * timer_us;
+}
+
+/*
+ * Drives one handshake to completion.  While neither side has anything to
+ * send we poll until the first retransmission timer expires, counting the
+ * timeouts in |*timeouts|.  A side that has finished keeps reading, so that
+ * it answers retransmissions of the peer's last flight.
+ */
+static int do_handshake(SSL *serverssl, SSL *clientssl, uint64_t start,
+                        uint64_t *timeouts)
+{
+    int done[2] = { 0, 0 }, side, ret;
+    unsigned char buf;
+
+    while (!done[0] || !done[1]) {
+        uint64_t before = sent;
+
+        if (ns_now() - start > MAX_HANDSHAKE_NS) {
+            TEST_info("Handshake did not complete");
+            return 0;
+        }
+        for (side = 0; side < 2; side++) {
+            SSL *s = side == 0 ? clientssl : serverssl;
+
+            if (!done[side]) {
+                ret = side == 0 ? SSL_connect(s) : SSL_accept(s);
+                if (ret == 1) {
+                    done[side] = 1;
+                    continue;
+                }
+            } else if ((ret = SSL_read(s, &buf, sizeof(buf))) > 0) {
+                TEST_info("Unexpected application data");
+                return 0;
+            }
+            if (SSL_get_error(s, ret) != SSL_ERROR_WANT_READ) {
+                TEST_info("%s failed", side == 0 ? "Client" : "Server");
+                return 0;
+            }
+        }
+        if (sent != before || (done[0] && done[1]))
+            continue;
+
+        /* Nothing in flight: the handshake can only go on after a timeout */
+        for (;;) {
+            struct timeval tv;
+            int running = 0;
+
+            for (side = 0; side < 2; side++) {
+                SSL *s = side == 0 ? clientssl : serverssl;
+
+                if (!DTLSv1_get_timeout(s, &tv))
+                    continue;
+                running = 1;
+                if ((ret = DTLSv1_handle_timeout(s)) < 0) {
+                    TEST_info("Retransmission failed");
+                    return 0;
+                }
+                if (ret > 0)
+                    (*timeouts)++;
+            }
+            if (!running) {
+                TEST_info("Handshake stalled with no timer running");
+                return 0;
+            }
+            if (sent != before)
+                break;
+        }
+    }
+    return 1;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int bench_loss(int idx)
+{
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    BIO *certbio = NULL, *sfilter = NULL, *cfilter = NULL;
+    X509 *chaincert = NULL;
+    uint64_t *times = NULL, total_sent = 0, total_dropped = 0;
+    uint64_t total_timeouts = 0, total_ns = 0, start;
+    int i, completed = 0, ret = 0;
+
+    loss = rates[idx] / 100;
+    if (!TEST_ptr(times = OPENSSL_malloc(handshakes * sizeof(*times)))
+            || !TEST_true(create_ssl_ctx_pair(DTLS_server_method(),
+                                              DTLS_client_method(),
+                                              DTLS1_VERSION, 0, &sctx, &cctx,
+                                              cert, privkey))
+            || !TEST_true(SSL_CTX_set_options(sctx, SSL_OP_NO_QUERY_MTU))
+            || !TEST_true(SSL_CTX_set_options(cctx, SSL_OP_NO_QUERY_MTU))
+            || !TEST_ptr(certbio = BIO_new_file(cert, "r"))
+            || !TEST_ptr(chaincert = PEM_read_bio_X509(certbio, NULL, NULL,
+                                                       NULL)))
+        goto end;
+    for (i = 0; i < chain_copies; i++)
+        if (!TEST_true(SSL_CTX_add1_chain_cert(sctx, chaincert)))
+            goto end;
+
+    for (i = 0; i < handshakes; i++) {
+        uint64_t timeouts = 0;
+
+        sent = dropped = 0;
+        if (!TEST_ptr(sfilter = BIO_new(bio_f_loss()))
+                || !TEST_ptr(cfilter = BIO_new(bio_f_loss())))
+            goto end;
+        /* create_ssl_objects() takes the filters, even on failure */
+        ret = create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                 sfilter, cfilter);
+        sfilter = cfilter = NULL;
+        if (!TEST_true(ret))
+            goto end;
+        ret = 0;
+        if (!TEST_true(SSL_set_mtu(serverssl, mtu))
+                || !TEST_true(SSL_set_mtu(clientssl, mtu)))
+            goto end;
+        DTLS_set_timer_cb(serverssl, timer_cb);
+        DTLS_set_timer_cb(clientssl, timer_cb);
+
+        start = ns_now();
+        if (do_handshake(serverssl, clientssl, start, &timeouts)) {
+            times[completed] = ns_now() - start;
+            total_ns += times[completed];
+            completed++;
+        }
+        total_sent += sent;
+        total_dropped += dropped;
+        total_timeouts += timeouts;
+
+        SSL_free(serverssl);
+        SSL_free(clientssl);
+        serverssl = clientssl = NULL;
+    }
+
+    qsort(times, completed, sizeof(*times), cmp_u64);
+    test_printf_stdout("%6.1f %5d/%-5d %9.2f %9.2f %9.2f %9.1f %8.1f %8.1f\n",
+                       rates[idx], completed, handshakes,
+                       completed > 0 ? total_ns / 1e6 / completed : 0.0,
+                       completed > 0 ? times[completed / 2] / 1e6 : 0.0,
+                       completed > 0 ? times[(completed * 95) / 100] / 1e6
+                                     : 0.0,
+                       (double)total_sent / handshakes,
+                       (double)total_dropped / handshakes,
+                       (double)total_timeouts / handshakes);
+    /* With no loss every handshake has to complete */
+    ret = rates[idx] > 0 || TEST_int_eq(completed, handshakes);
+
+ end:
+    BIO_free(sfilter);
+    BIO_free(cfilter);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    X509_free(chaincert);
+    BIO_free(certbio);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    OPENSSL_free(times);
+    return ret;
+}
+
+static int add_rate(const char *str)
+{
+    char *end;
+    double rate = strtod(str, &end);
+
+    if (num_rates == MAX_RATES || *end != '\0' || rate < 0 || rate >= 100) {
+        TEST_error("bad loss rate %s", str);
+        return 0;
+    }
+    rates[num_rates++] = rate;
+    return 1;
+}
+
+int setup_tests(void)
+{
+    static const char *default_rates[] = { "0", "1", "2", "5", "10", "20" };
+    const char *arg;
+    char *rate;
+    size_t i;
+
+    if (!TEST_ptr(cert = test_get_argument(0))
+            || !TEST_ptr(privkey = test_get_argument(1)))
+        return 0;
+
+    if ((arg = test_get_option_argument("-n=")) != NULL
+            && (handshakes = atoi(arg)) <= 0) {
+        TEST_error("bad handshake count %s", arg);
+        return 0;
+    }
+    if ((arg = test_get_option_argument("-mtu=")) != NULL
+            && (mtu = atol(arg)) <= 0) {
+        TEST_error("bad MTU %s", arg);
+        return 0;
+    }
+    if ((arg = test_get_option_argument("-chain=")) != NULL
+            && (chain_copies = atoi(arg)) < 0) {
+        TEST_error("bad chain length %s", arg);
+        return 0;
+    }
+    if ((arg = test_get_option_argument("-timeout=")) != NULL
+            && (initial_timeout = (unsigned int)atoi(arg)) == 0) {
+        TEST_error("bad timeout %s", arg);
+        return 0;
+    }
+    if ((arg = test_get_option_argument("-seed=")) != NULL
+            && (rng_state = (uint32_t)strtoul(arg, NULL, 0)) == 0) {
+        TEST_error("bad seed %s", arg);
+        return 0;
+    }
+
+    if ((arg = test_get_option_argument("-loss=")) != NULL) {
+        if (!TEST_ptr(rate_list = OPENSSL_strdup(arg)))
+            return 0;
+        for (rate = strtok(rate_list, ":"); rate != NULL;
+             rate = strtok(NULL, ":"))
+            if (!add_rate(rate))
+                return 0;
+    } else {
+        for (i = 0; i < OSSL_NELEM(default_rates); i++)
+            if (!add_rate(default_rates[i]))
+                return 0;
+    }
+
+    test_printf_stdout("%6s %11s %9s %9s %9s %9s %8s %8s\n", "loss%", "done",
+                       "mean ms", "p50 ms", "p95 ms", "datagrams", "dropped",
+                       "timeouts");
+    ADD_ALL_TESTS(bench_loss, num_rates);
+    return 1;
+}
+
+void cleanup_tests(void)
+{
+    bio_s_mempacket_test_free();
+    BIO_meth_free(meth_loss);
+    OPENSSL_free(rate_list);
+}
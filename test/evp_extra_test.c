@@ -19,6 +19,7 @@
 #include <openssl/pem.h>
 #include <openssl/kdf.h>
 #include <openssl/dh.h>
+#include <oqs/oqs.h>
 #include "testutil.h"
 #include "internal/nelem.h"
 #include "crypto/evp.h"
@@ -1173,6 +1174,89 @@ static int test_EVP_PKEY_set1_DH(void)
 }
 #endif
 
+static EVP_PKEY *oqs_keygen(int nid)
+{
+    EVP_PKEY_CTX *kctx = EVP_PKEY_CTX_new_id(nid, NULL);
+    EVP_PKEY *pkey = NULL;
+
+    if (kctx == NULL
+            || EVP_PKEY_keygen_init(kctx) <= 0
+            || EVP_PKEY_keygen(kctx, &pkey) <= 0) {
+        EVP_PKEY_free(pkey);
+        pkey = NULL;
+    }
+    EVP_PKEY_CTX_free(kctx);
+    return pkey;
+}
+
+/* Test EVP_DigestVerifyBatch() on OQS and RSA signatures, one of them bad */
+static int test_EVP_DigestVerifyBatch(void)
+{
+    static const unsigned char msg[] = "batch";
+    EVP_PKEY *keys[4] = { NULL, NULL, NULL, NULL };
+    unsigned char *sigs[4] = { NULL, NULL, NULL, NULL };
+    EVP_PKEY_VERIFY_ITEM items[4];
+    EVP_MD_CTX *ctx = NULL;
+    size_t i;
+    int ret = 0;
+
+    if (!OQS_SIG_alg_is_enabled(get_oqs_alg_name(NID_dilithium2))) {
+        TEST_note("dilithium2 not enabled in liboqs, skipping");
+        return 1;
+    }
+
+    if (!TEST_ptr(ctx = EVP_MD_CTX_new())
+            || !TEST_ptr(keys[0] = oqs_keygen(NID_dilithium2))
+            || !TEST_ptr(keys[1] = load_example_rsa_key())
+            || !TEST_ptr(keys[2] = oqs_keygen(NID_p256_dilithium2))
+            || !TEST_ptr(keys[3] = oqs_keygen(NID_dilithium2)))
+        goto err;
+
+    for (i = 0; i < OSSL_NELEM(items); i++) {
+        size_t siglen = EVP_PKEY_size(keys[i]);
+
+        EVP_MD_CTX_reset(ctx);
+        if (!TEST_ptr(sigs[i] = OPENSSL_malloc(siglen))
+                || !TEST_true(EVP_DigestSignInit(ctx, NULL, NULL, NULL,
+                                                 keys[i]))
+                || !TEST_true(EVP_DigestSign(ctx, sigs[i], &siglen, msg,
+                                             sizeof(msg))))
+            goto err;
+        items[i].pkey = keys[i];
+        items[i].tbs = msg;
+        items[i].tbslen = sizeof(msg);
+        items[i].sig = sigs[i];
+        items[i].siglen = siglen;
+        items[i].result = -2;
+    }
+
+    if (!TEST_true(EVP_DigestVerifyBatch(items, OSSL_NELEM(items))))
+        goto err;
+    for (i = 0; i < OSSL_NELEM(items); i++) {
+        if (!TEST_int_eq(items[i].result, 1))
+            goto err;
+    }
+
+    /* The last signature is checked against another key */
+    items[3].pkey = keys[0];
+    if (!TEST_false(EVP_DigestVerifyBatch(items, OSSL_NELEM(items)))
+            || !TEST_int_eq(items[0].result, 1)
+            || !TEST_int_eq(items[1].result, 1)
+            || !TEST_int_eq(items[2].result, 1)
+            || !TEST_int_ne(items[3].result, 1))
+        goto err;
+
+    ret = 1;
+ err:
+    ERR_clear_error();
+    for (i = 0; i < OSSL_NELEM(items); i++) {
+        EVP_PKEY_free(keys[i]);
+        OPENSSL_free(sigs[i]);
+    }
+    EVP_MD_CTX_free(ctx);
+    return ret;
+}
+
 int setup_tests(void)
 {
     ADD_TEST(test_EVP_DigestSignInit);
@@ -1208,6 +1292,7 @@ int setup_tests(void)
 #ifndef OPENSSL_NO_DH
     ADD_TEST(test_EVP_PKEY_set1_DH);
 #endif
+    ADD_TEST(test_EVP_DigestVerifyBatch);
 
     return 1;
 }
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Loopback benchmark of bulk transfer with the record layer in user space and
+ * with SSL_MODE_ENABLE_KTLS.  A client and a server in one thread talk over a
+ * pair of TCP sockets, and the client sends a fixed amount of data.  For each
+ * protocol version and mode it reports whether the kernel took the records,
+ * the throughput, and the CPU time, user and system, spent per megabyte.  If
+ * the kernel has no TLS module both modes run in user space.
+ *
+ * Usage: ktls_bench certfile keyfile [options]
+ *   -mb=num          megabytes sent per run, default 64
+ *   -size=num        bytes per SSL_write(), default 16384
+ *   -cipher=name     TLSv1.2 cipher, default ECDHE-RSA-AES128-GCM-SHA256
+ *   -ciphersuite=name
+ *                    TLSv1.3 cipher suite, default TLS_AES_128_GCM_SHA256
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <openssl/bio.h>
+#include <openssl/ssl.h>
+#include "internal/ktls.h"
+#include "ssltestlib.h"
+#include "testutil.h"
+#include "testutil/output.h"
+
+#ifndef OPENSSL_NO_KTLS
+# include <unistd.h>
+
+static char *cert, *privkey;
+static size_t megabytes = 64;
+static size_t write_size = 16384;
+static const char *cipher = "ECDHE-RSA-AES128-GCM-SHA256";
+static const char *ciphersuite = "TLS_AES_128_GCM_SHA256";
+
+static uint64_t ns_now(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/* Sends |total| bytes from |clientssl| to |serverssl| */
+static int transfer(SSL *clientssl, SSL *serverssl, const unsigned char *wbuf,
+                    unsigned char *rbuf, size_t total)
+{
+    size_t sent = 0, received = 0, len, n;
+
+    while (received < total) {
+        if (sent < total) {
+            len = total - sent < write_size ? total - sent : write_size;
+            if (SSL_write_ex(clientssl, wbuf, len, &n)) {
+                sent += n;
+            } else if (SSL_get_error(clientssl, 0) != SSL_ERROR_WANT_WRITE) {
+                TEST_info("SSL_write failed");
+                return 0;
+            }
+        }
+        if (SSL_read_ex(serverssl, rbuf, write_size, &n)) {
+            received += n;
+        } else if (SSL_get_error(serverssl, 0) != SSL_ERROR_WANT_READ) {
+            TEST_info("SSL_read failed");
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Test 0: TLSv1.2 in user space
+ * Test 1: TLSv1.2 with SSL_MODE_ENABLE_KTLS
+ * Test 2: TLSv1.3 in user space
+ * Test 3: TLSv1.3 with SSL_MODE_ENABLE_KTLS
+ */
+static int bench_ktls(int idx)
+{
+    int version = idx < 2 ? TLS1_2_VERSION : TLS1_3_VERSION;
+    int ktls = idx % 2;
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    unsigned char *wbuf = NULL, *rbuf = NULL;
+    size_t total = megabytes * 1024 * 1024;
+    uint64_t wall, cpu;
+    int cfd = -1, sfd = -1, ret = 0;
+
+#ifdef OPENSSL_NO_TLS1_2
+    if (version == TLS1_2_VERSION)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_3
+    if (version == TLS1_3_VERSION)
+        return 1;
+#endif
+
+    if (!TEST_ptr(wbuf = OPENSSL_zalloc(write_size))
+            || !TEST_ptr(rbuf = OPENSSL_malloc(write_size))
+            || !TEST_true(create_test_sockets(&cfd, &sfd))
+            || !TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                              TLS_client_method(), version,
+                                              version, &sctx, &cctx, cert,
+                                              privkey))
+            || !TEST_true(SSL_CTX_set_cipher_list(cctx, cipher))
+            || !TEST_true(SSL_CTX_set_ciphersuites(cctx, ciphersuite)))
+        goto end;
+    if (ktls) {
+        SSL_CTX_set_mode(sctx, SSL_MODE_ENABLE_KTLS);
+        SSL_CTX_set_mode(cctx, SSL_MODE_ENABLE_KTLS);
+    }
+    if (!TEST_true(create_ssl_objects2(sctx, cctx, &serverssl, &clientssl,
+                                       sfd, cfd))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    wall = ns_now(CLOCK_MONOTONIC);
+    cpu = ns_now(CLOCK_PROCESS_CPUTIME_ID);
+    if (!TEST_true(transfer(clientssl, serverssl, wbuf, rbuf, total)))
+        goto end;
+    cpu = ns_now(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+    wall = ns_now(CLOCK_MONOTONIC) - wall;
+
+    test_printf_stdout("%-8s %-5s %-6s %10.1f %12.1f\n",
+                       version == TLS1_2_VERSION ? "TLSv1.2" : "TLSv1.3",
+                       ktls ? "ktls" : "user",
+                       BIO_get_ktls_send(SSL_get_wbio(clientssl))
+                       ? "yes" : "no",
+                       total / 1048576.0 / (wall / 1e9),
+                       cpu / 1e3 / megabytes);
+    ret = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    OPENSSL_free(wbuf);
+    OPENSSL_free(rbuf);
+    if (cfd != -1)
+        close(cfd);
+    if (sfd != -1)
+        close(sfd);
+    return ret;
+}
+#endif
+
+int setup_tests(void)
+{
+#ifndef OPENSSL_NO_KTLS
+    const char *arg;
+    int n;
+
+    if (!TEST_ptr(cert = test_get_argument(0))
+            || !TEST_ptr(privkey = test_get_argument(1)))
+        return 0;
+
+    if ((arg = test_get_option_argument("-mb=")) != NULL) {
+        if ((n = atoi(arg)) <= 0) {
+            TEST_error("bad megabyte count %s", arg);
+            return 0;
+        }
+        megabytes = (size_t)n;
+    }
+    if ((arg = test_get_option_argument("-size=")) != NULL) {
+        if ((n = atoi(arg)) <= 0) {
+            TEST_error("bad write size %s", arg);
+            return 0;
+        }
+        write_size = (size_t)n;
+    }
+    if ((arg = test_get_option_argument("-cipher=")) != NULL)
+        cipher = arg;
+    if ((arg = test_get_option_argument("-ciphersuite=")) != NULL)
+        ciphersuite = arg;
+
+    test_printf_stdout("%-8s %-5s %-6s %10s %12s\n", "version", "mode",
+                       "kernel", "MB/s", "CPU us/MB");
+    ADD_ALL_TESTS(bench_ktls, 4);
+#endif
+    return 1;
+}
@@ -0,0 +1,373 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * In-process TLS 1.3 handshake benchmark over a memory BIO pair, for every
+ * combination of key exchange group and signature algorithm.  For each one
+ * it reports handshakes per second, the CPU time spent in the client and in
+ * the server, the bytes of every flight, the records each side sends and the
+ * round trips the client waits for.
+ *
+ * Options (all optional):
+ *   -groups=g1:g2...    groups to run, default X25519 and every OQS group
+ *   -sigalgs=s1:s2...   signature algorithms to run, default ecdsap256 and
+ *                       every OQS signature algorithm
+ *   -n=num              handshakes per combination, default 10
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/objects.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <oqs/oqs.h>
+#include "internal/nelem.h"
+#include "ssltestlib.h"
+#include "testutil.h"
+#include "testutil/output.h"
+
+#define MAX_FLIGHTS     8
+#define MAX_ALGS        128
+
+typedef struct {
+    const char *name;
+    EVP_PKEY *pkey;
+    X509 *cert;
+} BENCH_SIGALG;
+
+typedef struct {
+    uint64_t client_ns;
+    uint64_t server_ns;
+    size_t flight_bytes[MAX_FLIGHTS];
+    int flights;
+    int client_records;
+    int server_records;
+} HANDSHAKE_STATS;
+
+static const char *groups[MAX_ALGS];
+static size_t num_groups;
+static BENCH_SIGALG sigalgs[MAX_ALGS];
+static size_t num_sigalgs;
+static int handshakes = 10;
+static char *group_list, *sigalg_list;
+
+#if defined(CLOCK_MONOTONIC)
+# ifdef CLOCK_THREAD_CPUTIME_ID
+#  define CPU_CLOCK CLOCK_THREAD_CPUTIME_ID
+# else
+#  define CPU_CLOCK CLOCK_MONOTONIC
+# endif
+
+/* Returns the CPU time of this thread if |cpu| is set, else wall time */
+static uint64_t ns_now(int cpu)
+{
+    struct timespec ts;
+
+    clock_gettime(cpu ? CPU_CLOCK : CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+#else
+static uint64_t ns_now(int cpu)
+{
+    return (uint64_t)clock() * (1000000000 / CLOCKS_PER_SEC);
+}
+#endif
+
+static void count_records(int write_p, int version, int content_type,
+                          const void *buf, size_t len, SSL *ssl, void *arg)
+{
+    if (write_p && content_type == SSL3_RT_HEADER)
+        (*(int *)arg)++;
+}
+
+/*
+ * Drives one handshake by alternating the client and the server, timing
+ * each side and recording what it writes.  Consecutive writes by the same
+ * side make up one flight.
+ */
+static int do_handshake(SSL *serverssl, SSL *clientssl, HANDSHAKE_STATS *st)
+{
+    BIO *cbio = SSL_get_wbio(clientssl), *sbio = SSL_get_wbio(serverssl);
+    uint64_t cwritten = BIO_number_written(cbio);
+    uint64_t swritten = BIO_number_written(sbio);
+    int retc = 0, rets = 0, last_writer = -1, loops, side;
+
+    SSL_set_msg_callback(clientssl, count_records);
+    SSL_set_msg_callback_arg(clientssl, &st->client_records);
+    SSL_set_msg_callback(serverssl, count_records);
+    SSL_set_msg_callback_arg(serverssl, &st->server_records);
+
+    for (loops = 0; retc != 1 || rets != 1; loops++) {
+        if (loops == 100) {
+            TEST_info("Handshake did not complete");
+            return 0;
+        }
+        for (side = 0; side < 2; side++) {
+            SSL *s = side == 0 ? clientssl : serverssl;
+            BIO *wbio = side == 0 ? cbio : sbio;
+            uint64_t *written = side == 0 ? &cwritten : &swritten;
+            uint64_t start, now;
+            int ret;
+
+            if ((side == 0 ? retc : rets) == 1)
+                continue;
+            start = ns_now(1);
+            ret = side == 0 ? SSL_connect(s) : SSL_accept(s);
+            now = ns_now(1);
+            if (side == 0) {
+                retc = ret;
+                st->client_ns += now - start;
+            } else {
+                rets = ret;
+                st->server_ns += now - start;
+            }
+            if (ret <= 0 && SSL_get_error(s, ret) != SSL_ERROR_WANT_READ) {
+                TEST_info("%s failed", side == 0 ? "SSL_connect"
+                                                  : "SSL_accept");
+                return 0;
+            }
+            if (BIO_number_written(wbio) > *written) {
+                if (last_writer != side) {
+                    last_writer = side;
+                    st->flights++;
+                }
+                if (st->flights <= MAX_FLIGHTS)
+                    st->flight_bytes[st->flights - 1] +=
+                        (size_t)(BIO_number_written(wbio) - *written);
+                *written = BIO_number_written(wbio);
+            }
+        }
+    }
+    return 1;
+}
+
+static int bench_handshake(int idx)
+{
+    const char *group = groups[idx / num_sigalgs];
+    BENCH_SIGALG *sig = &sigalgs[idx % num_sigalgs];
+    SSL_CTX *sctx = NULL, *cctx = NULL;
+    SSL *serverssl = NULL, *clientssl = NULL;
+    HANDSHAKE_STATS first, total;
+    uint64_t start, elapsed;
+    char flights[MAX_FLIGHTS * 16];
+    size_t pos = 0;
+    int i, ret = 0;
+
+    memset(&first, 0, sizeof(first));
+    memset(&total, 0, sizeof(total));
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), TLS1_3_VERSION,
+                                       TLS1_3_VERSION, &sctx, &cctx, NULL,
+                                       NULL))
+            || !TEST_int_eq(SSL_CTX_use_certificate(sctx, sig->cert), 1)
+            || !TEST_int_eq(SSL_CTX_use_PrivateKey(sctx, sig->pkey), 1)
+            || !TEST_true(SSL_CTX_set_num_tickets(sctx, 0)))
+        goto end;
+    if (!SSL_CTX_set1_groups_list(sctx, group)
+            || !SSL_CTX_set1_groups_list(cctx, group)) {
+        TEST_note("%s is not supported by libssl, skipping", group);
+        ret = 1;
+        goto end;
+    }
+
+    start = ns_now(0);
+    for (i = 0; i < handshakes; i++) {
+        HANDSHAKE_STATS st;
+
+        memset(&st, 0, sizeof(st));
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+                || !TEST_true(do_handshake(serverssl, clientssl, &st)))
+            goto end;
+        if (i == 0)
+            first = st;
+        total.client_ns += st.client_ns;
+        total.server_ns += st.server_ns;
+        SSL_free(serverssl);
+        SSL_free(clientssl);
+        serverssl = clientssl = NULL;
+    }
+    elapsed = ns_now(0) - start;
+
+    for (i = 0; i < first.flights && i < MAX_FLIGHTS; i++)
+        pos += BIO_snprintf(flights + pos, sizeof(flights) - pos, "%s%c:%zu",
+                            i > 0 ? " " : "", i % 2 == 0 ? 'c' : 's',
+                            first.flight_bytes[i]);
+    test_printf_stdout("%-28s %-32s %9.1f %10.1f %10.1f %4d/%-4d %3d  %s\n",
+                       group, sig->name,
+                       handshakes * 1e9 / (double)elapsed,
+                       total.client_ns / 1e3 / handshakes,
+                       total.server_ns / 1e3 / handshakes,
+                       first.client_records, first.server_records,
+                       first.flights / 2, flights);
+    ret = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return ret;
+}
+
+static EVP_PKEY *keygen(const char *name)
+{
+    EVP_PKEY_CTX *kctx;
+    EVP_PKEY *pkey = NULL;
+    int nid = OBJ_sn2nid(name);
+
+    if (strcmp(name, "ecdsap256") == 0) {
+        kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+        if (kctx == NULL
+                || EVP_PKEY_keygen_init(kctx) <= 0
+                || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx,
+                                                          NID_X9_62_prime256v1) <= 0)
+            goto end;
+    } else {
+        if (!IS_OQS_OPENSSL_SIG_NID(nid)
+                || !OQS_SIG_alg_is_enabled(get_oqs_alg_name(nid)))
+            return NULL;
+        if ((kctx = EVP_PKEY_CTX_new_id(nid, NULL)) == NULL
+                || EVP_PKEY_keygen_init(kctx) <= 0)
+            goto end;
+    }
+    if (EVP_PKEY_keygen(kctx, &pkey) <= 0)
+        pkey = NULL;
+ end:
+    EVP_PKEY_CTX_free(kctx);
+    return pkey;
+}
+
+static X509 *self_signed(EVP_PKEY *pkey)
+{
+    X509 *x = X509_new();
+    X509_NAME *name;
+
+    if (x == NULL
+            || !X509_set_version(x, 2)
+            || !ASN1_INTEGER_set(X509_get_serialNumber(x), 1)
+            || X509_gmtime_adj(X509_getm_notBefore(x), 0) == NULL
+            || X509_gmtime_adj(X509_getm_notAfter(x), 86400) == NULL
+            || (name = X509_get_subject_name(x)) == NULL
+            || !X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                           (const unsigned char *)"bench",
+                                           -1, -1, 0)
+            || !X509_set_issuer_name(x, name)
+            || !X509_set_pubkey(x, pkey)
+            || X509_sign(x, pkey, EVP_PKEY_id(pkey) == EVP_PKEY_EC
+                                  ? EVP_sha256() : EVP_sha512()) <= 0) {
+        X509_free(x);
+        return NULL;
+    }
+    return x;
+}
+
+static int add_sigalg(const char *name)
+{
+    BENCH_SIGALG *sig = &sigalgs[num_sigalgs];
+
+    if (num_sigalgs == MAX_ALGS)
+        return 0;
+    if ((sig->pkey = keygen(name)) == NULL) {
+        TEST_note("%s is not available, skipping", name);
+        return 1;
+    }
+    if (!TEST_ptr(sig->cert = self_signed(sig->pkey))) {
+        EVP_PKEY_free(sig->pkey);
+        return 0;
+    }
+    sig->name = name;
+    num_sigalgs++;
+    return 1;
+}
+
+static int add_group(const char *name)
+{
+    int nid = OBJ_sn2nid(name);
+
+    if (num_groups == MAX_ALGS)
+        return 0;
+    if (IS_OQS_OPENSSL_KEM_NID(nid)
+            && !OQS_KEM_alg_is_enabled(get_oqs_alg_name(nid))) {
+        TEST_note("%s is not available, skipping", name);
+        return 1;
+    }
+    groups[num_groups++] = name;
+    return 1;
+}
+
+int setup_tests(void)
+{
+    const char *arg;
+    char *name;
+    int nid, *sig_nids;
+    size_t i;
+
+    if ((arg = test_get_option_argument("-n=")) != NULL
+            && (handshakes = atoi(arg)) <= 0) {
+        TEST_error("bad handshake count %s", arg);
+        return 0;
+    }
+
+    if ((arg = test_get_option_argument("-groups=")) != NULL) {
+        if (!TEST_ptr(group_list = OPENSSL_strdup(arg)))
+            return 0;
+        for (name = strtok(group_list, ":"); name != NULL;
+             name = strtok(NULL, ":"))
+            if (!add_group(name))
+                return 0;
+    } else {
+        add_group("X25519");
+        for (nid = NID_oqs_kem_default; IS_OQS_OPENSSL_KEM_NID(nid); nid++)
+            if (nid != NID_oqs_kem_default && nid != NID_p256_oqs_kem_default
+                    && !add_group(OBJ_nid2sn(nid)))
+                return 0;
+    }
+
+    if ((arg = test_get_option_argument("-sigalgs=")) != NULL) {
+        if (!TEST_ptr(sigalg_list = OPENSSL_strdup(arg)))
+            return 0;
+        for (name = strtok(sigalg_list, ":"); name != NULL;
+             name = strtok(NULL, ":"))
+            if (!add_sigalg(name))
+                return 0;
+    } else {
+        if (!add_sigalg("ecdsap256"))
+            return 0;
+        sig_nids = get_oqssl_sig_nids();
+        for (i = 0; i < OQS_OPENSSL_SIG_algs_length; i++)
+            if (!add_sigalg(OBJ_nid2sn(sig_nids[i])))
+                return 0;
+    }
+
+    if (num_groups == 0 || num_sigalgs == 0) {
+        TEST_note("No group or signature algorithm to benchmark");
+        return 1;
+    }
+    test_printf_stdout("%-28s %-32s %9s %10s %10s %9s %3s  %s\n", "group",
+                       "sigalg", "hs/s", "client us", "server us",
+                       "records", "rtt", "flight bytes");
+    ADD_ALL_TESTS(bench_handshake, num_groups * num_sigalgs);
+    return 1;
+}
+
+void cleanup_tests(void)
+{
+    size_t i;
+
+    for (i = 0; i < num_sigalgs; i++) {
+        EVP_PKEY_free(sigalgs[i].pkey);
+        X509_free(sigalgs[i].cert);
+    }
+    OPENSSL_free(group_list);
+    OPENSSL_free(sigalg_list);
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/* Internal tests for the in-place OQS key_share encoding */
+
+#include <string.h>
+
+#include <openssl/buffer.h>
+#include <openssl/crypto.h>
+#include "internal/nelem.h"
+#include "../ssl/packet_local.h"
+#include "../ssl/statem/ext_oqs_extra.h"
+#include "testutil.h"
+
+#define GROUP_ID 0x2F00
+
+/* Sizes of the classical and PQC messages, including Frodo/HQC sized ones */
+static const struct {
+    size_t classical_len;
+    size_t pqc_len;
+} msg_sizes[] = {
+    { 65, 800 },
+    { 97, 1184 },
+    { 133, 15632 },
+    { 65, 21520 },
+    { 1, 1 },
+};
+
+enum { SHARE_CLASSICAL, SHARE_PQC, SHARE_HYBRID };
+
+static unsigned char *classical_msg, *pqc_msg;
+
+/*
+ * Reference encoding of a KeyShareEntry: group id || key_exchange length ||
+ * key_exchange, where a hybrid key_exchange is
+ * msg1_len || msg1 || msg2_len || msg2.
+ */
+static size_t reference_key_share(unsigned char *out, int type,
+                                  size_t classical_len, size_t pqc_len)
+{
+    size_t len = 0, kexlen;
+
+    kexlen = type == SHARE_HYBRID ? 4 + classical_len + pqc_len
+             : type == SHARE_PQC ? pqc_len : classical_len;
+    out[len++] = GROUP_ID >> 8;
+    out[len++] = GROUP_ID & 0xff;
+    out[len++] = (unsigned char)(kexlen >> 8);
+    out[len++] = (unsigned char)kexlen;
+    if (type != SHARE_PQC) {
+        if (type == SHARE_HYBRID) {
+            out[len++] = (unsigned char)(classical_len >> 8);
+            out[len++] = (unsigned char)classical_len;
+        }
+        memcpy(out + len, classical_msg, classical_len);
+        len += classical_len;
+    }
+    if (type != SHARE_CLASSICAL) {
+        if (type == SHARE_HYBRID) {
+            out[len++] = (unsigned char)(pqc_len >> 8);
+            out[len++] = (unsigned char)pqc_len;
+        }
+        memcpy(out + len, pqc_msg, pqc_len);
+        len += pqc_len;
+    }
+    return len;
+}
+
+static int test_key_share(int idx)
+{
+    int type = idx % 3;
+    size_t classical_len = msg_sizes[idx / 3].classical_len;
+    size_t pqc_len = msg_sizes[idx / 3].pqc_len;
+    unsigned char *expected = NULL, *pqc = NULL;
+    size_t expected_len, written;
+    BUF_MEM *buf = NULL;
+    WPACKET pkt;
+    PACKET rpkt, key_share, classical_pt, pqc_pt;
+    unsigned int group_id = 0;
+    int ret = 0;
+
+    PACKET_null_init(&rpkt);
+    PACKET_null_init(&key_share);
+
+    if (!TEST_ptr(expected = OPENSSL_malloc(8 + classical_len + pqc_len))
+            || !TEST_ptr(buf = BUF_MEM_new())
+            || !TEST_true(WPACKET_init(&pkt, buf)))
+        goto err;
+    expected_len = reference_key_share(expected, type, classical_len, pqc_len);
+
+    if (!TEST_true(WPACKET_put_bytes_u16(&pkt, GROUP_ID))
+            || !TEST_true(OQS_put_key_share(&pkt,
+                                            type != SHARE_PQC ? classical_msg
+                                                              : NULL,
+                                            classical_len,
+                                            type != SHARE_CLASSICAL ? &pqc
+                                                                    : NULL,
+                                            pqc_len))) {
+        WPACKET_cleanup(&pkt);
+        goto err;
+    }
+    /* The PQC message is produced in place, as a KEM would */
+    if (pqc != NULL)
+        memcpy(pqc, pqc_msg, pqc_len);
+    if (!TEST_true(WPACKET_get_total_written(&pkt, &written))
+            || !TEST_true(WPACKET_finish(&pkt))
+            || !TEST_mem_eq(buf->data, written, expected, expected_len))
+        goto err;
+
+    if (!TEST_true(PACKET_buf_init(&rpkt, (unsigned char *)buf->data, written))
+            || !TEST_true(PACKET_get_net_2(&rpkt, &group_id))
+            || !TEST_uint_eq(group_id, GROUP_ID)
+            || !TEST_true(PACKET_get_length_prefixed_2(&rpkt, &key_share))
+            || !TEST_size_t_eq(PACKET_remaining(&rpkt), 0)
+            || !TEST_true(OQS_parse_key_share(&key_share, type == SHARE_PQC,
+                                              type == SHARE_HYBRID,
+                                              &classical_pt, &pqc_pt)))
+        goto err;
+    /* Both halves must be views into the received buffer */
+    if (type != SHARE_PQC
+            && (!TEST_mem_eq(PACKET_data(&classical_pt),
+                             PACKET_remaining(&classical_pt),
+                             classical_msg, classical_len)
+                || !TEST_ptr_eq(PACKET_data(&classical_pt),
+                                (unsigned char *)buf->data
+                                + (type == SHARE_HYBRID ? 6 : 4))))
+        goto err;
+    if (type != SHARE_CLASSICAL
+            && (!TEST_mem_eq(PACKET_data(&pqc_pt), PACKET_remaining(&pqc_pt),
+                             pqc_msg, pqc_len)
+                || !TEST_ptr_eq(PACKET_data(&pqc_pt),
+                                (unsigned char *)buf->data + written
+                                - pqc_len)))
+        goto err;
+
+    ret = 1;
+ err:
+    BUF_MEM_free(buf);
+    OPENSSL_free(expected);
+    return ret;
+}
+
+static int test_parse_bad_hybrid_key_share(void)
+{
+    /* classical_len || classical || pqc_len || pqc, with length errors */
+    static const unsigned char truncated[] = { 0x00, 0x01, 0xaa, 0x00, 0x02,
+                                               0xbb };
+    static const unsigned char trailing[] = { 0x00, 0x01, 0xaa, 0x00, 0x01,
+                                              0xbb, 0xcc };
+    static const unsigned char short_prefix[] = { 0x00, 0x01, 0xaa, 0x00 };
+    PACKET key_share, classical_pt, pqc_pt;
+
+    return TEST_true(PACKET_buf_init(&key_share, truncated, sizeof(truncated)))
+        && TEST_false(OQS_parse_key_share(&key_share, 0, 1,
+                                          &classical_pt, &pqc_pt))
+        && TEST_true(PACKET_buf_init(&key_share, trailing, sizeof(trailing)))
+        && TEST_false(OQS_parse_key_share(&key_share, 0, 1,
+                                          &classical_pt, &pqc_pt))
+        && TEST_true(PACKET_buf_init(&key_share, short_prefix,
+                                     sizeof(short_prefix)))
+        && TEST_false(OQS_parse_key_share(&key_share, 0, 1,
+                                          &classical_pt, &pqc_pt));
+}
+
+int setup_tests(void)
+{
+    size_t i, max_len = 0;
+
+    for (i = 0; i < OSSL_NELEM(msg_sizes); i++) {
+        if (msg_sizes[i].classical_len > max_len)
+            max_len = msg_sizes[i].classical_len;
+        if (msg_sizes[i].pqc_len > max_len)
+            max_len = msg_sizes[i].pqc_len;
+    }
+    if (!TEST_ptr(classical_msg = OPENSSL_malloc(max_len))
+            || !TEST_ptr(pqc_msg = OPENSSL_malloc(max_len)))
+        return 0;
+    for (i = 0; i < max_len; i++) {
+        classical_msg[i] = (unsigned char)(i * 7 + 1);
+        pqc_msg[i] = (unsigned char)(i * 13 + 5);
+    }
+
+    ADD_ALL_TESTS(test_key_share, OSSL_NELEM(msg_sizes) * 3);
+    ADD_TEST(test_parse_bad_hybrid_key_share);
+    return 1;
+}
+
+void cleanup_tests(void)
+{
+    OPENSSL_free(classical_msg);
+    OPENSSL_free(pqc_msg);
+}
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/*
+ * Internal tests for the OQS group and algorithm lookup tables and the KEM
+ * registry, including a microbenchmark comparing the tables to the linear
+ * search they replaced.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <openssl/ssl.h>
+#include <openssl/evp.h>
+#include <oqs/oqs.h>
+#include "testutil.h"
+#include "internal/nelem.h"
+
+#ifdef __VMS
+# pragma names save
+# pragma names as_is,shortened
+#endif
+
+#include "../ssl/ssl_local.h"
+
+#ifdef __VMS
+# pragma names restore
+#endif
+
+#ifndef OPENSSL_NO_EC
+
+#define LOOKUP_ROUNDS 20000
+
+/* Every assigned OQS group id, PQ-only and hybrid */
+static uint16_t group_ids[2 * (OQS_KEM_GROUP_ID_LAST
+                               - OQS_KEM_GROUP_ID_FIRST + 1)];
+static size_t group_ids_len = 0;
+
+static int test_group_id_lookup(void)
+{
+    unsigned int id;
+    const OQS_KEM_GROUP_INFO *ginf;
+    const TLS_GROUP_INFO *tinf;
+
+    for (id = OQS_KEM_GROUP_ID_FIRST; id <= OQS_KEM_HYBRID_GROUP_ID_LAST; id++) {
+        int hybrid = IS_OQS_KEM_HYBRID_CURVEID(id);
+
+        if (!IS_OQS_KEM_CURVEID(id) && !hybrid) {
+            if (!TEST_ptr_null(oqs_kem_group_id_lookup(id)))
+                return 0;
+            continue;
+        }
+        if ((ginf = oqs_kem_group_id_lookup(id)) == NULL)
+            continue;
+
+        tinf = tls1_group_id_lookup(id);
+        if (!TEST_ptr(tinf)
+                || !TEST_int_eq(hybrid ? ginf->hybrid_group_id
+                                       : ginf->group_id, id)
+                || !TEST_int_eq(tinf->nid, hybrid ? ginf->hybrid.nid
+                                                  : ginf->pq.nid)
+                || !TEST_ptr_eq(oqs_kem_group_nid_lookup(tinf->nid), ginf)
+                || !TEST_int_eq(oqs_kem_group_nid(id), ginf->pq.nid)
+                || !TEST_int_eq(ginf->pq.secbits, ginf->hybrid.secbits)
+                || !TEST_ptr(get_oqs_alg_name(ginf->pq.nid))
+                || !TEST_str_eq(get_oqs_alg_name(ginf->pq.nid),
+                                get_oqs_alg_name(ginf->hybrid.nid)))
+            return 0;
+
+        if (hybrid) {
+            if (!TEST_int_eq(oqs_kem_classical_group_id(id),
+                             ginf->classical_group_id)
+                    || !TEST_int_ge(ginf->classical_group_id,
+                                    TLSEXT_curve_P_256)
+                    || !TEST_int_le(ginf->classical_group_id, 25))
+                return 0;
+        } else if (!TEST_int_eq(oqs_kem_classical_group_id(id), 0)) {
+            return 0;
+        }
+    }
+    return TEST_size_t_gt(group_ids_len, 0);
+}
+
+/* The tables rely on the OQS NIDs being allocated contiguously */
+static int test_nid_lookup(void)
+{
+    int nid;
+
+    for (nid = NID_oqs_sig_default; nid <= NID_p521_hqc256_3_cca2; nid++) {
+        if (!TEST_ptr(get_oqs_alg_name(nid))) {
+            TEST_info("no OQS algorithm for NID %d (%s)", nid,
+                      OBJ_nid2sn(nid));
+            return 0;
+        }
+        if (nid >= NID_oqs_kem_default
+                && !TEST_ptr(oqs_kem_group_nid_lookup(nid)))
+            return 0;
+    }
+    return TEST_ptr_null(get_oqs_alg_name(NID_oqs_sig_default - 1))
+        && TEST_ptr_null(get_oqs_alg_name(NID_p521_hqc256_3_cca2 + 1))
+        && TEST_ptr_null(oqs_kem_group_nid_lookup(NID_X9_62_prime256v1));
+}
+
+/*
+ * Every KEM NID resolves to the one descriptor of its KEM, which the PQ-only
+ * and hybrid groups share
+ */
+static int test_kem_registry(void)
+{
+    const OQS_KEM_GROUP_INFO *ginf;
+    const OQS_KEM *kem;
+    const char *name;
+    int nid;
+
+    for (nid = NID_oqs_kem_default; nid <= NID_p521_hqc256_3_cca2; nid++) {
+        name = get_oqs_alg_name(nid);
+        kem = ssl_get_oqs_kem(nid);
+        if (!OQS_KEM_alg_is_enabled(name)) {
+            if (!TEST_ptr_null(kem))
+                return 0;
+            continue;
+        }
+        if (!TEST_ptr(kem)
+                || !TEST_str_eq(kem->method_name, name)
+                || !TEST_ptr_eq(ssl_get_oqs_kem(nid), kem)
+                || !TEST_ptr(ginf = oqs_kem_group_nid_lookup(nid))
+                || !TEST_ptr_eq(ssl_get_oqs_kem(ginf->pq.nid), kem)
+                || !TEST_ptr_eq(ssl_get_oqs_kem(ginf->hybrid.nid), kem))
+            return 0;
+    }
+    return TEST_ptr_null(ssl_get_oqs_kem(NID_X9_62_prime256v1))
+        && TEST_ptr_null(ssl_get_oqs_kem(NID_dilithium2))
+        && TEST_ptr_null(ssl_get_oqs_kem(NID_p521_hqc256_3_cca2 + 1));
+}
+
+/*
+ * The key share of a ClientHello uses the descriptor from the registry.
+ * Test 0: PQ group
+ * Test 1: hybrid group
+ */
+static int test_kem_registry_key_share(int tst)
+{
+    const char *group = tst == 0 ? "kyber512" : "p256_kyber512";
+    SSL_CTX *ctx = NULL;
+    SSL *s[2] = { NULL, NULL };
+    const OQS_KEM *kem;
+    int i, testresult = 0;
+
+    if ((kem = ssl_get_oqs_kem(OBJ_sn2nid(group))) == NULL) {
+        TEST_note("%s not enabled in liboqs, skipping", group);
+        return 1;
+    }
+    if (!TEST_ptr(ctx = SSL_CTX_new(TLS_client_method()))
+            || !TEST_true(SSL_CTX_set_min_proto_version(ctx, TLS1_3_VERSION))
+            || !TEST_true(SSL_CTX_set1_groups_list(ctx, group)))
+        goto end;
+
+    for (i = 0; i < 2; i++) {
+        /* Write the ClientHello, and stop waiting for the ServerHello */
+        if (!TEST_ptr(s[i] = SSL_new(ctx)))
+            goto end;
+        SSL_set_bio(s[i], BIO_new(BIO_s_mem()), BIO_new(BIO_s_mem()));
+        if (!TEST_int_le(SSL_connect(s[i]), 0)
+                || !TEST_int_eq(SSL_get_error(s[i], 0), SSL_ERROR_WANT_READ)
+                || !TEST_ptr_eq(s[i]->s3->tmp.oqs_kem, kem))
+            goto end;
+    }
+
+    testresult = 1;
+ end:
+    SSL_free(s[0]);
+    SSL_free(s[1]);
+    SSL_CTX_free(ctx);
+    return testresult;
+}
+
+/*
+ * Resolves a group id by linear search, like the chained ?: macros and
+ * tls1_group_id_lookup() did before the lookup tables.
+ */
+static int linear_group_id_lookup(uint16_t group_id, const int *nids)
+{
+    size_t i;
+
+    for (i = 0; i < group_ids_len; i++) {
+        if (group_ids[i] == group_id)
+            break;
+    }
+    if (i == group_ids_len)
+        return NID_undef;
+    return nids[i];
+}
+
+static double elapsed_ns(clock_t start, size_t lookups)
+{
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / lookups;
+}
+
+static int test_lookup_speed(void)
+{
+    int nids[OSSL_NELEM(group_ids)];
+    volatile int sink = 0;
+    size_t i, r, lookups = LOOKUP_ROUNDS * group_ids_len;
+    clock_t start;
+
+    if (!TEST_size_t_gt(group_ids_len, 0))
+        return 0;
+    for (i = 0; i < group_ids_len; i++)
+        nids[i] = tls1_group_id_lookup(group_ids[i])->nid;
+
+    start = clock();
+    for (r = 0; r < LOOKUP_ROUNDS; r++)
+        for (i = 0; i < group_ids_len; i++)
+            sink += linear_group_id_lookup(group_ids[i], nids);
+    TEST_info("linear search:     %.1f ns/lookup", elapsed_ns(start, lookups));
+
+    start = clock();
+    for (r = 0; r < LOOKUP_ROUNDS; r++)
+        for (i = 0; i < group_ids_len; i++)
+            sink += tls1_group_id_lookup(group_ids[i])->nid;
+    TEST_info("group id -> group: %.1f ns/lookup", elapsed_ns(start, lookups));
+
+    start = clock();
+    for (r = 0; r < LOOKUP_ROUNDS; r++)
+        for (i = 0; i < group_ids_len; i++)
+            sink += oqs_kem_group_nid_lookup(nids[i])->group_id;
+    TEST_info("nid -> group:      %.1f ns/lookup", elapsed_ns(start, lookups));
+
+    start = clock();
+    for (r = 0; r < LOOKUP_ROUNDS; r++)
+        for (i = 0; i < group_ids_len; i++)
+            sink += get_oqs_alg_name(nids[i])[0];
+    TEST_info("nid -> alg name:   %.1f ns/lookup", elapsed_ns(start, lookups));
+
+    (void)sink;
+    return 1;
+}
+
+#endif
+
+int setup_tests(void)
+{
+#ifndef OPENSSL_NO_EC
+    unsigned int id;
+
+    for (id = OQS_KEM_GROUP_ID_FIRST; id <= OQS_KEM_HYBRID_GROUP_ID_LAST; id++) {
+        if (oqs_kem_group_id_lookup(id) != NULL
+                && group_ids_len < OSSL_NELEM(group_ids))
+            group_ids[group_ids_len++] = (uint16_t)id;
+    }
+
+    ADD_TEST(test_group_id_lookup);
+    ADD_TEST(test_nid_lookup);
+    ADD_TEST(test_kem_registry);
+    ADD_ALL_TESTS(test_kem_registry_key_share, 2);
+    ADD_TEST(test_lookup_speed);
+#endif
+    return 1;
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+ *
+ * Licensed under the OpenSSL license (the "License").  You may not use
+ * this file except in compliance with the License.  You can obtain a copy
+ * in the file LICENSE in the source distribution or at
+ * https://www.openssl.org/source/license.html
+ */
+
+/* Internal tests for the DTLS priority queue */
+
+#include <string.h>
+
+#include <openssl/ssl.h>
+#include "testutil.h"
+
+#ifdef __VMS
+# pragma names save
+# pragma names as_is,shortened
+#endif
+
+#include "../ssl/ssl_local.h"
+
+#ifdef __VMS
+# pragma names restore
+#endif
+
+/* A prime, so that stepping through it by any smaller stride visits all */
+#define NUM_ITEMS   1009
+
+static void set_prio(unsigned char *prio64be, uint64_t v)
+{
+    int i;
+
+    for (i = 7; i >= 0; i--, v >>= 8)
+        prio64be[i] = (unsigned char)v;
+}
+
+static uint64_t get_prio(const unsigned char *prio64be)
+{
+    uint64_t v = 0;
+    int i;
+
+    for (i = 0; i < 8; i++)
+        v = (v << 8) | prio64be[i];
+    return v;
+}
+
+/*
+ * Insert the even priorities below 2 * NUM_ITEMS in an order given by
+ * |stride|, then check finds, ordering and popping.
+ * Test 0: ascending, as DTLS records mostly arrive
+ * Test 1: descending
+ * Test 2: scattered
+ */
+static int test_pqueue(int tst)
+{
+    static const size_t strides[] = { 1, NUM_ITEMS - 1, 389 };
+    pqueue *pq = NULL;
+    pitem *item;
+    piterator iter;
+    unsigned char prio[8];
+    uint64_t i, v, last;
+    int testresult = 0;
+
+    if (!TEST_ptr(pq = pqueue_new())
+            || !TEST_ptr_null(pqueue_peek(pq))
+            || !TEST_ptr_null(pqueue_pop(pq)))
+        goto end;
+    set_prio(prio, 0);
+    if (!TEST_ptr_null(pqueue_find(pq, prio)))
+        goto end;
+
+    for (i = 0; i < NUM_ITEMS; i++) {
+        v = 2 * ((i * strides[tst]) % NUM_ITEMS);
+        set_prio(prio, v);
+        if (!TEST_ptr(item = pitem_new(prio, NULL)))
+            goto end;
+        if (!TEST_ptr_eq(pqueue_insert(pq, item), item)) {
+            pitem_free(item);
+            goto end;
+        }
+    }
+    if (!TEST_size_t_eq(pqueue_size(pq), NUM_ITEMS))
+        goto end;
+
+    /* Duplicates are refused */
+    set_prio(prio, 2 * (NUM_ITEMS / 2));
+    if (!TEST_ptr(item = pitem_new(prio, NULL)))
+        goto end;
+    if (!TEST_ptr_null(pqueue_insert(pq, item))) {
+        pitem_free(item);
+        goto end;
+    }
+    pitem_free(item);
+
+    for (v = 0; v < 2 * NUM_ITEMS + 1; v++) {
+        set_prio(prio, v);
+        item = pqueue_find(pq, prio);
+        if (v % 2 == 0 && v < 2 * NUM_ITEMS) {
+            if (!TEST_ptr(item)
+                    || !TEST_mem_eq(item->priority, 8, prio, 8))
+                goto end;
+        } else if (!TEST_ptr_null(item)) {
+            goto end;
+        }
+    }
+
+    /* Iteration is in order */
+    iter = pqueue_iterator(pq);
+    for (i = 0; (item = pqueue_next(&iter)) != NULL; i++)
+        if (!TEST_true(get_prio(item->priority) == 2 * i))
+            goto end;
+    if (!TEST_true(i == NUM_ITEMS))
+        goto end;
+
+    /* So is popping, and the rest of the queue stays searchable */
+    for (last = 0, i = 0; (item = pqueue_pop(pq)) != NULL; i++) {
+        v = get_prio(item->priority);
+        pitem_free(item);
+        if (!TEST_true(v == 2 * i))
+            goto end;
+        if (v + 4 < 2 * NUM_ITEMS) {
+            set_prio(prio, v + 4);
+            if (!TEST_ptr(pqueue_find(pq, prio)))
+                goto end;
+        }
+        last = v;
+    }
+    if (!TEST_true(last == 2 * (NUM_ITEMS - 1))
+            || !TEST_size_t_eq(pqueue_size(pq), 0))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    if (pq != NULL) {
+        while ((item = pqueue_pop(pq)) != NULL)
+            pitem_free(item);
+        pqueue_free(pq);
+    }
+    return testresult;
+}
+
+int setup_tests(void)
+{
+    ADD_ALL_TESTS(test_pqueue, 3);
+    return 1;
+}
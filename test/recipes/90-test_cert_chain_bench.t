@@ -0,0 +1,23 @@
+#! /usr/bin/env perl
+# Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the OpenSSL license (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+
+use OpenSSL::Test::Utils;
+use OpenSSL::Test qw/:DEFAULT srctop_file/;
+
+setup("test_cert_chain_bench");
+
+plan skip_all => "No TLS protocols are supported by this OpenSSL build"
+    if alldisabled(available_protocols("tls"));
+
+plan tests => 1;
+
+# Only a smoke run; use "make bench-cert-chain" for real numbers.
+ok(run(test(["cert_chain_bench",
+             srctop_file("test", "certs", "server-ecdsa-cert.pem"),
+             srctop_file("test", "certs", "server-ecdsa-key.pem"), "-n=2"])),
+   "running cert_chain_bench");
@@ -0,0 +1,22 @@
+#! /usr/bin/env perl
+# Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the OpenSSL license (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+
+use OpenSSL::Test::Utils;
+use OpenSSL::Test qw/:DEFAULT srctop_file/;
+
+setup("test_dtls_loss_bench");
+
+plan skip_all => "No DTLS protocols are supported by this OpenSSL build"
+    if alldisabled(available_protocols("dtls"));
+
+plan tests => 1;
+
+# Only a smoke run; use "make bench-dtls-loss" for real numbers.
+ok(run(test(["dtls_loss_bench", srctop_file("apps", "server.pem"),
+             srctop_file("apps", "server.pem"), "-loss=0:10", "-n=2"])),
+   "running dtls_loss_bench");
@@ -0,0 +1,26 @@
+#! /usr/bin/env perl
+# Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the OpenSSL license (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+
+use OpenSSL::Test::Utils;
+use OpenSSL::Test qw/:DEFAULT srctop_file/;
+
+setup("test_ktls_bench");
+
+plan skip_all => "kTLS is disabled in this OpenSSL build"
+    if disabled("ktls") || disabled("sock");
+
+plan skip_all => "No TLS protocols are supported by this OpenSSL build"
+    if alldisabled(available_protocols("tls"));
+
+plan tests => 1;
+
+# Only a smoke run; use "make bench-ktls" for real numbers.
+ok(run(test(["ktls_bench",
+             srctop_file("test", "certs", "servercert.pem"),
+             srctop_file("test", "certs", "serverkey.pem"), "-mb=1"])),
+   "running ktls_bench");
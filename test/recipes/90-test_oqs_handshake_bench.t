@@ -0,0 +1,22 @@
+#! /usr/bin/env perl
+# Copyright 2020 The OpenSSL Project Authors. All Rights Reserved.
+#
+# Licensed under the OpenSSL license (the "License").  You may not use
+# this file except in compliance with the License.  You can obtain a copy
+# in the file LICENSE in the source distribution or at
+# https://www.openssl.org/source/license.html
+
+use OpenSSL::Test::Utils;
+use OpenSSL::Test qw/:DEFAULT/;
+
+setup("test_oqs_handshake_bench");
+
+plan skip_all => "TLSv1.3 is disabled in this OpenSSL build"
+    if disabled("tls1_3") || disabled("ec");
+
+plan tests => 1;
+
+# Only a smoke run; use "make bench-handshake" for real numbers.
+ok(run(test(["oqs_handshake_bench", "-groups=X25519:p256_kyber512",
+             "-sigalgs=ecdsap256:dilithium2", "-n=2"])),
+   "running oqs_handshake_bench");
@@ -7,6 +7,7 @@
  * https://www.openssl.org/source/license.html
  */
 
+#include <string.h>
 #include <openssl/crypto.h>
 
 #include "testutil.h"
@@ -175,9 +176,108 @@ err:
 #endif
 }
 
+static int test_sec_mem_large(void)
+{
+#ifdef OPENSSL_SECURE_MEMORY
+    int testresult = 0;
+    char *p = NULL, *q = NULL;
+    size_t used, high_water, free_bytes, largest_free;
+
+    if (!TEST_true(CRYPTO_secure_malloc_init_ex(4096, 32, 256 * 1024, 0)))
+        goto end;
+    /* Too large for the 4096 byte arena, rounded up to 64 bytes */
+    p = OPENSSL_secure_malloc(40001);
+    q = OPENSSL_secure_malloc(100000);
+    if (!TEST_ptr(p)
+        || !TEST_ptr(q)
+        || !TEST_true(CRYPTO_secure_allocated(p))
+        || !TEST_true(CRYPTO_secure_allocated(q))
+        || !TEST_size_t_eq(OPENSSL_secure_actual_size(p), 40064)
+        || !TEST_size_t_eq(CRYPTO_secure_used(), 40064 + 100032))
+        goto end;
+    OPENSSL_secure_free(p);
+    p = NULL;
+    if (!TEST_true(CRYPTO_secure_malloc_stats(&used, &high_water, &free_bytes,
+                                              &largest_free, NULL, NULL))
+        || !TEST_size_t_eq(used, 100032)
+        || !TEST_size_t_eq(high_water, 40064 + 100032)
+        || !TEST_size_t_eq(free_bytes, 4096 + 256 * 1024 - 100032)
+        || !TEST_size_t_eq(largest_free, 256 * 1024 - 40064 - 100032))
+        goto end;
+    OPENSSL_secure_free(q);
+    q = NULL;
+    /* The freed extents have been merged again */
+    if (!TEST_true(CRYPTO_secure_malloc_stats(&used, NULL, NULL,
+                                              &largest_free, NULL, NULL))
+        || !TEST_size_t_eq(used, 0)
+        || !TEST_size_t_eq(largest_free, 256 * 1024))
+        goto end;
+
+    testresult = 1;
+ end:
+    OPENSSL_secure_free(p);
+    OPENSSL_secure_free(q);
+    TEST_true(CRYPTO_secure_malloc_done());
+    return testresult;
+#else
+    return 1;
+#endif
+}
+
+static int test_sec_mem_thread_cache(void)
+{
+#ifdef OPENSSL_SECURE_MEMORY
+    int testresult = 0;
+    unsigned char *p = NULL, *q = NULL;
+    size_t i, used;
+    uint64_t hits = 0;
+
+    if (!TEST_true(CRYPTO_secure_malloc_init_ex(4096, 32, 0,
+                                                CRYPTO_SECURE_MALLOC_THREAD_CACHE)))
+        goto end;
+    p = OPENSSL_secure_malloc(20);
+    if (!TEST_ptr(p)
+        || !TEST_size_t_eq(CRYPTO_secure_used(), 32))
+        goto end;
+    memset(p, 0xaa, 20);
+    OPENSSL_secure_free(p);
+    /* The chunk is cached, but no longer counts as used */
+    if (!TEST_size_t_eq(CRYPTO_secure_used(), 0))
+        goto end;
+    q = OPENSSL_secure_zalloc(20);
+    if (!TEST_ptr_eq(q, p)) {
+        p = NULL;
+        goto end;
+    }
+    p = NULL;
+    for (i = 0; i < 32; i++)
+        if (!TEST_uchar_eq(q[i], 0))
+            goto end;
+    if (!TEST_true(CRYPTO_secure_malloc_stats(&used, NULL, NULL, NULL,
+                                              &hits, NULL))
+        || !TEST_size_t_eq(used, 32)
+        || !TEST_true(hits == 1))
+        goto end;
+    OPENSSL_secure_free(q);
+    q = NULL;
+
+    testresult = 1;
+ end:
+    OPENSSL_secure_free(p);
+    OPENSSL_secure_free(q);
+    /* Cached chunks are returned to the heap so that it can be released */
+    TEST_true(CRYPTO_secure_malloc_done());
+    return testresult;
+#else
+    return 1;
+#endif
+}
+
 int setup_tests(void)
 {
     ADD_TEST(test_sec_mem);
     ADD_TEST(test_sec_mem_clear);
+    ADD_TEST(test_sec_mem_large);
+    ADD_TEST(test_sec_mem_thread_cache);
     return 1;
 }
@@ -17,12 +17,19 @@
 #include <openssl/srp.h>
 #include <openssl/txt_db.h>
 #include <openssl/aes.h>
+#include <openssl/async.h>
 
 #include "ssltestlib.h"
 #include "testutil.h"
 #include "testutil/output.h"
 #include "internal/nelem.h"
 #include "../ssl/ssl_local.h"
+#include "internal/ktls.h"
+#include "internal/sockets.h"
+
+#ifdef OPENSSL_SYS_UNIX
+# include <unistd.h>
+#endif
 
 #ifndef OPENSSL_NO_TLS1_3
 
@@ -6658,104 +6665,1760 @@ static int test_ssl_dup(void)
 }
 #endif
 
-int setup_tests(void)
+#ifndef OPENSSL_NO_TLS1_3
+static int check_oqs_kem_pool_stats(SSL_CTX *ctx, int nid, size_t available,
+                                    unsigned long hits, unsigned long misses)
 {
-    if (!TEST_ptr(certsdir = test_get_argument(0))
-            || !TEST_ptr(srpvfile = test_get_argument(1))
-            || !TEST_ptr(tmpfilename = test_get_argument(2)))
-        return 0;
+    size_t cur_available = 0;
+    uint64_t cur_hits = 0, cur_misses = 0, refill_usec = 0;
+
+    return TEST_true(SSL_CTX_get_oqs_kem_pool_stats(ctx, nid, &cur_available,
+                                                    &cur_hits, &cur_misses,
+                                                    &refill_usec))
+        && TEST_size_t_eq(cur_available, available)
+        && TEST_ulong_eq((unsigned long)cur_hits, hits)
+        && TEST_ulong_eq((unsigned long)cur_misses, misses);
+}
 
-    if (getenv("OPENSSL_TEST_GETCOUNTS") != NULL) {
-#ifdef OPENSSL_NO_CRYPTO_MDEBUG
-        TEST_error("not supported in this build");
-        return 0;
-#else
-        int i, mcount, rcount, fcount;
+/*
+ * Test the SSL_CTX pool of pre-generated OQS KEM keypairs.
+ * Test 0: PQ group
+ * Test 1: hybrid group
+ * Test 2: hybrid group, with an HRR that keeps the key share
+ */
+static int test_oqs_kem_pool(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    const char *group = (tst == 0) ? "kyber512" : "p256_kyber512";
+    int nid = OBJ_sn2nid(group);
+    int testresult = 0, i;
 
-        for (i = 0; i < 4; i++)
-            test_export_key_mat(i);
-        CRYPTO_get_alloc_counts(&mcount, &rcount, &fcount);
-        test_printf_stdout("malloc %d realloc %d free %d\n",
-                mcount, rcount, fcount);
+    if (!OQS_KEM_alg_is_enabled(get_oqs_alg_name(NID_kyber512))) {
+        TEST_note("kyber512 not enabled in liboqs, skipping");
         return 1;
-#endif
     }
 
-    cert = test_mk_file_path(certsdir, "servercert.pem");
-    if (cert == NULL)
-        return 0;
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(),
+                                       TLS1_3_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set1_groups_list(sctx, group))
+            || !TEST_true(SSL_CTX_set1_groups_list(cctx, group))
+            || !TEST_false(SSL_CTX_set_oqs_kem_pool_depth(cctx,
+                                                          NID_X9_62_prime256v1,
+                                                          2))
+            || !TEST_false(SSL_CTX_get_oqs_kem_pool_stats(cctx, nid, NULL,
+                                                          NULL, NULL, NULL))
+            || !TEST_true(SSL_CTX_set_oqs_kem_pool_depth(cctx, nid, 2))
+            || !TEST_int_eq(SSL_CTX_fill_oqs_kem_pool(cctx), 2)
+            || !TEST_int_eq(SSL_CTX_fill_oqs_kem_pool(cctx), 0)
+            || !check_oqs_kem_pool_stats(cctx, nid, 2, 0, 0))
+        goto end;
 
-    privkey = test_mk_file_path(certsdir, "serverkey.pem");
-    if (privkey == NULL) {
-        OPENSSL_free(cert);
-        return 0;
+    if (tst == 2) {
+        /*
+         * The second ClientHello reuses the classical key, so only the first
+         * takes a keypair from the pool
+         */
+        SSL_CTX_set_stateless_cookie_generate_cb(sctx,
+                                                 generate_stateless_cookie_callback);
+        SSL_CTX_set_stateless_cookie_verify_cb(sctx,
+                                               verify_stateless_cookie_callback);
+        SSL_CTX_clear_options(cctx, SSL_OP_ENABLE_MIDDLEBOX_COMPAT);
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+                || !TEST_false(create_ssl_connection(serverssl, clientssl,
+                                                     SSL_ERROR_WANT_READ))
+                || !TEST_int_eq(SSL_stateless(serverssl), 0)
+                || !TEST_false(create_ssl_connection(serverssl, clientssl,
+                                                     SSL_ERROR_WANT_READ))
+                || !TEST_int_eq(SSL_stateless(serverssl), 1)
+                || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                    SSL_ERROR_NONE))
+                || !TEST_int_eq(SSL_get_shared_group(serverssl, 0), nid)
+                || !check_oqs_kem_pool_stats(cctx, nid, 1, 1, 0))
+            goto end;
+        testresult = 1;
+        goto end;
     }
 
-    ADD_TEST(test_large_message_tls);
-    ADD_TEST(test_large_message_tls_read_ahead);
-#ifndef OPENSSL_NO_DTLS
-    ADD_TEST(test_large_message_dtls);
-#endif
-#ifndef OPENSSL_NO_OCSP
-    ADD_TEST(test_tlsext_status_type);
-#endif
-    ADD_TEST(test_session_with_only_int_cache);
-    ADD_TEST(test_session_with_only_ext_cache);
-    ADD_TEST(test_session_with_both_cache);
-#ifndef OPENSSL_NO_TLS1_3
-    ADD_ALL_TESTS(test_stateful_tickets, 3);
-    ADD_ALL_TESTS(test_stateless_tickets, 3);
-    ADD_TEST(test_psk_tickets);
-#endif
-    ADD_ALL_TESTS(test_ssl_set_bio, TOTAL_SSL_SET_BIO_TESTS);
-    ADD_TEST(test_ssl_bio_pop_next_bio);
-    ADD_TEST(test_ssl_bio_pop_ssl_bio);
-    ADD_TEST(test_ssl_bio_change_rbio);
-    ADD_TEST(test_ssl_bio_change_wbio);
-#if !defined(OPENSSL_NO_TLS1_2) || defined(OPENSSL_NO_TLS1_3)
-    ADD_ALL_TESTS(test_set_sigalgs, OSSL_NELEM(testsigalgs) * 2);
-    ADD_TEST(test_keylog);
+    /* The first two handshakes are served from the pool, the third isn't */
+    for (i = 0; i < 3; i++) {
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+                || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                    SSL_ERROR_NONE))
+                || !TEST_int_eq(SSL_get_shared_group(serverssl, 0), nid)
+                || !check_oqs_kem_pool_stats(cctx, nid, i < 2 ? 1 - i : 0,
+                                             i < 2 ? i + 1 : 2, i < 2 ? 0 : 1))
+            goto end;
+
+        SSL_free(serverssl);
+        SSL_free(clientssl);
+        serverssl = clientssl = NULL;
+    }
+
+    /* Lowering the depth drops the surplus keypairs */
+    if (!TEST_int_eq(SSL_CTX_fill_oqs_kem_pool(cctx), 2)
+            || !TEST_true(SSL_CTX_set_oqs_kem_pool_depth(cctx, nid, 1))
+            || !check_oqs_kem_pool_stats(cctx, nid, 1, 2, 1)
+            || !TEST_true(SSL_CTX_set_oqs_kem_pool_depth(cctx, nid, 0))
+            || !check_oqs_kem_pool_stats(cctx, nid, 0, 2, 1)
+            || !TEST_int_eq(SSL_CTX_fill_oqs_kem_pool(cctx), 0))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+static int oqs_offloaded = 0;
+
+/* An offload method that pauses the job once and then runs the operation */
+static int oqs_pause_offload(int (*fn)(void *), void *arg)
+{
+    oqs_offloaded++;
+    if (!ASYNC_pause_job())
+        return -1;
+    return fn(arg);
+}
+
+/* An offload method that never takes the operation */
+static int oqs_decline_offload(int (*fn)(void *), void *arg)
+{
+    return -1;
+}
+
+/*
+ * Test that the OQS operations of a handshake in SSL_MODE_ASYNC are handed to
+ * the offload method, which can pause the handshake.
+ * Test 0: PQ group
+ * Test 1: hybrid group
+ */
+static int test_oqs_async_offload(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    int testresult = 0, paused = 0, retc = 0, rets = 0, i;
+    const char *group = tst == 0 ? "kyber512" : "p256_kyber512";
+
+    if (!OQS_KEM_alg_is_enabled(get_oqs_alg_name(NID_kyber512))) {
+        TEST_note("kyber512 not enabled in liboqs, skipping");
+        return 1;
+    }
+
+    oqs_offloaded = 0;
+    if (!TEST_true(EVP_set_oqs_offload(oqs_pause_offload))
+            /* It isn't replaced by another one */
+            || !TEST_false(EVP_set_oqs_offload(oqs_decline_offload))
+            || !TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(),
+                                       TLS1_3_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set1_groups_list(sctx, group))
+            || !TEST_true(SSL_CTX_set1_groups_list(cctx, group)))
+        goto end;
+    SSL_CTX_set_mode(sctx, SSL_MODE_ASYNC);
+    SSL_CTX_set_mode(cctx, SSL_MODE_ASYNC);
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL)))
+        goto end;
+    SSL_set_connect_state(clientssl);
+    SSL_set_accept_state(serverssl);
+
+    for (i = 0; i < 100 && (retc <= 0 || rets <= 0); i++) {
+        if (retc <= 0 && (retc = SSL_do_handshake(clientssl)) <= 0) {
+            int err = SSL_get_error(clientssl, retc);
+
+            if (err == SSL_ERROR_WANT_ASYNC)
+                paused++;
+            else if (!TEST_int_eq(err, SSL_ERROR_WANT_READ))
+                goto end;
+        }
+        if (rets <= 0 && (rets = SSL_do_handshake(serverssl)) <= 0) {
+            int err = SSL_get_error(serverssl, rets);
+
+            if (err == SSL_ERROR_WANT_ASYNC)
+                paused++;
+            else if (!TEST_int_eq(err, SSL_ERROR_WANT_READ))
+                goto end;
+        }
+    }
+
+    /* A key generation and a decapsulation by the client, and an encapsulation */
+    if (!TEST_int_eq(retc, 1)
+            || !TEST_int_eq(rets, 1)
+            || !TEST_int_eq(oqs_offloaded, 3)
+            || !TEST_int_eq(paused, 3)
+            || !TEST_int_eq(SSL_get_shared_group(serverssl, 0),
+                            tst == 0 ? NID_kyber512 : NID_p256_kyber512))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    EVP_clear_oqs_offload(oqs_pause_offload);
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+static int check_key_share_cache_stats(SSL_CTX *ctx, unsigned long predicted,
+                                       unsigned long hrr_avoided,
+                                       unsigned long hrr)
+{
+    uint64_t cur_predicted = 0, cur_hrr_avoided = 0, cur_hrr = 0;
+
+    return TEST_true(SSL_CTX_get_key_share_cache_stats(ctx, &cur_predicted,
+                                                       &cur_hrr_avoided,
+                                                       &cur_hrr))
+        && TEST_ulong_eq((unsigned long)cur_predicted, predicted)
+        && TEST_ulong_eq((unsigned long)cur_hrr_avoided, hrr_avoided)
+        && TEST_ulong_eq((unsigned long)cur_hrr, hrr);
+}
+
+/*
+ * Test that the client remembers which group each server selected.
+ * Test 0: classical group
+ * Test 1: PQ group
+ * Test 2: hybrid group
+ */
+static int test_key_share_cache(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    static const char *sgroups[] = { "P-256", "kyber512", "p256_kyber512" };
+    static const char *cgroups[] = {
+        "X25519:P-256", "X25519:kyber512", "X25519:p256_kyber512"
+    };
+    /* Server name, whether the handshake needs a HelloRetryRequest */
+    static const struct {
+        const char *host;
+        int hrr;
+    } conns[] = {
+        { "a.example", 1 },
+        { "a.example", 0 },
+        /* No SNI, no prediction */
+        { NULL, 1 },
+        /* Evicts a.example */
+        { "b.example", 1 },
+        { "a.example", 1 },
+        { "a.example", 0 }
+    };
+    unsigned long predicted = 0, hrr = 0;
+    size_t i;
+    int testresult = 0;
+
+    if (tst > 0
+            && !OQS_KEM_alg_is_enabled(get_oqs_alg_name(NID_kyber512))) {
+        TEST_note("kyber512 not enabled in liboqs, skipping");
+        return 1;
+    }
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(),
+                                       TLS1_3_VERSION, 0,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set1_groups_list(sctx, sgroups[tst]))
+            || !TEST_true(SSL_CTX_set1_groups_list(cctx, cgroups[tst]))
+            || !TEST_false(SSL_CTX_get_key_share_cache_stats(cctx, NULL, NULL,
+                                                             NULL))
+            || !TEST_true(SSL_CTX_set_key_share_cache_size(cctx, 1))
+            || !TEST_size_t_eq(SSL_CTX_get_key_share_cache_size(cctx), 1))
+        goto end;
+
+    for (i = 0; i < OSSL_NELEM(conns); i++) {
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+                || (conns[i].host != NULL
+                    && !TEST_true(SSL_set_tlsext_host_name(clientssl,
+                                                           conns[i].host)))
+                || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                    SSL_ERROR_NONE))
+                || !TEST_int_eq(clientssl->hello_retry_request
+                                != SSL_HRR_NONE, conns[i].hrr))
+            goto end;
+        if (conns[i].hrr) {
+            if (conns[i].host != NULL)
+                hrr++;
+        } else {
+            predicted++;
+        }
+        if (!check_key_share_cache_stats(cctx, predicted, predicted, hrr))
+            goto end;
+
+        SSL_free(serverssl);
+        SSL_free(clientssl);
+        serverssl = clientssl = NULL;
+    }
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
 #endif
-#ifndef OPENSSL_NO_TLS1_3
-    ADD_TEST(test_keylog_no_master_key);
+
+/*
+ * Test that SSL_MODE_COALESCE_FLIGHTS sends the server's handshake messages
+ * in fewer records, and once the size of its first flight is known, that
+ * flight in a single write.
+ * Test 0: TLSv1.3
+ * Test 1: TLSv1.2
+ */
+static int test_coalesce_flights(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    BIO *certbio = NULL, *fbio;
+    X509 *chaincert = NULL;
+    int version = tst == 0 ? TLS1_3_VERSION : TLS1_2_VERSION;
+    size_t writes[3], records[3];
+    int i, testresult = 0;
+
+#ifdef OPENSSL_NO_TLS1_3
+    if (tst == 0)
+        return 1;
 #endif
-#ifndef OPENSSL_NO_TLS1_2
-    ADD_TEST(test_client_hello_cb);
-    ADD_TEST(test_ccs_change_cipher);
+#ifdef OPENSSL_NO_TLS1_2
+    if (tst == 1)
+        return 1;
 #endif
-#ifndef OPENSSL_NO_TLS1_3
-    ADD_ALL_TESTS(test_early_data_read_write, 3);
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), version, version,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_ptr(certbio = BIO_new_file(cert, "r"))
+            || !TEST_ptr(chaincert = PEM_read_bio_X509(certbio, NULL, NULL,
+                                                       NULL)))
+        goto end;
+
+    /* A chain long enough for the first flight not to fit in 4096 bytes */
+    for (i = 0; i < 4; i++) {
+        if (!TEST_true(X509_up_ref(chaincert)))
+            goto end;
+        if (!TEST_true(SSL_CTX_add_extra_chain_cert(sctx, chaincert))) {
+            X509_free(chaincert);
+            goto end;
+        }
+    }
+
+    /* Once without coalescing, then twice with it */
+    for (i = 0; i < 3; i++) {
+        if (i == 1)
+            SSL_CTX_set_mode(sctx, SSL_MODE_COALESCE_FLIGHTS);
+        if (!TEST_ptr(fbio = BIO_new(bio_f_tls_count_filter()))
+                || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl,
+                                                 &clientssl, fbio, NULL))
+                || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                    SSL_ERROR_NONE)))
+            goto end;
+        tls_count_filter_get(SSL_get_wbio(serverssl), &writes[i], &records[i]);
+
+        SSL_free(serverssl);
+        SSL_free(clientssl);
+        serverssl = clientssl = NULL;
+    }
+
     /*
-     * We don't do replay tests for external PSK. Replay protection isn't used
-     * in that scenario.
+     * EncryptedExtensions to Finished in TLSv1.3, or ServerHello to
+     * ServerHelloDone in TLSv1.2, go in one record instead of four. The first
+     * handshake with coalescing learns how large a write buffer the flight
+     * needs, so the next sends it in one write. The server's other flights
+     * were a single write each already.
      */
-    ADD_ALL_TESTS(test_early_data_replay, 2);
-    ADD_ALL_TESTS(test_early_data_skip, 3);
-    ADD_ALL_TESTS(test_early_data_skip_hrr, 3);
-    ADD_ALL_TESTS(test_early_data_skip_hrr_fail, 3);
-    ADD_ALL_TESTS(test_early_data_skip_abort, 3);
-    ADD_ALL_TESTS(test_early_data_not_sent, 3);
-    ADD_ALL_TESTS(test_early_data_psk, 8);
-    ADD_ALL_TESTS(test_early_data_psk_with_all_ciphers, 5);
-    ADD_ALL_TESTS(test_early_data_not_expected, 3);
-# ifndef OPENSSL_NO_TLS1_2
-    ADD_ALL_TESTS(test_early_data_tls1_2, 3);
-# endif
-#endif
-#ifndef OPENSSL_NO_TLS1_3
-    ADD_ALL_TESTS(test_set_ciphersuite, 10);
-    ADD_TEST(test_ciphersuite_change);
-    ADD_ALL_TESTS(test_tls13_ciphersuite, 4);
-#ifdef OPENSSL_NO_PSK
-    ADD_ALL_TESTS(test_tls13_psk, 1);
-#else
-    ADD_ALL_TESTS(test_tls13_psk, 4);
-#endif  /* OPENSSL_NO_PSK */
-    ADD_ALL_TESTS(test_custom_exts, 5);
-    ADD_TEST(test_stateless);
-    ADD_TEST(test_pha_key_update);
-#else
-    ADD_ALL_TESTS(test_custom_exts, 3);
+    if (!TEST_size_t_eq(records[1], records[0] - 3)
+            || !TEST_size_t_eq(records[2], records[1])
+            || !TEST_size_t_gt(writes[0], writes[2])
+            || !TEST_size_t_eq(writes[2], tst == 0 ? 3 : 2))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    X509_free(chaincert);
+    BIO_free(certbio);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+/*
+ * Test RFC8879 certificate compression.
+ * Test 0: Server certificate compressed
+ * Test 1: Server and client certificates compressed
+ * Test 2: Server does not compress
+ * Test 3: Not used in TLSv1.2
+ */
+static int test_cert_compression(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    BIO *certbio = NULL;
+    X509 *chaincert = NULL;
+    const int algs[] = { TLSEXT_comp_cert_zlib };
+    int version = tst == 3 ? TLS1_2_VERSION : TLS1_3_VERSION;
+    int expected = tst == 2 || tst == 3 ? TLSEXT_comp_cert_none
+                                        : TLSEXT_comp_cert_zlib;
+    int expected_client = tst == 1 ? expected : TLSEXT_comp_cert_none;
+    uint64_t written[3], compressed = 0, cache_hits = 0;
+    int i, j, testresult = 0;
+
+#ifdef OPENSSL_NO_TLS1_3
+    if (tst != 3)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_2
+    if (tst == 3)
+        return 1;
+#endif
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), version, version,
+                                       &sctx, &cctx, cert, privkey)))
+        goto end;
+
+#if !defined(ZLIB) || defined(OPENSSL_NO_COMP)
+    if (!TEST_false(SSL_CTX_set1_cert_comp_preference(cctx, algs,
+                                                      OSSL_NELEM(algs))))
+        goto end;
+    testresult = 1;
+    goto end;
+#endif
+
+    if (!TEST_ptr(certbio = BIO_new_file(cert, "r"))
+            || !TEST_ptr(chaincert = PEM_read_bio_X509(certbio, NULL, NULL,
+                                                       NULL)))
+        goto end;
+
+    /* Session tickets vary in length, so don't send any */
+    SSL_CTX_set_options(sctx, SSL_OP_NO_TICKET);
+    if (!TEST_true(SSL_CTX_set_num_tickets(sctx, 0)))
+        goto end;
+
+    /* A chain with plenty of redundancy */
+    for (i = 0; i < 4; i++) {
+        if (!TEST_true(X509_up_ref(chaincert)))
+            goto end;
+        if (!TEST_true(SSL_CTX_add_extra_chain_cert(sctx, chaincert))) {
+            X509_free(chaincert);
+            goto end;
+        }
+    }
+
+    if (tst == 1) {
+        SSL_CTX_set_verify(sctx, SSL_VERIFY_PEER, verify_cb);
+        if (!TEST_true(SSL_CTX_use_certificate_file(cctx, cert,
+                                                    SSL_FILETYPE_PEM))
+                || !TEST_true(SSL_CTX_use_PrivateKey_file(cctx, privkey,
+                                                          SSL_FILETYPE_PEM)))
+            goto end;
+    }
+
+    /* Once without compression, then twice with it */
+    for (i = 0; i < 3; i++) {
+        if (i == 1) {
+            if (!TEST_true(SSL_CTX_set1_cert_comp_preference(cctx, algs,
+                                                         OSSL_NELEM(algs))))
+                goto end;
+            if (tst != 2
+                    && !TEST_true(SSL_CTX_set1_cert_comp_preference(sctx, algs,
+                                                         OSSL_NELEM(algs))))
+                goto end;
+        }
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+                || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                    SSL_ERROR_NONE))
+                || !TEST_ptr(SSL_SESSION_get0_peer(SSL_get_session(clientssl)))
+                || (tst == 1
+                    && !TEST_ptr(SSL_SESSION_get0_peer(
+                                     SSL_get_session(serverssl)))))
+            goto end;
+        for (j = 0; i > 0 && j < 2; j++) {
+            SSL *s = j == 0 ? clientssl : serverssl;
+
+            if (!TEST_int_eq(SSL_get_negotiated_server_cert_comp(s), expected)
+                    || !TEST_int_eq(SSL_get_negotiated_client_cert_comp(s),
+                                    expected_client))
+                goto end;
+        }
+        written[i] = BIO_number_written(SSL_get_wbio(serverssl));
+
+        SSL_free(serverssl);
+        SSL_free(clientssl);
+        serverssl = clientssl = NULL;
+    }
+
+    if (expected == TLSEXT_comp_cert_none) {
+        if (!TEST_true(written[1] == written[0]))
+            goto end;
+    } else {
+        /*
+         * The server compresses its chain once and then reuses the result
+         * from the cache.
+         */
+        if (!TEST_true(written[1] < written[0])
+                || !TEST_true(written[2] == written[1])
+                || !TEST_true(SSL_CTX_get_cert_comp_stats(sctx, &compressed,
+                                                          &cache_hits))
+                || !TEST_true(compressed == 1)
+                || !TEST_true(cache_hits == 1))
+            goto end;
+    }
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    X509_free(chaincert);
+    BIO_free(certbio);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+/*
+ * Test the cached_info extension (RFC7924)
+ * Test 0: TLSv1.3
+ * Test 1: TLSv1.2
+ * Test 2: TLSv1.3, with the server chain changing after the first handshake
+ */
+static int test_cached_info(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    BIO *certbio = NULL;
+    X509 *chaincert = NULL;
+    int version = tst == 1 ? TLS1_2_VERSION : TLS1_3_VERSION;
+    uint64_t written[3], offered = 0, used = 0;
+    int i, j, expected_used, chainlen = 5, testresult = 0;
+
+#ifdef OPENSSL_NO_TLS1_3
+    if (tst != 1)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_2
+    if (tst == 1)
+        return 1;
+#endif
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), version, version,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set_cached_info_cache_size(cctx, 4))
+            || !TEST_size_t_eq(SSL_CTX_get_cached_info_cache_size(cctx), 4))
+        goto end;
+
+    if (!TEST_ptr(certbio = BIO_new_file(cert, "r"))
+            || !TEST_ptr(chaincert = PEM_read_bio_X509(certbio, NULL, NULL,
+                                                       NULL)))
+        goto end;
+
+    /* Session tickets vary in length, so don't send any */
+    SSL_CTX_set_options(sctx, SSL_OP_NO_TICKET);
+    if (!TEST_true(SSL_CTX_set_num_tickets(sctx, 0)))
+        goto end;
+
+    for (i = 0; i < 4; i++) {
+        if (!TEST_true(X509_up_ref(chaincert)))
+            goto end;
+        if (!TEST_true(SSL_CTX_add_extra_chain_cert(sctx, chaincert))) {
+            X509_free(chaincert);
+            goto end;
+        }
+    }
+
+    /*
+     * The client only has the chain to offer after the first handshake. In
+     * test 2 the second handshake sends the new chain in full.
+     */
+    for (i = 0; i < 3; i++) {
+        if (i == 1 && tst == 2) {
+            if (!TEST_true(X509_up_ref(chaincert)))
+                goto end;
+            if (!TEST_true(SSL_CTX_add_extra_chain_cert(sctx, chaincert))) {
+                X509_free(chaincert);
+                goto end;
+            }
+            chainlen++;
+        }
+        expected_used = i == 2 || (i == 1 && tst != 2);
+
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+                || !TEST_true(SSL_set_tlsext_host_name(clientssl, "goodhost"))
+                || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                    SSL_ERROR_NONE))
+                || !TEST_int_eq(SSL_version(clientssl), version)
+                || !TEST_ptr(SSL_SESSION_get0_peer(SSL_get_session(clientssl)))
+                || !TEST_int_eq(sk_X509_num(SSL_get_peer_cert_chain(clientssl)),
+                                chainlen))
+            goto end;
+        for (j = 0; j < 2; j++) {
+            SSL *s = j == 0 ? clientssl : serverssl;
+
+            if (!TEST_int_eq(SSL_get_cached_info_used(s), expected_used))
+                goto end;
+        }
+        written[i] = BIO_number_written(SSL_get_wbio(serverssl));
+
+        SSL_free(serverssl);
+        SSL_free(clientssl);
+        serverssl = clientssl = NULL;
+    }
+
+    if (tst == 2) {
+        if (!TEST_true(written[1] > written[0]))
+            goto end;
+    } else if (!TEST_true(written[1] < written[0])
+               || !TEST_true(written[2] == written[1])) {
+        goto end;
+    }
+
+    for (j = 0; j < 2; j++) {
+        if (!TEST_true(SSL_CTX_get_cached_info_stats(j == 0 ? cctx : sctx,
+                                                     &offered, &used))
+                || !TEST_true(offered == 2)
+                || !TEST_true(used == (tst == 2 ? 1 : 2)))
+            goto end;
+    }
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    X509_free(chaincert);
+    BIO_free(certbio);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+/*
+ * Test cost aware selection of groups and signature algorithms on the server.
+ * Test 0: TLSv1.2 group, the cheaper P-256 over the client's preferred X25519
+ * Test 1: TLSv1.3 HelloRetryRequest group, the cheaper P-384 over P-256
+ * Test 2: TLSv1.3 sigalg, the cheaper RSA-PSS over ECDSA
+ * Test 3: measured costs, with a minimum that no candidate meets
+ */
+static int test_cost_aware_selection(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    EVP_PKEY *tmpkey = NULL;
+    char *ecdsacert = NULL, *ecdsakey = NULL;
+    int version = tst == 0 ? TLS1_2_VERSION : TLS1_3_VERSION;
+    int type = tst == 2 ? SSL_COST_SIGALG : SSL_COST_GROUP;
+    uint64_t cost = 0, selected = 0, cheapest = 0, preference = 0;
+    uint64_t below_minimum = 0;
+    int testresult = 0;
+
+#ifdef OPENSSL_NO_TLS1_3
+    if (tst != 0)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_2
+    if (tst == 0)
+        return 1;
+#endif
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), version, version,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_ptr(ecdsacert = test_mk_file_path(certsdir,
+                                                       "server-ecdsa-cert.pem"))
+            || !TEST_ptr(ecdsakey = test_mk_file_path(certsdir,
+                                                      "server-ecdsa-key.pem"))
+            || !TEST_int_eq(SSL_CTX_use_certificate_file(sctx, ecdsacert,
+                                                         SSL_FILETYPE_PEM), 1)
+            || !TEST_int_eq(SSL_CTX_use_PrivateKey_file(sctx, ecdsakey,
+                                                        SSL_FILETYPE_PEM), 1)
+            || !TEST_false(SSL_CTX_get_cost_selection_stats(sctx, type, NULL,
+                                                            NULL, NULL))
+            || !TEST_false(SSL_CTX_set_cost(sctx, SSL_COST_GROUP, "nosuch",
+                                            1))
+            || !TEST_true(SSL_CTX_set_cost_aware_selection(sctx, 1,
+                                                           tst == 3 ? 1000
+                                                                    : 0)))
+        goto end;
+
+    switch (tst) {
+    case 0:
+        if (!TEST_true(SSL_CTX_set1_groups_list(sctx, "X25519:P-256"))
+                || !TEST_true(SSL_CTX_set1_groups_list(cctx, "X25519:P-256"))
+                || !TEST_true(SSL_CTX_set_cost(sctx, SSL_COST_GROUP, "X25519",
+                                               1000))
+                || !TEST_true(SSL_CTX_set_cost(sctx, SSL_COST_GROUP, "P-256",
+                                               10)))
+            goto end;
+        break;
+    case 1:
+        if (!TEST_true(SSL_CTX_set1_groups_list(sctx, "P-256:P-384"))
+                || !TEST_true(SSL_CTX_set1_groups_list(cctx,
+                                                       "X25519:P-256:P-384"))
+                || !TEST_true(SSL_CTX_set_cost(sctx, SSL_COST_GROUP, "P-256",
+                                               1000))
+                || !TEST_true(SSL_CTX_set_cost(sctx, SSL_COST_GROUP, "P-384",
+                                               10)))
+            goto end;
+        break;
+    case 2:
+        if (!TEST_true(SSL_CTX_set_cost(sctx, SSL_COST_SIGALG,
+                                        "ecdsa_secp256r1_sha256", 1000))
+                || !TEST_true(SSL_CTX_set_cost(sctx, SSL_COST_SIGALG,
+                                               "rsa_pss_rsae_sha256", 10)))
+            goto end;
+        break;
+    case 3:
+        if (!TEST_true(SSL_CTX_measure_costs(sctx))
+                || !TEST_true(SSL_CTX_get_cost(sctx, SSL_COST_GROUP, "X25519",
+                                               &cost, NULL))
+                || !TEST_true(cost > 0)
+                || !TEST_true(SSL_CTX_get_cost(sctx, SSL_COST_SIGALG,
+                                               "ECDSA+SHA256", &cost, NULL))
+                || !TEST_true(cost > 0))
+            goto end;
+        break;
+    }
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    switch (tst) {
+    case 0:
+        if (!TEST_true(SSL_get_peer_tmp_key(clientssl, &tmpkey))
+                || !TEST_int_eq(EVP_PKEY_id(tmpkey), EVP_PKEY_EC)
+                || !TEST_true(SSL_CTX_get_cost(sctx, SSL_COST_GROUP, "P-256",
+                                               &cost, &selected))
+                || !TEST_true(cost == 10)
+                || !TEST_true(selected == 1))
+            goto end;
+        break;
+    case 1:
+        if (!TEST_int_eq(serverssl->hello_retry_request, SSL_HRR_COMPLETE)
+                || !TEST_int_eq(serverssl->s3->group_id, TLSEXT_curve_P_384))
+            goto end;
+        break;
+    case 2:
+        if (!TEST_int_eq(serverssl->s3->tmp.sigalg->sigalg,
+                         TLSEXT_SIGALG_rsa_pss_rsae_sha256))
+            goto end;
+        break;
+    }
+
+    if (!TEST_true(SSL_CTX_get_cost_selection_stats(sctx, type, &cheapest,
+                                                    &preference,
+                                                    &below_minimum))
+            || !TEST_true(cheapest == (tst == 3 ? 0 : 1))
+            || !TEST_true(preference == 0)
+            || !TEST_true(below_minimum == (tst == 3 ? 1 : 0)))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    EVP_PKEY_free(tmpkey);
+    OPENSSL_free(ecdsacert);
+    OPENSSL_free(ecdsakey);
+
+    return testresult;
+}
+
+/*
+ * Test handshake timing.
+ * Test 0: TLSv1.3 with X25519
+ * Test 1: TLSv1.3 with the p256_kyber512 hybrid group
+ * Test 2: TLSv1.2 with P-256, with timing only turned on for the server
+ */
+static int test_handshake_timing(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    int version = tst == 2 ? TLS1_2_VERSION : TLS1_3_VERSION;
+    const char *group = tst == 0 ? "X25519"
+                                 : tst == 1 ? "p256_kyber512" : "P-256";
+    uint64_t nsec = 0, count = 0, total = 0;
+    uint64_t buckets[SSL_HS_TIMING_BUCKETS];
+    size_t i, cbytes = 0, sbytes = 0;
+    int sent = 0, testresult = 0;
+
+#ifdef OPENSSL_NO_TLS1_3
+    if (tst != 2)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_2
+    if (tst == 2)
+        return 1;
+#endif
+    if (tst == 1
+            && !OQS_KEM_alg_is_enabled(get_oqs_alg_name(NID_kyber512))) {
+        TEST_note("kyber512 not enabled in liboqs, skipping");
+        return 1;
+    }
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), version, version,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set1_groups_list(sctx, group))
+            || !TEST_true(SSL_CTX_set1_groups_list(cctx, group))
+            || !TEST_false(SSL_CTX_get_handshake_histogram(sctx,
+                                                           SSL_HS_PHASE_TOTAL,
+                                                           buckets,
+                                                           OSSL_NELEM(buckets)))
+            || !TEST_true(SSL_CTX_set_handshake_timing(sctx, 1))
+            || !TEST_true(SSL_CTX_set_handshake_timing(cctx, tst != 2))
+            || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl,
+                                             &clientssl, NULL, NULL))
+            || !TEST_false(SSL_get_handshake_phase(serverssl,
+                                                   SSL_HS_PHASE_TOTAL, NULL,
+                                                   NULL))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    /* The server's view: one of each crypto step, and time spent in total */
+    if (!TEST_true(SSL_get_handshake_phase(serverssl, SSL_HS_PHASE_TOTAL,
+                                           &nsec, &count))
+            || !TEST_true(count == 1)
+            || !TEST_true(nsec > 0)
+            || !TEST_true(SSL_get_handshake_phase(serverssl, SSL_HS_PHASE_SIGN,
+                                                  NULL, &count))
+            || !TEST_true(count == 1)
+            || !TEST_true(SSL_get_handshake_phase(serverssl,
+                                                  SSL_HS_PHASE_ENCAPS, NULL,
+                                                  &count))
+            || !TEST_true(count == (tst == 1 ? 1 : 0))
+            || !TEST_true(SSL_get_handshake_phase(serverssl,
+                                                  SSL_HS_PHASE_KEYGEN, NULL,
+                                                  &count))
+            || !TEST_true(count == 1)
+            || !TEST_true(SSL_get_handshake_transition_count(serverssl) > 0)
+            || !TEST_true(SSL_get_handshake_flight(serverssl, 0, &sent,
+                                                   &sbytes, NULL))
+            || !TEST_false(sent)
+            || !TEST_str_eq(SSL_handshake_phase_name(SSL_HS_PHASE_PEER_WAIT),
+                            "peer_wait")
+            || !TEST_ptr_null(SSL_handshake_phase_name(SSL_HS_PHASE_NUM)))
+        goto end;
+
+    /* Flights alternate, and the first one is the ClientHello */
+    for (i = 1; i < SSL_get_handshake_flight_count(serverssl); i++) {
+        if (!TEST_true(SSL_get_handshake_flight(serverssl, i, &sent, NULL,
+                                                NULL))
+                || !TEST_int_eq(sent, i % 2))
+            goto end;
+    }
+
+    if (tst == 2) {
+        /* Timing was never turned on for the client */
+        if (!TEST_false(SSL_get_handshake_phase(clientssl, SSL_HS_PHASE_TOTAL,
+                                                NULL, NULL))
+                || !TEST_size_t_eq(SSL_get_handshake_flight_count(clientssl),
+                                   0)
+                || !TEST_false(SSL_CTX_get_handshake_histogram(cctx,
+                                                               SSL_HS_PHASE_TOTAL,
+                                                               buckets,
+                                                               OSSL_NELEM(buckets))))
+            goto end;
+    } else {
+        if (!TEST_true(SSL_get_handshake_phase(clientssl, SSL_HS_PHASE_TOTAL,
+                                               NULL, &count))
+                || !TEST_true(count == 1)
+                || !TEST_true(SSL_get_handshake_phase(clientssl,
+                                                      SSL_HS_PHASE_VERIFY,
+                                                      NULL, &count))
+                || !TEST_true(count == 1)
+                || !TEST_true(SSL_get_handshake_phase(clientssl,
+                                                      SSL_HS_PHASE_CHAIN,
+                                                      NULL, &count))
+                || !TEST_true(count == 1)
+                || !TEST_true(SSL_get_handshake_phase(clientssl,
+                                                      SSL_HS_PHASE_DECAPS,
+                                                      NULL, &count))
+                || !TEST_true(count == (tst == 1 ? 1 : 0))
+                || !TEST_true(SSL_get_handshake_flight(clientssl, 0, &sent,
+                                                       &cbytes, NULL))
+                || !TEST_true(sent)
+                || !TEST_size_t_eq(cbytes, sbytes)
+                || !TEST_size_t_eq(SSL_get_handshake_flight_count(clientssl),
+                                   SSL_get_handshake_flight_count(serverssl)))
+            goto end;
+    }
+
+    if (!TEST_true(SSL_CTX_get_handshake_histogram(sctx, SSL_HS_PHASE_TOTAL,
+                                                   buckets,
+                                                   OSSL_NELEM(buckets))))
+        goto end;
+    for (i = 0; i < OSSL_NELEM(buckets); i++)
+        total += buckets[i];
+    if (!TEST_true(total == 1))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+/*
+ * Test that the encoding of the server's certificate chain and CA names is
+ * kept, and dropped when they change, and that an SSL with a certificate of
+ * its own does not replace the encoding kept for the SSL_CTX.
+ * Test 0: TLSv1.3
+ * Test 1: TLSv1.2
+ */
+static int test_cert_der_cache(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    BIO *certbio = NULL;
+    X509 *chaincert = NULL;
+    CERT_DER_CACHE *cache;
+    CERT_CHAIN_DER *der[3];
+    int version = tst == 0 ? TLS1_3_VERSION : TLS1_2_VERSION;
+    int i, testresult = 0;
+
+#ifdef OPENSSL_NO_TLS1_3
+    if (tst == 0)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_2
+    if (tst == 1)
+        return 1;
+#endif
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), version, version,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_ptr(certbio = BIO_new_file(cert, "r"))
+            || !TEST_ptr(chaincert = PEM_read_bio_X509(certbio, NULL, NULL,
+                                                       NULL))
+            || !TEST_true(SSL_CTX_add_client_CA(sctx, chaincert))
+            || !TEST_true(X509_up_ref(chaincert)))
+        goto end;
+    if (!TEST_true(SSL_CTX_add_extra_chain_cert(sctx, chaincert))) {
+        X509_free(chaincert);
+        goto end;
+    }
+    SSL_CTX_set_verify(sctx, SSL_VERIFY_PEER, NULL);
+
+    for (i = 0; i < 3; i++) {
+        if (i == 2) {
+            /* Both the chain and the CA names grow by one */
+            if (!TEST_true(SSL_CTX_add_client_CA(sctx, chaincert))
+                    || !TEST_ptr_null(sctx->client_ca_names_der.der)
+                    || !TEST_true(X509_up_ref(chaincert)))
+                goto end;
+            if (!TEST_true(SSL_CTX_add_extra_chain_cert(sctx, chaincert))) {
+                X509_free(chaincert);
+                goto end;
+            }
+        }
+        if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                          NULL, NULL))
+                || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                    SSL_ERROR_NONE))
+                || !TEST_int_eq(sk_X509_num(SSL_get_peer_cert_chain(clientssl)),
+                                i < 2 ? 2 : 3)
+                || !TEST_int_eq(sk_X509_NAME_num(SSL_get0_peer_CA_list(clientssl)),
+                                i < 2 ? 1 : 2)
+                || !TEST_ptr(cache = sctx->cert->pkeys[SSL_PKEY_RSA].der_cache)
+                || !TEST_ptr_eq(serverssl->cert->pkeys[SSL_PKEY_RSA].der_cache,
+                                cache)
+                || !TEST_ptr(der[i] = cache->der)
+                || !TEST_int_eq(sk_X509_num(der[i]->chain), i < 2 ? 2 : 3)
+                || !TEST_int_eq(sctx->client_ca_names_der.num, i < 2 ? 1 : 2))
+            goto end;
+
+        SSL_free(serverssl);
+        SSL_free(clientssl);
+        serverssl = clientssl = NULL;
+    }
+
+    /* The second handshake copied the encoding made by the first */
+    if (!TEST_ptr_eq(der[1], der[0]))
+        goto end;
+
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      NULL, NULL))
+            || !TEST_int_eq(SSL_use_certificate_file(serverssl, cert,
+                                                     SSL_FILETYPE_PEM), 1)
+            || !TEST_int_eq(SSL_use_PrivateKey_file(serverssl, privkey,
+                                                    SSL_FILETYPE_PEM), 1)
+            || !TEST_ptr_ne(serverssl->cert->pkeys[SSL_PKEY_RSA].der_cache,
+                            cache)
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_ptr(serverssl->cert->pkeys[SSL_PKEY_RSA].der_cache->der)
+            || !TEST_ptr_eq(cache->der, der[2]))
+        goto end;
+
+    testresult = 1;
+
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    X509_free(chaincert);
+    BIO_free(certbio);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+
+    return testresult;
+}
+
+#ifndef OPENSSL_NO_KTLS
+/* Reads |len| bytes from the non-blocking |ssl| and checks they are |msg| */
+static int ktls_read_expect(SSL *ssl, const char *msg, size_t len)
+{
+    char buf[64];
+    size_t got = 0, n;
+    int i;
+
+    for (i = 0; got < len && i < 10000; i++) {
+        if (SSL_read_ex(ssl, buf + got, sizeof(buf) - got, &n))
+            got += n;
+        else if (!TEST_int_eq(SSL_get_error(ssl, 0), SSL_ERROR_WANT_READ))
+            return 0;
+    }
+    return TEST_mem_eq(buf, got, msg, len);
+}
+
+static int ktls_ping_pong(SSL *clientssl, SSL *serverssl)
+{
+    static const char cmsg[] = "ping from the client";
+    static const char smsg[] = "pong from the server";
+    size_t written;
+
+    return TEST_true(SSL_write_ex(clientssl, cmsg, sizeof(cmsg), &written))
+           && TEST_size_t_eq(written, sizeof(cmsg))
+           && ktls_read_expect(serverssl, cmsg, sizeof(cmsg))
+           && TEST_true(SSL_write_ex(serverssl, smsg, sizeof(smsg), &written))
+           && TEST_size_t_eq(written, sizeof(smsg))
+           && ktls_read_expect(clientssl, smsg, sizeof(smsg));
+}
+
+/*
+ * Test a connection over sockets with SSL_MODE_ENABLE_KTLS. Where the kernel
+ * takes the records, it does so in both directions of both ends, and where
+ * it cannot, the connection carries on in user space.
+ * Test 0: TLSv1.2, AES-128-GCM
+ * Test 1: TLSv1.2, AES-256-GCM
+ * Test 2: TLSv1.2, ChaCha20-Poly1305
+ * Test 3: TLSv1.3, AES-128-GCM
+ * Test 4: TLSv1.3, AES-256-GCM
+ * Test 5: TLSv1.3, ChaCha20-Poly1305
+ */
+static int test_ktls(int tst)
+{
+    static const char *tls12_ciphers[] = {
+        "ECDHE-RSA-AES128-GCM-SHA256", "ECDHE-RSA-AES256-GCM-SHA384",
+        "ECDHE-RSA-CHACHA20-POLY1305"
+    };
+    static const char *tls13_ciphers[] = {
+        "TLS_AES_128_GCM_SHA256", "TLS_AES_256_GCM_SHA384",
+        "TLS_CHACHA20_POLY1305_SHA256"
+    };
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    int version = tst < 3 ? TLS1_2_VERSION : TLS1_3_VERSION;
+    int cfd = -1, sfd = -1, offloaded, testresult = 0;
+    char buf;
+
+#ifdef OPENSSL_NO_TLS1_2
+    if (version == TLS1_2_VERSION)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_3
+    if (version == TLS1_3_VERSION)
+        return 1;
+#endif
+#if defined(OPENSSL_NO_CHACHA) || defined(OPENSSL_NO_POLY1305)
+    if (tst % 3 == 2)
+        return 1;
+#endif
+
+    if (!TEST_true(create_test_sockets(&cfd, &sfd))
+            || !TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                              TLS_client_method(), version,
+                                              version, &sctx, &cctx, cert,
+                                              privkey)))
+        goto end;
+    if (version == TLS1_2_VERSION) {
+        if (!TEST_true(SSL_CTX_set_cipher_list(cctx, tls12_ciphers[tst % 3])))
+            goto end;
+    } else if (!TEST_true(SSL_CTX_set_ciphersuites(cctx,
+                                                   tls13_ciphers[tst % 3]))) {
+        goto end;
+    }
+    SSL_CTX_set_mode(sctx, SSL_MODE_ENABLE_KTLS);
+    SSL_CTX_set_mode(cctx, SSL_MODE_ENABLE_KTLS);
+
+    if (!TEST_true(create_ssl_objects2(sctx, cctx, &serverssl, &clientssl,
+                                       sfd, cfd))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    offloaded = BIO_get_ktls_send(SSL_get_wbio(clientssl));
+    if (!TEST_int_eq(BIO_get_ktls_recv(SSL_get_rbio(clientssl)), offloaded)
+            || !TEST_int_eq(BIO_get_ktls_send(SSL_get_wbio(serverssl)),
+                            offloaded)
+            || !TEST_int_eq(BIO_get_ktls_recv(SSL_get_rbio(serverssl)),
+                            offloaded))
+        goto end;
+    if (!offloaded)
+        TEST_info("The kernel did not take the records, testing fallback");
+
+    if (!ktls_ping_pong(clientssl, serverssl))
+        goto end;
+
+    /* The kernel only has TLSv1.3 records if it can take new keys */
+    if (version == TLS1_3_VERSION
+            && (!TEST_true(SSL_key_update(clientssl,
+                                          SSL_KEY_UPDATE_REQUESTED))
+                || !ktls_ping_pong(clientssl, serverssl)
+                || !ktls_ping_pong(clientssl, serverssl)))
+        goto end;
+
+    /* The close_notify alert makes it to the server */
+    if (!TEST_int_eq(SSL_shutdown(clientssl), 0)
+            || !TEST_int_le(SSL_read(serverssl, &buf, sizeof(buf)), 0)
+            || !TEST_int_eq(SSL_get_error(serverssl, 0),
+                            SSL_ERROR_ZERO_RETURN))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    if (cfd != -1)
+        close(cfd);
+    if (sfd != -1)
+        close(sfd);
+    return testresult;
+}
+
+/*
+ * Test SSL_MODE_ENABLE_KTLS with filters standing in for the kernel.
+ * Test 0: TLSv1.3, the kernel can take new keys, so both ends hand it their
+ *         records, and a key update gives it new keys
+ * Test 1: TLSv1.3, the kernel cannot take new keys, so the records stay in
+ *         user space, where a key update works
+ * Test 2: TLSv1.2, the kernel cannot take new keys, which TLSv1.2 does not
+ *         need
+ */
+static int test_ktls_key_update(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    BIO *s_to_c_fbio = NULL, *c_to_s_fbio = NULL;
+    int version = tst < 2 ? TLS1_3_VERSION : TLS1_2_VERSION;
+    int offloaded = tst != 1;
+    size_t tx_keys, rx_keys, keys;
+    int testresult = 0;
+
+#ifdef OPENSSL_NO_TLS1_2
+    if (version == TLS1_2_VERSION)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_3
+    if (version == TLS1_3_VERSION)
+        return 1;
+#endif
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), version, version,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(SSL_CTX_set_ciphersuites(cctx,
+                                                   "TLS_AES_128_GCM_SHA256"))
+            || !TEST_true(SSL_CTX_set_cipher_list(
+                              cctx, "ECDHE-RSA-AES128-GCM-SHA256"))
+            || !TEST_ptr(s_to_c_fbio = BIO_new(bio_f_ktls_test_filter())))
+        goto end;
+    if (!TEST_ptr(c_to_s_fbio = BIO_new(bio_f_ktls_test_filter()))) {
+        BIO_free(s_to_c_fbio);
+        goto end;
+    }
+    SSL_CTX_set_mode(sctx, SSL_MODE_ENABLE_KTLS);
+    SSL_CTX_set_mode(cctx, SSL_MODE_ENABLE_KTLS);
+    ktls_test_filter_set_rekey(s_to_c_fbio, tst == 0);
+    ktls_test_filter_set_rekey(c_to_s_fbio, tst == 0);
+
+    /* The SSL objects own the filters from here */
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      s_to_c_fbio, c_to_s_fbio))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE))
+            || !TEST_int_eq(BIO_get_ktls_send(SSL_get_wbio(clientssl)),
+                            offloaded)
+            || !TEST_int_eq(BIO_get_ktls_recv(SSL_get_rbio(clientssl)),
+                            offloaded)
+            || !TEST_int_eq(BIO_get_ktls_send(SSL_get_wbio(serverssl)),
+                            offloaded)
+            || !TEST_int_eq(BIO_get_ktls_recv(SSL_get_rbio(serverssl)),
+                            offloaded)
+            || !ktls_ping_pong(clientssl, serverssl))
+        goto end;
+
+    /* Both ends update the keys of both directions */
+    if (version == TLS1_3_VERSION
+            && (!TEST_true(SSL_key_update(clientssl,
+                                          SSL_KEY_UPDATE_REQUESTED))
+                || !ktls_ping_pong(clientssl, serverssl)
+                || !ktls_ping_pong(clientssl, serverssl)))
+        goto end;
+    keys = !offloaded ? 0 : version == TLS1_3_VERSION ? 2 : 1;
+    ktls_test_filter_get_keys(s_to_c_fbio, &tx_keys, &rx_keys);
+    if (!TEST_size_t_eq(tx_keys, keys) || !TEST_size_t_eq(rx_keys, keys))
+        goto end;
+    ktls_test_filter_get_keys(c_to_s_fbio, &tx_keys, &rx_keys);
+    if (!TEST_size_t_eq(tx_keys, keys) || !TEST_size_t_eq(rx_keys, keys))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+#endif
+
+/*
+ * Test a connection through filters that answer 1 to every ctrl that they do
+ * not know, including the ones that report kTLS. The records must stay in
+ * user space, as SSL_MODE_ENABLE_KTLS is not set.
+ * Test 0: TLSv1.2
+ * Test 1: TLSv1.3, with a key update
+ */
+static int test_ctrl_ok_filter(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    BIO *s_to_c_fbio = NULL, *c_to_s_fbio = NULL;
+    int version = tst == 0 ? TLS1_2_VERSION : TLS1_3_VERSION;
+    static const char msg[] = "through the filter";
+    char buf[sizeof(msg)];
+    size_t written, readbytes;
+    int i, testresult = 0;
+
+#ifdef OPENSSL_NO_TLS1_2
+    if (version == TLS1_2_VERSION)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_3
+    if (version == TLS1_3_VERSION)
+        return 1;
+#endif
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), version, version,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_ptr(s_to_c_fbio = BIO_new(bio_f_ctrl_ok_filter())))
+        goto end;
+    if (!TEST_ptr(c_to_s_fbio = BIO_new(bio_f_ctrl_ok_filter()))) {
+        BIO_free(s_to_c_fbio);
+        goto end;
+    }
+
+    /* The SSL objects own the filters from here */
+    if (!TEST_true(create_ssl_objects(sctx, cctx, &serverssl, &clientssl,
+                                      s_to_c_fbio, c_to_s_fbio))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+    if (version == TLS1_3_VERSION
+            && !TEST_true(SSL_key_update(clientssl, SSL_KEY_UPDATE_REQUESTED)))
+        goto end;
+
+    for (i = 0; i < 2; i++) {
+        if (!TEST_true(SSL_write_ex(clientssl, msg, sizeof(msg), &written))
+                || !TEST_true(SSL_read_ex(serverssl, buf, sizeof(buf),
+                                          &readbytes))
+                || !TEST_mem_eq(buf, readbytes, msg, sizeof(msg))
+                || !TEST_true(SSL_write_ex(serverssl, msg, sizeof(msg),
+                                           &written))
+                || !TEST_true(SSL_read_ex(clientssl, buf, sizeof(buf),
+                                          &readbytes))
+                || !TEST_mem_eq(buf, readbytes, msg, sizeof(msg)))
+            goto end;
+    }
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+#if !defined(OPENSSL_NO_SOCK) && defined(OPENSSL_SYS_UNIX)
+/*
+ * Test SSL_sendfile() over sockets, from an offset that is not on a page
+ * boundary, with enough data for several records and writes that have to be
+ * retried.
+ * Test 0: TLSv1.2
+ * Test 1: TLSv1.3
+ * Test 2: TLSv1.3 with SSL_MODE_ENABLE_KTLS
+ */
+static int test_sendfile(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    const size_t filelen = 300000, offset = 1000, total = 250000;
+    unsigned char *file = NULL, *recvd = NULL;
+    size_t i, sent = 0, got = 0, n;
+    ossl_ssize_t ret;
+    FILE *fp = NULL;
+    int cfd = -1, sfd = -1, loops, testresult = 0, bufsize = 8192;
+    int version = tst == 0 ? TLS1_2_VERSION : TLS1_3_VERSION;
+
+#ifdef OPENSSL_NO_TLS1_2
+    if (version == TLS1_2_VERSION)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_3
+    if (version == TLS1_3_VERSION)
+        return 1;
+#endif
+
+    if (!TEST_ptr(file = OPENSSL_malloc(filelen))
+            || !TEST_ptr(recvd = OPENSSL_malloc(total))
+            || !TEST_ptr(fp = tmpfile()))
+        goto end;
+    for (i = 0; i < filelen; i++)
+        file[i] = (unsigned char)(i * 7 + (i >> 11));
+    if (!TEST_size_t_eq(fwrite(file, 1, filelen, fp), filelen)
+            || !TEST_int_eq(fflush(fp), 0))
+        goto end;
+
+    /* A small socket buffer, so that writes have to be retried */
+    if (!TEST_true(create_test_sockets(&cfd, &sfd))
+            || !TEST_int_eq(setsockopt(sfd, SOL_SOCKET, SO_SNDBUF,
+                                       (void *)&bufsize, sizeof(bufsize)), 0)
+            || !TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                              TLS_client_method(), version,
+                                              version, &sctx, &cctx, cert,
+                                              privkey)))
+        goto end;
+    if (tst == 2) {
+        SSL_CTX_set_mode(sctx, SSL_MODE_ENABLE_KTLS);
+        SSL_CTX_set_mode(cctx, SSL_MODE_ENABLE_KTLS);
+    }
+    if (!TEST_true(create_ssl_objects2(sctx, cctx, &serverssl, &clientssl,
+                                       sfd, cfd))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    for (loops = 0; got < total; loops++) {
+        if (!TEST_int_lt(loops, 10000000))
+            goto end;
+        if (sent < total) {
+            ret = SSL_sendfile(serverssl, fileno(fp), (off_t)(offset + sent),
+                               total - sent, 0);
+            if (ret > 0)
+                sent += (size_t)ret;
+            else if (!TEST_int_eq(SSL_get_error(serverssl, (int)ret),
+                                  SSL_ERROR_WANT_WRITE))
+                goto end;
+        }
+        if (SSL_read_ex(clientssl, recvd + got, total - got, &n))
+            got += n;
+        else if (!TEST_int_eq(SSL_get_error(clientssl, 0),
+                              SSL_ERROR_WANT_READ))
+            goto end;
+    }
+    if (!TEST_size_t_eq(sent, total)
+            || !TEST_mem_eq(recvd, got, file + offset, total))
+        goto end;
+
+    /* Nothing is sent from the end of the file */
+    if (!TEST_int_eq((int)SSL_sendfile(serverssl, fileno(fp), (off_t)filelen,
+                                       100, 0), 0))
+        goto end;
+
+    /* A file truncated under a transfer ends it early */
+    if (!TEST_int_eq(ftruncate(fileno(fp), (off_t)(offset + total + 100)), 0)
+            || !TEST_int_eq((int)SSL_sendfile(serverssl, fileno(fp),
+                                              (off_t)(offset + total), 10000,
+                                              0), 100)
+            || !TEST_int_eq((int)SSL_sendfile(serverssl, fileno(fp),
+                                              (off_t)(offset + total + 100),
+                                              10000, 0), 0))
+        goto end;
+    for (got = 0, loops = 0; got < 100; loops++) {
+        if (!TEST_int_lt(loops, 100000))
+            goto end;
+        if (SSL_read_ex(clientssl, recvd + got, 100 - got, &n))
+            got += n;
+        else if (!TEST_int_eq(SSL_get_error(clientssl, 0),
+                              SSL_ERROR_WANT_READ))
+            goto end;
+    }
+    if (!TEST_mem_eq(recvd, got, file + offset + total, 100))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    if (cfd != -1)
+        close(cfd);
+    if (sfd != -1)
+        close(sfd);
+    if (fp != NULL)
+        fclose(fp);
+    OPENSSL_free(file);
+    OPENSSL_free(recvd);
+    return testresult;
+}
+#endif
+
+static size_t writev_records;
+
+static void writev_msg_cb(int write_p, int version, int content_type,
+                          const void *buf, size_t len, SSL *ssl, void *arg)
+{
+    if (write_p && content_type == SSL3_RT_HEADER)
+        writev_records++;
+}
+
+/*
+ * Test SSL_writev_ex() and SSL_readv_ex(). The written buffers are packed into
+ * full records across their boundaries, and a record read is spread over
+ * several buffers.
+ * Test 0: TLSv1.2
+ * Test 1: TLSv1.3
+ * Test 2: TLSv1.2 with a max send fragment of 512 bytes
+ */
+static int test_writev_readv(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    unsigned char hdr[300], body[40000], trailer[2], head[20];
+    unsigned char *sent = NULL, *recvd = NULL;
+    const size_t total = sizeof(hdr) + sizeof(body) + sizeof(trailer);
+    size_t frag = tst == 2 ? 512 : SSL3_RT_MAX_PLAIN_LENGTH;
+    size_t i, written, got, n;
+    SSL_IOVEC wiov[4], riov[4];
+    int testresult = 0;
+    int version = tst == 1 ? TLS1_3_VERSION : TLS1_2_VERSION;
+
+#ifdef OPENSSL_NO_TLS1_2
+    if (version == TLS1_2_VERSION)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_3
+    if (version == TLS1_3_VERSION)
+        return 1;
+#endif
+
+    for (i = 0; i < sizeof(hdr); i++)
+        hdr[i] = (unsigned char)i;
+    for (i = 0; i < sizeof(body); i++)
+        body[i] = (unsigned char)(i * 3 + 1);
+    trailer[0] = '\r';
+    trailer[1] = '\n';
+    wiov[0].iov_base = hdr;
+    wiov[0].iov_len = sizeof(hdr);
+    wiov[1].iov_base = NULL;
+    wiov[1].iov_len = 0;
+    wiov[2].iov_base = body;
+    wiov[2].iov_len = sizeof(body);
+    wiov[3].iov_base = trailer;
+    wiov[3].iov_len = sizeof(trailer);
+
+    if (!TEST_ptr(sent = OPENSSL_malloc(total))
+            || !TEST_ptr(recvd = OPENSSL_malloc(total)))
+        goto end;
+    memcpy(sent, hdr, sizeof(hdr));
+    memcpy(sent + sizeof(hdr), body, sizeof(body));
+    memcpy(sent + sizeof(hdr) + sizeof(body), trailer, sizeof(trailer));
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), version, version,
+                                       &sctx, &cctx, cert, privkey))
+            || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl,
+                                             &clientssl, NULL, NULL))
+            || (tst == 2
+                && !TEST_true(SSL_set_max_send_fragment(clientssl, frag)))
+            || !TEST_true(create_ssl_connection(serverssl, clientssl,
+                                                SSL_ERROR_NONE)))
+        goto end;
+
+    writev_records = 0;
+    SSL_set_msg_callback(clientssl, writev_msg_cb);
+    if (!TEST_true(SSL_writev_ex(clientssl, wiov, OSSL_NELEM(wiov), &written))
+            || !TEST_size_t_eq(written, total)
+            || !TEST_size_t_eq(writev_records, (total + frag - 1) / frag))
+        goto end;
+
+    /* The first record fills the two small buffers and goes on into the last */
+    riov[0].iov_base = head;
+    riov[0].iov_len = 10;
+    riov[1].iov_base = NULL;
+    riov[1].iov_len = 0;
+    riov[2].iov_base = head + 10;
+    riov[2].iov_len = 10;
+    riov[3].iov_base = recvd + sizeof(head);
+    riov[3].iov_len = total - sizeof(head);
+    if (!TEST_true(SSL_readv_ex(serverssl, riov, OSSL_NELEM(riov), &got))
+            || !TEST_size_t_eq(got, frag))
+        goto end;
+    memcpy(recvd, head, sizeof(head));
+    riov[3].iov_base = recvd + got;
+    riov[3].iov_len = total - got;
+
+    while (got < total) {
+        if (!TEST_true(SSL_readv_ex(serverssl, &riov[3], 1, &n)))
+            goto end;
+        riov[3].iov_base = (unsigned char *)riov[3].iov_base + n;
+        riov[3].iov_len -= n;
+        got += n;
+    }
+    if (!TEST_mem_eq(recvd, got, sent, total))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    OPENSSL_free(sent);
+    OPENSSL_free(recvd);
+    return testresult;
+}
+
+/*
+ * Test SSL_write_reserve() and SSL_write_commit(): the payload written into
+ * the reserved region arrives intact, and a reservation is dropped by any
+ * other write.
+ * Test 0: TLSv1.2
+ * Test 1: TLSv1.3
+ * Test 2: TLSv1.2 CBC with an empty fragment in front of each record
+ */
+static int test_write_reserve(int tst)
+{
+    SSL_CTX *cctx = NULL, *sctx = NULL;
+    SSL *clientssl = NULL, *serverssl = NULL;
+    unsigned char *buf, expected[5000], rbuf[5000];
+    size_t len, i, written, readbytes, got;
+    SSL3_BUFFER *wb;
+    int testresult = 0;
+    int version = tst == 1 ? TLS1_3_VERSION : TLS1_2_VERSION;
+
+#ifdef OPENSSL_NO_TLS1_2
+    if (version == TLS1_2_VERSION)
+        return 1;
+#endif
+#ifdef OPENSSL_NO_TLS1_3
+    if (version == TLS1_3_VERSION)
+        return 1;
+#endif
+
+    for (i = 0; i < sizeof(expected); i++)
+        expected[i] = (unsigned char)(i * 5 + 3);
+
+    if (!TEST_true(create_ssl_ctx_pair(TLS_server_method(),
+                                       TLS_client_method(), version, version,
+                                       &sctx, &cctx, cert, privkey))
+            || (tst == 2
+                && !TEST_true(SSL_CTX_set_cipher_list(cctx, "AES128-SHA")))
+            || !TEST_true(create_ssl_objects(sctx, cctx, &serverssl,
+                                             &clientssl, NULL, NULL)))
+        goto end;
+
+    /* Nothing can be committed before something is reserved */
+    ERR_clear_error();
+    if (!TEST_true(create_ssl_connection(serverssl, clientssl,
+                                         SSL_ERROR_NONE))
+            || !TEST_false(SSL_write_commit(clientssl, 10, &written))
+            || !TEST_int_eq(ERR_GET_REASON(ERR_peek_last_error()),
+                            SSL_R_NO_WRITE_RESERVED))
+        goto end;
+    if (tst == 2) {
+        /* As with TLSv1_client_method() */
+        clientssl->s3->need_empty_fragments = 1;
+    }
+
+    if (!TEST_true(SSL_write_reserve(clientssl, &buf, &len))
+            || !TEST_size_t_ge(len, sizeof(expected)))
+        goto end;
+    /* The region is in the buffer that the record is encrypted in */
+    wb = &clientssl->rlayer.wbuf[0];
+    if (!TEST_true(buf > wb->buf && buf + len < wb->buf + wb->len))
+        goto end;
+    memcpy(buf, expected, sizeof(expected));
+    if (!TEST_false(SSL_write_commit(clientssl, len + 1, &written))
+            || !TEST_true(SSL_write_commit(clientssl, sizeof(expected),
+                                           &written))
+            || !TEST_size_t_eq(written, sizeof(expected)))
+        goto end;
+
+    for (got = 0; got < sizeof(expected); got += readbytes)
+        if (!TEST_true(SSL_read_ex(serverssl, rbuf + got,
+                                   sizeof(rbuf) - got, &readbytes)))
+            goto end;
+    if (!TEST_mem_eq(rbuf, got, expected, sizeof(expected)))
+        goto end;
+
+    /* Another write in between takes the buffer back */
+    if (!TEST_true(SSL_write_reserve(clientssl, &buf, &len))
+            || !TEST_true(SSL_write_ex(clientssl, "x", 1, &written))
+            || !TEST_false(SSL_write_commit(clientssl, 1, &written))
+            || !TEST_true(SSL_read_ex(serverssl, rbuf, sizeof(rbuf),
+                                      &readbytes))
+            || !TEST_size_t_eq(readbytes, 1))
+        goto end;
+
+    testresult = 1;
+ end:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    SSL_CTX_free(sctx);
+    SSL_CTX_free(cctx);
+    return testresult;
+}
+
+int setup_tests(void)
+{
+    if (!TEST_ptr(certsdir = test_get_argument(0))
+            || !TEST_ptr(srpvfile = test_get_argument(1))
+            || !TEST_ptr(tmpfilename = test_get_argument(2)))
+        return 0;
+
+    if (getenv("OPENSSL_TEST_GETCOUNTS") != NULL) {
+#ifdef OPENSSL_NO_CRYPTO_MDEBUG
+        TEST_error("not supported in this build");
+        return 0;
+#else
+        int i, mcount, rcount, fcount;
+
+        for (i = 0; i < 4; i++)
+            test_export_key_mat(i);
+        CRYPTO_get_alloc_counts(&mcount, &rcount, &fcount);
+        test_printf_stdout("malloc %d realloc %d free %d\n",
+                mcount, rcount, fcount);
+        return 1;
+#endif
+    }
+
+    cert = test_mk_file_path(certsdir, "servercert.pem");
+    if (cert == NULL)
+        return 0;
+
+    privkey = test_mk_file_path(certsdir, "serverkey.pem");
+    if (privkey == NULL) {
+        OPENSSL_free(cert);
+        return 0;
+    }
+
+    ADD_TEST(test_large_message_tls);
+    ADD_TEST(test_large_message_tls_read_ahead);
+#ifndef OPENSSL_NO_DTLS
+    ADD_TEST(test_large_message_dtls);
+#endif
+#ifndef OPENSSL_NO_OCSP
+    ADD_TEST(test_tlsext_status_type);
+#endif
+    ADD_TEST(test_session_with_only_int_cache);
+    ADD_TEST(test_session_with_only_ext_cache);
+    ADD_TEST(test_session_with_both_cache);
+#ifndef OPENSSL_NO_TLS1_3
+    ADD_ALL_TESTS(test_stateful_tickets, 3);
+    ADD_ALL_TESTS(test_stateless_tickets, 3);
+    ADD_TEST(test_psk_tickets);
+#endif
+    ADD_ALL_TESTS(test_ssl_set_bio, TOTAL_SSL_SET_BIO_TESTS);
+    ADD_TEST(test_ssl_bio_pop_next_bio);
+    ADD_TEST(test_ssl_bio_pop_ssl_bio);
+    ADD_TEST(test_ssl_bio_change_rbio);
+    ADD_TEST(test_ssl_bio_change_wbio);
+#if !defined(OPENSSL_NO_TLS1_2) || defined(OPENSSL_NO_TLS1_3)
+    ADD_ALL_TESTS(test_set_sigalgs, OSSL_NELEM(testsigalgs) * 2);
+    ADD_TEST(test_keylog);
+#endif
+#ifndef OPENSSL_NO_TLS1_3
+    ADD_TEST(test_keylog_no_master_key);
+#endif
+#ifndef OPENSSL_NO_TLS1_2
+    ADD_TEST(test_client_hello_cb);
+    ADD_TEST(test_ccs_change_cipher);
+#endif
+#ifndef OPENSSL_NO_TLS1_3
+    ADD_ALL_TESTS(test_early_data_read_write, 3);
+    /*
+     * We don't do replay tests for external PSK. Replay protection isn't used
+     * in that scenario.
+     */
+    ADD_ALL_TESTS(test_early_data_replay, 2);
+    ADD_ALL_TESTS(test_early_data_skip, 3);
+    ADD_ALL_TESTS(test_early_data_skip_hrr, 3);
+    ADD_ALL_TESTS(test_early_data_skip_hrr_fail, 3);
+    ADD_ALL_TESTS(test_early_data_skip_abort, 3);
+    ADD_ALL_TESTS(test_early_data_not_sent, 3);
+    ADD_ALL_TESTS(test_early_data_psk, 8);
+    ADD_ALL_TESTS(test_early_data_psk_with_all_ciphers, 5);
+    ADD_ALL_TESTS(test_early_data_not_expected, 3);
+# ifndef OPENSSL_NO_TLS1_2
+    ADD_ALL_TESTS(test_early_data_tls1_2, 3);
+# endif
+#endif
+#ifndef OPENSSL_NO_TLS1_3
+    ADD_ALL_TESTS(test_set_ciphersuite, 10);
+    ADD_TEST(test_ciphersuite_change);
+    ADD_ALL_TESTS(test_tls13_ciphersuite, 4);
+#ifdef OPENSSL_NO_PSK
+    ADD_ALL_TESTS(test_tls13_psk, 1);
+#else
+    ADD_ALL_TESTS(test_tls13_psk, 4);
+#endif  /* OPENSSL_NO_PSK */
+    ADD_ALL_TESTS(test_custom_exts, 5);
+    ADD_TEST(test_stateless);
+    ADD_TEST(test_pha_key_update);
+#else
+    ADD_ALL_TESTS(test_custom_exts, 3);
 #endif
     ADD_ALL_TESTS(test_serverinfo, 8);
     ADD_ALL_TESTS(test_export_key_mat, 6);
@@ -6781,6 +8444,27 @@ int setup_tests(void)
 #ifndef OPENSSL_NO_TLS1_2
     ADD_TEST(test_ssl_dup);
 #endif
+#ifndef OPENSSL_NO_TLS1_3
+    ADD_ALL_TESTS(test_oqs_kem_pool, 3);
+    ADD_ALL_TESTS(test_oqs_async_offload, 2);
+    ADD_ALL_TESTS(test_key_share_cache, 3);
+#endif
+    ADD_ALL_TESTS(test_coalesce_flights, 2);
+    ADD_ALL_TESTS(test_cert_compression, 4);
+    ADD_ALL_TESTS(test_cached_info, 3);
+    ADD_ALL_TESTS(test_cost_aware_selection, 4);
+    ADD_ALL_TESTS(test_handshake_timing, 3);
+    ADD_ALL_TESTS(test_cert_der_cache, 2);
+#ifndef OPENSSL_NO_KTLS
+    ADD_ALL_TESTS(test_ktls, 6);
+    ADD_ALL_TESTS(test_ktls_key_update, 3);
+#endif
+    ADD_ALL_TESTS(test_ctrl_ok_filter, 2);
+#if !defined(OPENSSL_NO_SOCK) && defined(OPENSSL_SYS_UNIX)
+    ADD_ALL_TESTS(test_sendfile, 3);
+#endif
+    ADD_ALL_TESTS(test_writev_readv, 3);
+    ADD_ALL_TESTS(test_write_reserve, 3);
     return 1;
 }
 
@@ -6790,4 +8474,7 @@ void cleanup_tests(void)
     OPENSSL_free(privkey);
     bio_s_mempacket_test_free();
     bio_s_always_retry_free();
+    bio_f_tls_count_filter_free();
+    bio_f_ktls_test_filter_free();
+    bio_f_ctrl_ok_filter_free();
 }
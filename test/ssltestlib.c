@@ -63,10 +63,16 @@ static int tls_dump_puts(BIO *bp, const char *str);
 #define BIO_TYPE_TLS_DUMP_FILTER  (0x80 | BIO_TYPE_FILTER)
 #define BIO_TYPE_MEMPACKET_TEST    0x81
 #define BIO_TYPE_ALWAYS_RETRY      0x82
+#define BIO_TYPE_TLS_COUNT_FILTER  (0x83 | BIO_TYPE_FILTER)
+#define BIO_TYPE_KTLS_TEST_FILTER  (0x84 | BIO_TYPE_FILTER)
+#define BIO_TYPE_CTRL_OK_FILTER    (0x85 | BIO_TYPE_FILTER)
 
 static BIO_METHOD *method_tls_dump = NULL;
 static BIO_METHOD *meth_mem = NULL;
 static BIO_METHOD *meth_always_retry = NULL;
+static BIO_METHOD *method_tls_count = NULL;
+static BIO_METHOD *method_ktls_test = NULL;
+static BIO_METHOD *method_ctrl_ok = NULL;
 
 /* Note: Not thread safe! */
 const BIO_METHOD *bio_f_tls_dump_filter(void)
@@ -708,6 +714,356 @@ static int always_retry_puts(BIO *bio, const char *str)
     return -1;
 }
 
+typedef struct tls_count_ctx_st {
+    size_t writes;
+    size_t records;
+    /* Partial record header, and what remains of the current record */
+    unsigned char hdr[SSL3_RT_HEADER_LENGTH];
+    size_t hdrlen;
+    size_t left;
+} TLS_COUNT_CTX;
+
+static int tls_count_new(BIO *bio);
+static int tls_count_free(BIO *bio);
+static int tls_count_read(BIO *bio, char *out, int outl);
+static int tls_count_write(BIO *bio, const char *in, int inl);
+static int tls_count_puts(BIO *bio, const char *str);
+
+const BIO_METHOD *bio_f_tls_count_filter(void)
+{
+    if (method_tls_count == NULL) {
+        if (!TEST_ptr(method_tls_count =
+                          BIO_meth_new(BIO_TYPE_TLS_COUNT_FILTER,
+                                       "TLS count filter"))
+            || !TEST_true(BIO_meth_set_write(method_tls_count,
+                                             tls_count_write))
+            || !TEST_true(BIO_meth_set_read(method_tls_count, tls_count_read))
+            || !TEST_true(BIO_meth_set_puts(method_tls_count, tls_count_puts))
+            || !TEST_true(BIO_meth_set_gets(method_tls_count, tls_dump_gets))
+            || !TEST_true(BIO_meth_set_ctrl(method_tls_count, tls_dump_ctrl))
+            || !TEST_true(BIO_meth_set_create(method_tls_count,
+                                              tls_count_new))
+            || !TEST_true(BIO_meth_set_destroy(method_tls_count,
+                                               tls_count_free)))
+            return NULL;
+    }
+    return method_tls_count;
+}
+
+void bio_f_tls_count_filter_free(void)
+{
+    BIO_meth_free(method_tls_count);
+}
+
+static int tls_count_new(BIO *bio)
+{
+    TLS_COUNT_CTX *ctx = OPENSSL_zalloc(sizeof(*ctx));
+
+    if (ctx == NULL)
+        return 0;
+    BIO_set_data(bio, ctx);
+    BIO_set_init(bio, 1);
+    return 1;
+}
+
+static int tls_count_free(BIO *bio)
+{
+    OPENSSL_free(BIO_get_data(bio));
+    BIO_set_data(bio, NULL);
+    BIO_set_init(bio, 0);
+    return 1;
+}
+
+static int tls_count_read(BIO *bio, char *out, int outl)
+{
+    int ret = BIO_read(BIO_next(bio), out, outl);
+
+    copy_flags(bio);
+    return ret;
+}
+
+static int tls_count_write(BIO *bio, const char *in, int inl)
+{
+    TLS_COUNT_CTX *ctx = BIO_get_data(bio);
+    const unsigned char *p = (const unsigned char *)in;
+    int ret;
+    size_t rem, n;
+
+    ret = BIO_write(BIO_next(bio), in, inl);
+    copy_flags(bio);
+    if (ret <= 0)
+        return ret;
+
+    ctx->writes++;
+    for (rem = (size_t)ret; rem > 0; rem -= n, p += n) {
+        if (ctx->left > 0) {
+            n = rem < ctx->left ? rem : ctx->left;
+            ctx->left -= n;
+            continue;
+        }
+        n = 1;
+        ctx->hdr[ctx->hdrlen++] = *p;
+        if (ctx->hdrlen == SSL3_RT_HEADER_LENGTH) {
+            ctx->records++;
+            ctx->left = (ctx->hdr[3] << 8) | ctx->hdr[4];
+            ctx->hdrlen = 0;
+        }
+    }
+    return ret;
+}
+
+static int tls_count_puts(BIO *bio, const char *str)
+{
+    return tls_count_write(bio, str, strlen(str));
+}
+
+void tls_count_filter_get(BIO *bio, size_t *writes, size_t *records)
+{
+    TLS_COUNT_CTX *ctx = BIO_get_data(bio);
+
+    *writes = ctx->writes;
+    *records = ctx->records;
+}
+
+void tls_count_filter_reset(BIO *bio)
+{
+    TLS_COUNT_CTX *ctx = BIO_get_data(bio);
+
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+/*
+ * Stands in for the kernel (kTLS) on one direction of a connection: once the
+ * writing end has installed its keys, records are written as their type and
+ * payload after a TLS record header, and once the reading end has, they are
+ * read one at a time as ktls_read_record() returns them. Nothing is encrypted.
+ */
+typedef struct ktls_test_ctx_st {
+    int rekey;
+    size_t tx_keys;
+    size_t rx_keys;
+    /* The type of the record being written, if it is not application data */
+    int ctrl_msg;
+    unsigned char type;
+} KTLS_TEST_CTX;
+
+static int ktls_test_new(BIO *bio);
+static int ktls_test_free(BIO *bio);
+static int ktls_test_read(BIO *bio, char *out, int outl);
+static int ktls_test_write(BIO *bio, const char *in, int inl);
+static int ktls_test_puts(BIO *bio, const char *str);
+static long ktls_test_ctrl(BIO *bio, int cmd, long num, void *ptr);
+
+const BIO_METHOD *bio_f_ktls_test_filter(void)
+{
+    if (method_ktls_test == NULL) {
+        if (!TEST_ptr(method_ktls_test =
+                          BIO_meth_new(BIO_TYPE_KTLS_TEST_FILTER,
+                                       "kTLS test filter"))
+            || !TEST_true(BIO_meth_set_write(method_ktls_test,
+                                             ktls_test_write))
+            || !TEST_true(BIO_meth_set_read(method_ktls_test, ktls_test_read))
+            || !TEST_true(BIO_meth_set_puts(method_ktls_test, ktls_test_puts))
+            || !TEST_true(BIO_meth_set_gets(method_ktls_test, tls_dump_gets))
+            || !TEST_true(BIO_meth_set_ctrl(method_ktls_test, ktls_test_ctrl))
+            || !TEST_true(BIO_meth_set_create(method_ktls_test,
+                                              ktls_test_new))
+            || !TEST_true(BIO_meth_set_destroy(method_ktls_test,
+                                               ktls_test_free)))
+            return NULL;
+    }
+    return method_ktls_test;
+}
+
+void bio_f_ktls_test_filter_free(void)
+{
+    BIO_meth_free(method_ktls_test);
+}
+
+static int ktls_test_new(BIO *bio)
+{
+    KTLS_TEST_CTX *ctx = OPENSSL_zalloc(sizeof(*ctx));
+
+    if (ctx == NULL)
+        return 0;
+    BIO_set_data(bio, ctx);
+    BIO_set_init(bio, 1);
+    return 1;
+}
+
+static int ktls_test_free(BIO *bio)
+{
+    OPENSSL_free(BIO_get_data(bio));
+    BIO_set_data(bio, NULL);
+    BIO_set_init(bio, 0);
+    return 1;
+}
+
+static int ktls_test_read(BIO *bio, char *out, int outl)
+{
+    KTLS_TEST_CTX *ctx = BIO_get_data(bio);
+    BIO *next = BIO_next(bio);
+    unsigned char *p = (unsigned char *)out;
+    int ret, len;
+
+    if (ctx->rx_keys == 0 || outl < SSL3_RT_HEADER_LENGTH) {
+        ret = BIO_read(next, out, outl);
+        copy_flags(bio);
+        return ret;
+    }
+
+    /* The writing end puts each record in at once */
+    ret = BIO_read(next, out, SSL3_RT_HEADER_LENGTH);
+    copy_flags(bio);
+    if (ret <= 0)
+        return ret;
+    len = (p[3] << 8) | p[4];
+    if (ret != SSL3_RT_HEADER_LENGTH || len > outl - SSL3_RT_HEADER_LENGTH
+            || BIO_read(next, out + SSL3_RT_HEADER_LENGTH, len) != len)
+        return -1;
+    return SSL3_RT_HEADER_LENGTH + len;
+}
+
+static int ktls_test_write(BIO *bio, const char *in, int inl)
+{
+    KTLS_TEST_CTX *ctx = BIO_get_data(bio);
+    BIO *next = BIO_next(bio);
+    unsigned char hdr[SSL3_RT_HEADER_LENGTH];
+    int ret;
+
+    if (ctx->tx_keys == 0) {
+        ret = BIO_write(next, in, inl);
+        copy_flags(bio);
+        return ret;
+    }
+
+    hdr[0] = ctx->ctrl_msg ? ctx->type : SSL3_RT_APPLICATION_DATA;
+    hdr[1] = TLS1_2_VERSION_MAJOR;
+    hdr[2] = TLS1_2_VERSION_MINOR;
+    hdr[3] = (unsigned char)(inl >> 8);
+    hdr[4] = (unsigned char)inl;
+    if (inl > SSL3_RT_MAX_PLAIN_LENGTH
+            || BIO_write(next, hdr, sizeof(hdr)) != (int)sizeof(hdr)
+            || BIO_write(next, in, inl) != inl)
+        return -1;
+    ctx->ctrl_msg = 0;
+    return inl;
+}
+
+static int ktls_test_puts(BIO *bio, const char *str)
+{
+    return ktls_test_write(bio, str, strlen(str));
+}
+
+static long ktls_test_ctrl(BIO *bio, int cmd, long num, void *ptr)
+{
+    KTLS_TEST_CTX *ctx = BIO_get_data(bio);
+    size_t *keys;
+
+    switch (cmd) {
+    case BIO_CTRL_SET_KTLS:
+        keys = num != 0 ? &ctx->tx_keys : &ctx->rx_keys;
+        /* Like a kernel that cannot do a TLSv1.3 key update, unless |rekey| */
+        if (*keys > 0 && !ctx->rekey)
+            return 0;
+        (*keys)++;
+        return 1;
+    case BIO_CTRL_GET_KTLS_REKEY:
+        return ctx->rekey;
+    case BIO_CTRL_GET_KTLS_SEND:
+        return ctx->tx_keys > 0;
+    case BIO_CTRL_GET_KTLS_RECV:
+        return ctx->rx_keys > 0;
+    case BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG:
+        ctx->type = (unsigned char)num;
+        ctx->ctrl_msg = 1;
+        return 1;
+    case BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG:
+        ctx->ctrl_msg = 0;
+        return 1;
+    default:
+        return tls_dump_ctrl(bio, cmd, num, ptr);
+    }
+}
+
+void ktls_test_filter_set_rekey(BIO *bio, int rekey)
+{
+    KTLS_TEST_CTX *ctx = BIO_get_data(bio);
+
+    ctx->rekey = rekey;
+}
+
+void ktls_test_filter_get_keys(BIO *bio, size_t *tx_keys, size_t *rx_keys)
+{
+    KTLS_TEST_CTX *ctx = BIO_get_data(bio);
+
+    *tx_keys = ctx->tx_keys;
+    *rx_keys = ctx->rx_keys;
+}
+
+static int ctrl_ok_read(BIO *bio, char *out, int outl);
+static int ctrl_ok_write(BIO *bio, const char *in, int inl);
+static int ctrl_ok_puts(BIO *bio, const char *str);
+static long ctrl_ok_ctrl(BIO *bio, int cmd, long num, void *ptr);
+
+const BIO_METHOD *bio_f_ctrl_ok_filter(void)
+{
+    if (method_ctrl_ok == NULL) {
+        if (!TEST_ptr(method_ctrl_ok =
+                          BIO_meth_new(BIO_TYPE_CTRL_OK_FILTER,
+                                       "ctrl ok filter"))
+            || !TEST_true(BIO_meth_set_write(method_ctrl_ok, ctrl_ok_write))
+            || !TEST_true(BIO_meth_set_read(method_ctrl_ok, ctrl_ok_read))
+            || !TEST_true(BIO_meth_set_puts(method_ctrl_ok, ctrl_ok_puts))
+            || !TEST_true(BIO_meth_set_gets(method_ctrl_ok, tls_dump_gets))
+            || !TEST_true(BIO_meth_set_ctrl(method_ctrl_ok, ctrl_ok_ctrl))
+            || !TEST_true(BIO_meth_set_create(method_ctrl_ok, tls_dump_new))
+            || !TEST_true(BIO_meth_set_destroy(method_ctrl_ok,
+                                               tls_dump_free)))
+            return NULL;
+    }
+    return method_ctrl_ok;
+}
+
+void bio_f_ctrl_ok_filter_free(void)
+{
+    BIO_meth_free(method_ctrl_ok);
+}
+
+static int ctrl_ok_read(BIO *bio, char *out, int outl)
+{
+    int ret = BIO_read(BIO_next(bio), out, outl);
+
+    copy_flags(bio);
+    return ret;
+}
+
+static int ctrl_ok_write(BIO *bio, const char *in, int inl)
+{
+    int ret = BIO_write(BIO_next(bio), in, inl);
+
+    copy_flags(bio);
+    return ret;
+}
+
+static int ctrl_ok_puts(BIO *bio, const char *str)
+{
+    return ctrl_ok_write(bio, str, strlen(str));
+}
+
+static long ctrl_ok_ctrl(BIO *bio, int cmd, long num, void *ptr)
+{
+    switch (cmd) {
+    case BIO_CTRL_FLUSH:
+    case BIO_CTRL_PENDING:
+    case BIO_CTRL_WPENDING:
+    case BIO_CTRL_DUP:
+        return tls_dump_ctrl(bio, cmd, num, ptr);
+    default:
+        return 1;
+    }
+}
+
 int create_ssl_ctx_pair(const SSL_METHOD *sm, const SSL_METHOD *cm,
                         int min_proto_version, int max_proto_version,
                         SSL_CTX **sctx, SSL_CTX **cctx, char *certfile,
@@ -822,6 +1178,103 @@ int create_ssl_objects(SSL_CTX *serverctx, SSL_CTX *clientctx, SSL **sssl,
     return 0;
 }
 
+#if !defined(OPENSSL_NO_SOCK) && defined(OPENSSL_SYS_UNIX)
+# include <errno.h>
+# include <fcntl.h>
+# include <sys/socket.h>
+# include <netinet/in.h>
+# include <netinet/tcp.h>
+# include <arpa/inet.h>
+
+/* Makes |fd| non-blocking, and sends small writes at once */
+static int set_nb(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0), on = 1;
+
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1
+           && setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) == 0;
+}
+
+/*
+ * Creates a connected pair of non-blocking TCP sockets over the loopback
+ * interface, for tests that need a real socket rather than a memory BIO.
+ */
+int create_test_sockets(int *cfdp, int *sfdp)
+{
+    struct sockaddr_in sin;
+    socklen_t slen = sizeof(sin);
+    int afd = -1, cfd = -1, sfd = -1, ret = 0;
+
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (!TEST_int_ge(afd = socket(AF_INET, SOCK_STREAM, 0), 0)
+            || !TEST_int_eq(bind(afd, (struct sockaddr *)&sin, sizeof(sin)),
+                            0)
+            || !TEST_int_eq(getsockname(afd, (struct sockaddr *)&sin, &slen),
+                            0)
+            || !TEST_int_eq(listen(afd, 1), 0)
+            || !TEST_int_ge(cfd = socket(AF_INET, SOCK_STREAM, 0), 0)
+            || !TEST_int_eq(connect(cfd, (struct sockaddr *)&sin, sizeof(sin)),
+                            0)
+            || !TEST_int_ge(sfd = accept(afd, NULL, NULL), 0)
+            || !TEST_true(set_nb(cfd))
+            || !TEST_true(set_nb(sfd)))
+        goto err;
+
+    *cfdp = cfd;
+    *sfdp = sfd;
+    cfd = sfd = -1;
+    ret = 1;
+ err:
+    if (cfd != -1)
+        close(cfd);
+    if (sfd != -1)
+        close(sfd);
+    if (afd != -1)
+        close(afd);
+    return ret;
+}
+
+/*
+ * As create_ssl_objects(), but the server and the client talk over the
+ * sockets |sfd| and |cfd|, which the caller closes.
+ */
+int create_ssl_objects2(SSL_CTX *serverctx, SSL_CTX *clientctx, SSL **sssl,
+                        SSL **cssl, int sfd, int cfd)
+{
+    SSL *serverssl = NULL, *clientssl = NULL;
+    BIO *s_bio = NULL, *c_bio = NULL;
+
+    if (*sssl != NULL)
+        serverssl = *sssl;
+    else if (!TEST_ptr(serverssl = SSL_new(serverctx)))
+        goto error;
+    if (*cssl != NULL)
+        clientssl = *cssl;
+    else if (!TEST_ptr(clientssl = SSL_new(clientctx)))
+        goto error;
+
+    if (!TEST_ptr(s_bio = BIO_new_socket(sfd, BIO_NOCLOSE))
+            || !TEST_ptr(c_bio = BIO_new_socket(cfd, BIO_NOCLOSE)))
+        goto error;
+
+    SSL_set_bio(serverssl, s_bio, s_bio);
+    SSL_set_bio(clientssl, c_bio, c_bio);
+    *sssl = serverssl;
+    *cssl = clientssl;
+    return 1;
+
+ error:
+    SSL_free(serverssl);
+    SSL_free(clientssl);
+    BIO_free(s_bio);
+    BIO_free(c_bio);
+    return 0;
+}
+#endif
+
 /*
  * Create an SSL connection, but does not ready any post-handshake
  * NewSessionTicket messages.
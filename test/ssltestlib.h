@@ -22,6 +22,11 @@ int create_bare_ssl_connection(SSL *serverssl, SSL *clientssl, int want,
                                int read);
 int create_ssl_connection(SSL *serverssl, SSL *clientssl, int want);
 void shutdown_ssl_connection(SSL *serverssl, SSL *clientssl);
+# if !defined(OPENSSL_NO_SOCK) && defined(OPENSSL_SYS_UNIX)
+int create_test_sockets(int *cfd, int *sfd);
+int create_ssl_objects2(SSL_CTX *serverctx, SSL_CTX *clientctx, SSL **sssl,
+                        SSL **cssl, int sfd, int cfd);
+# endif
 
 /* Note: Not thread safe! */
 const BIO_METHOD *bio_f_tls_dump_filter(void);
@@ -33,6 +38,29 @@ void bio_s_mempacket_test_free(void);
 const BIO_METHOD *bio_s_always_retry(void);
 void bio_s_always_retry_free(void);
 
+/* Counts the writes and TLS records passing through it. Not thread safe! */
+const BIO_METHOD *bio_f_tls_count_filter(void);
+void bio_f_tls_count_filter_free(void);
+void tls_count_filter_get(BIO *bio, size_t *writes, size_t *records);
+void tls_count_filter_reset(BIO *bio);
+
+/*
+ * Stands in for the kernel (kTLS) on one direction of a connection, without
+ * encrypting anything. Takes new keys for a direction that has some, and says
+ * so, only if set to with ktls_test_filter_set_rekey(). Not thread safe!
+ */
+const BIO_METHOD *bio_f_ktls_test_filter(void);
+void bio_f_ktls_test_filter_free(void);
+void ktls_test_filter_set_rekey(BIO *bio, int rekey);
+void ktls_test_filter_get_keys(BIO *bio, size_t *tx_keys, size_t *rx_keys);
+
+/*
+ * Passes everything through and answers 1 to every ctrl that it does not
+ * know, which filters are free to do. Not thread safe!
+ */
+const BIO_METHOD *bio_f_ctrl_ok_filter(void);
+void bio_f_ctrl_ok_filter_free(void);
+
 /* Packet types - value 0 is reserved */
 #define INJECT_PACKET                   1
 #define INJECT_PACKET_IGNORE_REC_SEQ    2
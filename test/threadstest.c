@@ -11,7 +11,11 @@
 # include <windows.h>
 #endif
 
+#include <string.h>
 #include <openssl/crypto.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <oqs/oqs.h>
 #include "testutil.h"
 
 #if !defined(OPENSSL_THREADS) || defined(CRYPTO_TDEBUG)
@@ -184,10 +188,126 @@ static int test_thread_local(void)
     return 1;
 }
 
+#define OQS_SIGN_THREADS    8
+#define OQS_SIGN_ROUNDS     50
+
+static EVP_PKEY *oqs_sign_key = NULL;
+static CRYPTO_RWLOCK *oqs_sign_lock = NULL;
+static int oqs_sign_failures = 0;
+
+/* Signs and verifies with the shared key, in streaming and one-shot mode */
+static int oqs_sign_rounds(void)
+{
+    EVP_MD_CTX *sctx = EVP_MD_CTX_new(), *vctx = EVP_MD_CTX_new();
+    unsigned char msg[1024], *sig = NULL;
+    size_t siglen, sigmax = (size_t)EVP_PKEY_size(oqs_sign_key);
+    int i, ok = 0;
+
+    if (sctx == NULL || vctx == NULL
+            || (sig = OPENSSL_malloc(sigmax)) == NULL)
+        goto end;
+
+    for (i = 0; i < OQS_SIGN_ROUNDS; i++) {
+        /* Make the message unique to this thread and round */
+        memset(msg, i, sizeof(msg));
+        memcpy(msg, &sctx, sizeof(sctx));
+
+        /* The contexts are reused from round to round */
+        siglen = sigmax;
+        if (EVP_DigestSignInit(sctx, NULL, NULL, NULL, oqs_sign_key) != 1
+                || EVP_DigestSignUpdate(sctx, msg, 100) != 1
+                || EVP_DigestSignUpdate(sctx, msg + 100,
+                                        sizeof(msg) - 100) != 1
+                || EVP_DigestSignFinal(sctx, sig, &siglen) != 1
+                || EVP_DigestVerifyInit(vctx, NULL, NULL, NULL,
+                                        oqs_sign_key) != 1
+                || EVP_DigestVerifyUpdate(vctx, msg, sizeof(msg)) != 1
+                || EVP_DigestVerifyFinal(vctx, sig, siglen) != 1)
+            goto end;
+
+        /* Another message must not verify */
+        msg[sizeof(msg) - 1] ^= 1;
+        if (EVP_DigestVerifyInit(vctx, NULL, NULL, NULL, oqs_sign_key) != 1
+                || EVP_DigestVerifyUpdate(vctx, msg, sizeof(msg)) != 1
+                || EVP_DigestVerifyFinal(vctx, sig, siglen) == 1)
+            goto end;
+        ERR_clear_error();
+
+        siglen = sigmax;
+        if (EVP_DigestSignInit(sctx, NULL, NULL, NULL, oqs_sign_key) != 1
+                || EVP_DigestSign(sctx, sig, &siglen, msg, sizeof(msg)) != 1
+                || EVP_DigestVerifyInit(vctx, NULL, NULL, NULL,
+                                        oqs_sign_key) != 1
+                || EVP_DigestVerify(vctx, sig, siglen, msg, sizeof(msg)) != 1)
+            goto end;
+    }
+    ok = 1;
+
+ end:
+    OPENSSL_free(sig);
+    EVP_MD_CTX_free(sctx);
+    EVP_MD_CTX_free(vctx);
+    return ok;
+}
+
+static void oqs_sign_thread_cb(void)
+{
+    int ret;
+
+    if (!oqs_sign_rounds())
+        CRYPTO_atomic_add(&oqs_sign_failures, 1, &ret, oqs_sign_lock);
+}
+
+/*
+ * Signs concurrently with a single OQS key from many threads.
+ * Test 0: PQ signature
+ * Test 1: hybrid signature
+ */
+static int test_oqs_multi_sign(int idx)
+{
+    int nid = idx == 0 ? NID_dilithium2 : NID_p256_dilithium2;
+    thread_t threads[OQS_SIGN_THREADS];
+    EVP_PKEY_CTX *kctx = NULL;
+    int i, started = 0, testresult = 0;
+
+    if (!OQS_SIG_alg_is_enabled(get_oqs_alg_name(nid))) {
+        TEST_note("%s not enabled in liboqs, skipping", OBJ_nid2sn(nid));
+        return 1;
+    }
+
+    oqs_sign_failures = 0;
+    if (!TEST_ptr(oqs_sign_lock = CRYPTO_THREAD_lock_new())
+            || !TEST_ptr(kctx = EVP_PKEY_CTX_new_id(nid, NULL))
+            || !TEST_int_gt(EVP_PKEY_keygen_init(kctx), 0)
+            || !TEST_int_gt(EVP_PKEY_keygen(kctx, &oqs_sign_key), 0))
+        goto end;
+
+    for (started = 0; started < OQS_SIGN_THREADS; started++) {
+        if (!TEST_true(run_thread(&threads[started], oqs_sign_thread_cb)))
+            break;
+    }
+    testresult = started == OQS_SIGN_THREADS;
+    for (i = 0; i < started; i++) {
+        if (!TEST_true(wait_for_thread(threads[i])))
+            testresult = 0;
+    }
+    if (!TEST_int_eq(oqs_sign_failures, 0))
+        testresult = 0;
+
+ end:
+    EVP_PKEY_CTX_free(kctx);
+    EVP_PKEY_free(oqs_sign_key);
+    oqs_sign_key = NULL;
+    CRYPTO_THREAD_lock_free(oqs_sign_lock);
+    oqs_sign_lock = NULL;
+    return testresult;
+}
+
 int setup_tests(void)
 {
     ADD_TEST(test_lock);
     ADD_TEST(test_once);
     ADD_TEST(test_thread_local);
+    ADD_ALL_TESTS(test_oqs_multi_sign, 2);
     return 1;
 }
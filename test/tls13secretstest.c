@@ -196,6 +196,13 @@ int ssl_log_secret(SSL *ssl,
     return 1;
 }
 
+int ssl_ktls_change_cipher_state(SSL *s, int sending,
+                                 const unsigned char *key,
+                                 const unsigned char *iv)
+{
+    return 1;
+}
+
 const EVP_MD *ssl_md(int idx)
 {
     return EVP_sha256();
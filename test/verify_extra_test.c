@@ -11,8 +11,13 @@
 #include <openssl/crypto.h>
 #include <openssl/bio.h>
 #include <openssl/x509.h>
+#include <openssl/x509v3.h>
+#include <openssl/evp.h>
+#include <openssl/objects.h>
 #include <openssl/pem.h>
 #include <openssl/err.h>
+#include <oqs/oqs.h>
+#include "crypto/evp.h"
 #include "testutil.h"
 
 static const char *roots_f;
@@ -175,6 +180,331 @@ static int test_store_ctx(void)
     return testresult;
 }
 
+/*
+ * Every OQS signature NID resolves to one shared descriptor, which a hybrid
+ * shares with its PQ component
+ */
+static int test_oqs_sig_registry(void)
+{
+    const OQS_SIG *sig;
+    const char *name;
+    int nid;
+
+    for (nid = NID_oqs_sig_default; IS_OQS_OPENSSL_SIG_NID(nid); nid++) {
+        name = get_oqs_alg_name(nid);
+        sig = get_oqs_sig(nid);
+        if (!OQS_SIG_alg_is_enabled(name)) {
+            if (!TEST_ptr_null(sig))
+                return 0;
+            continue;
+        }
+        if (!TEST_ptr(sig)
+                || !TEST_str_eq(sig->method_name, name)
+                || !TEST_ptr_eq(get_oqs_sig(nid), sig))
+            return 0;
+    }
+    if (OQS_SIG_alg_is_enabled(get_oqs_alg_name(NID_dilithium2))
+            && (!TEST_ptr_eq(get_oqs_sig(NID_p256_dilithium2),
+                             get_oqs_sig(NID_dilithium2))
+                || !TEST_ptr_eq(get_oqs_sig(NID_rsa3072_dilithium2),
+                                get_oqs_sig(NID_dilithium2))))
+        return 0;
+    return TEST_ptr_null(get_oqs_sig(NID_rsaEncryption))
+        && TEST_ptr_null(get_oqs_sig(NID_kyber512))
+        && TEST_ptr_null(get_oqs_sig(NID_oqs_sig_default - 1));
+}
+
+static EVP_PKEY *oqs_keygen(int nid)
+{
+    EVP_PKEY_CTX *kctx = EVP_PKEY_CTX_new_id(nid, NULL);
+    EVP_PKEY *pkey = NULL;
+
+    if (kctx == NULL
+            || EVP_PKEY_keygen_init(kctx) <= 0
+            || EVP_PKEY_keygen(kctx, &pkey) <= 0) {
+        EVP_PKEY_free(pkey);
+        pkey = NULL;
+    }
+    EVP_PKEY_CTX_free(kctx);
+    return pkey;
+}
+
+static X509 *make_cert(const char *cn, EVP_PKEY *pkey, X509 *issuer,
+                       EVP_PKEY *issuer_key, int ca)
+{
+    X509 *x = X509_new();
+    X509_NAME *name = NULL;
+    X509_EXTENSION *ext = NULL;
+    int ok = 0;
+
+    if (x == NULL
+            || !X509_set_version(x, 2)
+            || !ASN1_INTEGER_set(X509_get_serialNumber(x), 1)
+            || X509_gmtime_adj(X509_getm_notBefore(x), 0) == NULL
+            || X509_gmtime_adj(X509_getm_notAfter(x), 3600) == NULL
+            || (name = X509_NAME_new()) == NULL
+            || !X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                           (const unsigned char *)cn, -1,
+                                           -1, 0)
+            || !X509_set_subject_name(x, name)
+            || !X509_set_issuer_name(x, issuer != NULL
+                                        ? X509_get_subject_name(issuer)
+                                        : name)
+            || !X509_set_pubkey(x, pkey))
+        goto err;
+    if (ca && ((ext = X509V3_EXT_conf_nid(NULL, NULL, NID_basic_constraints,
+                                          "critical,CA:TRUE")) == NULL
+               || !X509_add_ext(x, ext, -1)))
+        goto err;
+    if (X509_sign(x, issuer_key, EVP_sha512()) <= 0)
+        goto err;
+    ok = 1;
+ err:
+    X509_EXTENSION_free(ext);
+    X509_NAME_free(name);
+    if (!ok) {
+        X509_free(x);
+        x = NULL;
+    }
+    return x;
+}
+
+static int (*oqs_verify_batch)(EVP_PKEY_VERIFY_ITEM *items, size_t num);
+static size_t oqs_batched = 0;
+
+static int counting_verify_batch(EVP_PKEY_VERIFY_ITEM *items, size_t num)
+{
+    oqs_batched += num;
+    return oqs_verify_batch(items, num);
+}
+
+/*
+ * Verify an OQS chain whose signatures are checked in one batch.
+ * Test 0: good chain
+ * Test 1: bad intermediate signature
+ */
+static int test_oqs_batch_chain(int tst)
+{
+    EVP_PKEY *root_key = NULL, *ca_key = NULL, *ee_key = NULL;
+    X509 *root = NULL, *ca = NULL, *ee = NULL;
+    X509_STORE *store = NULL;
+    X509_STORE_CTX *sctx = NULL;
+    STACK_OF(X509) *untrusted = NULL;
+    const EVP_PKEY_METHOD *orig;
+    EVP_PKEY_METHOD *meth = NULL;
+    int testresult = 0;
+
+    if (!OQS_SIG_alg_is_enabled(get_oqs_alg_name(NID_dilithium2))) {
+        TEST_note("dilithium2 not enabled in liboqs, skipping");
+        return 1;
+    }
+
+    if (!TEST_ptr(root_key = oqs_keygen(NID_dilithium2))
+            || !TEST_ptr(ca_key = oqs_keygen(NID_p256_dilithium2))
+            || !TEST_ptr(ee_key = oqs_keygen(NID_dilithium2))
+            || !TEST_ptr(root = make_cert("Root", root_key, NULL, root_key, 1))
+            || !TEST_ptr(ca = make_cert("CA", ca_key, root, root_key, 1))
+            || !TEST_ptr(ee = make_cert("EE", ee_key, ca, ca_key, 0)))
+        goto err;
+
+    if (tst == 1) {
+        const ASN1_BIT_STRING *sig;
+
+        X509_get0_signature(&sig, NULL, ca);
+        ((ASN1_BIT_STRING *)sig)->data[0] ^= 1;
+    }
+
+    if (!TEST_ptr(store = X509_STORE_new())
+            || !TEST_true(X509_STORE_add_cert(store, root))
+            || !TEST_ptr(untrusted = sk_X509_new_null())
+            || !TEST_true(sk_X509_push(untrusted, ca))
+            || !TEST_ptr(sctx = X509_STORE_CTX_new())
+            || !TEST_true(X509_STORE_CTX_init(sctx, store, ee, untrusted)))
+        goto err;
+
+    /* Count the signatures by the root key that are verified in a batch */
+    if (!TEST_ptr(orig = EVP_PKEY_meth_find(NID_dilithium2))
+            || !TEST_ptr(orig->digestverify_batch)
+            || !TEST_ptr(meth = EVP_PKEY_meth_new(NID_dilithium2, 0)))
+        goto err;
+    *meth = *orig;
+    meth->flags |= EVP_PKEY_FLAG_DYNAMIC;
+    oqs_verify_batch = orig->digestverify_batch;
+    meth->digestverify_batch = counting_verify_batch;
+    oqs_batched = 0;
+    if (!TEST_true(EVP_PKEY_meth_add0(meth))) {
+        EVP_PKEY_meth_free(meth);
+        meth = NULL;
+        goto err;
+    }
+
+    if (tst == 1) {
+        if (!TEST_int_eq(X509_verify_cert(sctx), 0)
+                || !TEST_int_eq(X509_STORE_CTX_get_error(sctx),
+                                X509_V_ERR_CERT_SIGNATURE_FAILURE)
+                || !TEST_int_eq(X509_STORE_CTX_get_error_depth(sctx), 1))
+            goto err;
+    } else if (!TEST_int_eq(X509_verify_cert(sctx), 1)) {
+        goto err;
+    }
+    /* The signature of the CA, good or bad */
+    if (!TEST_size_t_eq(oqs_batched, 1))
+        goto err;
+
+    testresult = 1;
+ err:
+    if (meth != NULL) {
+        EVP_PKEY_meth_remove(meth);
+        EVP_PKEY_meth_free(meth);
+    }
+    X509_STORE_CTX_free(sctx);
+    sk_X509_free(untrusted);
+    X509_STORE_free(store);
+    X509_free(root);
+    X509_free(ca);
+    X509_free(ee);
+    EVP_PKEY_free(root_key);
+    EVP_PKEY_free(ca_key);
+    EVP_PKEY_free(ee_key);
+    return testresult;
+}
+
+#if defined(OPENSSL_SYS_UNIX)
+# include <sys/resource.h>
+
+/* Peak resident set size of this process so far, in kB */
+static long peak_rss_kb(void)
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        return 0;
+    return ru.ru_maxrss;
+}
+#else
+static long peak_rss_kb(void)
+{
+    return 0;
+}
+#endif
+
+# define ZERO_COPY_CERTS 16
+
+/*
+ * Parses |der| ZERO_COPY_CERTS times, keeping the certificates and their keys
+ * alive, and returns by how much that grew the peak RSS
+ */
+static int parse_certs(const unsigned char *der, int derlen, long *growth)
+{
+    X509 *certs[ZERO_COPY_CERTS] = { NULL };
+    long before = peak_rss_kb();
+    const unsigned char *p;
+    int i, ret = 0;
+
+    for (i = 0; i < ZERO_COPY_CERTS; i++) {
+        p = der;
+        if (!TEST_ptr(certs[i] = d2i_X509(NULL, &p, derlen))
+                || !TEST_ptr(X509_get0_pubkey(certs[i])))
+            goto err;
+    }
+    *growth = peak_rss_kb() - before;
+    ret = 1;
+ err:
+    for (i = 0; i < ZERO_COPY_CERTS; i++)
+        X509_free(certs[i]);
+    return ret;
+}
+
+/*
+ * Decode OQS public keys that reference the encoding instead of a copy.
+ * Test 0: the PQ scheme with the largest public key
+ * Test 1: hybrid scheme
+ */
+static int test_oqs_zero_copy_keys(int tst)
+{
+    EVP_PKEY *key = NULL, *pubkey = NULL, *spki_key = NULL;
+    X509 *cert = NULL, *x = NULL;
+    unsigned char *der = NULL, *spki = NULL;
+    const unsigned char *p;
+    const int *nids = get_oqssl_sig_nids();
+    int nid = NID_undef, derlen, spkilen, i, testresult = 0;
+    long zero_copy_kb = 0, copy_kb = 0;
+    size_t pubkey_len = 0;
+
+    if (tst == 0) {
+        for (i = 0; i < OQS_OPENSSL_SIG_algs_length; i++) {
+            const OQS_SIG *sig = get_oqs_sig(nids[i]);
+
+            if (sig != NULL && nids[i] != NID_oqs_sig_default
+                    && get_oqs_classical_nid(nids[i]) == 0
+                    && sig->length_public_key > pubkey_len) {
+                nid = nids[i];
+                pubkey_len = sig->length_public_key;
+            }
+        }
+    } else if (get_oqs_sig(NID_p256_dilithium2) != NULL) {
+        nid = NID_p256_dilithium2;
+        pubkey_len = get_oqs_sig(nid)->length_public_key;
+    }
+    if (nid == NID_undef) {
+        TEST_note("no suitable OQS signature enabled in liboqs, skipping");
+        return 1;
+    }
+
+    if (!TEST_ptr(key = oqs_keygen(nid))
+            || !TEST_ptr(cert = make_cert("Zero copy", key, NULL, key, 0))
+            || !TEST_int_gt(derlen = i2d_X509(cert, &der), 0)
+            || !TEST_int_gt(spkilen = i2d_PUBKEY(key, &spki), 0))
+        goto err;
+
+    EVP_set_oqs_key_zero_copy(1);
+
+    /* The key outlives the certificate it references */
+    p = der;
+    if (!TEST_ptr(x = d2i_X509(NULL, &p, derlen))
+            || !TEST_ptr(pubkey = X509_get_pubkey(x))
+            || !TEST_int_eq(X509_verify(x, pubkey), 1))
+        goto err;
+    X509_free(x);
+    p = der;
+    if (!TEST_ptr(x = d2i_X509(NULL, &p, derlen))
+            || !TEST_int_eq(EVP_PKEY_cmp(pubkey, key), 1)
+            || !TEST_int_eq(X509_verify(x, pubkey), 1))
+        goto err;
+
+    /* d2i_PUBKEY() frees the X509_PUBKEY it decodes the key from */
+    p = spki;
+    if (!TEST_ptr(spki_key = d2i_PUBKEY(NULL, &p, spkilen))
+            || !TEST_int_eq(EVP_PKEY_cmp(spki_key, key), 1)
+            || !TEST_int_eq(X509_verify(x, spki_key), 1))
+        goto err;
+
+    /* Zero-copy first, so that it doesn't benefit from an earlier peak */
+    if (!parse_certs(der, derlen, &zero_copy_kb))
+        goto err;
+    EVP_set_oqs_key_zero_copy(0);
+    if (!parse_certs(der, derlen, &copy_kb))
+        goto err;
+    TEST_info("%s: %d certificates with %zu byte keys grew the peak RSS by "
+              "%ld kB with zero-copy keys, %ld kB without", OBJ_nid2sn(nid),
+              ZERO_COPY_CERTS, pubkey_len, zero_copy_kb, copy_kb);
+    /* Only large keys make a difference beyond the noise */
+    if (pubkey_len >= 256 * 1024 && !TEST_long_lt(zero_copy_kb, copy_kb))
+        goto err;
+
+    testresult = 1;
+ err:
+    EVP_set_oqs_key_zero_copy(0);
+    OPENSSL_free(der);
+    OPENSSL_free(spki);
+    X509_free(x);
+    X509_free(cert);
+    EVP_PKEY_free(spki_key);
+    EVP_PKEY_free(pubkey);
+    EVP_PKEY_free(key);
+    return testresult;
+}
+
 int setup_tests(void)
 {
     if (!TEST_ptr(roots_f = test_get_argument(0))
@@ -186,5 +516,8 @@ int setup_tests(void)
 
     ADD_TEST(test_alt_chains_cert_forgery);
     ADD_TEST(test_store_ctx);
+    ADD_TEST(test_oqs_sig_registry);
+    ADD_ALL_TESTS(test_oqs_batch_chain, 2);
+    ADD_ALL_TESTS(test_oqs_zero_copy_keys, 2);
     return 1;
 }